@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "autosave.h"
+#include "build_options.h"
+#include "config.h"
+#include "debug_utils.h"
+#include "file_utils.h"
+
+#include "gb_core/gameboy.h"
+#include "gb_core/rom.h"
+
+#include "gba_core/save.h"
+
+// Time without writes to the save memory before the data is saved
+#define AUTOSAVE_IDLE_MS    2000
+// Games that write all the time are saved at least this often
+#define AUTOSAVE_MAX_WAIT_MS 10000
+
+#define AUTOSAVE_BUFFER_SIZE \
+    ((GBA_SAVE_MAX_SIZE > GB_SRAM_SAVE_MAX_SIZE) ? \
+     GBA_SAVE_MAX_SIZE : GB_SRAM_SAVE_MAX_SIZE)
+
+typedef struct
+{
+    u8 data[AUTOSAVE_BUFFER_SIZE];
+    size_t size;
+    char path[MAX_PATHLEN + 4];
+} autosave_job;
+
+// One buffer can be written by the thread while the other one is filled
+static autosave_job autosave_jobs[2];
+
+static SDL_Thread *autosave_thread = NULL;
+static SDL_mutex *autosave_mutex = NULL;
+static SDL_cond *autosave_cond = NULL;
+
+// All the variables below are protected by autosave_mutex
+static int autosave_pending_index = -1; // Job waiting to be written
+static int autosave_writing_index = -1; // Job being written by the thread
+static int autosave_quit = 0;
+
+// Only used from the thread that emulates the frames
+static int autosave_is_dirty = 0;
+static Uint32 autosave_first_dirty_ticks;
+static Uint32 autosave_last_dirty_ticks;
+
+static int _autosave_thread_func(void *data)
+{
+    (void)data;
+
+    SDL_LockMutex(autosave_mutex);
+
+    while (1)
+    {
+        while ((autosave_pending_index < 0) && !autosave_quit)
+            SDL_CondWait(autosave_cond, autosave_mutex);
+
+        if (autosave_pending_index < 0)
+            break; // Quit, and there is nothing left to save
+
+        int index = autosave_pending_index;
+        autosave_pending_index = -1;
+        autosave_writing_index = index;
+
+        SDL_UnlockMutex(autosave_mutex);
+
+        autosave_job *job = &autosave_jobs[index];
+        FileSaveAtomic(job->path, job->data, job->size);
+
+        SDL_LockMutex(autosave_mutex);
+
+        autosave_writing_index = -1;
+        SDL_CondBroadcast(autosave_cond);
+    }
+
+    SDL_UnlockMutex(autosave_mutex);
+
+    return 0;
+}
+
+int Autosave_Init(void)
+{
+    autosave_mutex = SDL_CreateMutex();
+    autosave_cond = SDL_CreateCond();
+    if ((autosave_mutex == NULL) || (autosave_cond == NULL))
+    {
+        Debug_ErrorMsgArg("Autosave: Failed to create mutex: %s",
+                          SDL_GetError());
+        return 0;
+    }
+
+    autosave_quit = 0;
+    autosave_thread = SDL_CreateThread(_autosave_thread_func, "Autosave",
+                                       NULL);
+    if (autosave_thread == NULL)
+    {
+        Debug_ErrorMsgArg("Autosave: Failed to create thread: %s",
+                          SDL_GetError());
+        return 0;
+    }
+
+    return 1;
+}
+
+void Autosave_End(void)
+{
+    if (autosave_thread == NULL)
+        return;
+
+    // Pending data is written before the thread exits
+    SDL_LockMutex(autosave_mutex);
+    autosave_quit = 1;
+    SDL_CondBroadcast(autosave_cond);
+    SDL_UnlockMutex(autosave_mutex);
+
+    SDL_WaitThread(autosave_thread, NULL);
+    autosave_thread = NULL;
+
+    SDL_DestroyCond(autosave_cond);
+    SDL_DestroyMutex(autosave_mutex);
+    autosave_cond = NULL;
+    autosave_mutex = NULL;
+}
+
+void Autosave_Cancel(void)
+{
+    autosave_is_dirty = 0;
+
+    if (autosave_thread == NULL)
+        return;
+
+    SDL_LockMutex(autosave_mutex);
+
+    autosave_pending_index = -1;
+    while (autosave_writing_index >= 0)
+        SDL_CondWait(autosave_cond, autosave_mutex);
+
+    SDL_UnlockMutex(autosave_mutex);
+}
+
+// Returns 1 if the save data has to be sent to the thread now
+static int _autosave_update(int core_is_dirty)
+{
+    Uint32 now = SDL_GetTicks();
+
+    if (core_is_dirty)
+    {
+        if (!autosave_is_dirty)
+            autosave_first_dirty_ticks = now;
+        autosave_last_dirty_ticks = now;
+        autosave_is_dirty = 1;
+    }
+
+    if (!autosave_is_dirty)
+        return 0;
+
+    if ((now - autosave_last_dirty_ticks) >= AUTOSAVE_IDLE_MS)
+        return 1;
+
+    if ((now - autosave_first_dirty_ticks) >= AUTOSAVE_MAX_WAIT_MS)
+        return 1;
+
+    return 0;
+}
+
+// Returns the job that can be filled by the emulation. The mutex must be
+// locked by the caller.
+static autosave_job *_autosave_get_free_job(int *index)
+{
+    *index = (autosave_writing_index == 0) ? 1 : 0;
+    return &autosave_jobs[*index];
+}
+
+static void _autosave_submit(int index)
+{
+    autosave_pending_index = index;
+    SDL_CondBroadcast(autosave_cond);
+
+    autosave_is_dirty = 0;
+}
+
+void Autosave_HandleGBA(void)
+{
+    if ((autosave_thread == NULL) || !EmulatorConfig.autosave)
+        return;
+
+    int core_is_dirty = GBA_SaveIsDirty();
+    GBA_SaveClearDirty();
+
+    if (!_autosave_update(core_is_dirty))
+        return;
+
+    int index;
+
+    SDL_LockMutex(autosave_mutex);
+
+    autosave_job *job = _autosave_get_free_job(&index);
+    job->size = GBA_SaveGetData(job->data);
+    if (job->size > 0)
+    {
+        GBA_SaveGetFilename(job->path, sizeof(job->path));
+        _autosave_submit(index);
+    }
+    else
+    {
+        autosave_is_dirty = 0;
+    }
+
+    SDL_UnlockMutex(autosave_mutex);
+}
+
+void Autosave_HandleGB(void)
+{
+    if ((autosave_thread == NULL) || !EmulatorConfig.autosave)
+        return;
+
+    int core_is_dirty = GB_SRAM_IsDirty();
+    GB_SRAM_ClearDirty();
+
+    if (!_autosave_update(core_is_dirty))
+        return;
+
+    int index;
+
+    SDL_LockMutex(autosave_mutex);
+
+    autosave_job *job = _autosave_get_free_job(&index);
+    job->size = GB_SRAM_GetData(job->data);
+    if (job->size > 0)
+    {
+        GB_SRAM_GetFilename(job->path, sizeof(job->path));
+        _autosave_submit(index);
+    }
+    else
+    {
+        autosave_is_dirty = 0;
+    }
+
+    SDL_UnlockMutex(autosave_mutex);
+}
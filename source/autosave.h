@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef AUTOSAVE__
+#define AUTOSAVE__
+
+// Starts and stops the thread that writes battery saves to disk
+int Autosave_Init(void);
+void Autosave_End(void);
+
+// Call once per emulated frame. When the game has written to its save memory,
+// the data is written to the save file after a few seconds without writes.
+void Autosave_HandleGBA(void);
+void Autosave_HandleGB(void);
+
+// Drops any pending write and waits until the thread is idle. Call it before
+// unloading a ROM so that the final save isn't overwritten by old data.
+void Autosave_Cancel(void);
+
+#endif // AUTOSAVE__
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef BENCH__
+#define BENCH__
+
+#include "../general_utils.h"
+
+// Benchmark suite of the emulator. It runs without creating any window. Each
+// benchmark runs a number of iterations of the code being measured, and the
+// result is the time of one iteration. Lower values are always better.
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    double scale; // Multiplier to convert seconds per iteration to 'unit'
+    // Returns 1 on success. 'arg' is only used by some macro benchmarks.
+    int (*setup)(const char *arg);
+    void (*run)(u32 iterations);
+    void (*cleanup)(void);
+} bench_t;
+
+// Lists of benchmarks. They end with an entry with a NULL name.
+extern const bench_t bench_gba_list[];
+extern const bench_t bench_gb_list[];
+extern const bench_t bench_macro_list[];
+
+// Macro benchmark of a ROM file. The setup argument is the path to the ROM.
+extern const bench_t bench_macro_rom;
+
+// Checks that the fast paths of the copy and decompression functions of the
+// GBA BIOS give the same results as the regular code on 'cases' random inputs
+// per function. It returns the number of mismatches, or -1 on error.
+int Bench_GBASwiCheck(u32 cases);
+
+// Results are written here so that the compiler can't remove the code that
+// generates them.
+extern volatile u32 bench_sink;
+
+// Synthetic test ROMs
+// -------------------
+
+// GBA ROM that fills VRAM, palettes and OAM with noise, enables all
+// backgrounds, sprites and alpha blending in mode 0, and then runs a loop of
+// ARM and THUMB code that works with IWRAM.
+#define BENCH_GBA_ARM_LOOP      0x08000180 // Only the ARM part of the loop
+#define BENCH_GBA_THUMB_LOOP    0x080001A2 // Only the THUMB part of the loop
+
+// GB ROM that fills VRAM with a pattern, turns on the screen and runs a loop
+// that works with WRAM.
+#define BENCH_GB_CPU_LOOP       0x016D // Loop without the initialization
+
+// Load the synthetic ROMs. They use the emulated GBA BIOS and no GB boot ROM.
+// They return 1 on success.
+int Bench_GBALoadSynthetic(void);
+int Bench_GBLoadSynthetic(void);
+// The same GB ROM in a GB Camera cartridge. The webcam image is read from
+// EmulatorConfig.webcam_file, which must be set before loading it.
+int Bench_GBLoadSyntheticCamera(void);
+
+// Load a ROM file. The system is selected by the extension of the file. It
+// returns 1 on success.
+int Bench_LoadFile(const char *path);
+
+// Unload whatever ROM has been loaded
+void Bench_Unload(void);
+
+// Returns 1 if the loaded ROM is a GBA ROM, 0 if it is a GB ROM
+int Bench_IsGBA(void);
+
+// Run the loaded ROM for one frame and convert the result to RGB
+void Bench_RunFrame(void);
+
+#endif // BENCH__
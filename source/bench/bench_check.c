@@ -0,0 +1,347 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../build_options.h"
+#include "../general_utils.h"
+
+#include "../gba_core/bios.h"
+#include "../gba_core/cpu.h"
+#include "../gba_core/memory.h"
+
+// Each case is run twice from the same initial state, once with the fast paths
+// of the BIOS functions and once going through the memory bus. The state of
+// all the RAM regions and the registers must be the same after both runs.
+
+typedef struct {
+    u32 address;
+    u32 size;
+} bench_check_region_t;
+
+static const bench_check_region_t bench_check_regions[] = {
+    { 0x02000000, 256 * 1024 }, // EWRAM
+    { 0x03000000, 32 * 1024 },  // IWRAM
+    { 0x05000000, 1024 },       // Palettes
+    { 0x06000000, 96 * 1024 },  // VRAM
+    { 0x07000000, 1024 },       // OAM
+};
+
+#define BENCH_CHECK_NUM_REGIONS ARRAY_NUM_ELEMENTS(bench_check_regions)
+
+#define BENCH_CHECK_STATE_SIZE  ((256 + 32 + 1 + 96 + 1) * 1024)
+
+// Maximum size of the data generated by one case
+#define BENCH_CHECK_MAX_SIZE    (8 * 1024)
+#define BENCH_CHECK_STREAM_SIZE (BENCH_CHECK_MAX_SIZE * 4 + 1024)
+
+static u8 bench_check_initial[BENCH_CHECK_STATE_SIZE];
+static u8 bench_check_fast[BENCH_CHECK_STATE_SIZE];
+static u8 bench_check_stream[BENCH_CHECK_STREAM_SIZE];
+
+static u32 bench_check_seed;
+
+static u32 bench_check_rand(void)
+{
+    bench_check_seed ^= bench_check_seed << 13;
+    bench_check_seed ^= bench_check_seed >> 17;
+    bench_check_seed ^= bench_check_seed << 5;
+    return bench_check_seed;
+}
+
+// Returns the position of an address inside of a state buffer
+static u8 *bench_check_state_ptr(u8 *state, u32 address)
+{
+    for (size_t i = 0; i < BENCH_CHECK_NUM_REGIONS; i++)
+    {
+        const bench_check_region_t *r = &bench_check_regions[i];
+        if ((address >= r->address) && (address < r->address + r->size))
+            return state + (address - r->address);
+        state += r->size;
+    }
+
+    return NULL;
+}
+
+static void bench_check_state_save(u8 *state)
+{
+    for (size_t i = 0; i < BENCH_CHECK_NUM_REGIONS; i++)
+    {
+        const bench_check_region_t *r = &bench_check_regions[i];
+        u32 available;
+        const u8 *src = GBA_MemoryGetReadPointer(r->address, &available);
+        memcpy(state, src, r->size);
+        state += r->size;
+    }
+}
+
+static void bench_check_state_load(const u8 *state)
+{
+    for (size_t i = 0; i < BENCH_CHECK_NUM_REGIONS; i++)
+    {
+        const bench_check_region_t *r = &bench_check_regions[i];
+        u32 available;
+        u8 *dst = GBA_MemoryGetWritePointer(r->address, &available, 0);
+        memcpy(dst, state, r->size);
+        state += r->size;
+    }
+}
+
+// Returns a random address. Most of them are word-aligned, so that the fast
+// paths are used. Data of 'size' bytes at that address fits in the region.
+static u32 bench_check_address(u32 size)
+{
+    const bench_check_region_t *r;
+    do
+    {
+        r = &bench_check_regions[bench_check_rand() % BENCH_CHECK_NUM_REGIONS];
+    }
+    while (r->size <= size);
+
+    u32 offset = bench_check_rand() % (r->size - size);
+    if (bench_check_rand() & 3)
+        offset &= ~3;
+
+    return r->address + offset;
+}
+
+// Returns a destination address. Sometimes it is close to the source address
+// so that they overlap. The data written to it may not fit in the region.
+static u32 bench_check_dst_address(u32 src)
+{
+    if ((bench_check_rand() & 3) == 0)
+    {
+        u32 dst = src + (bench_check_rand() % 512) - 256;
+        if (bench_check_state_ptr(bench_check_initial, dst) != NULL)
+            return dst;
+    }
+
+    return bench_check_address(0);
+}
+
+static u32 bench_check_size(void)
+{
+    u32 size = (bench_check_rand() % BENCH_CHECK_MAX_SIZE) + 1;
+    if (bench_check_rand() & 3)
+        size &= ~3;
+    return size;
+}
+
+static void bench_check_header(u32 type, u32 size)
+{
+    u32 header = type | (size << 8);
+    for (int i = 0; i < 4; i++)
+        bench_check_stream[i] = header >> (i * 8);
+}
+
+// Valid LZ77 stream with references anywhere in the data decoded so far. Like
+// the streams of a real encoder, it ends exactly when 'size' bytes have been
+// decoded. The regular code overflows its buffer with longer streams.
+static u32 bench_check_lz77(u32 size)
+{
+    bench_check_header(0x10, size);
+
+    u32 out = 4;
+    u32 total = 0;
+
+    while (total < size)
+    {
+        u32 flags_index = out++;
+        u8 flags = 0;
+
+        for (int b = 0; (b < 8) && (total < size); b++)
+        {
+            u32 len = 3 + (bench_check_rand() % 16);
+            if (len > size - total)
+                len = size - total;
+
+            if ((total > 0) && (len >= 3) && (bench_check_rand() & 1))
+            {
+                u32 window = (total < 4096) ? total : 4096;
+                u32 disp = bench_check_rand() % window;
+                flags |= 0x80 >> b;
+                bench_check_stream[out++] = ((len - 3) << 4) | (disp >> 8);
+                bench_check_stream[out++] = disp & 0xFF;
+                total += len;
+            }
+            else
+            {
+                bench_check_stream[out++] = bench_check_rand();
+                total++;
+            }
+        }
+
+        bench_check_stream[flags_index] = flags;
+    }
+
+    return out;
+}
+
+// Any sequence of bytes is a valid stream for the other formats, even the
+// Huffman tree. Nodes always point forwards, so decoding always ends.
+static u32 bench_check_random(u32 type, u32 size, u32 stream_size)
+{
+    bench_check_header(type, size);
+
+    for (u32 i = 4; i < stream_size; i++)
+        bench_check_stream[i] = bench_check_rand();
+
+    return stream_size;
+}
+
+// Sets up the initial state of a case and the arguments of the function
+static void bench_check_generate(u8 number, u32 *regs)
+{
+    for (u32 i = 0; i < BENCH_CHECK_STATE_SIZE; i++)
+        bench_check_initial[i] = bench_check_rand();
+
+    u32 stream_size = 0;
+    u32 size = bench_check_size();
+
+    switch (number)
+    {
+        case 0x0B: // CpuSet
+            regs[2] = (bench_check_rand() % 0x1000)
+                      | ((bench_check_rand() & 1) << 24)
+                      | ((bench_check_rand() & 1) << 26);
+            break;
+        case 0x0C: // CpuFastSet
+            regs[2] = (bench_check_rand() % 0x800)
+                      | ((bench_check_rand() & 1) << 24);
+            break;
+        case 0x11: // LZ77UnCompWram
+        case 0x12: // LZ77UnCompVram
+            stream_size = bench_check_lz77(size);
+            break;
+        case 0x13: // HuffUnComp
+            stream_size = bench_check_random((bench_check_rand() & 1) ?
+                                             0x24 : 0x28, size,
+                                             4 + 512 + size * 4);
+            break;
+        case 0x14: // RLUnCompWram
+        case 0x15: // RLUnCompVram
+            stream_size = bench_check_random(0x30, size, 4 + size * 2);
+            break;
+        case 0x16: // Diff8bitUnFilterWram
+        case 0x17: // Diff8bitUnFilterVram
+            stream_size = bench_check_random(0x81, size, 4 + size);
+            break;
+        case 0x18: // Diff16bitUnFilter
+            stream_size = bench_check_random(0x82, size, 4 + size);
+            break;
+        default:
+            break;
+    }
+
+    // Compressed data must be word-aligned, the header is read as a word
+    regs[0] = bench_check_address(stream_size);
+    if (stream_size > 0)
+        regs[0] &= ~3;
+    regs[1] = bench_check_dst_address(regs[0]);
+
+    memcpy(bench_check_state_ptr(bench_check_initial, regs[0]),
+           bench_check_stream, stream_size);
+}
+
+static void bench_check_run(u8 number, const u32 *regs, int direct)
+{
+    bench_check_state_load(bench_check_initial);
+
+    memcpy(CPU.R, regs, sizeof(CPU.R));
+
+    GBA_SwiSetDirectAccess(direct);
+    GBA_Swi(number);
+    GBA_SwiSetDirectAccess(1);
+}
+
+// Returns 1 if the results of both paths are the same
+static int bench_check_case(u8 number, u32 index)
+{
+    u32 regs[16];
+    for (int i = 0; i < 16; i++)
+        regs[i] = bench_check_rand();
+
+    bench_check_generate(number, regs);
+
+    u32 regs_fast[16];
+    bench_check_run(number, regs, 1);
+    bench_check_state_save(bench_check_fast);
+    memcpy(regs_fast, CPU.R, sizeof(regs_fast));
+
+    bench_check_run(number, regs, 0);
+
+    for (int i = 0; i < 16; i++)
+    {
+        if (CPU.R[i] != regs_fast[i])
+        {
+            fprintf(stderr, "SWI 0x%02X case %u: R%d mismatch: "
+                    "0x%08X (direct) != 0x%08X (bus)\n", number, index, i,
+                    regs_fast[i], CPU.R[i]);
+            return 0;
+        }
+    }
+
+    for (size_t i = 0; i < BENCH_CHECK_NUM_REGIONS; i++)
+    {
+        const bench_check_region_t *r = &bench_check_regions[i];
+        u32 available;
+        const u8 *bus = GBA_MemoryGetReadPointer(r->address, &available);
+        const u8 *fast = bench_check_state_ptr(bench_check_fast, r->address);
+
+        for (u32 j = 0; j < r->size; j++)
+        {
+            if (bus[j] != fast[j])
+            {
+                fprintf(stderr, "SWI 0x%02X case %u: Mismatch at 0x%08X: "
+                        "0x%02X (direct) != 0x%02X (bus) "
+                        "[R0=0x%08X R1=0x%08X R2=0x%08X]\n", number, index,
+                        r->address + j, fast[j], bus[j], regs[0], regs[1],
+                        regs[2]);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+int Bench_GBASwiCheck(u32 cases)
+{
+    static const u8 numbers[] = {
+        0x0B, 0x0C, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18
+    };
+
+    if (!Bench_GBALoadSynthetic())
+        return -1;
+
+    int mismatches = 0;
+
+    for (size_t n = 0; n < ARRAY_NUM_ELEMENTS(numbers); n++)
+    {
+        int failed = 0;
+
+        // Every function uses the same cases no matter which ones run first
+        bench_check_seed = 0x2545F491 + numbers[n];
+
+        for (u32 i = 0; i < cases; i++)
+        {
+            if (!bench_check_case(numbers[n], i))
+                failed++;
+        }
+
+        fprintf(stderr, "SWI 0x%02X: %u cases, %d mismatches\n", numbers[n],
+                cases, failed);
+
+        mismatches += failed;
+    }
+
+    Bench_Unload();
+
+    return mismatches;
+}
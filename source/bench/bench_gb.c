@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdio.h>
+
+#include <SDL2/SDL.h>
+
+#include "bench.h"
+
+#include "../config.h"
+#include "../general_utils.h"
+
+#include "../gb_core/camera.h"
+#include "../gb_core/cpu.h"
+#include "../gb_core/gameboy.h"
+#include "../gb_core/memory.h"
+#include "../gb_core/video.h"
+
+extern _GB_CONTEXT_ GameBoy;
+
+// Clocks of one frame in single speed mode
+#define BENCH_GB_FRAME_CLOCKS   70224
+
+// Frames that the synthetic ROM needs to initialize the video memory
+#define BENCH_GB_SETUP_FRAMES 8
+
+// Load the synthetic ROM and let it initialize the video memory
+static int bench_gb_setup(unused__ const char *arg)
+{
+    if (!Bench_GBLoadSynthetic())
+        return 0;
+
+    for (int i = 0; i < BENCH_GB_SETUP_FRAMES; i++)
+        Bench_RunFrame();
+
+    return 1;
+}
+
+static void bench_gb_cleanup(void)
+{
+    Bench_Unload();
+}
+
+//------------------------------------------------------------------------------
+
+// Run the main loop of the ROM with the screen off so that only the CPU and
+// the rest of the hardware that doesn't depend on the PPU is emulated.
+static int bench_gb_cpu_setup(const char *arg)
+{
+    if (!bench_gb_setup(arg))
+        return 0;
+
+    GB_MemWrite8(0xFF40, 0x00);
+    GameBoy.CPU.R16.PC = BENCH_GB_CPU_LOOP;
+
+    return 1;
+}
+
+static void bench_gb_cpu(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+        GB_RunFor(BENCH_GB_FRAME_CLOCKS);
+}
+
+//------------------------------------------------------------------------------
+
+static u8 bench_gb_rgb_buffer[256 * 224 * 3];
+
+static void bench_gb_convert(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+        GB_Screen_WriteBuffer_24RGB(bench_gb_rgb_buffer);
+
+    bench_sink = bench_gb_rgb_buffer[0];
+}
+
+//------------------------------------------------------------------------------
+
+// The GB Camera reads its image from a ".raw" file, so this doesn't need a
+// webcam. Each iteration takes one picture: it gets a frame of the file and
+// processes it like the cartridge does.
+
+#define BENCH_GB_CAMERA_FILE    "giibiiadvance_bench_camera.raw"
+#define BENCH_GB_CAMERA_FRAMES  4
+
+static char bench_gb_camera_old_file[MAX_PATHLEN];
+
+static int bench_gb_camera_write_file(void)
+{
+    FILE *f = fopen(BENCH_GB_CAMERA_FILE, "wb");
+    if (f == NULL)
+        return 0;
+
+    static u8 frame[GBCAM_SENSOR_H][GBCAM_SENSOR_W];
+
+    for (int n = 0; n < BENCH_GB_CAMERA_FRAMES; n++)
+    {
+        for (int j = 0; j < GBCAM_SENSOR_H; j++)
+        {
+            for (int i = 0; i < GBCAM_SENSOR_W; i++)
+                frame[j][i] = (i * 2) ^ (j + n * 32);
+        }
+
+        if (fwrite(frame, sizeof(frame), 1, f) != 1)
+        {
+            fclose(f);
+            return 0;
+        }
+    }
+
+    fclose(f);
+    return 1;
+}
+
+static void bench_gb_camera_cleanup(void)
+{
+    Bench_Unload();
+
+    s_strncpy(EmulatorConfig.webcam_file, bench_gb_camera_old_file,
+              sizeof(EmulatorConfig.webcam_file));
+
+    remove(BENCH_GB_CAMERA_FILE);
+}
+
+static int bench_gb_camera_setup(unused__ const char *arg)
+{
+    if (!bench_gb_camera_write_file())
+        return 0;
+
+    s_strncpy(bench_gb_camera_old_file, EmulatorConfig.webcam_file,
+              sizeof(bench_gb_camera_old_file));
+    s_strncpy(EmulatorConfig.webcam_file, BENCH_GB_CAMERA_FILE,
+              sizeof(EmulatorConfig.webcam_file));
+
+    if (!Bench_GBLoadSyntheticCamera())
+    {
+        bench_gb_camera_cleanup();
+        return 0;
+    }
+
+    // Settings of the Game Boy Camera: Positive and negative image, 2D edge
+    // enhancement, and a dither matrix with increasing thresholds.
+    GB_CameraWriteRegister(0xA001, 0xE0);
+    GB_CameraWriteRegister(0xA002, 0x03);
+    GB_CameraWriteRegister(0xA003, 0x00);
+    GB_CameraWriteRegister(0xA004, 0x07);
+    GB_CameraWriteRegister(0xA005, 0xBF);
+    for (int i = 0; i < 16; i++)
+    {
+        GB_CameraWriteRegister(0xA006 + i * 3 + 0, 0x80 + i * 2);
+        GB_CameraWriteRegister(0xA006 + i * 3 + 1, 0x90 + i * 2);
+        GB_CameraWriteRegister(0xA006 + i * 3 + 2, 0xC0 + i * 2);
+    }
+
+    // Give the capture thread time to read the first frame of the file
+    SDL_Delay(100);
+
+    return 1;
+}
+
+static void bench_gb_camera(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+    {
+        // A new frame is only requested to the webcam every few frames
+        for (int f = 0; f < 5; f++)
+            GB_CameraWebcamDelayDecrease();
+
+        GB_CameraWriteRegister(0xA000, 0x03); // Take picture
+    }
+
+    bench_sink = GB_CameraRetinaProcessedImageGetPixel(0, 0);
+}
+
+//------------------------------------------------------------------------------
+
+const bench_t bench_gb_list[] = {
+    { "gb_cpu_screen_off", "us/frame", 1e6,
+      bench_gb_cpu_setup, bench_gb_cpu, bench_gb_cleanup },
+    { "gb_convert_rgb24", "us/frame", 1e6,
+      bench_gb_setup, bench_gb_convert, bench_gb_cleanup },
+    { "gb_camera_picture", "us/picture", 1e6,
+      bench_gb_camera_setup, bench_gb_camera, bench_gb_camera_cleanup },
+    { NULL, NULL, 0, NULL, NULL, NULL }
+};
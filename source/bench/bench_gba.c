@@ -0,0 +1,431 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../general_utils.h"
+
+#include "../gba_core/bios.h"
+#include "../gba_core/cpu.h"
+#include "../gba_core/gba.h"
+#include "../gba_core/memory.h"
+#include "../gba_core/sound.h"
+#include "../gba_core/video.h"
+
+// Clocks of one scanline and one frame
+#define BENCH_GBA_LINE_CLOCKS   1232
+#define BENCH_GBA_FRAME_CLOCKS  (BENCH_GBA_LINE_CLOCKS * 228)
+
+// Frames that the synthetic ROM needs to initialize the video memory
+#define BENCH_GBA_SETUP_FRAMES 8
+
+// Load the synthetic ROM and let it initialize the video memory
+static int bench_gba_setup(unused__ const char *arg)
+{
+    if (!Bench_GBALoadSynthetic())
+        return 0;
+
+    for (int i = 0; i < BENCH_GBA_SETUP_FRAMES; i++)
+        Bench_RunFrame();
+
+    return 1;
+}
+
+static void bench_gba_cleanup(void)
+{
+    Bench_Unload();
+}
+
+//------------------------------------------------------------------------------
+
+static void bench_gba_memory_read32(u32 iterations)
+{
+    static const u32 base[8] = {
+        0x03000000, 0x02000000, 0x08000000, 0x06000000,
+        0x03004000, 0x05000000, 0x07000000, 0x04000000
+    };
+
+    u32 acc = 0;
+
+    for (u32 i = 0; i < iterations; i++)
+        acc += GBA_MemoryRead32(base[i & 7] + ((i >> 1) & 0x3C));
+
+    bench_sink = acc;
+}
+
+//------------------------------------------------------------------------------
+
+static s32 bench_gba_residual;
+
+static int bench_gba_cpu_setup(u32 pc, int thumb)
+{
+    if (!bench_gba_setup(NULL))
+        return 0;
+
+    CPU.R[R_PC] = pc;
+    if (thumb)
+    {
+        CPU.CPSR |= F_T;
+        CPU.EXECUTION_MODE = EXEC_THUMB;
+    }
+
+    bench_gba_residual = 0;
+
+    return 1;
+}
+
+static int bench_gba_cpu_arm_setup(unused__ const char *arg)
+{
+    return bench_gba_cpu_setup(BENCH_GBA_ARM_LOOP, 0);
+}
+
+static int bench_gba_cpu_thumb_setup(unused__ const char *arg)
+{
+    return bench_gba_cpu_setup(BENCH_GBA_THUMB_LOOP, 1);
+}
+
+// One iteration is one frame of CPU time, run in chunks of one scanline
+static void bench_gba_cpu(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+    {
+        for (int line = 0; line < 228; line++)
+        {
+            s32 clocks = BENCH_GBA_LINE_CLOCKS + bench_gba_residual;
+            while (clocks > 0)
+                clocks = GBA_Execute(clocks);
+            bench_gba_residual = clocks;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static int bench_gba_brightness_setup(const char *arg)
+{
+    if (!bench_gba_setup(arg))
+        return 0;
+
+    // All layers are first target, brightness increase
+    GBA_RegisterWrite16(BLDCNT, 0x00BF);
+    GBA_RegisterWrite16(BLDY, 8);
+
+    return 1;
+}
+
+static void bench_gba_draw_frame(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+    {
+        for (int y = 0; y < 160; y++)
+            GBA_DrawScanline(y);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static int bench_gba_sound_setup(const char *arg)
+{
+    if (!bench_gba_setup(arg))
+        return 0;
+
+    // Channels 1, 2 and 4 playing forever at full volume on both sides
+    GBA_RegisterWrite16(SOUNDCNT_X, 0x0080);
+    GBA_RegisterWrite16(SOUNDCNT_L, 0xBB77);
+    GBA_RegisterWrite16(SOUNDCNT_H, 0x0002);
+    GBA_RegisterWrite16(SOUND1CNT_H, 0xF080);
+    GBA_RegisterWrite16(SOUND1CNT_X, 0x8600);
+    GBA_RegisterWrite16(SOUND2CNT_L, 0xF0C0);
+    GBA_RegisterWrite16(SOUND2CNT_H, 0x8700);
+    GBA_RegisterWrite16(SOUND4CNT_L, 0xF000);
+    GBA_RegisterWrite16(SOUND4CNT_H, 0x8011);
+
+    return 1;
+}
+
+static void bench_gba_sound_frame(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+    {
+        GBA_SoundResetBufferPointers();
+        GBA_SoundUpdate(BENCH_GBA_FRAME_CLOCKS);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+#define BENCH_SWI_DATA_SIZE (32 * 1024)
+#define BENCH_SWI_SRC       0x02000000
+#define BENCH_SWI_DST       0x02020000
+
+static u8 *bench_swi_data;
+static u8 bench_swi_number;
+
+// Tile-like data: blocks of 64 bytes that are filled with a value, repeated
+// from a previous block, filled with a gradient or filled with noise.
+static void bench_swi_data_generate(u8 *data, u32 size)
+{
+    u32 seed = 0x5A00002A;
+
+    for (u32 block = 0; block < size / 64; block++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        u8 *dst = &data[block * 64];
+        u32 type = (block < 16) ? 3 : (seed & 3);
+        const u8 *prev = dst;
+        if (type == 1)
+            prev = &data[(block - 2 - ((seed >> 8) & 7)) * 64];
+
+        for (u32 i = 0; i < 64; i++)
+        {
+            switch (type)
+            {
+                case 0:
+                    dst[i] = seed >> 8;
+                    break;
+                case 1:
+                    dst[i] = prev[i];
+                    break;
+                case 2:
+                    dst[i] = (seed >> 8) + i;
+                    break;
+                default:
+                    seed ^= seed << 13;
+                    seed ^= seed >> 17;
+                    seed ^= seed << 5;
+                    dst[i] = seed;
+                    break;
+            }
+        }
+    }
+}
+
+// Greedy LZ77 encoder in the format of the BIOS. Returns the compressed size.
+static u32 bench_lz77_compress(const u8 *src, u32 size, u8 *dst)
+{
+    u32 in = 0;
+    u32 out = 4;
+
+    dst[0] = 0x10;
+    dst[1] = size & 0xFF;
+    dst[2] = (size >> 8) & 0xFF;
+    dst[3] = (size >> 16) & 0xFF;
+
+    while (in < size)
+    {
+        u32 flags_index = out++;
+        u8 flags = 0;
+
+        for (int b = 0; (b < 8) && (in < size); b++)
+        {
+            u32 max_len = ((size - in) < 18) ? (size - in) : 18;
+            u32 window = (in < 4096) ? in : 4096;
+            u32 best_len = 0;
+            u32 best_disp = 0;
+
+            for (u32 disp = 1; disp <= window; disp++)
+            {
+                u32 len = 0;
+                const u8 *match = &src[in - disp];
+                while ((len < max_len) && (match[len] == src[in + len]))
+                    len++;
+
+                if (len > best_len)
+                {
+                    best_len = len;
+                    best_disp = disp;
+                    if (len == max_len)
+                        break;
+                }
+            }
+
+            if (best_len >= 3)
+            {
+                flags |= 0x80 >> b;
+                dst[out++] = ((best_len - 3) << 4) | ((best_disp - 1) >> 8);
+                dst[out++] = (best_disp - 1) & 0xFF;
+                in += best_len;
+            }
+            else
+            {
+                dst[out++] = src[in++];
+            }
+        }
+
+        dst[flags_index] = flags;
+    }
+
+    return out;
+}
+
+// Huffman encoder in the format of the BIOS with 4-bit symbols. It uses a
+// balanced tree, so every symbol uses 4 bits. Returns the compressed size.
+static u32 bench_huffman_compress(const u8 *src, u32 size, u8 *dst)
+{
+    u32 out = 0;
+
+    dst[out++] = 0x24;
+    dst[out++] = size & 0xFF;
+    dst[out++] = (size >> 8) & 0xFF;
+    dst[out++] = (size >> 16) & 0xFF;
+
+    // The tree has 15 nodes and 16 leaves stored like a binary heap. The
+    // children of node k are at 2k+1 and 2k+2.
+    dst[out++] = 15;
+    for (int k = 0; k < 31; k++)
+    {
+        if (k < 15)
+            dst[out++] = (k >> 1) | ((k >= 7) ? 0xC0 : 0);
+        else
+            dst[out++] = k - 15;
+    }
+
+    // The bitstream is read in 32-bit words from the most significant bit,
+    // and the low nibble of each byte goes first.
+    u32 word = 0;
+    int bits = 0;
+
+    for (u32 i = 0; i < size * 2; i++)
+    {
+        u32 nibble = (i & 1) ? (src[i >> 1] >> 4) : (src[i >> 1] & 0xF);
+
+        word = (word << 4) | nibble;
+        bits += 4;
+
+        if (bits == 32)
+        {
+            dst[out++] = word & 0xFF;
+            dst[out++] = (word >> 8) & 0xFF;
+            dst[out++] = (word >> 16) & 0xFF;
+            dst[out++] = (word >> 24) & 0xFF;
+            word = 0;
+            bits = 0;
+        }
+    }
+
+    return out;
+}
+
+static void bench_swi(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+    {
+        CPU.R[0] = BENCH_SWI_SRC;
+        CPU.R[1] = BENCH_SWI_DST;
+        GBA_Swi(bench_swi_number);
+    }
+}
+
+static int bench_swi_setup(u8 number)
+{
+    if (!bench_gba_setup(NULL))
+        return 0;
+
+    bench_swi_data = malloc(BENCH_SWI_DATA_SIZE);
+    u8 *compressed = malloc(BENCH_SWI_DATA_SIZE * 2);
+    if ((bench_swi_data == NULL) || (compressed == NULL))
+    {
+        free(bench_swi_data);
+        free(compressed);
+        bench_swi_data = NULL;
+        Bench_Unload();
+        return 0;
+    }
+
+    bench_swi_data_generate(bench_swi_data, BENCH_SWI_DATA_SIZE);
+
+    u32 size;
+    if (number == 0x11)
+        size = bench_lz77_compress(bench_swi_data, BENCH_SWI_DATA_SIZE,
+                                   compressed);
+    else
+        size = bench_huffman_compress(bench_swi_data, BENCH_SWI_DATA_SIZE,
+                                      compressed);
+
+    for (u32 i = 0; i < size; i++)
+        GBA_MemoryWrite8(BENCH_SWI_SRC + i, compressed[i]);
+
+    free(compressed);
+
+    bench_swi_number = number;
+
+    // Check that the encoder is correct
+    bench_swi(1);
+    for (u32 i = 0; i < BENCH_SWI_DATA_SIZE; i++)
+    {
+        if (GBA_MemoryRead8(BENCH_SWI_DST + i) != bench_swi_data[i])
+        {
+            fprintf(stderr, "SWI 0x%02X: Decompressed data mismatch at %u\n",
+                    number, i);
+            free(bench_swi_data);
+            bench_swi_data = NULL;
+            Bench_Unload();
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int bench_swi_lz77_setup(unused__ const char *arg)
+{
+    return bench_swi_setup(0x11);
+}
+
+static int bench_swi_huffman_setup(unused__ const char *arg)
+{
+    return bench_swi_setup(0x13);
+}
+
+static void bench_swi_cleanup(void)
+{
+    free(bench_swi_data);
+    bench_swi_data = NULL;
+    Bench_Unload();
+}
+
+//------------------------------------------------------------------------------
+
+static u8 bench_gba_rgb_buffer[240 * 160 * 3];
+
+static void bench_gba_convert(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+        GBA_ConvertScreenBufferTo24RGB(bench_gba_rgb_buffer);
+
+    bench_sink = bench_gba_rgb_buffer[0];
+}
+
+//------------------------------------------------------------------------------
+
+const bench_t bench_gba_list[] = {
+    { "gba_memory_read32", "ns/read", 1e9,
+      bench_gba_setup, bench_gba_memory_read32, bench_gba_cleanup },
+    { "gba_cpu_arm", "us/frame", 1e6,
+      bench_gba_cpu_arm_setup, bench_gba_cpu, bench_gba_cleanup },
+    { "gba_cpu_thumb", "us/frame", 1e6,
+      bench_gba_cpu_thumb_setup, bench_gba_cpu, bench_gba_cleanup },
+    { "gba_draw_alpha_blend", "us/frame", 1e6,
+      bench_gba_setup, bench_gba_draw_frame, bench_gba_cleanup },
+    { "gba_draw_brightness", "us/frame", 1e6,
+      bench_gba_brightness_setup, bench_gba_draw_frame, bench_gba_cleanup },
+    { "gba_sound_frame", "us/frame", 1e6,
+      bench_gba_sound_setup, bench_gba_sound_frame, bench_gba_cleanup },
+    { "gba_swi_lz77_32k", "us/call", 1e6,
+      bench_swi_lz77_setup, bench_swi, bench_swi_cleanup },
+    { "gba_swi_huffman_32k", "us/call", 1e6,
+      bench_swi_huffman_setup, bench_swi, bench_swi_cleanup },
+    { "gba_convert_rgb24", "us/frame", 1e6,
+      bench_gba_setup, bench_gba_convert, bench_gba_cleanup },
+    { NULL, NULL, 0, NULL, NULL, NULL }
+};
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include "bench.h"
+
+#include "../general_utils.h"
+
+// Frames emulated after loading a ROM and before measuring anything, so that
+// the boot code of the ROM isn't part of the result.
+#define BENCH_MACRO_WARMUP_FRAMES 60
+
+static int bench_macro_warmup(void)
+{
+    for (int i = 0; i < BENCH_MACRO_WARMUP_FRAMES; i++)
+        Bench_RunFrame();
+
+    return 1;
+}
+
+static int bench_macro_gba_setup(unused__ const char *arg)
+{
+    if (!Bench_GBALoadSynthetic())
+        return 0;
+
+    return bench_macro_warmup();
+}
+
+static int bench_macro_gb_setup(unused__ const char *arg)
+{
+    if (!Bench_GBLoadSynthetic())
+        return 0;
+
+    return bench_macro_warmup();
+}
+
+static int bench_macro_rom_setup(const char *arg)
+{
+    if (!Bench_LoadFile(arg))
+        return 0;
+
+    return bench_macro_warmup();
+}
+
+static void bench_macro_run(u32 iterations)
+{
+    for (u32 i = 0; i < iterations; i++)
+        Bench_RunFrame();
+}
+
+static void bench_macro_cleanup(void)
+{
+    Bench_Unload();
+}
+
+const bench_t bench_macro_list[] = {
+    { "rom_gba_synthetic", "us/frame", 1e6,
+      bench_macro_gba_setup, bench_macro_run, bench_macro_cleanup },
+    { "rom_gb_synthetic", "us/frame", 1e6,
+      bench_macro_gb_setup, bench_macro_run, bench_macro_cleanup },
+    { NULL, NULL, 0, NULL, NULL, NULL }
+};
+
+const bench_t bench_macro_rom = {
+    "rom", "us/frame", 1e6,
+    bench_macro_rom_setup, bench_macro_run, bench_macro_cleanup
+};
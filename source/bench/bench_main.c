@@ -0,0 +1,387 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "bench.h"
+
+#include "../build_options.h"
+#include "../file_utils.h"
+#include "../general_utils.h"
+
+volatile u32 bench_sink;
+
+// Micro benchmarks run for at least this time before being measured, and the
+// best of a few runs is used as result.
+#define BENCH_MIN_RUN_TIME  0.05 // Seconds
+#define BENCH_RUNS          5
+#define BENCH_MACRO_RUNS    3
+
+#define BENCH_DEFAULT_FRAMES    300
+#define BENCH_DEFAULT_THRESHOLD 10.0 // Percentage
+
+#define BENCH_CHECK_CASES   500 // Cases per function in the BIOS check
+
+#define BENCH_MAX_ROMS      16
+#define BENCH_MAX_RESULTS   64
+
+typedef struct {
+    char name[64];
+    const char *unit;
+    double value;
+} bench_result_t;
+
+static bench_result_t bench_results[BENCH_MAX_RESULTS];
+static int bench_num_results = 0;
+static int bench_num_errors = 0;
+
+static const char *bench_filter = NULL;
+static int bench_list_only = 0;
+
+static double bench_time(const bench_t *b, u32 iterations)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    b->run(iterations);
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    return (double)(end - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+// If 'iterations' is 0 the number of iterations is calibrated so that each
+// run takes at least BENCH_MIN_RUN_TIME.
+static void bench_run(const bench_t *b, const char *name, const char *arg,
+                      u32 iterations, int runs)
+{
+    if ((bench_filter != NULL) && (strstr(name, bench_filter) == NULL))
+        return;
+
+    if (bench_list_only)
+    {
+        printf("%s\n", name);
+        return;
+    }
+
+    if (bench_num_results == BENCH_MAX_RESULTS)
+    {
+        fprintf(stderr, "%s: Too many results\n", name);
+        bench_num_errors++;
+        return;
+    }
+
+    if (!b->setup(arg))
+    {
+        fprintf(stderr, "%s: Setup failed\n", name);
+        bench_num_errors++;
+        return;
+    }
+
+    if (iterations == 0)
+    {
+        iterations = 1;
+        while (iterations < 0x40000000)
+        {
+            double t = bench_time(b, iterations);
+            if (t >= BENCH_MIN_RUN_TIME)
+                break;
+
+            // Aim for a bit more than the minimum time
+            double factor = (t > 0.0) ? (BENCH_MIN_RUN_TIME * 1.5 / t) : 16.0;
+            if (factor > 16.0)
+                factor = 16.0;
+            else if (factor < 2.0)
+                factor = 2.0;
+            iterations = (u32)(iterations * factor);
+        }
+    }
+
+    double best = 0.0;
+    for (int r = 0; r < runs; r++)
+    {
+        double t = bench_time(b, iterations) / iterations;
+        if ((r == 0) || (t < best))
+            best = t;
+    }
+
+    b->cleanup();
+
+    bench_result_t *result = &bench_results[bench_num_results++];
+    s_strncpy(result->name, name, sizeof(result->name));
+    result->unit = b->unit;
+    result->value = best * b->scale;
+
+    fprintf(stderr, "%-28s %12.3f %s\n", result->name, result->value,
+            result->unit);
+}
+
+static void bench_run_list(const bench_t *list)
+{
+    for (int i = 0; list[i].name != NULL; i++)
+        bench_run(&list[i], list[i].name, NULL, 0, BENCH_RUNS);
+}
+
+// The name of a ROM benchmark is "rom_" followed by the name of the file
+static void bench_rom_name(char *name, size_t size, const char *path)
+{
+    const char *base = path;
+    for (const char *c = path; *c != '\0'; c++)
+    {
+        if ((*c == '/') || (*c == '\\'))
+            base = c + 1;
+    }
+
+    snprintf(name, size, "rom_%s", base);
+
+    for (char *c = name; *c != '\0'; c++)
+    {
+        if (!(((*c >= 'a') && (*c <= 'z')) || ((*c >= 'A') && (*c <= 'Z'))
+              || ((*c >= '0') && (*c <= '9')) || (*c == '.') || (*c == '-')))
+            *c = '_';
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void bench_results_save(FILE *f)
+{
+    fprintf(f, "{\n");
+    fprintf(f, "  \"results\": [\n");
+
+    // One result per line, the baseline parser depends on it
+    for (int i = 0; i < bench_num_results; i++)
+    {
+        const bench_result_t *r = &bench_results[i];
+        fprintf(f, "    { \"name\": \"%s\", \"value\": %.4f, "
+                "\"unit\": \"%s\" }%s\n", r->name, r->value, r->unit,
+                (i < bench_num_results - 1) ? "," : "");
+    }
+
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+}
+
+// Returns the number of results that are worse than the baseline by more than
+// the threshold, or -1 on error.
+static int bench_baseline_check(const char *path, double threshold)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Couldn't open baseline: %s\n", path);
+        return -1;
+    }
+
+    fprintf(stderr, "\nBaseline: %s (threshold %.1f%%)\n", path, threshold);
+
+    int regressions = 0;
+    char line[256];
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char name[64];
+        double value;
+
+        if (sscanf(line, " { \"name\": \"%63[^\"]\", \"value\": %lf",
+                   name, &value) != 2)
+            continue;
+
+        const bench_result_t *r = NULL;
+        for (int i = 0; i < bench_num_results; i++)
+        {
+            if (strcmp(bench_results[i].name, name) == 0)
+            {
+                r = &bench_results[i];
+                break;
+            }
+        }
+
+        if (r == NULL)
+            continue;
+
+        double change = 0.0;
+        if (value > 0.0)
+            change = (r->value - value) * 100.0 / value;
+
+        int regressed = change > threshold;
+        if (regressed)
+            regressions++;
+
+        fprintf(stderr, "%-28s %12.3f -> %12.3f %s (%+.1f%%)%s\n", name,
+                value, r->value, r->unit, change,
+                regressed ? " REGRESSION" : "");
+    }
+
+    fclose(f);
+
+    return regressions;
+}
+
+//------------------------------------------------------------------------------
+
+static void bench_usage(const char *exe)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "\n"
+        "  --rom <path>          Add a macro benchmark of a ROM (up to %d)\n"
+        "  --frames <n>          Frames measured in macro benchmarks (%d)\n"
+        "  --filter <text>       Only run benchmarks with 'text' in the name\n"
+        "  --list                List benchmarks without running them\n"
+        "  --check               Compare the fast paths of the BIOS functions\n"
+        "                        with the regular code instead of running\n"
+        "                        benchmarks\n"
+        "  --output <path>       Save results to a file instead of stdout\n"
+        "  --baseline <path>     Compare with the results of a previous run\n"
+        "  --threshold <pct>     Maximum slowdown allowed (%.0f%%)\n"
+        "\n"
+        "Results are saved as JSON. The exit code is 0 on success, 1 on\n"
+        "error and 2 if any result is worse than the baseline. With --check\n"
+        "it is 1 if the results of the fast paths are different.\n",
+        exe, BENCH_MAX_ROMS, BENCH_DEFAULT_FRAMES, BENCH_DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *roms[BENCH_MAX_ROMS];
+    int num_roms = 0;
+    u32 frames = BENCH_DEFAULT_FRAMES;
+    const char *output_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    int check = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--list") == 0)
+        {
+            bench_list_only = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--check") == 0)
+        {
+            check = 1;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            bench_usage(argv[0]);
+            return 1;
+        }
+
+        if ((strcmp(argv[i], "--rom") == 0) && (num_roms < BENCH_MAX_ROMS))
+        {
+            roms[num_roms++] = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frames") == 0)
+        {
+            int value = atoi(argv[++i]);
+            frames = (value > 0) ? value : BENCH_DEFAULT_FRAMES;
+        }
+        else if (strcmp(argv[i], "--filter") == 0)
+        {
+            bench_filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            output_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0)
+        {
+            baseline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0)
+        {
+            threshold = atof(argv[++i]);
+        }
+        else
+        {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc > 0)
+        DirSetRunningPath(argv[0]);
+
+    if (SDL_Init(SDL_INIT_TIMER) != 0)
+    {
+        fprintf(stderr, "SDL could not initialize! SDL Error: %s\n",
+                SDL_GetError());
+        return 1;
+    }
+    atexit(SDL_Quit);
+
+    if (check)
+    {
+        int mismatches = Bench_GBASwiCheck(BENCH_CHECK_CASES);
+        if (mismatches != 0)
+        {
+            if (mismatches > 0)
+                fprintf(stderr, "%d mismatch(es) found\n", mismatches);
+            return 1;
+        }
+        return 0;
+    }
+
+    bench_run_list(bench_gba_list);
+    bench_run_list(bench_gb_list);
+
+    for (int i = 0; bench_macro_list[i].name != NULL; i++)
+    {
+        bench_run(&bench_macro_list[i], bench_macro_list[i].name, NULL,
+                  frames, BENCH_MACRO_RUNS);
+    }
+
+    for (int i = 0; i < num_roms; i++)
+    {
+        char name[64];
+        bench_rom_name(name, sizeof(name), roms[i]);
+        bench_run(&bench_macro_rom, name, roms[i], frames, BENCH_MACRO_RUNS);
+    }
+
+    if (bench_list_only)
+        return 0;
+
+    if (output_path != NULL)
+    {
+        FILE *f = fopen(output_path, "w");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Couldn't open %s for writing\n", output_path);
+            return 1;
+        }
+        bench_results_save(f);
+        fclose(f);
+    }
+    else
+    {
+        bench_results_save(stdout);
+    }
+
+    int regressions = 0;
+    if (baseline_path != NULL)
+    {
+        regressions = bench_baseline_check(baseline_path, threshold);
+        if (regressions < 0)
+            return 1;
+    }
+
+    if (bench_num_errors > 0)
+        return 1;
+
+    if (regressions > 0)
+    {
+        fprintf(stderr, "%d benchmark(s) regressed\n", regressions);
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "../build_options.h"
+#include "../file_utils.h"
+#include "../general_utils.h"
+
+#include "../gb_core/gb_main.h"
+#include "../gb_core/general.h"
+#include "../gb_core/rom.h"
+#include "../gb_core/sound.h"
+#include "../gb_core/video.h"
+
+#include "../gba_core/bios.h"
+#include "../gba_core/gba.h"
+#include "../gba_core/save.h"
+#include "../gba_core/sound.h"
+#include "../gba_core/video.h"
+
+// Code of the synthetic GBA ROM, starting at 0x080000C0:
+//
+//     setup:   DISPCNT = 0x1F40, BLDCNT = 0x3E41, BLDALPHA = 0x0808
+//              BG1CNT = 0x0400, BG2CNT = 0x0800, BG3CNT = 0x0C00
+//              Fill VRAM, palettes and OAM with xorshift32 noise
+//     main:    bl arm_block, then bx to thumb_block with lr = main
+//     fill:    xorshift32 fill loop
+//     arm_block:   256 read-modify-write iterations over IWRAM (ARM)
+//     arm_only:    bl arm_block ; b arm_only
+//     thumb_block: 256 read-modify-write iterations over IWRAM (THUMB)
+//     thumb_only:  bl thumb_block ; b thumb_only
+static const u32 bench_gba_code[] = {
+    0xE3A00301, 0xE3A01C1F, 0xE3811040, 0xE1C010B0, 0xE3A01C3E, 0xE3811041,
+    0xE1C015B0, 0xE3A01B02, 0xE3811008, 0xE1C015B2, 0xE3A01B01, 0xE1C010BA,
+    0xE3A01B02, 0xE1C010BC, 0xE3A01B03, 0xE1C010BE, 0xE3A0402A, 0xE384445A,
+    0xE3A02406, 0xE3A03906, 0xEB000009, 0xE3A02405, 0xE3A03B01, 0xEB000006,
+    0xE3A02407, 0xE3A03B01, 0xEB000003, 0xEB000009, 0xE28F5051, 0xE24FE010,
+    0xE12FFF15, 0xE4824004, 0xE0244684, 0xE02448A4, 0xE0244284, 0xE2533004,
+    0x1AFFFFF9, 0xE12FFF1E, 0xE3A00403, 0xE3A01000, 0xE7902101, 0xE0822001,
+    0xE02221A2, 0xE7802101, 0xE2811001, 0xE3510C01, 0x1AFFFFF8, 0xE12FFF1E,
+    0xEBFFFFF4, 0xEAFFFFFD, 0x048020C0, 0x008B2100, 0x185258C2, 0x406208D4,
+    0x310150C2, 0xD9F629FF, 0xF7FF4770, 0xE7FCFFF1
+};
+
+#define BENCH_GBA_ROM_SIZE  (64 * 1024)
+
+// Code of the synthetic GB ROM, starting at 0x0150:
+//
+//     di
+//     ld   sp,$FFFE
+//     xor  a
+//     ldh  [$40],a     ; Screen off
+//     ld   hl,$8000
+//     ld   bc,$2000
+// fill:
+//     ld   a,l
+//     xor  h
+//     ld   [hl+],a
+//     dec  bc
+//     ld   a,b
+//     or   c
+//     jr   nz,fill
+//     ld   a,$E4
+//     ldh  [$47],a     ; BGP
+//     ld   a,$93
+//     ldh  [$40],a     ; Screen, BG and sprites on
+// main:
+//     ld   hl,$C000
+//     ld   b,0
+// loop:
+//     ld   a,[hl]
+//     add  a,b
+//     ld   [hl+],a
+//     inc  b
+//     jr   nz,loop
+//     jr   main
+static const u8 bench_gb_code[] = {
+    0xF3, 0x31, 0xFE, 0xFF, 0xAF, 0xE0, 0x40, 0x21, 0x00, 0x80, 0x01, 0x00,
+    0x20, 0x7D, 0xAC, 0x22, 0x0B, 0x78, 0xB1, 0x20, 0xF8, 0x3E, 0xE4, 0xE0,
+    0x47, 0x3E, 0x93, 0xE0, 0x40, 0x21, 0x00, 0xC0, 0x06, 0x00, 0x7E, 0x80,
+    0x22, 0x04, 0x20, 0xFA, 0x18, 0xF3
+};
+
+#define BENCH_GB_ROM_SIZE   (32 * 1024)
+
+static int bench_loaded = 0; // 0 = none, 1 = GBA, 2 = GB
+static void *bench_gba_rom = NULL;
+
+static char bench_gba_save_path[MAX_PATHLEN];
+
+static int bench_gba_load(void *rom, u32 size, const char *path)
+{
+    Bench_Unload();
+
+    // Always use the emulated BIOS so that results don't depend on the files
+    // that are present in the BIOS folder.
+    GBA_BiosLoaded(0);
+
+    s_strncpy(bench_gba_save_path, path, sizeof(bench_gba_save_path));
+    GBA_SaveSetFilename(bench_gba_save_path);
+
+    if (!GBA_InitRom(NULL, rom, size))
+        return 0;
+
+    GBA_SkipFrame(0);
+
+    bench_gba_rom = rom;
+    bench_loaded = 1;
+
+    return 1;
+}
+
+static int bench_gb_load(void *rom, u32 size, const char *path)
+{
+    Bench_Unload();
+
+    // The cartridge code takes ownership of the buffer
+    if (GB_CartridgeLoad(rom, size) == 0)
+    {
+        fprintf(stderr, "Error while loading cartridge: %s\n", path);
+        free(rom);
+        return 0;
+    }
+
+    GB_Cardridge_Set_Filename(path);
+
+    GB_PowerOn();
+    GB_SkipFrame(0);
+
+    bench_loaded = 2;
+
+    return 1;
+}
+
+int Bench_GBALoadSynthetic(void)
+{
+    u8 *rom = calloc(1, BENCH_GBA_ROM_SIZE);
+    if (rom == NULL)
+        return 0;
+
+    // b 0x080000C0
+    rom[0] = 0x2E;
+    rom[3] = 0xEA;
+
+    memcpy(&rom[0xA0], "BENCHMARK", 9);
+    rom[0xB2] = 0x96;
+
+    u8 chk = 0;
+    for (int i = 0xA0; i < 0xBD; i++)
+        chk -= rom[i];
+    rom[0xBD] = chk - 0x19;
+
+    for (size_t i = 0; i < ARRAY_NUM_ELEMENTS(bench_gba_code); i++)
+    {
+        u32 v = bench_gba_code[i];
+        rom[0xC0 + i * 4 + 0] = v & 0xFF;
+        rom[0xC0 + i * 4 + 1] = (v >> 8) & 0xFF;
+        rom[0xC0 + i * 4 + 2] = (v >> 16) & 0xFF;
+        rom[0xC0 + i * 4 + 3] = (v >> 24) & 0xFF;
+    }
+
+    if (!bench_gba_load(rom, BENCH_GBA_ROM_SIZE, "giibiiadvance_bench.gba"))
+    {
+        free(rom);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int bench_gb_synthetic_load(u8 cart_type, u8 ram_size,
+                                   const char *path)
+{
+    u8 *rom = calloc(1, BENCH_GB_ROM_SIZE);
+    if (rom == NULL)
+        return 0;
+
+    // nop ; jp $0150
+    rom[0x101] = 0xC3;
+    rom[0x102] = 0x50;
+    rom[0x103] = 0x01;
+
+    memcpy(&rom[0x134], "BENCHMARK", 9);
+    rom[0x143] = 0x80; // GBC mode
+    rom[0x147] = cart_type;
+    rom[0x149] = ram_size;
+
+    u8 chk = 0;
+    for (int i = 0x134; i < 0x14D; i++)
+        chk = chk - rom[i] - 1;
+    rom[0x14D] = chk;
+
+    memcpy(&rom[0x150], bench_gb_code, sizeof(bench_gb_code));
+
+    u16 global_chk = 0;
+    for (int i = 0; i < BENCH_GB_ROM_SIZE; i++)
+        global_chk += rom[i];
+    rom[0x14E] = global_chk >> 8;
+    rom[0x14F] = global_chk & 0xFF;
+
+    return bench_gb_load(rom, BENCH_GB_ROM_SIZE, path);
+}
+
+int Bench_GBLoadSynthetic(void)
+{
+    return bench_gb_synthetic_load(0x00, 0x00, "giibiiadvance_bench.gbc");
+}
+
+int Bench_GBLoadSyntheticCamera(void)
+{
+    // POCKET CAMERA, 128 KB of RAM
+    return bench_gb_synthetic_load(0xFC, 0x04,
+                                   "giibiiadvance_bench_camera.gbc");
+}
+
+int Bench_LoadFile(const char *path)
+{
+    void *rom;
+    size_t size;
+
+    FileLoad_NoError(path, &rom, &size);
+    if (rom == NULL)
+    {
+        fprintf(stderr, "Couldn't load %s\n", path);
+        return 0;
+    }
+
+    size_t len = strlen(path);
+    char ext[4] = { 0 };
+    if (len > 3)
+    {
+        for (int i = 0; i < 3; i++)
+            ext[i] = toupper((unsigned char)path[len - 3 + i]);
+    }
+
+    if ((strcmp(ext, "GBA") == 0) || (strcmp(ext, "AGB") == 0)
+        || (strcmp(ext, "BIN") == 0))
+    {
+        if (!bench_gba_load(rom, size, path))
+        {
+            free(rom);
+            return 0;
+        }
+        return 1;
+    }
+
+    return bench_gb_load(rom, size, path);
+}
+
+void Bench_Unload(void)
+{
+    if (bench_loaded == 1)
+    {
+        GBA_EndRom(0);
+        free(bench_gba_rom);
+        bench_gba_rom = NULL;
+    }
+    else if (bench_loaded == 2)
+    {
+        GB_End(0);
+    }
+
+    bench_loaded = 0;
+}
+
+int Bench_IsGBA(void)
+{
+    return bench_loaded == 1;
+}
+
+static u8 bench_rgb_buffer[256 * 224 * 3];
+
+void Bench_RunFrame(void)
+{
+    if (bench_loaded == 1)
+    {
+        GBA_SoundResetBufferPointers();
+        GBA_RunForOneFrame();
+        GBA_ConvertScreenBufferTo24RGB(bench_rgb_buffer);
+    }
+    else if (bench_loaded == 2)
+    {
+        GB_SoundResetBufferPointers();
+        GB_RunForOneFrame();
+        GB_Screen_WriteBuffer_24RGB(bench_rgb_buffer);
+    }
+}
@@ -0,0 +1,552 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "build_options.h"
+#include "capture.h"
+#include "config.h"
+#include "debug_utils.h"
+#include "file_utils.h"
+#include "general_utils.h"
+#include "png_utils.h"
+
+#define CAPTURE_NUM_BUFFERS 8
+#define CAPTURE_NUM_THREADS 2
+
+// Frame rate of GB and GBA: 16777216 Hz / 280896 clocks per frame
+#define CAPTURE_FPS_NUM     262144
+#define CAPTURE_FPS_DEN     4389
+
+#define CAPTURE_JOB_SCREENSHOT  0
+#define CAPTURE_JOB_VIDEO       1
+
+typedef struct
+{
+    unsigned char data[CAPTURE_FRAME_SIZE];
+    int type;
+    int width;
+    int height;
+    int png_level;
+    u32 frame; // Index of the frame in the video
+    char path[MAX_PATHLEN];
+} capture_job;
+
+static capture_job capture_jobs[CAPTURE_NUM_BUFFERS];
+
+// Used by the threads to convert frames before writing them to the video
+static unsigned char
+capture_convert_buffers[CAPTURE_NUM_THREADS][CAPTURE_FRAME_SIZE];
+
+static SDL_Thread *capture_threads[CAPTURE_NUM_THREADS];
+static int capture_num_threads = 0;
+static SDL_mutex *capture_mutex = NULL;
+static SDL_cond *capture_work_cond = NULL; // A job has been queued
+static SDL_cond *capture_done_cond = NULL; // A job has been finished
+
+// All the variables below are protected by capture_mutex
+
+static int capture_free_list[CAPTURE_NUM_BUFFERS]; // Jobs that can be used
+static int capture_free_count;
+static int capture_queue[CAPTURE_NUM_BUFFERS]; // Jobs waiting for a thread
+static int capture_queue_start;
+static int capture_queue_count;
+static int capture_quit;
+
+static int capture_video_recording = 0;
+static int capture_video_format;
+static int capture_video_wait; // Wait for a free buffer instead of dropping
+static FILE *capture_video_file = NULL;
+static char capture_video_path[MAX_PATHLEN]; // Without extension
+static int capture_video_width;
+static int capture_video_height;
+static u32 capture_video_frames; // Frames queued
+static u32 capture_video_done; // Frames written. Streams write them in order.
+static u32 capture_video_pending; // Frames queued or being written
+static u32 capture_video_dropped;
+static int capture_video_error;
+
+static const char *capture_video_extension[CAPTURE_FORMAT_NUM] = {
+    "txt", "y4m", "rgb"
+};
+
+//------------------------------------------------------------------------------
+
+static int _capture_get_job_index(const unsigned char *buffer)
+{
+    for (int i = 0; i < CAPTURE_NUM_BUFFERS; i++)
+    {
+        if (capture_jobs[i].data == buffer)
+            return i;
+    }
+
+    return -1;
+}
+
+// Returns -1 if there are no free jobs and the caller doesn't want to wait.
+// The mutex must be locked by the caller.
+static int _capture_get_free_job(int wait)
+{
+    while (capture_free_count == 0)
+    {
+        if (!wait)
+            return -1;
+
+        SDL_CondWait(capture_done_cond, capture_mutex);
+    }
+
+    return capture_free_list[--capture_free_count];
+}
+
+// The mutex must be locked by the caller
+static void _capture_queue_job(int index)
+{
+    int end = (capture_queue_start + capture_queue_count) % CAPTURE_NUM_BUFFERS;
+    capture_queue[end] = index;
+    capture_queue_count++;
+
+    SDL_CondSignal(capture_work_cond);
+}
+
+// BT.601 with limited range, which is what most players expect
+static void _capture_rgb_to_yuv444(unsigned char *dst,
+                                   const unsigned char *src, int pixels)
+{
+    unsigned char *y_plane = dst;
+    unsigned char *u_plane = dst + pixels;
+    unsigned char *v_plane = dst + (pixels * 2);
+
+    for (int i = 0; i < pixels; i++)
+    {
+        int r = src[0];
+        int g = src[1];
+        int b = src[2];
+        src += 3;
+
+        y_plane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        u_plane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        v_plane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+}
+
+// Returns 1 on success
+static int _capture_write_video_frame(capture_job *job,
+                                      unsigned char *convert_buffer)
+{
+    if (capture_video_format == CAPTURE_FORMAT_PNG)
+    {
+        return Save_PNG_Level(job->path, job->data, job->width, job->height,
+                              0, job->png_level) == 0;
+    }
+
+    const unsigned char *data = job->data;
+    size_t size = job->width * job->height * 3;
+
+    // Convert the frame before waiting for the previous ones to be written
+    if (capture_video_format == CAPTURE_FORMAT_Y4M)
+    {
+        _capture_rgb_to_yuv444(convert_buffer, data,
+                               job->width * job->height);
+        data = convert_buffer;
+    }
+
+    SDL_LockMutex(capture_mutex);
+    while (capture_video_done != job->frame)
+        SDL_CondWait(capture_done_cond, capture_mutex);
+    SDL_UnlockMutex(capture_mutex);
+
+    if (capture_video_format == CAPTURE_FORMAT_Y4M)
+    {
+        if (fputs("FRAME\n", capture_video_file) < 0)
+            return 0;
+    }
+
+    return fwrite(data, size, 1, capture_video_file) == 1;
+}
+
+static int _capture_thread_func(void *data)
+{
+    unsigned char *convert_buffer = capture_convert_buffers[(intptr_t)data];
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    SDL_LockMutex(capture_mutex);
+
+    while (1)
+    {
+        while ((capture_queue_count == 0) && !capture_quit)
+            SDL_CondWait(capture_work_cond, capture_mutex);
+
+        if (capture_queue_count == 0)
+            break; // Quit, and there is nothing left to write
+
+        int index = capture_queue[capture_queue_start];
+        capture_queue_start = (capture_queue_start + 1) % CAPTURE_NUM_BUFFERS;
+        capture_queue_count--;
+
+        SDL_UnlockMutex(capture_mutex);
+
+        capture_job *job = &capture_jobs[index];
+        int ok;
+
+        if (job->type == CAPTURE_JOB_SCREENSHOT)
+        {
+            ok = Save_PNG_Level(job->path, job->data, job->width,
+                                job->height, 0, job->png_level) == 0;
+            if (!ok)
+                Debug_LogMsgArg("Capture: Can't save %s", job->path);
+        }
+        else
+        {
+            ok = _capture_write_video_frame(job, convert_buffer);
+        }
+
+        SDL_LockMutex(capture_mutex);
+
+        if (job->type == CAPTURE_JOB_VIDEO)
+        {
+            if (!ok)
+                capture_video_error = 1;
+            capture_video_done++;
+            capture_video_pending--;
+        }
+
+        capture_free_list[capture_free_count++] = index;
+        SDL_CondBroadcast(capture_done_cond);
+    }
+
+    SDL_UnlockMutex(capture_mutex);
+
+    return 0;
+}
+
+int Capture_Init(void)
+{
+    capture_mutex = SDL_CreateMutex();
+    capture_work_cond = SDL_CreateCond();
+    capture_done_cond = SDL_CreateCond();
+    if ((capture_mutex == NULL) || (capture_work_cond == NULL)
+        || (capture_done_cond == NULL))
+    {
+        Debug_ErrorMsgArg("Capture: Failed to create mutex: %s",
+                          SDL_GetError());
+        SDL_DestroyCond(capture_done_cond);
+        SDL_DestroyCond(capture_work_cond);
+        SDL_DestroyMutex(capture_mutex);
+        capture_done_cond = NULL;
+        capture_work_cond = NULL;
+        capture_mutex = NULL;
+        return 0;
+    }
+
+    for (int i = 0; i < CAPTURE_NUM_BUFFERS; i++)
+        capture_free_list[i] = i;
+    capture_free_count = CAPTURE_NUM_BUFFERS;
+    capture_queue_start = 0;
+    capture_queue_count = 0;
+    capture_quit = 0;
+
+    for (int i = 0; i < CAPTURE_NUM_THREADS; i++)
+    {
+        SDL_Thread *thread = SDL_CreateThread(_capture_thread_func, "Capture",
+                                              (void *)(intptr_t)i);
+        if (thread == NULL)
+        {
+            Debug_LogMsgArg("Capture: Failed to create thread: %s",
+                            SDL_GetError());
+            break;
+        }
+
+        capture_threads[capture_num_threads++] = thread;
+    }
+
+    if (capture_num_threads == 0)
+    {
+        // Screenshots will be saved without threads
+        SDL_DestroyCond(capture_done_cond);
+        SDL_DestroyCond(capture_work_cond);
+        SDL_DestroyMutex(capture_mutex);
+        capture_done_cond = NULL;
+        capture_work_cond = NULL;
+        capture_mutex = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+void Capture_End(void)
+{
+    if (capture_mutex == NULL)
+        return;
+
+    Capture_VideoStop();
+
+    // Pending screenshots are written before the threads exit
+    SDL_LockMutex(capture_mutex);
+    capture_quit = 1;
+    SDL_CondBroadcast(capture_work_cond);
+    SDL_UnlockMutex(capture_mutex);
+
+    for (int i = 0; i < capture_num_threads; i++)
+        SDL_WaitThread(capture_threads[i], NULL);
+    capture_num_threads = 0;
+
+    SDL_DestroyCond(capture_done_cond);
+    SDL_DestroyCond(capture_work_cond);
+    SDL_DestroyMutex(capture_mutex);
+    capture_done_cond = NULL;
+    capture_work_cond = NULL;
+    capture_mutex = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+unsigned char *Capture_ScreenshotBegin(void)
+{
+    // Without threads, screenshots are saved right away
+    if (capture_mutex == NULL)
+        return capture_jobs[0].data;
+
+    SDL_LockMutex(capture_mutex);
+    int index = _capture_get_free_job(1);
+    SDL_UnlockMutex(capture_mutex);
+
+    return capture_jobs[index].data;
+}
+
+void Capture_ScreenshotEnd(unsigned char *buffer, const char *path,
+                           int width, int height)
+{
+    int level = EmulatorConfig.capture_png_level;
+
+    if (capture_mutex == NULL)
+    {
+        if (Save_PNG_Level(path, buffer, width, height, 0, level) != 0)
+            Debug_LogMsgArg("Capture: Can't save %s", path);
+        return;
+    }
+
+    // Reserve the name of the file
+    FILE *f = fopen(path, "wb");
+    if (f)
+        fclose(f);
+
+    int index = _capture_get_job_index(buffer);
+    capture_job *job = &capture_jobs[index];
+
+    job->type = CAPTURE_JOB_SCREENSHOT;
+    job->width = width;
+    job->height = height;
+    job->png_level = level;
+    s_strncpy(job->path, path, sizeof(job->path));
+
+    SDL_LockMutex(capture_mutex);
+    _capture_queue_job(index);
+    SDL_UnlockMutex(capture_mutex);
+}
+
+//------------------------------------------------------------------------------
+
+int Capture_VideoStart(void)
+{
+    if (capture_mutex == NULL)
+    {
+        Debug_ErrorMsgArg("Video capture isn't available.");
+        return 0;
+    }
+
+    if (capture_video_recording)
+        return 1;
+
+    int format = EmulatorConfig.capture_video_format;
+
+    char *path = FU_GetNewTimestampFilenameExt("video",
+                                               capture_video_extension[format]);
+
+    // For PNG sequences this is the information file. It is created now so
+    // that the name isn't used by other videos.
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        Debug_ErrorMsgArg("Can't create %s", path);
+        return 0;
+    }
+
+    SDL_LockMutex(capture_mutex);
+
+    s_strncpy(capture_video_path, path, sizeof(capture_video_path));
+    capture_video_path[strlen(capture_video_path) - 4] = '\0';
+
+    capture_video_format = format;
+    capture_video_wait = EmulatorConfig.capture_video_wait;
+    capture_video_file = f;
+    capture_video_width = 0;
+    capture_video_height = 0;
+    capture_video_frames = 0;
+    capture_video_done = 0;
+    capture_video_pending = 0;
+    capture_video_dropped = 0;
+    capture_video_error = 0;
+    capture_video_recording = 1;
+
+    SDL_UnlockMutex(capture_mutex);
+
+    Debug_LogMsgArg("Capture: Recording %s", path);
+
+    return 1;
+}
+
+// Written next to PNG sequences and raw videos, they don't have a header
+static void _capture_video_write_info(FILE *f)
+{
+    fprintf(f, "format=%s\n",
+            (capture_video_format == CAPTURE_FORMAT_PNG) ? "png" : "rgb24");
+    fprintf(f, "width=%d\n", capture_video_width);
+    fprintf(f, "height=%d\n", capture_video_height);
+    fprintf(f, "fps=%d/%d\n", CAPTURE_FPS_NUM, CAPTURE_FPS_DEN);
+    fprintf(f, "frames=%u\n", capture_video_done);
+    fprintf(f, "dropped=%u\n", capture_video_dropped);
+}
+
+void Capture_VideoStop(void)
+{
+    if (capture_mutex == NULL)
+        return;
+
+    SDL_LockMutex(capture_mutex);
+
+    if (!capture_video_recording)
+    {
+        SDL_UnlockMutex(capture_mutex);
+        return;
+    }
+
+    capture_video_recording = 0;
+
+    while (capture_video_pending > 0)
+        SDL_CondWait(capture_done_cond, capture_mutex);
+
+    SDL_UnlockMutex(capture_mutex);
+
+    // The threads don't use the video anymore
+
+    if (capture_video_format == CAPTURE_FORMAT_PNG)
+    {
+        _capture_video_write_info(capture_video_file);
+    }
+    else if (capture_video_format == CAPTURE_FORMAT_RAW)
+    {
+        char path[MAX_PATHLEN + 4];
+        snprintf(path, sizeof(path), "%s.txt", capture_video_path);
+
+        FILE *f = fopen(path, "wb");
+        if (f)
+        {
+            _capture_video_write_info(f);
+            fclose(f);
+        }
+    }
+
+    if (fclose(capture_video_file) != 0)
+        capture_video_error = 1;
+    capture_video_file = NULL;
+
+    Debug_LogMsgArg("Capture: %u frames written, %u dropped",
+                    capture_video_done, capture_video_dropped);
+
+    if (capture_video_error)
+        Debug_ErrorMsgArg("Error while writing video: %s", capture_video_path);
+}
+
+int Capture_VideoIsRecording(void)
+{
+    if (capture_mutex == NULL)
+        return 0;
+
+    SDL_LockMutex(capture_mutex);
+    int ret = capture_video_recording;
+    SDL_UnlockMutex(capture_mutex);
+
+    return ret;
+}
+
+unsigned char *Capture_VideoFrameBegin(void)
+{
+    if (capture_mutex == NULL)
+        return NULL;
+
+    SDL_LockMutex(capture_mutex);
+
+    int index = -1;
+
+    if (capture_video_recording)
+    {
+        index = _capture_get_free_job(capture_video_wait);
+        if (index < 0)
+            capture_video_dropped++;
+    }
+
+    SDL_UnlockMutex(capture_mutex);
+
+    if (index < 0)
+        return NULL;
+
+    return capture_jobs[index].data;
+}
+
+void Capture_VideoFrameEnd(unsigned char *buffer, int width, int height)
+{
+    int index = _capture_get_job_index(buffer);
+    capture_job *job = &capture_jobs[index];
+
+    SDL_LockMutex(capture_mutex);
+
+    if (capture_video_width == 0)
+    {
+        capture_video_width = width;
+        capture_video_height = height;
+
+        // Nothing is written to the file until the first frame is queued
+        if (capture_video_format == CAPTURE_FORMAT_Y4M)
+        {
+            if (fprintf(capture_video_file,
+                        "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n",
+                        width, height, CAPTURE_FPS_NUM, CAPTURE_FPS_DEN) < 0)
+                capture_video_error = 1;
+        }
+    }
+
+    // All frames of a video must have the same size
+    if ((width != capture_video_width) || (height != capture_video_height))
+    {
+        capture_free_list[capture_free_count++] = index;
+        capture_video_dropped++;
+        SDL_UnlockMutex(capture_mutex);
+        return;
+    }
+
+    job->type = CAPTURE_JOB_VIDEO;
+    job->width = width;
+    job->height = height;
+    job->png_level = EmulatorConfig.capture_png_level;
+    job->frame = capture_video_frames++;
+
+    if (capture_video_format == CAPTURE_FORMAT_PNG)
+    {
+        snprintf(job->path, sizeof(job->path), "%s_%06u.png",
+                 capture_video_path, job->frame);
+    }
+
+    capture_video_pending++;
+    _capture_queue_job(index);
+
+    SDL_UnlockMutex(capture_mutex);
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef CAPTURE__
+#define CAPTURE__
+
+// Screenshots and video capture. Frames are drawn into a pool of preallocated
+// buffers, and they are encoded and written to disk by worker threads so that
+// the emulation doesn't have to wait for the encoder.
+
+// Size of the buffers of the pool. Frames are RGB24, up to 256x224 pixels.
+#define CAPTURE_FRAME_SIZE      (256 * 224 * 3)
+
+#define CAPTURE_FORMAT_PNG      0 // Sequence of PNG files
+#define CAPTURE_FORMAT_Y4M      1 // YUV 4:4:4 video stream
+#define CAPTURE_FORMAT_RAW      2 // RGB24 video stream without header
+#define CAPTURE_FORMAT_NUM      3
+
+// Starts and stops the worker threads. Pending screenshots and frames are
+// written before the threads exit.
+int Capture_Init(void);
+void Capture_End(void);
+
+// Returns a buffer of the pool to draw a frame. It waits until one is free if
+// all of them are being used. It never returns NULL.
+unsigned char *Capture_ScreenshotBegin(void);
+// Saves the buffer as a PNG file in the background. The file is created
+// before returning so that the name isn't reused by the next screenshot.
+void Capture_ScreenshotEnd(unsigned char *buffer, const char *path,
+                           int width, int height);
+
+// Starts recording a video in the screenshots folder with the format set in
+// the configuration. Returns 1 on success.
+int Capture_VideoStart(void);
+// Waits until all frames have been written and closes the video
+void Capture_VideoStop(void);
+int Capture_VideoIsRecording(void);
+
+// Call it once per emulated frame. It returns a buffer to draw the frame, or
+// NULL if there is no video being recorded or if the frame has to be dropped
+// because the encoders are busy. Pass the buffer to Capture_VideoFrameEnd()
+// once the frame has been drawn.
+unsigned char *Capture_VideoFrameBegin(void);
+void Capture_VideoFrameEnd(unsigned char *buffer, int width, int height);
+
+#endif // CAPTURE__
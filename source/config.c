@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "build_options.h"
+#include "capture.h"
 #include "config.h"
 #include "file_utils.h"
 #include "input_utils.h"
@@ -28,7 +29,14 @@ t_config EmulatorConfig = {
     0, // frameskip
     0, // oglfilter
     0, // auto_close_debugger
+    1, // autosave
+    1, // emulation_thread
+    0, // run_ahead
     0, // webcam_select
+    "", // webcam_file
+    6, // capture_png_level
+    CAPTURE_FORMAT_PNG, // capture_video_format
+    0, // capture_video_wait
     //---------
     64,   // volume
     0x3F, // chn_flags
@@ -39,6 +47,8 @@ t_config EmulatorConfig = {
     0,                // enableblur
     0,                // realcolors
     0x0200,           // gbcam_exposure_reference
+    //---------
+    0, // gba_link_cable
 
     // The GB palette is not stored here, it is stored in gb_main.c
     // The input config not here, either... it's in input_utils.c
@@ -64,9 +74,32 @@ static const char *oglfiltertype[] = {
 #define CFG_AUTO_CLOSE_DEBUGGER "auto_close_debugger"
 // "true" - "false"
 
+#define CFG_AUTOSAVE "autosave"
+// "true" - "false"
+
+#define CFG_EMULATION_THREAD "emulation_thread"
+// "true" - "false"
+
+#define CFG_RUN_AHEAD "run_ahead"
+// "0" - "8"
+
 #define CFG_WEBCAM_SELECT "webcam_select"
 // "0" - "9"
 
+#define CFG_WEBCAM_FILE "webcam_file"
+// Path, empty to use the webcam
+
+#define CFG_CAPTURE_PNG_LEVEL "capture_png_level"
+// "0" - "9"
+
+#define CFG_CAPTURE_VIDEO_FORMAT "capture_video_format"
+static const char *capturevideoformat[] = {
+    "png", "y4m", "raw"
+};
+
+#define CFG_CAPTURE_VIDEO_WAIT "capture_video_wait"
+// "true" - "false"
+
 #define CFG_SND_CHN_ENABLE "channels_enabled"
 // "#3F" 3F = flags
 
@@ -83,7 +116,7 @@ static const char *hwtype[] = {
 
 #define CFG_SERIAL_DEVICE "serial_device"
 static const char *serialdevice[] = {
-    "None", "GBPrinter" //, "Gameboy"
+    "None", "GBPrinter", "Gameboy"
 };
 
 #define CFG_ENABLE_BLUR "enable_blur"
@@ -98,6 +131,9 @@ static const char *serialdevice[] = {
 #define CFG_GB_PALETTE "gb_palette"
 // "#RRGGBB"
 
+#define CFG_GBA_LINK_CABLE "gba_link_cable"
+// "true" - "false"
+
 //---------------------------------------------------------------------
 
 void Config_Save(void)
@@ -129,7 +165,19 @@ void Config_Save(void)
             oglfiltertype[EmulatorConfig.oglfilter]);
     fprintf(ini_file, CFG_AUTO_CLOSE_DEBUGGER "=%s\n",
             EmulatorConfig.auto_close_debugger ? "true" : "false");
+    fprintf(ini_file, CFG_AUTOSAVE "=%s\n",
+            EmulatorConfig.autosave ? "true" : "false");
+    fprintf(ini_file, CFG_EMULATION_THREAD "=%s\n",
+            EmulatorConfig.emulation_thread ? "true" : "false");
+    fprintf(ini_file, CFG_RUN_AHEAD "=%d\n", EmulatorConfig.run_ahead);
     fprintf(ini_file, CFG_WEBCAM_SELECT "=%d\n", EmulatorConfig.webcam_select);
+    fprintf(ini_file, CFG_WEBCAM_FILE "=%s\n", EmulatorConfig.webcam_file);
+    fprintf(ini_file, CFG_CAPTURE_PNG_LEVEL "=%d\n",
+            EmulatorConfig.capture_png_level);
+    fprintf(ini_file, CFG_CAPTURE_VIDEO_FORMAT "=%s\n",
+            capturevideoformat[EmulatorConfig.capture_video_format]);
+    fprintf(ini_file, CFG_CAPTURE_VIDEO_WAIT "=%s\n",
+            EmulatorConfig.capture_video_wait ? "true" : "false");
     fprintf(ini_file, "\n");
 
     fprintf(ini_file, "[Sound]\n");
@@ -158,6 +206,11 @@ void Config_Save(void)
     fprintf(ini_file, CFG_GB_PALETTE "=#%02X%02X%02X\n", r, g, b);
     fprintf(ini_file, "\n");
 
+    fprintf(ini_file, "[GameBoyAdvance]\n");
+    fprintf(ini_file, CFG_GBA_LINK_CABLE "=%s\n",
+            EmulatorConfig.gba_link_cable ? "true" : "false");
+    fprintf(ini_file, "\n");
+
     fprintf(ini_file, "[Controls]\n");
 
     for (int player = 0; player < 4; player++)
@@ -326,6 +379,37 @@ void Config_Load(void)
             EmulatorConfig.auto_close_debugger = 0;
     }
 
+    tmp = strstr(ini, CFG_AUTOSAVE);
+    if (tmp)
+    {
+        tmp += strlen(CFG_AUTOSAVE) + 1;
+        if (strncmp(tmp, "true", strlen("true")) == 0)
+            EmulatorConfig.autosave = 1;
+        else
+            EmulatorConfig.autosave = 0;
+    }
+
+    tmp = strstr(ini, CFG_EMULATION_THREAD);
+    if (tmp)
+    {
+        tmp += strlen(CFG_EMULATION_THREAD) + 1;
+        if (strncmp(tmp, "true", strlen("true")) == 0)
+            EmulatorConfig.emulation_thread = 1;
+        else
+            EmulatorConfig.emulation_thread = 0;
+    }
+
+    tmp = strstr(ini, CFG_RUN_AHEAD);
+    if (tmp)
+    {
+        tmp += strlen(CFG_RUN_AHEAD) + 1;
+        EmulatorConfig.run_ahead = atoi(tmp);
+        if (EmulatorConfig.run_ahead > 8)
+            EmulatorConfig.run_ahead = 8;
+        else if (EmulatorConfig.run_ahead < 0)
+            EmulatorConfig.run_ahead = 0;
+    }
+
     tmp = strstr(ini, CFG_WEBCAM_SELECT);
     if (tmp)
     {
@@ -335,6 +419,58 @@ void Config_Load(void)
             EmulatorConfig.webcam_select = 9;
     }
 
+    tmp = strstr(ini, CFG_WEBCAM_FILE);
+    if (tmp)
+    {
+        tmp += strlen(CFG_WEBCAM_FILE) + 1;
+
+        size_t len = 0;
+        while ((tmp[len] != '\0') && (tmp[len] != '\r') && (tmp[len] != '\n')
+               && (len < sizeof(EmulatorConfig.webcam_file) - 1))
+        {
+            EmulatorConfig.webcam_file[len] = tmp[len];
+            len++;
+        }
+        EmulatorConfig.webcam_file[len] = '\0';
+    }
+
+    tmp = strstr(ini, CFG_CAPTURE_PNG_LEVEL);
+    if (tmp)
+    {
+        tmp += strlen(CFG_CAPTURE_PNG_LEVEL) + 1;
+        EmulatorConfig.capture_png_level = atoi(tmp);
+        if (EmulatorConfig.capture_png_level > 9)
+            EmulatorConfig.capture_png_level = 9;
+        else if (EmulatorConfig.capture_png_level < 0)
+            EmulatorConfig.capture_png_level = 0;
+    }
+
+    tmp = strstr(ini, CFG_CAPTURE_VIDEO_FORMAT);
+    if (tmp)
+    {
+        tmp += strlen(CFG_CAPTURE_VIDEO_FORMAT) + 1;
+
+        int result = CAPTURE_FORMAT_PNG;
+        for (size_t i = 0; i < ARRAY_NUM_ELEMENTS(capturevideoformat); i++)
+        {
+            if (strncmp(tmp, capturevideoformat[i],
+                        strlen(capturevideoformat[i])) == 0)
+                result = i;
+        }
+
+        EmulatorConfig.capture_video_format = result;
+    }
+
+    tmp = strstr(ini, CFG_CAPTURE_VIDEO_WAIT);
+    if (tmp)
+    {
+        tmp += strlen(CFG_CAPTURE_VIDEO_WAIT) + 1;
+        if (strncmp(tmp, "true", strlen("true")) == 0)
+            EmulatorConfig.capture_video_wait = 1;
+        else
+            EmulatorConfig.capture_video_wait = 0;
+    }
+
     // SOUND
     int vol = 64, chn_flags = 0x3F;
     tmp = strstr(ini, CFG_SND_CHN_ENABLE);
@@ -481,6 +617,16 @@ void Config_Load(void)
         }
     }
 
+    tmp = strstr(ini, CFG_GBA_LINK_CABLE);
+    if (tmp)
+    {
+        tmp += strlen(CFG_GBA_LINK_CABLE) + 1;
+        if (strncmp(tmp, "true", strlen("true")) == 0)
+            EmulatorConfig.gba_link_cable = 1;
+        else
+            EmulatorConfig.gba_link_cable = 0;
+    }
+
     for (int player = 0; player < 4; player++)
     {
         int player_enabled = 0;
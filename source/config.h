@@ -7,6 +7,8 @@
 #ifndef CONFIG__
 #define CONFIG__
 
+#include "build_options.h"
+
 typedef struct
 {
     int debug_msg_enable;
@@ -16,7 +18,18 @@ typedef struct
     int frameskip; // -1 = auto, 0-9 = fixed frameskip
     int oglfilter;
     int auto_close_debugger;
+    int autosave; // Write battery saves in the background while playing
+    int emulation_thread; // Emulate in a thread separated from the GUI
+    int run_ahead; // Frames emulated ahead of the input to reduce latency
     unsigned int webcam_select; // 0 = CV_CAP_ANY
+    // If not empty, the GB Camera reads frames from this file instead of
+    // using the webcam. It can be a ".raw" file with 8 bit grayscale frames of
+    // the size of the sensor, or any video or image sequence OpenCV can open.
+    char webcam_file[MAX_PATHLEN];
+    int capture_png_level; // zlib level of screenshots and PNG videos (0-9)
+    int capture_video_format; // CAPTURE_FORMAT_*
+    // When recording video, wait for the encoders instead of dropping frames
+    int capture_video_wait;
 
     // Sound
     //-----
@@ -32,6 +45,10 @@ typedef struct
     int realcolors;
     unsigned int gbcam_exposure_reference;
 
+    // GameBoy Advance
+    //---------------
+    int gba_link_cable; // Link with another instance of the emulator
+
     // The GB palette is not stored here, it is stored in gb_main.c
 
     // The input configuration is in input_utils.c
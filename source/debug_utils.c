@@ -21,15 +21,21 @@
 
 //------------------------------------------------------------------------------
 
+// Messages can be logged from any thread. The mutex protects the log file.
+static SDL_mutex *log_mutex = NULL;
 static FILE *f_log;
 static int log_file_opened = 0;
 
 void Debug_End(void)
 {
+    SDL_LockMutex(log_mutex);
+
     if (log_file_opened)
         fclose(f_log);
 
     log_file_opened = 0;
+
+    SDL_UnlockMutex(log_mutex);
 }
 
 void Debug_Init(void)
@@ -37,6 +43,9 @@ void Debug_Init(void)
     log_file_opened = 0;
     atexit(Debug_End);
 
+    if (log_mutex == NULL)
+        log_mutex = SDL_CreateMutex();
+
     // Remove previous log files
     char logpath[MAX_PATHLEN];
     snprintf(logpath, sizeof(logpath), "%slog.txt", DirGetRunningPath());
@@ -46,6 +55,8 @@ void Debug_Init(void)
 
 void Debug_LogMsgArg(const char *msg, ...)
 {
+    SDL_LockMutex(log_mutex);
+
     if (log_file_opened == 0)
     {
         char logpath[MAX_PATHLEN];
@@ -63,6 +74,8 @@ void Debug_LogMsgArg(const char *msg, ...)
         va_end(args);
         fputc('\n', f_log);
     }
+
+    SDL_UnlockMutex(log_mutex);
 }
 
 void Debug_DebugMsgArg(const char *msg, ...)
@@ -9,6 +9,8 @@
 
 void Debug_Init(void);
 void Debug_End(void);
+// Writes a message to the log file. It can be called from any thread once
+// Debug_Init() has been called.
 void Debug_LogMsgArg(const char *msg, ...);
 void Debug_DebugMsgArg(const char *msg, ...);
 void Debug_ErrorMsgArg(const char *msg, ...);
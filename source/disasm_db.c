@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <SDL2/SDL.h>
+
+#include "debug_utils.h"
+#include "disasm_db.h"
+
+#include "gb_core/analysis.h"
+#include "gb_core/gameboy.h"
+
+#include "gba_core/analysis.h"
+#include "gba_core/gba.h"
+#include "gba_core/memory.h"
+
+extern _GB_CONTEXT_ GameBoy;
+
+// Instructions decoded each time the mutex is locked by the thread
+#define DISASM_DB_STEP_INSTRUCTIONS 4096
+
+static SDL_Thread *disasm_db_thread = NULL;
+static SDL_mutex *disasm_db_mutex = NULL;
+static SDL_cond *disasm_db_cond = NULL;
+
+// All the variables below are protected by disasm_db_mutex
+static int disasm_db_system = 0;
+static int disasm_db_busy = 0;
+static int disasm_db_quit = 0;
+
+static int _disasm_db_thread_func(void *data)
+{
+    (void)data;
+
+    SDL_LockMutex(disasm_db_mutex);
+
+    while (disasm_db_quit == 0)
+    {
+        if (disasm_db_system == DISASM_DB_SYSTEM_GBA)
+            disasm_db_busy = GBA_AnalysisStep(DISASM_DB_STEP_INSTRUCTIONS);
+        else
+            disasm_db_busy = GB_AnalysisStep(DISASM_DB_STEP_INSTRUCTIONS);
+
+        if (disasm_db_busy == 0)
+        {
+            // Wait until more entry points are added
+            SDL_CondWait(disasm_db_cond, disasm_db_mutex);
+            continue;
+        }
+
+        // Let the windows read the results between steps
+        SDL_UnlockMutex(disasm_db_mutex);
+        SDL_Delay(0);
+        SDL_LockMutex(disasm_db_mutex);
+    }
+
+    SDL_UnlockMutex(disasm_db_mutex);
+
+    return 0;
+}
+
+void DisasmDB_ROMLoaded(int system)
+{
+    DisasmDB_ROMUnloaded();
+
+    int ret;
+
+    if (system == DISASM_DB_SYSTEM_GBA)
+    {
+        ret = GBA_AnalysisInit(Mem.rom_wait0, GBA_GetRomSize());
+    }
+    else
+    {
+        ret = GB_AnalysisInit((const u8 *)GameBoy.Emulator.Rom_Pointer,
+                              GameBoy.Emulator.ROM_Banks * 0x4000);
+    }
+
+    if (ret == 0)
+        return;
+
+    disasm_db_mutex = SDL_CreateMutex();
+    disasm_db_cond = SDL_CreateCond();
+    if ((disasm_db_mutex == NULL) || (disasm_db_cond == NULL))
+    {
+        Debug_LogMsgArg("DisasmDB: Failed to create mutex: %s",
+                        SDL_GetError());
+        DisasmDB_ROMUnloaded();
+        return;
+    }
+
+    disasm_db_system = system;
+    disasm_db_busy = 1;
+    disasm_db_quit = 0;
+
+    disasm_db_thread = SDL_CreateThread(_disasm_db_thread_func, "DisasmDB",
+                                        NULL);
+    if (disasm_db_thread == NULL)
+    {
+        Debug_LogMsgArg("DisasmDB: Failed to create thread: %s",
+                        SDL_GetError());
+        DisasmDB_ROMUnloaded();
+        return;
+    }
+}
+
+void DisasmDB_ROMUnloaded(void)
+{
+    if (disasm_db_thread != NULL)
+    {
+        SDL_LockMutex(disasm_db_mutex);
+        disasm_db_quit = 1;
+        SDL_CondBroadcast(disasm_db_cond);
+        SDL_UnlockMutex(disasm_db_mutex);
+
+        SDL_WaitThread(disasm_db_thread, NULL);
+        disasm_db_thread = NULL;
+    }
+
+    if (disasm_db_cond != NULL)
+    {
+        SDL_DestroyCond(disasm_db_cond);
+        disasm_db_cond = NULL;
+    }
+
+    if (disasm_db_mutex != NULL)
+    {
+        SDL_DestroyMutex(disasm_db_mutex);
+        disasm_db_mutex = NULL;
+    }
+
+    GBA_AnalysisEnd();
+    GB_AnalysisEnd();
+
+    disasm_db_system = 0;
+    disasm_db_busy = 0;
+}
+
+void DisasmDB_Lock(void)
+{
+    if (disasm_db_mutex != NULL)
+        SDL_LockMutex(disasm_db_mutex);
+}
+
+void DisasmDB_Unlock(void)
+{
+    if (disasm_db_mutex != NULL)
+        SDL_UnlockMutex(disasm_db_mutex);
+}
+
+void DisasmDB_GBAAddEntry(uint32_t address, int thumb)
+{
+    if (disasm_db_thread == NULL)
+        return;
+
+    SDL_LockMutex(disasm_db_mutex);
+
+    u32 instructions, pending;
+
+    GBA_AnalysisAddEntry(address, thumb);
+    GBA_AnalysisGetStats(&instructions, &pending);
+
+    // Nothing is queued if it's outside of the ROM or if it's already known
+    if (pending > 0)
+    {
+        disasm_db_busy = 1;
+        SDL_CondBroadcast(disasm_db_cond);
+    }
+
+    SDL_UnlockMutex(disasm_db_mutex);
+}
+
+void DisasmDB_GBAddEntry(uint32_t offset)
+{
+    if (disasm_db_thread == NULL)
+        return;
+
+    SDL_LockMutex(disasm_db_mutex);
+
+    u32 instructions, pending;
+
+    GB_AnalysisAddEntry(offset);
+    GB_AnalysisGetStats(&instructions, &pending);
+
+    if (pending > 0)
+    {
+        disasm_db_busy = 1;
+        SDL_CondBroadcast(disasm_db_cond);
+    }
+
+    SDL_UnlockMutex(disasm_db_mutex);
+}
+
+int DisasmDB_IsBusy(void)
+{
+    if (disasm_db_thread == NULL)
+        return 0;
+
+    SDL_LockMutex(disasm_db_mutex);
+    int busy = disasm_db_busy;
+    SDL_UnlockMutex(disasm_db_mutex);
+
+    return busy;
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef DISASM_DB__
+#define DISASM_DB__
+
+#include <stdint.h>
+
+// Runs the static analysis of the code of the loaded ROM (gba_core/analysis.h
+// and gb_core/analysis.h) in a background thread. The disassembler windows use
+// it to know which addresses are ARM or THUMB code, where instructions start,
+// and which ones are the targets of jumps and calls.
+
+#define DISASM_DB_SYSTEM_GB     1
+#define DISASM_DB_SYSTEM_GBA    2
+
+// Called by the main window. The thread is stopped before the ROM is freed.
+void DisasmDB_ROMLoaded(int system);
+void DisasmDB_ROMUnloaded(void);
+
+// The functions of the analysis modules can only be called between these two
+// calls, as the thread may be using them at the same time.
+void DisasmDB_Lock(void);
+void DisasmDB_Unlock(void);
+
+// Adds code found while the game runs (the current PC, for example)
+void DisasmDB_GBAAddEntry(uint32_t address, int thumb);
+void DisasmDB_GBAddEntry(uint32_t offset);
+
+// Returns 1 while the thread is analysing code
+int DisasmDB_IsBusy(void);
+
+#endif // DISASM_DB__
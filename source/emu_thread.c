@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <SDL2/SDL.h>
+
+#include "debug_utils.h"
+#include "emu_thread.h"
+#include "general_utils.h"
+
+#define EMU_THREAD_MS_PER_FRAME ((double)1000.0 / (double)60.0)
+
+#define EMU_THREAD_MAX_DEFERRED 8
+
+// Triple buffer. The thread draws to one buffer, the main thread reads from
+// another one, and the third one holds the last finished frame. The index of
+// the last finished frame is swapped atomically with the one of the buffer
+// that has just been drawn or read, so no side ever waits for the other one.
+static unsigned char emu_thread_buffers[3][EMU_THREAD_FRAME_SIZE];
+
+#define EMU_THREAD_INDEX_MASK   0x3
+#define EMU_THREAD_FRESH        0x4 // The ready buffer hasn't been read yet
+
+static int emu_thread_write_index = 0; // Only used by the emulation thread
+static int emu_thread_read_index = 2; // Only used by the main thread
+static SDL_atomic_t emu_thread_ready_index; // Index of the last frame | flags
+
+static SDL_Thread *emu_thread = NULL;
+static SDL_threadID emu_thread_id;
+static SDL_mutex *emu_thread_mutex = NULL;
+static SDL_cond *emu_thread_cond = NULL;
+static SDL_sem *emu_thread_frame_sem = NULL;
+
+// Number of times the main thread is waiting to get the lock
+static SDL_atomic_t emu_thread_ui_waiting;
+
+// All the variables below are protected by emu_thread_mutex
+static emu_thread_frame_fn emu_thread_frame = NULL;
+static int emu_thread_run = 0;
+static int emu_thread_quit = 0;
+static emu_thread_fn emu_thread_deferred[EMU_THREAD_MAX_DEFERRED];
+static int emu_thread_num_deferred = 0;
+
+static double _emu_thread_get_ms(void)
+{
+    return (double)SDL_GetPerformanceCounter() * 1000.0
+           / (double)SDL_GetPerformanceFrequency();
+}
+
+static void _emu_thread_publish_frame(void)
+{
+    int old = SDL_AtomicSet(&emu_thread_ready_index,
+                            emu_thread_write_index | EMU_THREAD_FRESH);
+    emu_thread_write_index = old & EMU_THREAD_INDEX_MASK;
+
+    SDL_SemPost(emu_thread_frame_sem);
+}
+
+static int _emu_thread_func(unused__ void *data)
+{
+    double waitforms = 0.0;
+
+    SDL_LockMutex(emu_thread_mutex);
+
+    while (1)
+    {
+        while (!emu_thread_quit
+               && (!emu_thread_run || (emu_thread_num_deferred > 0)))
+        {
+            SDL_CondWait(emu_thread_cond, emu_thread_mutex);
+        }
+
+        if (emu_thread_quit)
+            break;
+
+        int flags = emu_thread_frame(
+                        emu_thread_buffers[emu_thread_write_index]);
+
+        if (flags & EMU_THREAD_FRAME_DRAWN)
+            _emu_thread_publish_frame();
+
+        SDL_UnlockMutex(emu_thread_mutex);
+
+        // Synchronise video
+        if (flags & EMU_THREAD_NO_WAIT)
+        {
+            waitforms = 0.0;
+        }
+        else
+        {
+            double msnow = _emu_thread_get_ms();
+
+            while (waitforms > msnow)
+            {
+                SDL_Delay(1);
+                msnow = _emu_thread_get_ms();
+            }
+
+            // If the emulator missed a frame or more, adjust next frame
+            if (waitforms < (msnow - EMU_THREAD_MS_PER_FRAME))
+                waitforms = msnow + EMU_THREAD_MS_PER_FRAME;
+            else
+                waitforms += EMU_THREAD_MS_PER_FRAME;
+        }
+
+        // Mutexes aren't fair. Let the main thread get the lock if it's
+        // waiting for it, or it may never get it during speedup.
+        while (SDL_AtomicGet(&emu_thread_ui_waiting) > 0)
+            SDL_Delay(0);
+
+        SDL_LockMutex(emu_thread_mutex);
+    }
+
+    SDL_UnlockMutex(emu_thread_mutex);
+
+    return 0;
+}
+
+int EmuThread_Init(emu_thread_frame_fn frame_fn)
+{
+    emu_thread_mutex = SDL_CreateMutex();
+    emu_thread_cond = SDL_CreateCond();
+    emu_thread_frame_sem = SDL_CreateSemaphore(0);
+    if ((emu_thread_mutex == NULL) || (emu_thread_cond == NULL)
+        || (emu_thread_frame_sem == NULL))
+    {
+        Debug_LogMsgArg("EmuThread: Failed to create mutex: %s",
+                        SDL_GetError());
+        return 0;
+    }
+
+    SDL_AtomicSet(&emu_thread_ready_index, 1);
+    SDL_AtomicSet(&emu_thread_ui_waiting, 0);
+
+    emu_thread_frame = frame_fn;
+    emu_thread_run = 0;
+    emu_thread_quit = 0;
+    emu_thread_num_deferred = 0;
+
+    // Don't let the thread start until its ID has been saved
+    SDL_LockMutex(emu_thread_mutex);
+
+    emu_thread = SDL_CreateThread(_emu_thread_func, "Emulation", NULL);
+    if (emu_thread == NULL)
+    {
+        SDL_UnlockMutex(emu_thread_mutex);
+        Debug_LogMsgArg("EmuThread: Failed to create thread: %s",
+                        SDL_GetError());
+        return 0;
+    }
+
+    emu_thread_id = SDL_GetThreadID(emu_thread);
+
+    SDL_UnlockMutex(emu_thread_mutex);
+
+    return 1;
+}
+
+void EmuThread_End(void)
+{
+    if (emu_thread == NULL)
+        return;
+
+    SDL_LockMutex(emu_thread_mutex);
+    emu_thread_quit = 1;
+    SDL_CondBroadcast(emu_thread_cond);
+    SDL_UnlockMutex(emu_thread_mutex);
+
+    SDL_WaitThread(emu_thread, NULL);
+    emu_thread = NULL;
+
+    SDL_DestroySemaphore(emu_thread_frame_sem);
+    SDL_DestroyCond(emu_thread_cond);
+    SDL_DestroyMutex(emu_thread_mutex);
+    emu_thread_frame_sem = NULL;
+    emu_thread_cond = NULL;
+    emu_thread_mutex = NULL;
+}
+
+int EmuThread_IsStarted(void)
+{
+    return emu_thread != NULL;
+}
+
+int EmuThread_IsCurrent(void)
+{
+    if (emu_thread == NULL)
+        return 0;
+
+    return SDL_ThreadID() == emu_thread_id;
+}
+
+void EmuThread_SetRunning(int run)
+{
+    if (emu_thread == NULL)
+        return;
+
+    if (emu_thread_run == run)
+        return;
+
+    emu_thread_run = run;
+    SDL_CondBroadcast(emu_thread_cond);
+}
+
+int EmuThread_IsRunning(void)
+{
+    if (emu_thread == NULL)
+        return 0;
+
+    return emu_thread_run;
+}
+
+void EmuThread_Lock(void)
+{
+    if (emu_thread == NULL)
+        return;
+
+    SDL_AtomicAdd(&emu_thread_ui_waiting, 1);
+    SDL_LockMutex(emu_thread_mutex);
+    SDL_AtomicAdd(&emu_thread_ui_waiting, -1);
+}
+
+void EmuThread_Unlock(void)
+{
+    if (emu_thread == NULL)
+        return;
+
+    SDL_UnlockMutex(emu_thread_mutex);
+}
+
+const unsigned char *EmuThread_GetFrame(void)
+{
+    if (emu_thread == NULL)
+        return NULL;
+
+    if ((SDL_AtomicGet(&emu_thread_ready_index) & EMU_THREAD_FRESH) == 0)
+        return NULL;
+
+    int old = SDL_AtomicSet(&emu_thread_ready_index, emu_thread_read_index);
+    emu_thread_read_index = old & EMU_THREAD_INDEX_MASK;
+
+    return emu_thread_buffers[emu_thread_read_index];
+}
+
+int EmuThread_WaitFrame(unsigned int timeout_ms)
+{
+    if (emu_thread == NULL)
+        return 0;
+
+    if ((SDL_AtomicGet(&emu_thread_ready_index) & EMU_THREAD_FRESH) == 0)
+        SDL_SemWaitTimeout(emu_thread_frame_sem, timeout_ms);
+
+    // Frames that have been replaced by newer ones have posted the semaphore
+    // too, drain it so that the next call doesn't return right away.
+    while (SDL_SemTryWait(emu_thread_frame_sem) == 0)
+        ;
+
+    return (SDL_AtomicGet(&emu_thread_ready_index) & EMU_THREAD_FRESH) != 0;
+}
+
+void EmuThread_Defer(emu_thread_fn fn)
+{
+    // The caller is the emulation thread, so the lock is already held
+
+    for (int i = 0; i < emu_thread_num_deferred; i++)
+    {
+        if (emu_thread_deferred[i] == fn)
+            return;
+    }
+
+    if (emu_thread_num_deferred == EMU_THREAD_MAX_DEFERRED)
+    {
+        Debug_LogMsgArg("EmuThread: Too many deferred calls");
+        return;
+    }
+
+    emu_thread_deferred[emu_thread_num_deferred++] = fn;
+}
+
+void EmuThread_HandleDeferred(void)
+{
+    if (emu_thread == NULL)
+        return;
+
+    EmuThread_Lock();
+
+    for (int i = 0; i < emu_thread_num_deferred; i++)
+        emu_thread_deferred[i]();
+
+    if (emu_thread_num_deferred > 0)
+    {
+        emu_thread_num_deferred = 0;
+        SDL_CondBroadcast(emu_thread_cond);
+    }
+
+    EmuThread_Unlock();
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef EMU_THREAD__
+#define EMU_THREAD__
+
+// Size of the frames handed from the emulation thread to the main thread
+#define EMU_THREAD_FRAME_SIZE   (256 * 224 * 3)
+
+// Flags returned by the frame function
+#define EMU_THREAD_FRAME_DRAWN  (1 << 0) // The buffer contains a new frame
+#define EMU_THREAD_NO_WAIT      (1 << 1) // Don't wait before the next frame
+
+// Emulates one frame and draws it to the buffer if it isn't skipped. It's
+// called from the emulation thread with the emulation lock held.
+typedef int (*emu_thread_frame_fn)(unsigned char *buffer);
+
+typedef void (*emu_thread_fn)(void);
+
+// Starts and stops the emulation thread. It starts paused.
+int EmuThread_Init(emu_thread_frame_fn frame_fn);
+void EmuThread_End(void);
+
+// Returns 1 if the thread has been started
+int EmuThread_IsStarted(void);
+
+// Returns 1 if the caller is the emulation thread
+int EmuThread_IsCurrent(void);
+
+// Lets the thread emulate frames or pauses it. The lock must be held.
+void EmuThread_SetRunning(int run);
+int EmuThread_IsRunning(void);
+
+// The state of the emulated system can only be accessed from the main thread
+// while the lock is held. The thread holds it while it emulates a frame.
+void EmuThread_Lock(void);
+void EmuThread_Unlock(void);
+
+// Returns the last frame drawn by the thread, or NULL if there isn't any new
+// frame since the last call. Only the main thread can call this.
+const unsigned char *EmuThread_GetFrame(void);
+
+// Waits until the thread draws a new frame or the timeout (in ms) expires.
+// Returns 1 if there is a new frame.
+int EmuThread_WaitFrame(unsigned int timeout_ms);
+
+// Called from the emulation thread to run a function in the main thread, for
+// things like opening windows. The thread doesn't emulate any other frame until
+// the main thread calls EmuThread_HandleDeferred().
+void EmuThread_Defer(emu_thread_fn fn);
+void EmuThread_HandleDeferred(void);
+
+#endif // EMU_THREAD__
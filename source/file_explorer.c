@@ -17,8 +17,10 @@
 #endif
 
 #include "build_options.h"
+#include "file_explorer.h"
 #include "general_utils.h"
 #include "file_utils.h"
+#include "rom_library.h"
 
 static int _file_explorer_is_valid_rom_type(char *name)
 {
@@ -42,6 +44,8 @@ static int _file_explorer_is_valid_rom_type(char *name)
         return 1;
     if (strcmp(extension, "SGB") == 0)
         return 1;
+    if (strcmp(extension, "ZIP") == 0)
+        return 1;
 
     extension[0] = extension[1];
     extension[1] = extension[2];
@@ -49,6 +53,8 @@ static int _file_explorer_is_valid_rom_type(char *name)
 
     if (strcmp(extension, "GB") == 0)
         return 1;
+    if (strcmp(extension, "GZ") == 0)
+        return 1;
 
     return 0;
 }
@@ -81,14 +87,23 @@ static char fileselected[MAX_PATHLEN];
 
 static char **filename = NULL;
 static int *list_isdir = NULL;
+static u64 *list_size = NULL;
+static s64 *list_mtime = NULL;
 static int maxfiles; // Allocated space for files
 static int is_root = 0;
 static char exploring_path[MAX_PATHLEN];
 static int list_inited = 0;
 
+// Indices of the files shown, sorted and filtered
+static int *list_order = NULL;
+static int list_shown;
+
+static int sort_mode = FILE_EXPLORER_SORT_NAME;
+static int filter_system = FILE_EXPLORER_FILTER_ALL;
+
 int FileExplorer_GetNumFiles(void)
 {
-    return filenum;
+    return list_shown;
 }
 
 void FileExplorer_SetPath(char *path)
@@ -108,6 +123,12 @@ void FileExplorer_ListFree(void)
 
     if (list_isdir)
         free(list_isdir);
+    free(list_size);
+    free(list_mtime);
+    free(list_order);
+    list_size = NULL;
+    list_mtime = NULL;
+    list_order = NULL;
 
     if (filename)
     {
@@ -121,18 +142,22 @@ void FileExplorer_ListFree(void)
 
     filenum = 0;
     maxfiles = 0;
+    list_shown = 0;
 }
 
 void FileExplorer_ListInit(int numfiles)
 {
     list_isdir = malloc(numfiles * sizeof(int));
     filename = malloc(numfiles * sizeof(char *));
+    list_size = calloc(numfiles, sizeof(u64));
+    list_mtime = calloc(numfiles, sizeof(s64));
+    list_order = malloc(numfiles * sizeof(int));
     maxfiles = numfiles;
     is_root = 1;
     list_inited = 1;
 }
 
-void FileExplorer_ListAdd(char *name, int isdir)
+void FileExplorer_ListAdd(char *name, int isdir, u64 size, s64 mtime)
 {
     if (strcmp(name, ".") == 0)
         return;
@@ -154,28 +179,184 @@ void FileExplorer_ListAdd(char *name, int isdir)
         }
 
         list_isdir[filenum] = isdir;
-        size_t size = strlen(name) + 1;
-        filename[filenum] = malloc(size);
-        s_strncpy(filename[filenum], name, size);
+        list_size[filenum] = size;
+        list_mtime[filenum] = mtime;
+        size_t len = strlen(name) + 1;
+        filename[filenum] = malloc(len);
+        s_strncpy(filename[filenum], name, len);
         filenum++;
     }
 }
 
 char *FileExplorer_GetName(int index)
 {
-    if (index < filenum)
-        return filename[index];
+    if (index < list_shown)
+        return filename[list_order[index]];
     return ".";
 }
 
 int FileExplorer_GetIsDir(int index)
 {
-    if (index < filenum)
-        return list_isdir[index];
+    if (index < list_shown)
+        return list_isdir[list_order[index]];
     return 0;
 }
 
-int FileExplorer_LoadFolder(void)
+// Returns 1 if the information of the ROM is in the ROM library
+static int _file_explorer_get_info(int file, rom_library_info *info)
+{
+    if (list_isdir[file])
+        return 0;
+
+    char path[MAX_PATHLEN];
+    snprintf(path, sizeof(path), "%s%s", exploring_path, filename[file]);
+
+    return RomLibrary_Get(path, list_size[file], list_mtime[file], info);
+}
+
+int FileExplorer_GetInfo(int index, rom_library_info *info)
+{
+    if (index < list_shown)
+        return _file_explorer_get_info(list_order[index], info);
+    return 0;
+}
+
+// Used while sorting
+static rom_library_info *sort_info = NULL;
+static int *sort_has_info = NULL;
+
+static int _file_explorer_compare(const void *a, const void *b)
+{
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+
+    // ".." goes always first, then directories
+    if (strcmp(filename[ia], "..") == 0)
+        return -1;
+    if (strcmp(filename[ib], "..") == 0)
+        return 1;
+
+    if (list_isdir[ia] != list_isdir[ib])
+        return list_isdir[ia] ? -1 : 1;
+
+    int diff = 0;
+
+    if (list_isdir[ia] == 0)
+    {
+        // Files without information go at the end
+        if ((sort_mode == FILE_EXPLORER_SORT_TITLE)
+            || (sort_mode == FILE_EXPLORER_SORT_SYSTEM))
+        {
+            if (sort_has_info[ia] != sort_has_info[ib])
+                return sort_has_info[ia] ? -1 : 1;
+        }
+
+        if (sort_mode == FILE_EXPLORER_SORT_TITLE)
+        {
+            if (sort_has_info[ia])
+                diff = strcmp(sort_info[ia].title, sort_info[ib].title);
+        }
+        else if (sort_mode == FILE_EXPLORER_SORT_SYSTEM)
+        {
+            if (sort_has_info[ia])
+                diff = sort_info[ia].system - sort_info[ib].system;
+        }
+        else if (sort_mode == FILE_EXPLORER_SORT_SIZE)
+        {
+            if (list_size[ia] != list_size[ib])
+                diff = (list_size[ia] < list_size[ib]) ? -1 : 1;
+        }
+    }
+
+    if (diff == 0)
+        diff = strcmp(filename[ia], filename[ib]);
+
+    return diff;
+}
+
+static int _file_explorer_filter(int file)
+{
+    if ((filter_system == FILE_EXPLORER_FILTER_ALL) || list_isdir[file])
+        return 1;
+
+    // Files that haven't been indexed yet are shown
+    if (sort_has_info[file] == 0)
+        return 1;
+
+    int system = sort_info[file].system;
+
+    if (filter_system == FILE_EXPLORER_FILTER_GB)
+    {
+        return (system == ROM_LIBRARY_SYSTEM_GB)
+               || (system == ROM_LIBRARY_SYSTEM_GBC);
+    }
+
+    return system == ROM_LIBRARY_SYSTEM_GBA;
+}
+
+void FileExplorer_UpdateOrder(void)
+{
+    list_shown = 0;
+
+    if (list_inited == 0)
+        return;
+
+    sort_info = malloc(filenum * sizeof(rom_library_info));
+    sort_has_info = malloc(filenum * sizeof(int));
+
+    if ((sort_info == NULL) || (sort_has_info == NULL))
+    {
+        free(sort_info);
+        free(sort_has_info);
+        sort_info = NULL;
+        sort_has_info = NULL;
+
+        // Show the files in the order of the folder
+        for (int i = 0; i < filenum; i++)
+            list_order[list_shown++] = i;
+        return;
+    }
+
+    for (int i = 0; i < filenum; i++)
+        sort_has_info[i] = _file_explorer_get_info(i, &sort_info[i]);
+
+    for (int i = 0; i < filenum; i++)
+    {
+        if (_file_explorer_filter(i))
+            list_order[list_shown++] = i;
+    }
+
+    qsort(list_order, list_shown, sizeof(int), _file_explorer_compare);
+
+    free(sort_info);
+    free(sort_has_info);
+    sort_info = NULL;
+    sort_has_info = NULL;
+}
+
+void FileExplorer_SetSortMode(int mode)
+{
+    sort_mode = mode;
+    FileExplorer_UpdateOrder();
+}
+
+int FileExplorer_GetSortMode(void)
+{
+    return sort_mode;
+}
+
+void FileExplorer_SetFilter(int system)
+{
+    filter_system = system;
+    FileExplorer_UpdateOrder();
+}
+
+int FileExplorer_GetFilter(void)
+{
+    return filter_system;
+}
+
+static int _file_explorer_read_folder(void)
 {
     //Debug_DebugMsg(exploring_path);
 
@@ -196,7 +377,7 @@ int FileExplorer_LoadFolder(void)
     if (hFind == INVALID_HANDLE_VALUE)
     {
         FileExplorer_ListInit(1);
-        FileExplorer_ListAdd("..", 1);
+        FileExplorer_ListAdd("..", 1, 0, 0);
         return 1;
     }
 
@@ -211,7 +392,7 @@ int FileExplorer_LoadFolder(void)
     if (count == 0)
     {
         FileExplorer_ListInit(1);
-        FileExplorer_ListAdd("..", 1);
+        FileExplorer_ListAdd("..", 1, 0, 0);
         return 1;
     }
 
@@ -219,18 +400,22 @@ int FileExplorer_LoadFolder(void)
     if (hFind == INVALID_HANDLE_VALUE)
     {
         FileExplorer_ListInit(1);
-        FileExplorer_ListAdd("..", 1);
+        FileExplorer_ListAdd("..", 1, 0, 0);
         return 1;
     }
 
     // Allocate enough space and get information...
     FileExplorer_ListInit(count);
-    FileExplorer_ListAdd("..", 1); // Make it go always first
+    FileExplorer_ListAdd("..", 1, 0, 0); // Make it go always first
 
     do
     {
         int isdir = FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
-        FileExplorer_ListAdd(FindFileData.cFileName, isdir != 0);
+        u64 size = ((u64)FindFileData.nFileSizeHigh << 32)
+                 | FindFileData.nFileSizeLow;
+        s64 mtime = ((s64)FindFileData.ftLastWriteTime.dwHighDateTime << 32)
+                  | FindFileData.ftLastWriteTime.dwLowDateTime;
+        FileExplorer_ListAdd(FindFileData.cFileName, isdir != 0, size, mtime);
     }
     while (FindNextFile(hFind, &FindFileData));
 
@@ -244,7 +429,7 @@ int FileExplorer_LoadFolder(void)
     if (pdir == NULL)
     {
         FileExplorer_ListInit(1);
-        FileExplorer_ListAdd("..", 1);
+        FileExplorer_ListAdd("..", 1, 0, 0);
         return 1;
     }
 
@@ -265,13 +450,13 @@ int FileExplorer_LoadFolder(void)
     if (count == 0)
     {
         FileExplorer_ListInit(1);
-        FileExplorer_ListAdd("..", 1);
+        FileExplorer_ListAdd("..", 1, 0, 0);
         return 1;
     }
 
     // Allocate enough space and get information...
     FileExplorer_ListInit(count);
-    FileExplorer_ListAdd("..", 1); // Make it go always first
+    FileExplorer_ListAdd("..", 1, 0, 0); // Make it go always first
     while (1)
     {
         pent = readdir(pdir);
@@ -282,8 +467,11 @@ int FileExplorer_LoadFolder(void)
         snprintf(checkingfile, sizeof(checkingfile), "%s%s", exploring_path,
                  pent->d_name);
 
-        stat(checkingfile, &statbuf);
-        FileExplorer_ListAdd(pent->d_name, S_ISDIR(statbuf.st_mode) != 0);
+        if (stat(checkingfile, &statbuf) != 0)
+            continue;
+
+        FileExplorer_ListAdd(pent->d_name, S_ISDIR(statbuf.st_mode) != 0,
+                             statbuf.st_size, statbuf.st_mtime);
         //Debug_DebugMsgArg("Entry: %d || <%s> dir: %d", filenum, pent->d_name,
         //                  S_ISDIR(statbuf.st_mode) != 0);
     }
@@ -296,6 +484,14 @@ int FileExplorer_LoadFolder(void)
 #endif
 }
 
+int FileExplorer_LoadFolder(void)
+{
+    _file_explorer_read_folder();
+    FileExplorer_UpdateOrder();
+
+    return list_shown;
+}
+
 void FileExplorer_GoUp(void)
 {
     char separator = GetFolderSeparator(exploring_path);
@@ -325,6 +521,7 @@ int FileExplorer_SelectEntry(char *file)
     if (strcmp(file, "..") == 0)
     {
         FileExplorer_GoUp();
+        FileExplorer_LoadFolder();
         return 1;
     }
 
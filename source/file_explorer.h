@@ -7,13 +7,38 @@
 #ifndef FILE_EXPLORER__
 #define FILE_EXPLORER__
 
+#include "rom_library.h"
+
+#define FILE_EXPLORER_SORT_NAME     0
+#define FILE_EXPLORER_SORT_TITLE    1
+#define FILE_EXPLORER_SORT_SYSTEM   2
+#define FILE_EXPLORER_SORT_SIZE     3
+#define FILE_EXPLORER_SORT_NUM      4
+
+#define FILE_EXPLORER_FILTER_ALL    0
+#define FILE_EXPLORER_FILTER_GB     1
+#define FILE_EXPLORER_FILTER_GBA    2
+#define FILE_EXPLORER_FILTER_NUM    3
+
+// Number of files shown, after applying the filter
 int FileExplorer_GetNumFiles(void);
 void FileExplorer_SetPath(char *path);
 void FileExplorer_ListFree(void);
 char *FileExplorer_GetName(int index);
 int FileExplorer_GetIsDir(int index);
+// Returns 1 if the information of the file is in the ROM library. If not, it
+// is requested to the library.
+int FileExplorer_GetInfo(int index, rom_library_info *info);
 int FileExplorer_LoadFolder(void);
 
+// Sorting and filtering use the information of the ROM library, so they have
+// to be done again with FileExplorer_UpdateOrder() when it changes.
+void FileExplorer_UpdateOrder(void);
+void FileExplorer_SetSortMode(int mode);
+int FileExplorer_GetSortMode(void);
+void FileExplorer_SetFilter(int system);
+int FileExplorer_GetFilter(void);
+
 // Returns 1 if dir, 0 if file
 int FileExplorer_SelectEntry(char *file);
 // This holds the last file selected even after FileExplorer_ListFree()
@@ -4,6 +4,9 @@
 //
 // GiiBiiAdvance - GBA/GB emulator
 
+// Needed for fileno() and fsync()
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +17,11 @@
 
 #if defined(_MSC_VER)
 # include <direct.h>
+# include <io.h>
+# include <windows.h>
+#elif defined(_WIN32)
+# include <io.h>
+# include <unistd.h>
 # include <windows.h>
 #else
 # include <unistd.h>
@@ -184,6 +192,56 @@ int FileExists(const char *filename)
     return 1;
 }
 
+int FileSaveAtomic(const char *filename, const void *buffer, size_t size)
+{
+    char tmp_path[MAX_PATHLEN + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", filename);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL)
+    {
+        Debug_ErrorMsgArg("%s couldn't be opened!", tmp_path);
+        return 0;
+    }
+
+    int ok = (fwrite(buffer, 1, size, f) == size);
+
+    // Make sure that the data has reached the disk before replacing the file
+    if (fflush(f) != 0)
+        ok = 0;
+#if defined(_WIN32)
+    if (_commit(_fileno(f)) != 0)
+        ok = 0;
+#else
+    if (fsync(fileno(f)) != 0)
+        ok = 0;
+#endif
+
+    if (fclose(f) != 0)
+        ok = 0;
+
+    if (!ok)
+    {
+        Debug_ErrorMsgArg("Error while writing: %s", tmp_path);
+        remove(tmp_path);
+        return 0;
+    }
+
+#if defined(_WIN32)
+    // rename() fails in Windows if the destination exists
+    if (MoveFileExA(tmp_path, filename, MOVEFILE_REPLACE_EXISTING) == 0)
+#else
+    if (rename(tmp_path, filename) != 0)
+#endif
+    {
+        Debug_ErrorMsgArg("%s couldn't be replaced!", filename);
+        remove(tmp_path);
+        return 0;
+    }
+
+    return 1;
+}
+
 //-------------------------------------------------
 
 int PathIsDir(char *path)
@@ -293,7 +351,8 @@ int DirCreate(char *path)
 
 static char _fu_filename[MAX_PATHLEN];
 
-char *FU_GetNewTimestampFilename(const char *basename)
+char *FU_GetNewTimestampFilenameExt(const char *basename,
+                                    const char *extension)
 {
     long long int number = 0;
 
@@ -311,8 +370,9 @@ char *FU_GetNewTimestampFilename(const char *basename)
     // same second.
     while (1)
     {
-        snprintf(_fu_filename, sizeof(_fu_filename), "%s%s_%s_%lld.png",
-                 DirGetScreenshotFolderPath(), basename, timestamp, number);
+        snprintf(_fu_filename, sizeof(_fu_filename), "%s%s_%s_%lld.%s",
+                 DirGetScreenshotFolderPath(), basename, timestamp, number,
+                 extension);
 
         FILE *file = fopen(_fu_filename, "rb");
         if (file == NULL)
@@ -324,3 +384,8 @@ char *FU_GetNewTimestampFilename(const char *basename)
 
     return _fu_filename;
 }
+
+char *FU_GetNewTimestampFilename(const char *basename)
+{
+    return FU_GetNewTimestampFilenameExt(basename, "png");
+}
@@ -17,11 +17,19 @@ void FileLoad(const char *filename, void **buffer, size_t *size_);
 
 int FileExists(const char *filename); // Returns 1 if file exists
 
+// Writes the buffer to a temporary file next to the destination and renames it
+// to the final name, so that the previous contents of the file are kept if the
+// process dies while saving. Returns 1 on success.
+int FileSaveAtomic(const char *filename, const void *buffer, size_t size);
+
 int PathIsDir(char *path); // Returns 1 if path is a directory
 
 int DirCheckExistence(char *path);
 int DirCreate(char *path);
 
-char *FU_GetNewTimestampFilename(const char *basename);
+// Returns a path in the screenshots folder that isn't used by any file
+char *FU_GetNewTimestampFilename(const char *basename); // ".png" extension
+char *FU_GetNewTimestampFilenameExt(const char *basename,
+                                    const char *extension);
 
 #endif // FILE_UTILS__
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../debug_utils.h"
+
+#include "analysis.h"
+#include "debug.h"
+#include "gameboy.h"
+
+typedef struct {
+    u32 from;
+    u32 to;
+} gb_analysis_xref;
+
+static const u8 *analysis_rom = NULL;
+static u32 analysis_rom_size;
+
+// One entry per byte of the ROM
+static u8 *analysis_flags = NULL;
+
+// Offsets of the blocks of code waiting to be analysed
+static u32 *analysis_queue = NULL;
+static u32 analysis_queue_count, analysis_queue_max;
+
+// Sorted by destination once the analysis is finished
+static gb_analysis_xref *analysis_xrefs = NULL;
+static u32 analysis_xrefs_count, analysis_xrefs_max;
+static int analysis_xrefs_sorted;
+
+static u32 analysis_instructions;
+
+static void *_gb_analysis_grow(void *array, u32 *max, size_t element_size)
+{
+    u32 new_max = (*max == 0) ? 1024 : (*max * 2);
+
+    void *new_array = realloc(array, new_max * element_size);
+    if (new_array == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return NULL;
+    }
+
+    *max = new_max;
+    return new_array;
+}
+
+static void _gb_analysis_add_xref(u32 from, u32 to)
+{
+    if (analysis_xrefs_count == analysis_xrefs_max)
+    {
+        gb_analysis_xref *array =
+                _gb_analysis_grow(analysis_xrefs, &analysis_xrefs_max,
+                                  sizeof(gb_analysis_xref));
+        if (array == NULL)
+            return;
+        analysis_xrefs = array;
+    }
+
+    analysis_xrefs[analysis_xrefs_count].from = from;
+    analysis_xrefs[analysis_xrefs_count].to = to;
+    analysis_xrefs_count++;
+
+    analysis_xrefs_sorted = 0;
+}
+
+// The flag is added to the destination even if it has already been analysed
+static void _gb_analysis_queue(u32 offset, s32 from, u8 flag)
+{
+    if (offset >= analysis_rom_size)
+        return;
+
+    u8 *flags = &analysis_flags[offset];
+
+    *flags |= flag;
+
+    if (from >= 0)
+        _gb_analysis_add_xref(from, offset);
+
+    if (*flags & GB_ANALYSIS_CODE)
+        return;
+
+    if (analysis_queue_count == analysis_queue_max)
+    {
+        u32 *array = _gb_analysis_grow(analysis_queue, &analysis_queue_max,
+                                       sizeof(u32));
+        if (array == NULL)
+            return;
+        analysis_queue = array;
+    }
+
+    analysis_queue[analysis_queue_count++] = offset;
+}
+
+// Converts the destination of a jump to a ROM offset. Returns 0 if it isn't in
+// the ROM (code in RAM, for example).
+static int _gb_analysis_target(u32 offset, u32 address, u32 *target)
+{
+    if (address < 0x4000)
+    {
+        *target = address;
+        return 1;
+    }
+
+    if (address < 0x8000)
+    {
+        u32 bank = offset / 0x4000;
+        if (bank == 0)
+            bank = 1;
+
+        *target = (bank * 0x4000) + (address - 0x4000);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Returns the number of instructions decoded. The code is followed until the
+// end of the block or until the limit of instructions is reached. In that
+// case, the rest of the block is queued again.
+static int _gb_analysis_block(u32 offset, int max_instructions)
+{
+    int count = 0;
+
+    // Code can't continue from the end of a bank to the start of the next one
+    // unless it goes from bank 0 to bank 1.
+    u32 bank_end = (offset < 0x8000) ? 0x8000 : ((offset | 0x3FFF) + 1);
+    if (bank_end > analysis_rom_size)
+        bank_end = analysis_rom_size;
+
+    while (offset < bank_end)
+    {
+        u8 *flags = &analysis_flags[offset];
+
+        if (*flags & GB_ANALYSIS_CODE)
+            break;
+
+        if (count == max_instructions)
+        {
+            _gb_analysis_queue(offset, -1, 0);
+            break;
+        }
+
+        const u8 *ptr = &analysis_rom[offset];
+        u8 opcode = ptr[0];
+        u32 size = gb_debug_get_instruction_size(opcode);
+
+        if (offset + size > bank_end)
+            break;
+
+        *flags |= GB_ANALYSIS_CODE;
+        count++;
+
+        u32 address = (offset < 0x4000) ? offset : (0x4000 + (offset & 0x3FFF));
+        u32 next = address + size;
+        u32 target;
+        int end = 0;
+
+        switch (opcode)
+        {
+            case 0xC3: // jp nn
+            case 0xC2: // jp nz,nn
+            case 0xCA: // jp z,nn
+            case 0xD2: // jp nc,nn
+            case 0xDA: // jp c,nn
+                if (_gb_analysis_target(offset, ptr[1] | (ptr[2] << 8),
+                                        &target))
+                {
+                    _gb_analysis_queue(target, offset, GB_ANALYSIS_LABEL);
+                }
+                end = (opcode == 0xC3);
+                break;
+
+            case 0x18: // jr n
+            case 0x20: // jr nz,n
+            case 0x28: // jr z,n
+            case 0x30: // jr nc,n
+            case 0x38: // jr c,n
+                if (_gb_analysis_target(offset, (next + (s8)ptr[1]) & 0xFFFF,
+                                        &target))
+                {
+                    _gb_analysis_queue(target, offset, GB_ANALYSIS_LABEL);
+                }
+                end = (opcode == 0x18);
+                break;
+
+            case 0xCD: // call nn
+            case 0xC4: // call nz,nn
+            case 0xCC: // call z,nn
+            case 0xD4: // call nc,nn
+            case 0xDC: // call c,nn
+                if (_gb_analysis_target(offset, ptr[1] | (ptr[2] << 8),
+                                        &target))
+                {
+                    _gb_analysis_queue(target, offset, GB_ANALYSIS_FUNCTION);
+                }
+                break;
+
+            case 0xC7: // rst
+            case 0xCF:
+            case 0xD7:
+            case 0xDF:
+            case 0xE7:
+            case 0xEF:
+            case 0xF7:
+            case 0xFF:
+                _gb_analysis_queue(opcode & 0x38, offset,
+                                   GB_ANALYSIS_FUNCTION);
+                break;
+
+            case 0xC9: // ret
+            case 0xD9: // reti
+            case 0xE9: // jp hl
+                end = 1;
+                break;
+
+            case 0xD3: // Undefined opcodes lock the CPU
+            case 0xDB:
+            case 0xDD:
+            case 0xE3:
+            case 0xE4:
+            case 0xEB:
+            case 0xEC:
+            case 0xED:
+            case 0xF4:
+            case 0xFC:
+            case 0xFD:
+                end = 1;
+                break;
+
+            default:
+                break;
+        }
+
+        if (end)
+            break;
+
+        offset += size;
+    }
+
+    return count;
+}
+
+static int _gb_analysis_xref_compare(const void *a, const void *b)
+{
+    const gb_analysis_xref *xa = a;
+    const gb_analysis_xref *xb = b;
+
+    if (xa->to != xb->to)
+        return (xa->to < xb->to) ? -1 : 1;
+    if (xa->from != xb->from)
+        return (xa->from < xb->from) ? -1 : 1;
+    return 0;
+}
+
+int GB_AnalysisInit(const u8 *rom, u32 size)
+{
+    GB_AnalysisEnd();
+
+    analysis_flags = calloc(1, size);
+    if (analysis_flags == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    analysis_rom = rom;
+    analysis_rom_size = size;
+
+    // Interrupt vectors, then the entry point so that it is analysed first
+    for (u32 offset = 0x40; offset <= 0x60; offset += 8)
+        GB_AnalysisAddEntry(offset);
+    GB_AnalysisAddEntry(0x100);
+
+    return 1;
+}
+
+void GB_AnalysisEnd(void)
+{
+    free(analysis_flags);
+    analysis_flags = NULL;
+    free(analysis_queue);
+    analysis_queue = NULL;
+    free(analysis_xrefs);
+    analysis_xrefs = NULL;
+
+    analysis_rom = NULL;
+    analysis_rom_size = 0;
+    analysis_queue_count = 0;
+    analysis_queue_max = 0;
+    analysis_xrefs_count = 0;
+    analysis_xrefs_max = 0;
+    analysis_xrefs_sorted = 0;
+    analysis_instructions = 0;
+}
+
+void GB_AnalysisAddEntry(u32 offset)
+{
+    if (analysis_flags == NULL)
+        return;
+
+    _gb_analysis_queue(offset, -1, GB_ANALYSIS_ENTRY);
+}
+
+int GB_AnalysisStep(int max_instructions)
+{
+    if (analysis_flags == NULL)
+        return 0;
+
+    while ((analysis_queue_count > 0) && (max_instructions > 0))
+    {
+        u32 offset = analysis_queue[--analysis_queue_count];
+        int count = _gb_analysis_block(offset, max_instructions);
+
+        analysis_instructions += count;
+        max_instructions -= count;
+    }
+
+    if (analysis_queue_count > 0)
+        return 1;
+
+    if (analysis_xrefs_sorted == 0)
+    {
+        qsort(analysis_xrefs, analysis_xrefs_count, sizeof(gb_analysis_xref),
+              _gb_analysis_xref_compare);
+        analysis_xrefs_sorted = 1;
+    }
+
+    return 0;
+}
+
+u8 GB_AnalysisGetFlags(u32 offset)
+{
+    if ((analysis_flags == NULL) || (offset >= analysis_rom_size))
+        return 0;
+
+    return analysis_flags[offset];
+}
+
+int GB_AnalysisGetXrefs(u32 offset, u32 *from, int max)
+{
+    if ((analysis_flags == NULL) || (offset >= analysis_rom_size))
+        return 0;
+
+    u32 start = 0;
+    u32 end = analysis_xrefs_count;
+
+    if (analysis_xrefs_sorted)
+    {
+        // Look for the first reference to the offset
+        while (start < end)
+        {
+            u32 middle = (start + end) / 2;
+
+            if (analysis_xrefs[middle].to < offset)
+                start = middle + 1;
+            else
+                end = middle;
+        }
+        end = analysis_xrefs_count;
+    }
+
+    int count = 0;
+
+    for (u32 i = start; i < end; i++)
+    {
+        if (analysis_xrefs[i].to != offset)
+        {
+            if (analysis_xrefs_sorted)
+                break;
+            continue;
+        }
+
+        if (count < max)
+            from[count] = analysis_xrefs[i].from;
+        count++;
+    }
+
+    return count;
+}
+
+s32 GB_AnalysisFindLabel(u32 offset, int direction, int functions_only)
+{
+    if ((analysis_flags == NULL) || (offset >= analysis_rom_size))
+        return -1;
+
+    u8 mask = GB_ANALYSIS_FUNCTION | GB_ANALYSIS_ENTRY;
+    if (functions_only == 0)
+        mask |= GB_ANALYSIS_LABEL;
+
+    s32 index = offset;
+
+    while (1)
+    {
+        index += (direction > 0) ? 1 : -1;
+
+        if ((index < 0) || (index >= (s32)analysis_rom_size))
+            return -1;
+
+        if (analysis_flags[index] & mask)
+            return index;
+    }
+}
+
+void GB_AnalysisGetStats(u32 *instructions, u32 *pending)
+{
+    *instructions = analysis_instructions;
+    *pending = analysis_queue_count;
+}
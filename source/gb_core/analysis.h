@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GB_ANALYSIS__
+#define GB_ANALYSIS__
+
+#include "gameboy.h"
+
+// Static analysis of the code of the ROM. Starting from the entry points, it
+// follows the flow of the code (recursive descent) and marks the bytes of the
+// ROM where instructions start and the targets of jumps and calls. It is done
+// in small steps so that it can run in the background. This module doesn't
+// lock anything, the caller has to make sure that the queries don't happen at
+// the same time as a step.
+//
+// All offsets are relative to the start of the ROM (bank * 0x4000 + address
+// inside of the bank). Jumps to the switchable bank from bank 0 are assumed to
+// go to bank 1, and jumps from other banks stay in the same bank.
+
+#define GB_ANALYSIS_CODE        (1 << 0) // Start of an instruction
+#define GB_ANALYSIS_LABEL       (1 << 1) // Target of a jump
+#define GB_ANALYSIS_FUNCTION    (1 << 2) // Target of a call
+#define GB_ANALYSIS_ENTRY       (1 << 3) // Entry point
+
+// The ROM must stay allocated until GB_AnalysisEnd() is called. Returns 1 on
+// success. The entry point of the cartridge and the interrupt vectors are
+// added as first entry points.
+int GB_AnalysisInit(const u8 *rom, u32 size);
+void GB_AnalysisEnd(void);
+
+// Offsets outside of the ROM are ignored
+void GB_AnalysisAddEntry(u32 offset);
+
+// Decodes up to the specified number of instructions. Returns 1 if there is
+// still code left to analyse.
+int GB_AnalysisStep(int max_instructions);
+
+// Returns the GB_ANALYSIS_* flags of a ROM offset, or 0 if it is outside of
+// the ROM or it hasn't been analysed.
+u8 GB_AnalysisGetFlags(u32 offset);
+
+// Fills "from" with up to "max" offsets of the instructions that jump to the
+// specified offset. Returns the total number of them.
+int GB_AnalysisGetXrefs(u32 offset, u32 *from, int max);
+
+// Returns the offset of the next (direction > 0) or previous label starting
+// from the specified offset (not included). Only functions are considered if
+// functions_only is 1. Returns -1 if there aren't more labels.
+s32 GB_AnalysisFindLabel(u32 offset, int direction, int functions_only);
+
+// Number of instructions found so far and number of blocks of code waiting to
+// be analysed.
+void GB_AnalysisGetStats(u32 *instructions, u32 *pending);
+
+#endif // GB_ANALYSIS__
@@ -4,7 +4,6 @@
 //
 // GiiBiiAdvance - GBA/GB emulator
 
-#include <stdlib.h>
 #include <string.h>
 
 #include "../build_options.h"
@@ -15,6 +14,7 @@
 
 #include "cpu.h"
 #include "gameboy.h"
+#include "state.h"
 
 //------------------------------------------------------------------------------
 
@@ -23,9 +23,9 @@ extern _GB_CONTEXT_ GameBoy;
 //------------------------------------------------------------------------------
 
 // Webcam image (exposed in gc_core/camera.h, values in the range 0-255)
-int gb_camera_webcam_output[GBCAM_SENSOR_W][GBCAM_SENSOR_H];
+int gb_camera_webcam_output[GBCAM_SENSOR_H][GBCAM_SENSOR_W];
 // Image processed by the retina chip
-static int gb_cam_retina_output_buf[GBCAM_SENSOR_W][GBCAM_SENSOR_H];
+static int gb_cam_retina_output_buf[GBCAM_SENSOR_H][GBCAM_SENSOR_W];
 
 void GB_CameraEnd(void)
 {
@@ -131,45 +131,113 @@ static int gb_max_int(int a, int b)
     return (a > b) ? a : b;
 }
 
-static u32 gb_cam_matrix_process(u32 value, int x, int y)
+//----------------------------------------------------------------------------
+
+// The parameters that depend on the registers are converted into lookup tables
+// or integer coefficients before processing the image, so that the loops that
+// process the image don't need to check any register.
+
+// Registers 6 to 0x35 hold the thresholds of the 4x4 dither matrix
+#define GB_CAM_MATRIX_REG_BASE  6
+#define GB_CAM_MATRIX_REG_NUM   (4 * 4 * 3)
+
+// Final Game Boy color (0 to 3) of each pixel value for each matrix position
+static u8 gb_cam_matrix_lut[4][4][256];
+// Registers used to build the matrix lookup table
+static u8 gb_cam_matrix_lut_regs[GB_CAM_MATRIX_REG_NUM];
+static int gb_cam_matrix_lut_valid = 0;
+
+static void gb_cam_matrix_lut_update(void)
 {
     _GB_CAMERA_CART_ *cam = &GameBoy.Emulator.CAM;
+    const u8 *regs = &cam->reg[GB_CAM_MATRIX_REG_BASE];
 
-    x = x & 3;
-    y = y & 3;
-
-    int base = 6 + (y * 4 + x) * 3;
+    // The registers may also change when loading a savestate, so compare them
+    // instead of rebuilding the table on register writes.
+    if (gb_cam_matrix_lut_valid
+        && (memcmp(gb_cam_matrix_lut_regs, regs, GB_CAM_MATRIX_REG_NUM) == 0))
+        return;
 
-    u32 r0 = cam->reg[base + 0];
-    u32 r1 = cam->reg[base + 1];
-    u32 r2 = cam->reg[base + 2];
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            const u8 *r = &regs[(y * 4 + x) * 3];
+            u8 *lut = gb_cam_matrix_lut[y][x];
 
-    if (value < r0)
-        return 0x00;
-    if (value < r1)
-        return 0x40;
-    if (value < r2)
-        return 0x80;
+            for (int value = 0; value < 256; value++)
+            {
+                if (value < r[0])
+                    lut[value] = 3;
+                else if (value < r[1])
+                    lut[value] = 2;
+                else if (value < r[2])
+                    lut[value] = 1;
+                else
+                    lut[value] = 0;
+            }
+        }
+    }
 
-    return 0xC0;
+    memcpy(gb_cam_matrix_lut_regs, regs, GB_CAM_MATRIX_REG_NUM);
+    gb_cam_matrix_lut_valid = 1;
 }
 
-static void GB_CameraTakePicture(void)
+// Converts a webcam value into a signed retina value (-128 to 127) applying
+// the exposure time, the voltage adaptation and the inversion.
+static int gb_cam_exposure_lut[256];
+
+static void gb_cam_exposure_lut_update(u32 exposure, int invert)
 {
-    // Buffer for the image as seen after processed by the sensor
-    int (*temp_buf)[GBCAM_SENSOR_W];
-    temp_buf = calloc(GBCAM_SENSOR_W * GBCAM_SENSOR_H, sizeof(int));
+    int reference = EmulatorConfig.gbcam_exposure_reference;
+
+    for (int i = 0; i < 256; i++)
+    {
+        int value = (i * exposure) / reference;
+
+        value = 128 + (((value - 128) * 1) / 8); // "adapt" to "3.1"/5.0 V
+        value = gb_clamp_int(0, value, 255);
+
+        if (invert)
+            value = 255 - value;
 
-    // Buffer after controller matrix
-    int (*fourcolorsbuffer)[GBCAM_W];
-    fourcolorsbuffer = calloc(GBCAM_W * GBCAM_H, sizeof(int));
+        gb_cam_exposure_lut[i] = value - 128;
+    }
+}
 
-    if ((temp_buf == NULL) || (fourcolorsbuffer == NULL))
+// Edge enhancement ratios multiplied by 4 so that integers can be used
+static const int gb_cam_edge_ratio_x4_lut[8] = {
+    2, 3, 4, 5, 8, 12, 16, 20 // 0.50, 0.75, 1.00, 1.25, 2.00, 3.00, 4.00, 5.00
+};
+
+// Buffer for the image as seen after processed by the sensor
+static int gb_cam_sensor_buf[GBCAM_SENSOR_H][GBCAM_SENSOR_W];
+// Game Boy colors after the controller matrix
+static u8 gb_cam_fourcolors_buf[GBCAM_H][GBCAM_W];
+
+// Output = px_k * P + ms_k * MS, where MS is the pixel in the next row. The
+// coefficients are calculated from the P and M bits of register 0.
+static void gb_cam_filter_pm(int dst[GBCAM_SENSOR_H][GBCAM_SENSOR_W],
+                             int src[GBCAM_SENSOR_H][GBCAM_SENSOR_W],
+                             int px_k, int ms_k)
+{
+    for (int j = 0; j < GBCAM_SENSOR_H; j++)
     {
-        Debug_ErrorMsgArg("%s(): Not enough memory.");
-        goto cleanup;
+        int j_next = gb_min_int(j + 1, GBCAM_SENSOR_H - 1);
+        const int *px_row = src[j];
+        const int *ms_row = src[j_next];
+        int *dst_row = dst[j];
+
+        for (int i = 0; i < GBCAM_SENSOR_W; i++)
+        {
+            int value = px_k * px_row[i] + ms_k * ms_row[i];
+            dst_row[i] = gb_clamp_int(-128, value, 127);
+        }
     }
+}
 
+static void GB_CameraTakePicture(void)
+{
     _GB_CAMERA_CART_ *cam = &GameBoy.Emulator.CAM;
 
     //------------------------------------------------
@@ -207,6 +275,9 @@ static void GB_CameraTakePicture(void)
             break;
     }
 
+    int px_k = (int)(P_bits & BIT(0)) - (int)(M_bits & BIT(0));
+    int ms_k = (int)((P_bits & BIT(1)) >> 1) - (int)((M_bits & BIT(1)) >> 1);
+
     // Register 1
     u32 N_bit = (cam->reg[1] & BIT(7)) >> 7;
     u32 VH_bits = (cam->reg[1] & (BIT(6) | BIT(5))) >> 5;
@@ -215,15 +286,14 @@ static void GB_CameraTakePicture(void)
     u32 EXPOSURE_bits = cam->reg[3] | (cam->reg[2] << 8);
 
     // Register 4
-    const float edge_ratio_lut[8] = {
-        0.50, 0.75, 1.00, 1.25, 2.00, 3.00, 4.00, 5.00
-    };
-
-    float EDGE_alpha = edge_ratio_lut[(cam->reg[4] & 0x70) >> 4];
+    int EDGE_alpha_x4 = gb_cam_edge_ratio_x4_lut[(cam->reg[4] & 0x70) >> 4];
 
     u32 E3_bit = (cam->reg[4] & BIT(7)) >> 7;
     u32 I_bit = (cam->reg[4] & BIT(3)) >> 3;
 
+    gb_cam_exposure_lut_update(EXPOSURE_bits, I_bit);
+    gb_cam_matrix_lut_update();
+
     //------------------------------------------------
 
     // Calculate timings
@@ -236,41 +306,15 @@ static void GB_CameraTakePicture(void)
     // Sensor handling
     // ---------------
 
-    // Copy webcam buffer to sensor buffer applying color correction and
-    // exposure time
-    for (int i = 0; i < GBCAM_SENSOR_W; i++)
+    // Copy webcam buffer to sensor buffer applying color correction, exposure
+    // time and inversion. The result is signed.
+    for (int j = 0; j < GBCAM_SENSOR_H; j++)
     {
-        for (int j = 0; j < GBCAM_SENSOR_H; j++)
-        {
-            int value = gb_camera_webcam_output[i][j];
-            value = (value * EXPOSURE_bits)
-                    / EmulatorConfig.gbcam_exposure_reference;
-
-            value = 128 + (((value - 128) * 1) / 8); // "adapt" to "3.1"/5.0 V
-            gb_cam_retina_output_buf[i][j] = gb_clamp_int(0, value, 255);
-        }
-    }
+        const int *src = gb_camera_webcam_output[j];
+        int *dst = gb_cam_retina_output_buf[j];
 
-    if (I_bit) // Invert image
-    {
         for (int i = 0; i < GBCAM_SENSOR_W; i++)
-        {
-            for (int j = 0; j < GBCAM_SENSOR_H; j++)
-            {
-                gb_cam_retina_output_buf[i][j] =
-                        255 - gb_cam_retina_output_buf[i][j];
-            }
-        }
-    }
-
-    // Make signed
-    for (int i = 0; i < GBCAM_SENSOR_W; i++)
-    {
-        for (int j = 0; j < GBCAM_SENSOR_H; j++)
-        {
-            gb_cam_retina_output_buf[i][j] =
-                    gb_cam_retina_output_buf[i][j] - 128;
-        }
+            dst[i] = gb_cam_exposure_lut[src[i] & 0xFF];
     }
 
     u32 filtering_mode = (N_bit << 3) | (VH_bits << 1) | E3_bit;
@@ -279,34 +323,10 @@ static void GB_CameraTakePicture(void)
         // 1-D filtering
         case 0x0:
         {
-            for (int j = 0; j < GBCAM_SENSOR_H; j++)
-            {
-                for (int i = 0; i < GBCAM_SENSOR_W; i++)
-                {
-                    temp_buf[j][i] = gb_cam_retina_output_buf[i][j];
-                }
-            }
-
-            for (int j = 0; j < GBCAM_SENSOR_H; j++)
-            {
-                for (int i = 0; i < GBCAM_SENSOR_W; i++)
-                {
-                    int ms = temp_buf[gb_min_int(j + 1, GBCAM_SENSOR_H - 1)][i];
-                    int px = temp_buf[j][i];
-
-                    int value = 0;
-                    if (P_bits & BIT(0))
-                        value += px;
-                    if (P_bits & BIT(1))
-                        value += ms;
-                    if (M_bits & BIT(0))
-                        value -= px;
-                    if (M_bits & BIT(1))
-                        value -= ms;
-                    gb_cam_retina_output_buf[i][j] =
-                            gb_clamp_int(-128, value, 127);
-                }
-            }
+            // Each row only depends on itself and the next one, so this can be
+            // done in place.
+            gb_cam_filter_pm(gb_cam_retina_output_buf, gb_cam_retina_output_buf,
+                             px_k, ms_k);
             break;
         }
 
@@ -315,38 +335,23 @@ static void GB_CameraTakePicture(void)
         {
             for (int j = 0; j < GBCAM_SENSOR_H; j++)
             {
+                const int *src = gb_cam_retina_output_buf[j];
+                int *dst = gb_cam_sensor_buf[j];
+
                 for (int i = 0; i < GBCAM_SENSOR_W; i++)
                 {
-                    int mw = gb_cam_retina_output_buf[gb_max_int(0, i - 1)][j];
-                    int me = gb_cam_retina_output_buf
-                            [gb_min_int(i + 1, GBCAM_SENSOR_W - 1)][j];
-                    int px = gb_cam_retina_output_buf[i][j];
-
-                    temp_buf[j][i] = gb_clamp_int(0,
-                            px + ((2 * px - mw - me) * EDGE_alpha),
-                            255);
-                }
-            }
-            for (int j = 0; j < GBCAM_SENSOR_H; j++)
-            {
-                for (int i = 0; i < GBCAM_SENSOR_W; i++)
-                {
-                    int ms = temp_buf[gb_min_int(j + 1, GBCAM_SENSOR_H - 1)][i];
-                    int px = temp_buf[j][i];
-
-                    int value = 0;
-                    if (P_bits & BIT(0))
-                        value += px;
-                    if (P_bits & BIT(1))
-                        value += ms;
-                    if (M_bits & BIT(0))
-                        value -= px;
-                    if (M_bits & BIT(1))
-                        value -= ms;
-                    gb_cam_retina_output_buf[i][j] =
-                            gb_clamp_int(-128, value, 127);
+                    int mw = src[gb_max_int(0, i - 1)];
+                    int me = src[gb_min_int(i + 1, GBCAM_SENSOR_W - 1)];
+                    int px = src[i];
+
+                    int value = (4 * px + (2 * px - mw - me) * EDGE_alpha_x4)
+                                / 4;
+                    dst[i] = gb_clamp_int(0, value, 255);
                 }
             }
+
+            gb_cam_filter_pm(gb_cam_retina_output_buf, gb_cam_sensor_buf,
+                             px_k, ms_k);
             break;
         }
 
@@ -355,28 +360,30 @@ static void GB_CameraTakePicture(void)
         {
             for (int j = 0; j < GBCAM_SENSOR_H; j++)
             {
+                int j_prev = gb_max_int(0, j - 1);
+                int j_next = gb_min_int(j + 1, GBCAM_SENSOR_H - 1);
+                const int *src = gb_cam_retina_output_buf[j];
+                const int *src_n = gb_cam_retina_output_buf[j_prev];
+                const int *src_s = gb_cam_retina_output_buf[j_next];
+                int *dst = gb_cam_sensor_buf[j];
+
                 for (int i = 0; i < GBCAM_SENSOR_W; i++)
                 {
-                    int ms = gb_cam_retina_output_buf[i]
-                            [gb_min_int(j + 1, GBCAM_SENSOR_H - 1)];
-                    int mn = gb_cam_retina_output_buf[i][gb_max_int(0, j - 1)];
-                    int mw = gb_cam_retina_output_buf[gb_max_int(0, i - 1)][j];
-                    int me = gb_cam_retina_output_buf
-                            [gb_min_int(i + 1, GBCAM_SENSOR_W - 1)][j];
-                    int px = gb_cam_retina_output_buf[i][j];
-
-                    temp_buf[j][i] = gb_clamp_int(-128,
-                            px + ((4 * px - mw - me - mn - ms) * EDGE_alpha),
-                            127);
-                }
-            }
-            for (int j = 0; j < GBCAM_SENSOR_H; j++)
-            {
-                for (int i = 0; i < GBCAM_SENSOR_W; i++)
-                {
-                    gb_cam_retina_output_buf[i][j] = temp_buf[j][i];
+                    int ms = src_s[i];
+                    int mn = src_n[i];
+                    int mw = src[gb_max_int(0, i - 1)];
+                    int me = src[gb_min_int(i + 1, GBCAM_SENSOR_W - 1)];
+                    int px = src[i];
+
+                    int value = (4 * px
+                                 + (4 * px - mw - me - mn - ms) * EDGE_alpha_x4)
+                                / 4;
+                    dst[i] = gb_clamp_int(-128, value, 127);
                 }
             }
+
+            memcpy(gb_cam_retina_output_buf, gb_cam_sensor_buf,
+                   sizeof(gb_cam_retina_output_buf));
             break;
         }
 
@@ -385,13 +392,8 @@ static void GB_CameraTakePicture(void)
         // Maybe this is a bug?
         case 0x1:
         {
-            for (int j = 0; j < GBCAM_SENSOR_H; j++)
-            {
-                for (int i = 0; i < GBCAM_SENSOR_W; i++)
-                {
-                    gb_cam_retina_output_buf[i][j] = 0;
-                }
-            }
+            memset(gb_cam_retina_output_buf, 0,
+                   sizeof(gb_cam_retina_output_buf));
             break;
         }
 
@@ -410,11 +412,10 @@ static void GB_CameraTakePicture(void)
     // Make unsigned
     for (int j = 0; j < GBCAM_SENSOR_H; j++)
     {
+        int *row = gb_cam_retina_output_buf[j];
+
         for (int i = 0; i < GBCAM_SENSOR_W; i++)
-        {
-            gb_cam_retina_output_buf[i][j] =
-                    gb_cam_retina_output_buf[i][j] + 128;
-        }
+            row[i] += 128;
     }
 
     //------------------------------------------------
@@ -425,40 +426,43 @@ static void GB_CameraTakePicture(void)
     // Convert to Game Boy colors using the controller matrix
     for (int j = 0; j < GBCAM_H; j++)
     {
+        const int *src =
+                gb_cam_retina_output_buf[j + (GBCAM_SENSOR_EXTRA_LINES / 2)];
+        u8 *dst = gb_cam_fourcolors_buf[j];
+
         for (int i = 0; i < GBCAM_W; i++)
-        {
-            int v;
-            v = gb_cam_retina_output_buf[i][j + (GBCAM_SENSOR_EXTRA_LINES / 2)];
-            fourcolorsbuffer[j][i] = gb_cam_matrix_process(v, i, j);
-        }
+            dst[i] = gb_cam_matrix_lut[j & 3][i & 3][src[i] & 0xFF];
     }
 
     // Convert to tiles
     u8 finalbuffer[14][16][16]; // Final buffer
-    memset(finalbuffer, 0, sizeof(finalbuffer));
     for (int j = 0; j < GBCAM_H; j++)
     {
-        for (int i = 0; i < GBCAM_W; i++)
+        const u8 *src = gb_cam_fourcolors_buf[j];
+
+        for (int tile = 0; tile < GBCAM_W / 8; tile++)
         {
-            u8 outcolor = 3 - (fourcolorsbuffer[j][i] >> 6);
+            u8 plane0 = 0;
+            u8 plane1 = 0;
+
+            for (int i = 0; i < 8; i++)
+            {
+                u8 outcolor = src[tile * 8 + i];
 
-            u8 *tile_base = finalbuffer[j >> 3][i >> 3];
-            tile_base = &tile_base[(j & 7) * 2];
+                plane0 |= (outcolor & 1) << (7 - i);
+                plane1 |= ((outcolor >> 1) & 1) << (7 - i);
+            }
 
-            if (outcolor & 1)
-                tile_base[0] |= 1 << (7 - (7 & i));
-            if (outcolor & 2)
-                tile_base[1] |= 1 << (7 - (7 & i));
+            u8 *tile_base = &finalbuffer[j >> 3][tile][(j & 7) * 2];
+            tile_base[0] = plane0;
+            tile_base[1] = plane1;
         }
     }
 
     // Copy to cart ram...
     memcpy(&(GameBoy.Memory.ExternRAM[0][0xA100 - 0xA000]), finalbuffer,
            sizeof(finalbuffer));
-
-cleanup:
-    free(temp_buf);
-    free(fourcolorsbuffer);
+    GameBoy.Emulator.sram_dirty = 1;
 }
 
 int GB_CameraReadRegister(int address)
@@ -512,11 +516,16 @@ int GB_MapperIsGBCamera(void)
 
 int GB_CameraWebcamImageGetPixel(int x, int y)
 {
-    return gb_camera_webcam_output[x][y + (GBCAM_SENSOR_EXTRA_LINES / 2)];
+    return gb_camera_webcam_output[y + (GBCAM_SENSOR_EXTRA_LINES / 2)][x];
 }
 
 int GB_CameraRetinaProcessedImageGetPixel(int x, int y)
 {
     // 4 extra rows, 2 on each border
-    return gb_cam_retina_output_buf[x][y + (GBCAM_SENSOR_EXTRA_LINES / 2)];
+    return gb_cam_retina_output_buf[y + (GBCAM_SENSOR_EXTRA_LINES / 2)][x];
+}
+
+void GB_CameraStateRegister(void)
+{
+    GB_StateRegister(&gb_camera_clock_counter, sizeof(gb_camera_clock_counter));
 }
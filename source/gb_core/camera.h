@@ -19,8 +19,8 @@
 
 //----------------------------------------------------------------
 
-// Values in range 0-255
-extern int gb_camera_webcam_output[GBCAM_SENSOR_W][GBCAM_SENSOR_H];
+// Values in range 0-255, one row after another
+extern int gb_camera_webcam_output[GBCAM_SENSOR_H][GBCAM_SENSOR_W];
 
 //----------------------------------------------------------------
 
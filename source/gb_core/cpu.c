@@ -21,6 +21,8 @@
 #include "serial.h"
 #include "sgb.h"
 #include "sound.h"
+#include "state.h"
+#include "timing.h"
 
 #include "../gui/win_gb_debugger.h"
 
@@ -58,6 +60,69 @@ extern const u8 gb_daa_table[256 * 8 * 2]; // In file daa_table.c
 
 //----------------------------------------------------------------
 
+// Versions of GB_MemRead8() and GB_MemWrite8() for the CPU loop that also
+// check the watchpoints. The PC is incremented before it is masked in some
+// instructions, so the address has to be masked here. Only the direct page
+// access is inlined.
+
+static u32 GB_CPUMemRead8Slow(u32 address)
+{
+    u32 value = GameBoy.Memory.MemRead(address);
+
+    if (GameBoy.Memory.WatchPage[address >> 8] & GB_WATCH_READ)
+        GB_DebugWatchRead(address, value);
+
+    return value;
+}
+
+static void GB_CPUMemWrite8Slow(u32 address, u32 value)
+{
+    if (GameBoy.Memory.WatchPage[address >> 8] & GB_WATCH_WRITE)
+        GB_DebugWatchWrite(address, value);
+
+    GameBoy.Memory.MemWrite(address, value);
+}
+
+static inline u32 GB_CPUMemRead8(u32 address)
+{
+    address &= 0xFFFF;
+
+    const u8 *page = GameBoy.Memory.ReadPage[address >> 8];
+
+    if (page != NULL)
+        return page[address & 0xFF];
+
+    return GB_CPUMemRead8Slow(address);
+}
+
+static inline void GB_CPUMemWrite8(u32 address, u32 value)
+{
+    address &= 0xFFFF;
+
+    u8 *page = GameBoy.Memory.WritePage[address >> 8];
+
+    if (page != NULL)
+        page[address & 0xFF] = value;
+    else
+        GB_CPUMemWrite8Slow(address, value);
+}
+
+// Non-inline wrappers of the functions above. They are used by the CB-prefixed
+// instructions that access [HL], which are rare. GCC considers those paths cold
+// and refuses to inline the accesses in them, but it inlines them here.
+
+static NOINLINE u32 GB_CPUMemRead8CB(u32 address)
+{
+    return GB_CPUMemRead8(address);
+}
+
+static NOINLINE void GB_CPUMemWrite8CB(u32 address, u32 value)
+{
+    GB_CPUMemWrite8(address, value);
+}
+
+//----------------------------------------------------------------
+
 static int gb_break_cpu_loop = 0;
 
 // Call this function when writing to a register that can generate an event
@@ -131,11 +196,24 @@ static void GB_ClockCountersReset(void)
 
 void GB_UpdateCounterToClocks(int reference_clocks)
 {
+    GB_TIMING_BEGIN(GB_TIMING_TIMERS);
     GB_TimersUpdateClocksCounterReference(reference_clocks);
+    GB_TIMING_END(GB_TIMING_TIMERS);
+
+    GB_TIMING_BEGIN(GB_TIMING_VIDEO);
     GB_PPUUpdateClocksCounterReference(reference_clocks);
+    GB_TIMING_END(GB_TIMING_VIDEO);
+
     GB_SerialUpdateClocksCounterReference(reference_clocks);
+
+    GB_TIMING_BEGIN(GB_TIMING_SOUND);
     GB_SoundUpdateClocksCounterReference(reference_clocks);
+    GB_TIMING_END(GB_TIMING_SOUND);
+
+    GB_TIMING_BEGIN(GB_TIMING_DMA);
     GB_DMAUpdateClocksCounterReference(reference_clocks);
+    GB_TIMING_END(GB_TIMING_DMA);
+
     //SGB_Update(reference_clocks);
     GB_CameraUpdateClocksCounterReference(reference_clocks);
 }
@@ -262,9 +340,9 @@ void _gb_break_to_debugger(void)
 #define gb_ld_r16_nnnn(reg_hi, reg_low)                                        \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        reg_low = GB_MemRead8(cpu->R16.PC++);                                  \
+        reg_low = GB_CPUMemRead8(cpu->R16.PC++);                               \
         GB_CPUClockCounterAdd(4);                                              \
-        reg_hi = GB_MemRead8(cpu->R16.PC++);                                   \
+        reg_hi = GB_CPUMemRead8(cpu->R16.PC++);                                \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -272,7 +350,7 @@ void _gb_break_to_debugger(void)
 #define gb_ld_r8_nn(reg8)                                                      \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        reg8 = GB_MemRead8(cpu->R16.PC++);                                     \
+        reg8 = GB_CPUMemRead8(cpu->R16.PC++);                                  \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -280,7 +358,7 @@ void _gb_break_to_debugger(void)
 #define gb_ld_ptr_r16_r8(reg16, r8)                                            \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        GB_MemWrite8(reg16, r8);                                               \
+        GB_CPUMemWrite8(reg16, r8);                                            \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -288,7 +366,7 @@ void _gb_break_to_debugger(void)
 #define gb_ld_r8_ptr_r16(r8, reg16)                                            \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        r8 = GB_MemRead8(reg16);                                               \
+        r8 = GB_CPUMemRead8(reg16);                                            \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -428,11 +506,11 @@ void _gb_break_to_debugger(void)
         GB_CPUClockCounterAdd(8);                                              \
         cpu->R16.SP--;                                                         \
         cpu->R16.SP &= 0xFFFF;                                                 \
-        GB_MemWrite8(cpu->R16.SP, cpu->R8.PCH);                                \
+        GB_CPUMemWrite8(cpu->R16.SP, cpu->R8.PCH);                             \
         GB_CPUClockCounterAdd(4);                                              \
         cpu->R16.SP--;                                                         \
         cpu->R16.SP &= 0xFFFF;                                                 \
-        GB_MemWrite8(cpu->R16.SP, cpu->R8.PCL);                                \
+        GB_CPUMemWrite8(cpu->R16.SP, cpu->R8.PCL);                             \
         cpu->R16.PC = addr;                                                    \
         GB_CPUClockCounterAdd(4);                                              \
     }
@@ -443,11 +521,11 @@ void _gb_break_to_debugger(void)
         GB_CPUClockCounterAdd(8);                                              \
         cpu->R16.SP--;                                                         \
         cpu->R16.SP &= 0xFFFF;                                                 \
-        GB_MemWrite8(cpu->R16.SP, reg_hi);                                     \
+        GB_CPUMemWrite8(cpu->R16.SP, reg_hi);                                  \
         GB_CPUClockCounterAdd(4);                                              \
         cpu->R16.SP--;                                                         \
         cpu->R16.SP &= 0xFFFF;                                                 \
-        GB_MemWrite8(cpu->R16.SP, reg_low);                                    \
+        GB_CPUMemWrite8(cpu->R16.SP, reg_low);                                 \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -455,10 +533,10 @@ void _gb_break_to_debugger(void)
 #define gb_pop_r16(reg_hi, reg_low)                                            \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        reg_low = GB_MemRead8(cpu->R16.SP++);                                  \
+        reg_low = GB_CPUMemRead8(cpu->R16.SP++);                               \
         cpu->R16.SP &= 0xFFFF;                                                 \
         GB_CPUClockCounterAdd(4);                                              \
-        reg_hi = GB_MemRead8(cpu->R16.SP++);                                   \
+        reg_hi = GB_CPUMemRead8(cpu->R16.SP++);                                \
         cpu->R16.SP &= 0xFFFF;                                                 \
         GB_CPUClockCounterAdd(4);                                              \
     }
@@ -469,17 +547,17 @@ void _gb_break_to_debugger(void)
         if (cond)                                                              \
         {                                                                      \
             GB_CPUClockCounterAdd(4);                                          \
-            u32 temp = GB_MemRead8(cpu->R16.PC++);                             \
+            u32 temp = GB_CPUMemRead8(cpu->R16.PC++);                          \
             GB_CPUClockCounterAdd(4);                                          \
-            temp |= ((u32)GB_MemRead8(cpu->R16.PC++)) << 8;                    \
+            temp |= ((u32)GB_CPUMemRead8(cpu->R16.PC++)) << 8;                 \
             GB_CPUClockCounterAdd(8);                                          \
             cpu->R16.SP--;                                                     \
             cpu->R16.SP &= 0xFFFF;                                             \
-            GB_MemWrite8(cpu->R16.SP, cpu->R8.PCH);                            \
+            GB_CPUMemWrite8(cpu->R16.SP, cpu->R8.PCH);                         \
             GB_CPUClockCounterAdd(4);                                          \
             cpu->R16.SP--;                                                     \
             cpu->R16.SP &= 0xFFFF;                                             \
-            GB_MemWrite8(cpu->R16.SP, cpu->R8.PCL);                            \
+            GB_CPUMemWrite8(cpu->R16.SP, cpu->R8.PCL);                         \
             cpu->R16.PC = temp;                                                \
             GB_CPUClockCounterAdd(4);                                          \
         }                                                                      \
@@ -497,10 +575,10 @@ void _gb_break_to_debugger(void)
         if (cond)                                                              \
         {                                                                      \
             GB_CPUClockCounterAdd(4);                                          \
-            u32 temp = GB_MemRead8(cpu->R16.SP++);                             \
+            u32 temp = GB_CPUMemRead8(cpu->R16.SP++);                          \
             cpu->R16.SP &= 0xFFFF;                                             \
             GB_CPUClockCounterAdd(4);                                          \
-            temp |= ((u32)GB_MemRead8(cpu->R16.SP++)) << 8;                    \
+            temp |= ((u32)GB_CPUMemRead8(cpu->R16.SP++)) << 8;                 \
             cpu->R16.SP &= 0xFFFF;                                             \
             GB_CPUClockCounterAdd(4);                                          \
             cpu->R16.PC = temp;                                                \
@@ -518,9 +596,9 @@ void _gb_break_to_debugger(void)
         if (cond)                                                              \
         {                                                                      \
             GB_CPUClockCounterAdd(4);                                          \
-            u32 temp = GB_MemRead8(cpu->R16.PC++);                             \
+            u32 temp = GB_CPUMemRead8(cpu->R16.PC++);                          \
             GB_CPUClockCounterAdd(4);                                          \
-            temp |= ((u32)GB_MemRead8(cpu->R16.PC++)) << 8;                    \
+            temp |= ((u32)GB_CPUMemRead8(cpu->R16.PC++)) << 8;                 \
             GB_CPUClockCounterAdd(4);                                          \
             cpu->R16.PC = temp;                                                \
             GB_CPUClockCounterAdd(4);                                          \
@@ -539,7 +617,7 @@ void _gb_break_to_debugger(void)
         if (cond)                                                              \
         {                                                                      \
             GB_CPUClockCounterAdd(4);                                          \
-            u32 temp = GB_MemRead8(cpu->R16.PC++);                             \
+            u32 temp = GB_CPUMemRead8(cpu->R16.PC++);                          \
             cpu->R16.PC = (cpu->R16.PC + (s8)temp) & 0xFFFF;                   \
             GB_CPUClockCounterAdd(8);                                          \
         }                                                                      \
@@ -646,7 +724,7 @@ void _gb_break_to_debugger(void)
         GB_CPUClockCounterAdd(4);                                              \
         cpu->R16.AF &= ~F_SUBTRACT;                                            \
         cpu->R16.AF |= F_HALFCARRY;                                            \
-        cpu->F.Z = (GB_MemRead8(cpu->R16.HL) & (1 << bitn)) == 0;              \
+        cpu->F.Z = (GB_CPUMemRead8CB(cpu->R16.HL) & (1 << bitn)) == 0;         \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -661,9 +739,9 @@ void _gb_break_to_debugger(void)
 #define gb_res_n_ptr_hl(bitn)                                                  \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        u32 temp = GB_MemRead8(cpu->R16.HL);                                   \
+        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);                              \
         GB_CPUClockCounterAdd(4);                                              \
-        GB_MemWrite8(cpu->R16.HL, temp &(~(1 << bitn)));                       \
+        GB_CPUMemWrite8CB(cpu->R16.HL, temp &(~(1 << bitn)));                  \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -678,9 +756,9 @@ void _gb_break_to_debugger(void)
 #define gb_set_n_ptr_hl(bitn)                                                  \
     {                                                                          \
         GB_CPUClockCounterAdd(4);                                              \
-        u32 temp = GB_MemRead8(cpu->R16.HL);                                   \
+        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);                              \
         GB_CPUClockCounterAdd(4);                                              \
-        GB_MemWrite8(cpu->R16.HL, temp | (1 << bitn));                         \
+        GB_CPUMemWrite8CB(cpu->R16.HL, temp | (1 << bitn));                    \
         GB_CPUClockCounterAdd(4);                                              \
     }
 
@@ -711,9 +789,12 @@ static int GB_CPUExecute(int clocks)
     // If nothing interesting happens before, stop here
     int finish_clocks = GB_CPUClockCounterGet() + clocks;
 
+    // Breakpoints can't be added while the CPU is running
+    int check_breakpoints = GB_DebugAnyBreakpoint();
+
     while (GB_CPUClockCounterGet() < finish_clocks)
     {
-        if (GB_DebugCPUIsBreakpoint(cpu->R16.PC))
+        if (check_breakpoints && GB_DebugCPUIsBreakpoint(cpu->R16.PC))
         {
             _gb_break_to_debugger();
             Win_GBDisassemblerSetFocus();
@@ -728,7 +809,7 @@ static int GB_CPUExecute(int clocks)
             GB_CPUBreakLoop();
         }
 
-        u8 opcode = (u8)GB_MemRead8(cpu->R16.PC++);
+        u8 opcode = (u8)GB_CPUMemRead8(cpu->R16.PC++);
         cpu->R16.PC &= 0xFFFF;
 
         if (GameBoy.Emulator.halt_bug)
@@ -770,13 +851,13 @@ static int GB_CPUExecute(int clocks)
             case 0x08: // LD [nnnn],SP - 5
             {
                 GB_CPUClockCounterAdd(4);
-                u16 temp = GB_MemRead8(cpu->R16.PC++);
+                u16 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)GB_MemRead8(cpu->R16.PC++)) << 8;
+                temp |= ((u32)GB_CPUMemRead8(cpu->R16.PC++)) << 8;
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(temp++, cpu->R8.SPL);
+                GB_CPUMemWrite8(temp++, cpu->R8.SPL);
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(temp, cpu->R8.SPH);
+                GB_CPUMemWrite8(temp, cpu->R8.SPH);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
@@ -806,7 +887,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0x10: // STOP - 1*
                 GB_CPUClockCounterAdd(4);
-                if (GB_MemRead8(cpu->R16.PC++) != 0)
+                if (GB_CPUMemRead8(cpu->R16.PC++) != 0)
                 {
                     Debug_DebugMsgArg("Corrupted stop.\n"
                                       "PC: %04X\n"
@@ -871,7 +952,7 @@ static int GB_CPUExecute(int clocks)
             case 0x18: // JR nn - 3
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.PC = (cpu->R16.PC + (s8)temp) & 0xFFFF;
                 GB_CPUClockCounterAdd(4);
@@ -912,7 +993,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0x22: // LD [HL+],A - 2
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(cpu->R16.HL, cpu->R8.A);
+                GB_CPUMemWrite8(cpu->R16.HL, cpu->R8.A);
                 cpu->R16.HL = (cpu->R16.HL + 1) & 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -949,7 +1030,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0x2A: // LD A,[HL+] - 2
                 GB_CPUClockCounterAdd(4);
-                cpu->R8.A = GB_MemRead8(cpu->R16.HL);
+                cpu->R8.A = GB_CPUMemRead8(cpu->R16.HL);
                 cpu->R16.HL = (cpu->R16.HL + 1) & 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -978,7 +1059,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0x32: // LD [HL-],A - 2
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(cpu->R16.HL, cpu->R8.A);
+                GB_CPUMemWrite8(cpu->R16.HL, cpu->R8.A);
                 cpu->R16.HL = (cpu->R16.HL - 1) & 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -988,35 +1069,35 @@ static int GB_CPUExecute(int clocks)
             case 0x34: // INC [HL] - 3
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.HL);
+                u32 temp = GB_CPUMemRead8(cpu->R16.HL);
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~F_SUBTRACT;
                 cpu->F.H = ((temp & 0xF) == 0xF);
                 temp = (temp + 1) & 0xFF;
                 cpu->F.Z = (temp == 0);
-                GB_MemWrite8(cpu->R16.HL, temp);
+                GB_CPUMemWrite8(cpu->R16.HL, temp);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
             case 0x35: // DEC [HL] - 3
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.HL);
+                u32 temp = GB_CPUMemRead8(cpu->R16.HL);
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF |= F_SUBTRACT;
                 cpu->F.H = ((temp & 0xF) == 0x0);
                 temp = (temp - 1) & 0xFF;
                 cpu->F.Z = (temp == 0);
-                GB_MemWrite8(cpu->R16.HL, temp);
+                GB_CPUMemWrite8(cpu->R16.HL, temp);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
             case 0x36: // LD [HL],n - 3
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(cpu->R16.HL, temp);
+                GB_CPUMemWrite8(cpu->R16.HL, temp);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
@@ -1033,7 +1114,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0x3A: // LD A,[HL-] - 2
                 GB_CPUClockCounterAdd(4);
-                cpu->R8.A = GB_MemRead8(cpu->R16.HL);
+                cpu->R8.A = GB_CPUMemRead8(cpu->R16.HL);
                 cpu->R16.HL = (cpu->R16.HL - 1) & 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -1329,7 +1410,7 @@ static int GB_CPUExecute(int clocks)
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~F_SUBTRACT;
                 u32 temp = cpu->R8.A;
-                u32 temp2 = GB_MemRead8(cpu->R16.HL);
+                u32 temp2 = GB_CPUMemRead8(cpu->R16.HL);
                 cpu->F.H = ((temp & 0xF) + (temp2 & 0xF)) > 0xF;
                 cpu->R8.A += temp2;
                 cpu->F.Z = (cpu->R8.A == 0);
@@ -1367,7 +1448,7 @@ static int GB_CPUExecute(int clocks)
             {
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~F_SUBTRACT;
-                u32 temp = GB_MemRead8(cpu->R16.HL);
+                u32 temp = GB_CPUMemRead8(cpu->R16.HL);
                 u32 temp2 = cpu->R8.A + temp + cpu->F.C;
                 cpu->F.H = (((cpu->R8.A & 0xF) + (temp & 0xF)) + cpu->F.C) > 0xF;
                 cpu->F.C = (temp2 > 0xFF);
@@ -1411,7 +1492,7 @@ static int GB_CPUExecute(int clocks)
             case 0x96: // SUB A,[HL] - 2
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.HL);
+                u32 temp = GB_CPUMemRead8(cpu->R16.HL);
                 cpu->R8.F = F_SUBTRACT;
                 cpu->F.H = (cpu->R8.A & 0xF) < (temp & 0xF);
                 cpu->F.C = (u32)cpu->R8.A < (u32)temp;
@@ -1446,7 +1527,7 @@ static int GB_CPUExecute(int clocks)
             case 0x9E: // SBC A,[HL] - 2
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp2 = GB_MemRead8(cpu->R16.HL);
+                u32 temp2 = GB_CPUMemRead8(cpu->R16.HL);
                 u32 temp = cpu->R8.A - temp2 - ((cpu->R8.F & F_CARRY) ? 1 : 0);
                 cpu->R8.F = ((temp & ~0xFF) ? F_CARRY : 0)
                             | ((temp & 0xFF) ? 0 : F_ZERO)
@@ -1484,7 +1565,7 @@ static int GB_CPUExecute(int clocks)
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF |= F_HALFCARRY;
                 cpu->R16.AF &= ~(F_SUBTRACT | F_CARRY);
-                cpu->R8.A &= GB_MemRead8(cpu->R16.HL);
+                cpu->R8.A &= GB_CPUMemRead8(cpu->R16.HL);
                 cpu->F.Z = (cpu->R8.A == 0);
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -1516,7 +1597,7 @@ static int GB_CPUExecute(int clocks)
             case 0xAE: // XOR A,[HL] - 2
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~(F_SUBTRACT | F_CARRY | F_HALFCARRY);
-                cpu->R8.A ^= GB_MemRead8(cpu->R16.HL);
+                cpu->R8.A ^= GB_CPUMemRead8(cpu->R16.HL);
                 cpu->F.Z = (cpu->R8.A == 0);
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -1545,7 +1626,7 @@ static int GB_CPUExecute(int clocks)
             case 0xB6: // OR A,[HL] - 2
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~(F_SUBTRACT | F_CARRY | F_HALFCARRY);
-                cpu->R8.A |= GB_MemRead8(cpu->R16.HL);
+                cpu->R8.A |= GB_CPUMemRead8(cpu->R16.HL);
                 cpu->F.Z = (cpu->R8.A == 0);
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -1577,7 +1658,7 @@ static int GB_CPUExecute(int clocks)
             {
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF |= F_SUBTRACT;
-                u32 temp = GB_MemRead8(cpu->R16.HL);
+                u32 temp = GB_CPUMemRead8(cpu->R16.HL);
                 cpu->F.H = (cpu->R8.A & 0xF) < (temp & 0xF);
                 cpu->F.C = (u32)cpu->R8.A < temp;
                 cpu->F.Z = (cpu->R8.A == temp);
@@ -1601,10 +1682,10 @@ static int GB_CPUExecute(int clocks)
             case 0xC3: // JP nnnn - 4
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)(u8)GB_MemRead8(cpu->R16.PC++)) << 8;
+                temp |= ((u32)(u8)GB_CPUMemRead8(cpu->R16.PC++)) << 8;
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.PC = temp;
@@ -1622,7 +1703,7 @@ static int GB_CPUExecute(int clocks)
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~F_SUBTRACT;
                 u32 temp = cpu->R8.A;
-                u32 temp2 = GB_MemRead8(cpu->R16.PC++);
+                u32 temp2 = GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->F.H = ((temp & 0xF) + (temp2 & 0xF)) > 0xF;
                 cpu->R8.A += temp2;
                 cpu->F.Z = (cpu->R8.A == 0);
@@ -1639,10 +1720,10 @@ static int GB_CPUExecute(int clocks)
             case 0xC9: // RET - 4
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.SP++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.SP++);
                 cpu->R16.SP &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)GB_MemRead8(cpu->R16.SP++)) << 8;
+                temp |= ((u32)GB_CPUMemRead8(cpu->R16.SP++)) << 8;
                 cpu->R16.SP &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.PC = temp;
@@ -1654,7 +1735,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0xCB:
                 GB_CPUClockCounterAdd(4);
-                opcode = (u32)(u8)GB_MemRead8(cpu->R16.PC++);
+                opcode = (u32)(u8)GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.PC &= 0xFFFF;
 
                 switch (opcode)
@@ -1680,13 +1761,13 @@ static int GB_CPUExecute(int clocks)
                     case 0x06: // RLC [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp = GB_MemRead8(cpu->R16.HL);
+                        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         cpu->F.C = (temp & 0x80) != 0;
                         temp = (temp << 1) | cpu->F.C;
                         cpu->F.Z = (temp == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -1715,13 +1796,13 @@ static int GB_CPUExecute(int clocks)
                     case 0x0E: // RRC [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp = GB_MemRead8(cpu->R16.HL);
+                        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         cpu->F.C = (temp & 0x01) != 0;
                         temp = (temp >> 1) | (cpu->F.C << 7);
                         cpu->F.Z = (temp == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -1750,14 +1831,14 @@ static int GB_CPUExecute(int clocks)
                     case 0x16: // RL [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp2 = GB_MemRead8(cpu->R16.HL);
+                        u32 temp2 = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         u32 temp = cpu->F.C; // Old carry flag
                         cpu->F.C = (temp2 & 0x80) != 0;
                         temp2 = ((temp2 << 1) | temp) & 0xFF;
                         cpu->F.Z = (temp2 == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp2);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp2);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -1786,14 +1867,14 @@ static int GB_CPUExecute(int clocks)
                     case 0x1E: // RR [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp2 = GB_MemRead8(cpu->R16.HL);
+                        u32 temp2 = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         u32 temp = cpu->F.C; // Old carry flag
                         cpu->F.C = (temp2 & 0x01) != 0;
                         temp2 = (temp2 >> 1) | (temp << 7);
                         cpu->F.Z = (temp2 == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp2);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp2);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -1822,13 +1903,13 @@ static int GB_CPUExecute(int clocks)
                     case 0x26: // SLA [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp = GB_MemRead8(cpu->R16.HL);
+                        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         cpu->F.C = (temp & 0x80) != 0;
                         temp = (temp << 1) & 0xFF;
                         cpu->F.Z = (temp == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -1857,13 +1938,13 @@ static int GB_CPUExecute(int clocks)
                     case 0x2E: // SRA [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp = GB_MemRead8(cpu->R16.HL);
+                        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         cpu->F.C = (temp & 0x01) != 0;
                         temp = (temp & 0x80) | (temp >> 1);
                         cpu->F.Z = (temp == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -1892,11 +1973,11 @@ static int GB_CPUExecute(int clocks)
                     case 0x36: // SWAP [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp = GB_MemRead8(cpu->R16.HL);
+                        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY | F_CARRY);
                         temp = ((temp >> 4) | (temp << 4)) & 0xFF;
-                        GB_MemWrite8(cpu->R16.HL, temp);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp);
                         cpu->F.Z = (temp == 0);
                         GB_CPUClockCounterAdd(4);
                         break;
@@ -1926,13 +2007,13 @@ static int GB_CPUExecute(int clocks)
                     case 0x3E: // SRL [HL] - 4
                     {
                         GB_CPUClockCounterAdd(4);
-                        u32 temp = GB_MemRead8(cpu->R16.HL);
+                        u32 temp = GB_CPUMemRead8CB(cpu->R16.HL);
                         GB_CPUClockCounterAdd(4);
                         cpu->R16.AF &= ~(F_SUBTRACT | F_HALFCARRY);
                         cpu->F.C = (temp & 0x01) != 0;
                         temp = temp >> 1;
                         cpu->F.Z = (temp == 0);
-                        GB_MemWrite8(cpu->R16.HL, temp);
+                        GB_CPUMemWrite8CB(cpu->R16.HL, temp);
                         GB_CPUClockCounterAdd(4);
                         break;
                     }
@@ -2537,19 +2618,19 @@ static int GB_CPUExecute(int clocks)
             case 0xCD: // CALL nnnn - 6
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)GB_MemRead8(cpu->R16.PC++)) << 8;
+                temp |= ((u32)GB_CPUMemRead8(cpu->R16.PC++)) << 8;
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(8);
                 cpu->R16.SP--;
                 cpu->R16.SP &= 0xFFFF;
-                GB_MemWrite8(cpu->R16.SP, cpu->R8.PCH);
+                GB_CPUMemWrite8(cpu->R16.SP, cpu->R8.PCH);
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.SP--;
                 cpu->R16.SP &= 0xFFFF;
-                GB_MemWrite8(cpu->R16.SP, cpu->R8.PCL);
+                GB_CPUMemWrite8(cpu->R16.SP, cpu->R8.PCL);
                 cpu->R16.PC = temp;
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -2558,7 +2639,7 @@ static int GB_CPUExecute(int clocks)
             {
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~F_SUBTRACT;
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 u32 temp2 = cpu->R8.A + temp + cpu->F.C;
                 cpu->F.H = (((cpu->R8.A & 0xF) + (temp & 0xF)) + cpu->F.C) > 0xF;
                 cpu->F.C = (temp2 > 0xFF);
@@ -2591,7 +2672,7 @@ static int GB_CPUExecute(int clocks)
             case 0xD6: // SUB A,nn - 2
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.AF |= F_SUBTRACT;
                 cpu->F.H = (cpu->R8.A & 0xF) < (temp & 0xF);
                 cpu->F.C = (u32)cpu->R8.A < temp;
@@ -2609,10 +2690,10 @@ static int GB_CPUExecute(int clocks)
             case 0xD9: // RETI - 4
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.SP++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.SP++);
                 cpu->R16.SP &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)GB_MemRead8(cpu->R16.SP++)) << 8;
+                temp |= ((u32)GB_CPUMemRead8(cpu->R16.SP++)) << 8;
                 cpu->R16.SP &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.PC = temp;
@@ -2636,7 +2717,7 @@ static int GB_CPUExecute(int clocks)
             case 0xDE: // SBC A,nn - 2
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp2 = GB_MemRead8(cpu->R16.PC++);
+                u32 temp2 = GB_CPUMemRead8(cpu->R16.PC++);
                 u32 temp = cpu->R8.A - temp2 - ((cpu->R8.F & F_CARRY) ? 1 : 0);
                 cpu->R8.F = ((temp & ~0xFF) ? F_CARRY : 0)
                             | ((temp & 0xFF) ? 0 : F_ZERO)
@@ -2652,9 +2733,9 @@ static int GB_CPUExecute(int clocks)
             case 0xE0: // LD [0xFF00+nn],A - 3
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = 0xFF00 + (u32)GB_MemRead8(cpu->R16.PC++);
+                u32 temp = 0xFF00 + (u32)GB_CPUMemRead8(cpu->R16.PC++);
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(temp, cpu->R8.A);
+                GB_CPUMemWrite8(temp, cpu->R8.A);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
@@ -2663,7 +2744,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0xE2: // LD [0xFF00+C],A - 2
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(0xFF00 + (u32)cpu->R8.C, cpu->R8.A);
+                GB_CPUMemWrite8(0xFF00 + (u32)cpu->R8.C, cpu->R8.A);
                 GB_CPUClockCounterAdd(4);
                 break;
             case 0xE3: // Undefined - *
@@ -2680,7 +2761,7 @@ static int GB_CPUExecute(int clocks)
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~(F_SUBTRACT | F_CARRY);
                 cpu->R16.AF |= F_HALFCARRY;
-                cpu->R8.A &= GB_MemRead8(cpu->R16.PC++);
+                cpu->R8.A &= GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->F.Z = (cpu->R8.A == 0);
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -2692,7 +2773,7 @@ static int GB_CPUExecute(int clocks)
             {
                 GB_CPUClockCounterAdd(4);
                 // Expand sign
-                u32 temp = (u16)(s16)(s8)GB_MemRead8(cpu->R16.PC++);
+                u32 temp = (u16)(s16)(s8)GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R8.F = 0;
                 cpu->F.C = ((cpu->R16.SP & 0x00FF) + (temp & 0x00FF)) > 0x00FF;
                 cpu->F.H = ((cpu->R16.SP & 0x000F) + (temp & 0x000F)) > 0x000F;
@@ -2707,13 +2788,13 @@ static int GB_CPUExecute(int clocks)
             case 0xEA: // LD [nnnn],A - 4
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)GB_MemRead8(cpu->R16.PC++)) << 8;
+                temp |= ((u32)GB_CPUMemRead8(cpu->R16.PC++)) << 8;
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                GB_MemWrite8(temp, cpu->R8.A);
+                GB_CPUMemWrite8(temp, cpu->R8.A);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
@@ -2729,7 +2810,7 @@ static int GB_CPUExecute(int clocks)
             case 0xEE: // XOR A,nn - 2
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~(F_SUBTRACT | F_CARRY | F_HALFCARRY);
-                cpu->R8.A ^= GB_MemRead8(cpu->R16.PC++);
+                cpu->R8.A ^= GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->F.Z = (cpu->R8.A == 0);
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -2740,9 +2821,9 @@ static int GB_CPUExecute(int clocks)
             case 0xF0: // LD A,[0xFF00+nn] - 3
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = 0xFF00 + (u32)GB_MemRead8(cpu->R16.PC++);
+                u32 temp = 0xFF00 + (u32)GB_CPUMemRead8(cpu->R16.PC++);
                 GB_CPUClockCounterAdd(4);
-                cpu->R8.A = GB_MemRead8(temp);
+                cpu->R8.A = GB_CPUMemRead8(temp);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
@@ -2752,7 +2833,7 @@ static int GB_CPUExecute(int clocks)
                 break;
             case 0xF2: // LD A,[0xFF00+C] - 2
                 GB_CPUClockCounterAdd(4);
-                cpu->R8.A = GB_MemRead8(0xFF00 + (u32)cpu->R8.C);
+                cpu->R8.A = GB_CPUMemRead8(0xFF00 + (u32)cpu->R8.C);
                 GB_CPUClockCounterAdd(4);
                 break;
             case 0xF3: // DI - 1
@@ -2769,7 +2850,7 @@ static int GB_CPUExecute(int clocks)
             case 0xF6: // OR A,nn - 2
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF &= ~(F_SUBTRACT | F_CARRY | F_HALFCARRY);
-                cpu->R8.A |= GB_MemRead8(cpu->R16.PC++);
+                cpu->R8.A |= GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->F.Z = (cpu->R8.A == 0);
                 GB_CPUClockCounterAdd(4);
                 break;
@@ -2779,7 +2860,7 @@ static int GB_CPUExecute(int clocks)
             case 0xF8: // LD HL,SP+nn - 3
             {
                 GB_CPUClockCounterAdd(4);
-                s32 temp = (s32)(s8)GB_MemRead8(cpu->R16.PC++);
+                s32 temp = (s32)(s8)GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.PC &= 0xFFFF;
                 s32 res = (s32)cpu->R16.SP + temp;
                 cpu->R16.HL = res & 0xFFFF;
@@ -2796,13 +2877,13 @@ static int GB_CPUExecute(int clocks)
             case 0xFA: // LD A,[nnnn] - 4
             {
                 GB_CPUClockCounterAdd(4);
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                temp |= ((u32)GB_MemRead8(cpu->R16.PC++)) << 8;
+                temp |= ((u32)GB_CPUMemRead8(cpu->R16.PC++)) << 8;
                 cpu->R16.PC &= 0xFFFF;
                 GB_CPUClockCounterAdd(4);
-                cpu->R8.A = GB_MemRead8(temp);
+                cpu->R8.A = GB_CPUMemRead8(temp);
                 GB_CPUClockCounterAdd(4);
                 break;
             }
@@ -2821,7 +2902,7 @@ static int GB_CPUExecute(int clocks)
             {
                 GB_CPUClockCounterAdd(4);
                 cpu->R16.AF |= F_SUBTRACT;
-                u32 temp = GB_MemRead8(cpu->R16.PC++);
+                u32 temp = GB_CPUMemRead8(cpu->R16.PC++);
                 u32 temp2 = cpu->R8.A;
                 cpu->F.H = (temp2 & 0xF) < (temp & 0xF);
                 cpu->F.C = (temp2 < temp);
@@ -2907,7 +2988,9 @@ int GB_RunFor(s32 run_for_clocks) // 1 frame = 70224 clocks
             else
             {
                 // GB_CPUClockCounterAdd() internal
+                GB_TIMING_BEGIN(GB_TIMING_DMA);
                 int dma_executed_clocks = GB_DMAExecute(clocks_to_next_event);
+                GB_TIMING_END(GB_TIMING_DMA);
                 if (dma_executed_clocks == 0)
                 {
                     // GB_CPUClockCounterAdd() internal
@@ -2917,8 +3000,10 @@ int GB_RunFor(s32 run_for_clocks) // 1 frame = 70224 clocks
                         if (GameBoy.Emulator.CPUHalt == 0) // No halt
                         {
                             // GB_CPUClockCounterAdd() internal
+                            GB_TIMING_BEGIN(GB_TIMING_CPU);
                             executed_clocks =
                                     GB_CPUExecute(clocks_to_next_event);
+                            GB_TIMING_END(GB_TIMING_CPU);
                         }
                         else // Halt or stop
                         {
@@ -2965,3 +3050,11 @@ void GB_RunForInstruction(void)
     gb_last_residual_clocks = 0;
     GB_RunFor(4);
 }
+
+void GB_CPUStateRegister(void)
+{
+    GB_StateRegister(&gb_last_residual_clocks, sizeof(gb_last_residual_clocks));
+    GB_StateRegister(&gb_break_cpu_loop, sizeof(gb_break_cpu_loop));
+    GB_StateRegister(&gb_cpu_clock_counter, sizeof(gb_cpu_clock_counter));
+    GB_StateRegister(&gb_break_execution, sizeof(gb_break_execution));
+}
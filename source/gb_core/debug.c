@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "../build_options.h"
+#include "../debug_utils.h"
 #include "../font_utils.h"
 #include "../general_utils.h"
 
@@ -25,107 +26,297 @@ extern _GB_CONTEXT_ GameBoy;
 
 //------------------------------------------------------------------------------
 
-#define GB_MAX_BREAKPOINTS 20
+// One bit per address of the 16-bit address space
+static u32 gb_brkpoint_bitmap[0x10000 / 32];
+static int gb_brkpoint_count = 0;
 
-static u32 gb_brkpoint_addrlist[GB_MAX_BREAKPOINTS];
-static int gb_brkpoint_used[GB_MAX_BREAKPOINTS];
-static int gb_any_breakpoint_used = 0;
+static int gb_watch_count = 0;
+
+// Execution hooks use the same kind of bitmap as breakpoints
+static u32 gb_pchook_bitmap[0x10000 / 32];
+static int gb_pchook_count = 0;
+static gb_pc_hook_fn gb_pchook_callback = NULL;
+
+int GB_DebugAnyBreakpoint(void)
+{
+    return (gb_brkpoint_count > 0) || (gb_watch_count > 0)
+           || (gb_pchook_count > 0);
+}
 
 int GB_DebugIsBreakpoint(u32 addr)
 {
-    if (gb_any_breakpoint_used == 0)
+    if (addr > 0xFFFF)
         return 0;
 
-    for (int i = 0; i < GB_MAX_BREAKPOINTS; i++)
-    {
-        if (gb_brkpoint_used[i])
-        {
-            if (gb_brkpoint_addrlist[i] == addr)
-            {
-                return 1;
-            }
-        }
-    }
-    return 0;
+    return (gb_brkpoint_bitmap[addr >> 5] >> (addr & 31)) & 1;
 }
 
 static u32 gb_last_executed_opcode = 1;
 
+// Address of the instruction being executed, used for the watchpoint log
+static u32 gb_watch_pc;
+// Set when a watchpoint with GB_WATCH_BREAK is triggered
+static int gb_watch_break_pending = 0;
+
 int GB_DebugCPUIsBreakpoint(u32 addr)
 {
-    if (gb_any_breakpoint_used == 0)
-        return 0;
+    gb_watch_pc = addr;
+
+    if (gb_watch_break_pending)
+    {
+        gb_watch_break_pending = 0;
+        return 1;
+    }
 
+    // When resuming from a breakpoint, the hook has already been called
     if (gb_last_executed_opcode == addr)
     {
         gb_last_executed_opcode = 1;
         return 0;
     }
 
-    for (int i = 0; i < GB_MAX_BREAKPOINTS; i++)
+    if ((gb_pchook_count > 0) && (addr <= 0xFFFF)
+        && ((gb_pchook_bitmap[addr >> 5] >> (addr & 31)) & 1))
     {
-        if (gb_brkpoint_used[i])
-        {
-            if (gb_brkpoint_addrlist[i] == addr)
-            {
-                gb_last_executed_opcode = addr;
-                return 1;
-            }
-        }
+        if (gb_pchook_callback != NULL)
+            gb_pchook_callback(addr);
     }
+
+    if (gb_brkpoint_count == 0)
+        return 0;
+
+    if (GB_DebugIsBreakpoint(addr))
+    {
+        gb_last_executed_opcode = addr;
+        return 1;
+    }
+
     return 0;
 }
 
 void GB_DebugAddBreakpoint(u32 addr)
 {
+    if (addr > 0xFFFF)
+        return;
+
     if (GB_DebugIsBreakpoint(addr))
         return;
 
-    for (int i = 0; i < GB_MAX_BREAKPOINTS; i++)
-    {
-        if (gb_brkpoint_used[i] == 0)
-        {
-            gb_brkpoint_addrlist[i] = addr;
-            gb_brkpoint_used[i] = 1;
-            gb_any_breakpoint_used = 1;
-            return;
-        }
-    }
+    gb_brkpoint_bitmap[addr >> 5] |= 1U << (addr & 31);
+    gb_brkpoint_count++;
 }
 
 void GB_DebugClearBreakpoint(u32 addr)
 {
-    for (int i = 0; i < GB_MAX_BREAKPOINTS; i++)
+    if (GB_DebugIsBreakpoint(addr) == 0)
+        return;
+
+    gb_brkpoint_bitmap[addr >> 5] &= ~(1U << (addr & 31));
+    gb_brkpoint_count--;
+}
+
+void GB_DebugClearBreakpointAll(void)
+{
+    memset(gb_brkpoint_bitmap, 0, sizeof(gb_brkpoint_bitmap));
+    gb_brkpoint_count = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void GB_DebugSetPCHookCallback(gb_pc_hook_fn fn)
+{
+    gb_pchook_callback = fn;
+}
+
+void GB_DebugAddPCHook(u32 addr)
+{
+    if (addr > 0xFFFF)
+        return;
+
+    if ((gb_pchook_bitmap[addr >> 5] >> (addr & 31)) & 1)
+        return;
+
+    gb_pchook_bitmap[addr >> 5] |= 1U << (addr & 31);
+    gb_pchook_count++;
+}
+
+void GB_DebugClearPCHookAll(void)
+{
+    memset(gb_pchook_bitmap, 0, sizeof(gb_pchook_bitmap));
+    gb_pchook_count = 0;
+}
+
+static gb_vblank_hook_fn gb_vblank_callback = NULL;
+
+void GB_DebugSetVBlankHookCallback(gb_vblank_hook_fn fn)
+{
+    gb_vblank_callback = fn;
+}
+
+void GB_DebugVBlankHook(void)
+{
+    if (gb_vblank_callback != NULL)
+        gb_vblank_callback();
+}
+
+//------------------------------------------------------------------------------
+
+#define GB_MAX_WATCHPOINTS 16
+
+typedef struct
+{
+    u32 start, end;
+    int flags;
+    int has_value;
+    u32 value;
+} _gb_watchpoint_t;
+
+static _gb_watchpoint_t gb_watchpoints[GB_MAX_WATCHPOINTS];
+
+#define GB_WATCH_LOG_SIZE 4096 // Must be a power of 2
+
+typedef struct
+{
+    u32 pc;
+    u32 clocks;
+    u32 address;
+    u8 old_value;
+    u8 new_value;
+    u8 flags;
+} _gb_watch_log_entry_t;
+
+static _gb_watch_log_entry_t gb_watch_log[GB_WATCH_LOG_SIZE];
+static u32 gb_watch_log_count = 0; // Total number of entries ever logged
+
+static void gb_watch_update_pages(void)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    memset(mem->WatchPage, 0, sizeof(mem->WatchPage));
+
+    for (int i = 0; i < gb_watch_count; i++)
     {
-        if (gb_brkpoint_used[i])
-        {
-            if (gb_brkpoint_addrlist[i] == addr)
-            {
-                gb_brkpoint_used[i] = 0;
-                break;
-            }
-        }
+        _gb_watchpoint_t *w = &gb_watchpoints[i];
+
+        for (u32 page = w->start >> 8; page <= (w->end >> 8); page++)
+            mem->WatchPage[page] |= w->flags & (GB_WATCH_READ | GB_WATCH_WRITE);
     }
 
-    for (int i = 0; i < GB_MAX_BREAKPOINTS; i++)
+    GB_MemUpdatePages();
+}
+
+int GB_DebugAddWatchpoint(u32 start, u32 end, int flags, int has_value,
+                          u32 value)
+{
+    if ((start > end) || (end > 0xFFFF))
+        return 0;
+
+    if ((flags & (GB_WATCH_READ | GB_WATCH_WRITE)) == 0)
+        return 0;
+
+    if (gb_watch_count == GB_MAX_WATCHPOINTS)
+        return 0;
+
+    _gb_watchpoint_t *w = &gb_watchpoints[gb_watch_count++];
+
+    w->start = start;
+    w->end = end;
+    w->flags = flags;
+    w->has_value = has_value;
+    w->value = value & 0xFF;
+
+    gb_watch_update_pages();
+
+    return 1;
+}
+
+void GB_DebugClearWatchpointAll(void)
+{
+    gb_watch_count = 0;
+    gb_watch_break_pending = 0;
+
+    gb_watch_update_pages();
+}
+
+static void gb_watch_check(u32 address, u32 old_value, u32 new_value,
+                           int type)
+{
+    for (int i = 0; i < gb_watch_count; i++)
     {
-        if (gb_brkpoint_used[i])
-        {
-            return;
-        }
+        _gb_watchpoint_t *w = &gb_watchpoints[i];
+
+        if ((w->flags & type) == 0)
+            continue;
+
+        if ((address < w->start) || (address > w->end))
+            continue;
+
+        if (w->has_value && (w->value != new_value))
+            continue;
+
+        _gb_watch_log_entry_t *e =
+                &gb_watch_log[gb_watch_log_count & (GB_WATCH_LOG_SIZE - 1)];
+        gb_watch_log_count++;
+
+        e->pc = gb_watch_pc;
+        e->clocks = GB_CPUClockCounterGet();
+        e->address = address;
+        e->old_value = old_value;
+        e->new_value = new_value;
+        e->flags = type;
+
+        if (w->flags & GB_WATCH_BREAK)
+            gb_watch_break_pending = 1;
+
+        return;
     }
+}
 
-    gb_any_breakpoint_used = 0;
+void GB_DebugWatchRead(u32 address, u32 value)
+{
+    gb_watch_check(address, value, value, GB_WATCH_READ);
 }
 
-void GB_DebugClearBreakpointAll(void)
+void GB_DebugWatchWrite(u32 address, u32 value)
 {
-    for (int i = 0; i < GB_MAX_BREAKPOINTS; i++)
+    // A regular read could change the state of the emulation
+    u32 old_value = GB_MemPeek8(address);
+
+    gb_watch_check(address, old_value, value & 0xFF, GB_WATCH_WRITE);
+}
+
+void GB_DebugWatchLogClear(void)
+{
+    gb_watch_log_count = 0;
+}
+
+int GB_DebugWatchLogSave(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
     {
-        gb_brkpoint_used[i] = 0;
+        Debug_ErrorMsgArg("Couldn't open %s for writing.", path);
+        return 0;
     }
 
-    gb_any_breakpoint_used = 0;
+    fprintf(f, "pc,clocks,access,address,old,new\n");
+
+    u32 first = 0;
+    if (gb_watch_log_count > GB_WATCH_LOG_SIZE)
+        first = gb_watch_log_count - GB_WATCH_LOG_SIZE;
+
+    for (u32 i = first; i < gb_watch_log_count; i++)
+    {
+        _gb_watch_log_entry_t *e = &gb_watch_log[i & (GB_WATCH_LOG_SIZE - 1)];
+
+        fprintf(f, "%04X,%u,%c,%04X,%02X,%02X\n", e->pc, e->clocks,
+                (e->flags & GB_WATCH_WRITE) ? 'W' : 'R', e->address,
+                e->old_value, e->new_value);
+    }
+
+    fclose(f);
+
+    return 1;
 }
 
 //------------------------------------------------------------------------------
@@ -386,10 +577,16 @@ static const int debug_commands_cb_info[256] = {
 
 //------------------------------------------------------------------------------
 
-int gb_debug_get_address_increment(u32 address)
+int gb_debug_get_instruction_size(u8 opcode)
 {
-    int temp;
+    int temp = debug_command_param_size[opcode];
+    if (temp == 3)
+        temp = 1;
+    return temp + 1;
+}
 
+int gb_debug_get_address_increment(u32 address)
+{
     switch (address >> 12)
     {
         case 0:
@@ -403,10 +600,7 @@ int gb_debug_get_address_increment(u32 address)
         case 5:
         case 6:
         case 7:
-            temp = debug_command_param_size[GB_MemRead8(address)];
-            if (temp == 3)
-                temp = 1;
-            return temp + 1;
+            return gb_debug_get_instruction_size(GB_MemRead8(address));
         case 8:
         case 9:
         case 0xA:
@@ -415,17 +609,11 @@ int gb_debug_get_address_increment(u32 address)
         case 0xC:
         case 0xD:
         case 0xE:
-            temp = debug_command_param_size[GB_MemRead8(address)];
-            if (temp == 3)
-                temp = 1;
-            return temp + 1;
+            return gb_debug_get_instruction_size(GB_MemRead8(address));
         case 0xF:
             if (address < 0xFF80)
                 return 1;
-            temp = debug_command_param_size[GB_MemRead8(address)];
-            if (temp == 3)
-                temp = 1;
-            return temp + 1;
+            return gb_debug_get_instruction_size(GB_MemRead8(address));
     }
 
     return 1;
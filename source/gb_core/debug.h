@@ -14,7 +14,48 @@ void GB_DebugClearBreakpoint(u32 addr);
 int GB_DebugIsBreakpoint(u32 addr);    // Used in debugger
 int GB_DebugCPUIsBreakpoint(u32 addr); // Used in CPU loop
 void GB_DebugClearBreakpointAll(void);
+int GB_DebugAnyBreakpoint(void); // The CPU loop skips checks if this is 0
 
+// Hooks
+// -----
+
+// The PC hook callback is called right before executing an instruction at any
+// of the hook addresses. Like breakpoints, hooks added while the CPU is running
+// may not be checked until the CPU loop is entered again.
+typedef void (*gb_pc_hook_fn)(u32 addr);
+void GB_DebugSetPCHookCallback(gb_pc_hook_fn fn);
+void GB_DebugAddPCHook(u32 addr);
+void GB_DebugClearPCHookAll(void);
+
+// The VBlank hook callback is called when the PPU enters the VBlank period
+typedef void (*gb_vblank_hook_fn)(void);
+void GB_DebugSetVBlankHookCallback(gb_vblank_hook_fn fn);
+void GB_DebugVBlankHook(void); // Called by the PPU
+
+// Watchpoints
+// -----------
+
+#define GB_WATCH_READ  (1 << 0)
+#define GB_WATCH_WRITE (1 << 1)
+#define GB_WATCH_BREAK (1 << 2) // Break to the debugger when triggered
+
+// Watch accesses to the range [start, end]. If has_value is set, it only
+// triggers when the value read or written is equal to value. Returns 1 on
+// success.
+int GB_DebugAddWatchpoint(u32 start, u32 end, int flags, int has_value,
+                          u32 value);
+void GB_DebugClearWatchpointAll(void);
+
+// Called by the CPU for accesses to pages with watchpoints
+void GB_DebugWatchRead(u32 address, u32 value);
+void GB_DebugWatchWrite(u32 address, u32 value);
+
+// Saves the log of triggered watchpoints as text. Returns 1 on success.
+int GB_DebugWatchLogSave(const char *path);
+void GB_DebugWatchLogClear(void);
+
+// Size in bytes of the instruction that starts with the specified opcode
+int gb_debug_get_instruction_size(u8 opcode);
 int gb_debug_get_address_increment(u32 address);
 int gb_debug_get_address_is_code(u32 address);
 char *GB_Dissasemble(u16 addr, int *step);
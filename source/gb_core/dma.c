@@ -8,6 +8,7 @@
 
 #include "cpu.h"
 #include "memory.h"
+#include "state.h"
 
 //----------------------------------------------------------------
 
@@ -459,3 +460,8 @@ int GB_DMAExecute(int clocks)
 
     return executed_clocks;
 }
+
+void GB_DMAStateRegister(void)
+{
+    GB_StateRegister(&gb_dma_clock_counter, sizeof(gb_dma_clock_counter));
+}
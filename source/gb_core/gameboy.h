@@ -191,6 +191,13 @@ typedef struct
     gb_mem_write_fn_ptr MemWrite, MemWriteReg; // 8 bit
     gb_mem_read_fn_ptr MemRead, MemReadReg;    // 8 bit
 
+    // Pointers to each 256 byte page of the memory map that can be accessed
+    // directly. NULL pages need to go through MemRead/MemWrite.
+    const u8 *ReadPage[256];
+    u8 *WritePage[256];
+    // Watchpoint flags of each page. Watched pages aren't mapped directly.
+    u8 WatchPage[256];
+
     u32 selected_rom, selected_ram;
     u32 selected_wram, selected_vram; //gbc only
 
@@ -321,6 +328,7 @@ typedef struct
     u32 rumble; // Rumble enabled
     u32 *Rom_Pointer;
     char save_filename[MAX_PATHLEN];
+    u32 sram_dirty; // Set when a byte of cartridge RAM is written (autosave)
     u32 game_supports_gbc;
 
     u8 *boot_rom;
@@ -12,6 +12,7 @@
 #include "../debug_utils.h"
 #include "../file_utils.h"
 #include "../general_utils.h"
+#include "../rom_archive.h"
 
 #include "cpu.h"
 #include "gameboy.h"
@@ -35,7 +36,7 @@ int GB_ROMLoad(const char *rom_path)
     void *ptr;
     size_t size;
 
-    FileLoad(rom_path, &ptr, &size);
+    RomArchive_Load(rom_path, &ptr, &size);
 
     if (ptr == NULL)
     {
@@ -54,7 +55,9 @@ int GB_ROMLoad(const char *rom_path)
     // Init after loading the cartridge to set the hardware type value and allow
     // GB_Screen_Init() choose the correct dimensions for the texture.
 
-    GB_Cardridge_Set_Filename(rom_path);
+    char base_path[MAX_PATHLEN];
+    RomArchive_GetBasePath(rom_path, base_path, sizeof(base_path));
+    GB_Cardridge_Set_Filename(base_path);
 
     GB_SRAM_Load();
 
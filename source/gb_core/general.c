@@ -23,6 +23,7 @@
 #include "serial.h"
 #include "sgb.h"
 #include "sound.h"
+#include "state.h"
 #include "video.h"
 
 _GB_CONTEXT_ GameBoy;
@@ -94,3 +95,8 @@ int GB_RumbleEnabled(void)
 {
     return GameBoy.Emulator.rumble;
 }
+
+void GB_GeneralStateRegister(void)
+{
+    GB_StateRegister(&GameBoy, sizeof(GameBoy));
+}
@@ -18,6 +18,7 @@
 #include "memory.h"
 #include "ppu.h"
 #include "serial.h"
+#include "state.h"
 #include "video.h"
 
 //----------------------------------------------------------------
@@ -861,3 +862,8 @@ void GB_CheckJoypadInterrupt(void)
 
     return;
 }
+
+void GB_InterruptsStateRegister(void)
+{
+    GB_StateRegister(&gb_timer_clock_counter, sizeof(gb_timer_clock_counter));
+}
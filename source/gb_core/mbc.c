@@ -86,6 +86,7 @@ static void GB_MBC1Write(u32 address, u32 value)
             mem->selected_rom &= GameBoy.Emulator.ROM_Banks - 1;
 
             mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+            GB_MemUpdatePagesROM();
             break;
         case 0x4:
         case 0x5: // RAM Bank Number - or - Upper Bits of ROM Bank Number
@@ -98,6 +99,7 @@ static void GB_MBC1Write(u32 address, u32 value)
                 mem->selected_rom &= GameBoy.Emulator.ROM_Banks - 1;
 
                 mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+                GB_MemUpdatePagesROM();
             }
             else // RAM mode
             {
@@ -114,8 +116,9 @@ static void GB_MBC1Write(u32 address, u32 value)
         case 0xB:
             if (mem->RAMEnabled == 0)
                 return;
-            else
-                mem->RAM_Curr[address - 0xA000] = value;
+
+            mem->RAM_Curr[address - 0xA000] = value;
+            GameBoy.Emulator.sram_dirty = 1;
             break;
         default:
             //Debug_DebugMsgArg("MBC1 WROTE - %02x to %04x", value, address);
@@ -148,6 +151,7 @@ static void GB_MBC2Write(u32 address, u32 value)
                 if (mem->selected_rom == 0)
                     mem->selected_rom++;
                 mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+                GB_MemUpdatePagesROM();
             }
             break;
         case 0x4:
@@ -159,8 +163,9 @@ static void GB_MBC2Write(u32 address, u32 value)
         case 0xB:
             if (mem->RAMEnabled == 0)
                 return;
-            else
-                mem->RAM_Curr[address - 0xA000] = value & 0x0F;
+
+            mem->RAM_Curr[address - 0xA000] = value & 0x0F;
+            GameBoy.Emulator.sram_dirty = 1;
             break;
         default:
             //Debug_DebugMsgArg("MBC2 WROTE - %02x to %04x", value, address);
@@ -187,6 +192,7 @@ static void GB_MBC3Write(u32 address, u32 value)
             if (mem->selected_rom == 0)
                 mem->selected_rom = 1;
             mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+            GB_MemUpdatePagesROM();
             break;
         case 0x4:
         case 0x5: // RAM Bank Number - or - RTC Register Select
@@ -226,6 +232,7 @@ static void GB_MBC3Write(u32 address, u32 value)
             if (mem->mbc_mode == 1) // RAM mode
             {
                 mem->RAM_Curr[address - 0xA000] = value;
+                GameBoy.Emulator.sram_dirty = 1;
             }
             else // RTC REGISTER
             {
@@ -284,12 +291,14 @@ static void GB_MBC5Write(u32 address, u32 value)
             mem->selected_rom |= (value & 0xFF);
             mem->selected_rom &= GameBoy.Emulator.ROM_Banks - 1;
             mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+            GB_MemUpdatePagesROM();
             break;
         case 0x3:
             mem->selected_rom &= 0xFF;
             mem->selected_rom |= value << 8;
             mem->selected_rom &= GameBoy.Emulator.ROM_Banks - 1;
             mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+            GB_MemUpdatePagesROM();
             break;
         case 0x4:
         case 0x5:
@@ -311,8 +320,9 @@ static void GB_MBC5Write(u32 address, u32 value)
         case 0xB:
             if (mem->RAMEnabled == 0)
                 return;
-            else
-                mem->RAM_Curr[address - 0xA000] = value;
+
+            mem->RAM_Curr[address - 0xA000] = value;
+            GameBoy.Emulator.sram_dirty = 1;
             break;
         default:
             //Debug_DebugMsgArg("MBC5 WROTE - %02x to %04x", value, address);
@@ -351,6 +361,7 @@ static void GB_MBC6Write(u32 address, u32 value)
                 if (value == 0)
                 {
                     mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+                    GB_MemUpdatePagesROM();
                 }
                 //else
                 //{
@@ -395,8 +406,9 @@ static void GB_MBC6Write(u32 address, u32 value)
             //Debug_DebugMsgArg("MBC6 WROTE - %02x to %04x", value, address);
             if (mem->RAMEnabled == 0)
                 return;
-            else
-                mem->RAM_Curr[address - 0xA000] = value;
+
+            mem->RAM_Curr[address - 0xA000] = value;
+            GameBoy.Emulator.sram_dirty = 1;
             break;
         default:
             //Debug_DebugMsgArg("MBC6 WROTE - %02x to %04x", value, address);
@@ -421,6 +433,7 @@ static void GB_MBC7Write(u32 address, u32 value)
             if (mem->selected_rom == 0)
                 mem->selected_rom = 1;
             mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+            GB_MemUpdatePagesROM();
             break;
         case 0x4:
         case 0x5:
@@ -457,6 +470,7 @@ static void GB_MBC7Write(u32 address, u32 value)
                                     mbc7->buffer >> 8;
                             mem->RAM_Curr[mbc7->address * 2 + 1] =
                                     mbc7->buffer & 0xFF;
+                            GameBoy.Emulator.sram_dirty = 1;
                         }
                         mbc7->state = 0;
                         mbc7->value = 1;
@@ -548,6 +562,7 @@ static void GB_MBC7Write(u32 address, u32 value)
                                                         mem->RAM_Curr[i * 2 + 1] =
                                                                 mbc7->buffer & 0xFF;
                                                     }
+                                                    GameBoy.Emulator.sram_dirty = 1;
                                                 }
                                                 mbc7->state = 5;
                                             }
@@ -561,6 +576,7 @@ static void GB_MBC7Write(u32 address, u32 value)
                                                         p = (u16 *)&mem->RAM_Curr[i * 2];
                                                         *p = 0xFFFF;
                                                     }
+                                                    GameBoy.Emulator.sram_dirty = 1;
                                                 }
                                                 mbc7->state = 5;
                                             }
@@ -648,6 +664,7 @@ static void GB_MMM01Write(u32 address, u32 value)
                     mem->selected_rom = (GameBoy.Emulator.MMM01.offset + 1)
                                         & (GameBoy.Emulator.ROM_Banks - 1);
                     mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+                    GB_MemUpdatePagesROM();
                     GameBoy.Emulator.EnableBank0Switch = 0;
                 }
             }
@@ -666,6 +683,7 @@ static void GB_MMM01Write(u32 address, u32 value)
                 mem->selected_rom = (value & GameBoy.Emulator.MMM01.mask)
                                     + GameBoy.Emulator.MMM01.offset;
                 mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+                GB_MemUpdatePagesROM();
             }
             //Debug_DebugMsgArg("MMM01 WROTE - %02x to %04x", value, address);
             break;
@@ -713,6 +731,7 @@ static void GB_MMM01Write(u32 address, u32 value)
                 return;
 
             mem->RAM_Curr[address - 0xA000] = value;
+            GameBoy.Emulator.sram_dirty = 1;
             break;
         default:
             //Debug_DebugMsgArg("MMM01 WROTE - %02x to %04x", value, address);
@@ -737,6 +756,7 @@ static void GB_CameraWrite(u32 address, u32 value)
             mem->selected_rom |= (value & 0xFF);
             mem->selected_rom &= GameBoy.Emulator.ROM_Banks - 1;
             mem->ROM_Curr = mem->ROM_Switch[mem->selected_rom];
+            GB_MemUpdatePagesROM();
             break;
         case 0x3:
             break;
@@ -770,6 +790,7 @@ static void GB_CameraWrite(u32 address, u32 value)
                 return;
 
             mem->RAM_Curr[address - 0xA000] = value;
+            GameBoy.Emulator.sram_dirty = 1;
             break;
         default:
             //Debug_DebugMsgArg("CAMERA WROTE - %02x to %04x", value, address);
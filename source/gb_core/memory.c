@@ -92,6 +92,93 @@ void GB_MemUpdateReadWriteFunctionPointers(void)
                 break;
         }
     }
+
+    GB_MemUpdatePages();
+}
+
+//----------------------------------------------------------------
+
+// Maps pages [first, last] to consecutive 256 byte blocks starting at base. A
+// NULL base unmaps them.
+static void GB_MemMapPages(u32 first, u32 last, u8 *base, int writable)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    for (u32 i = first; i <= last; i++)
+    {
+        u8 *page = (base == NULL) ? NULL : base + ((i - first) << 8);
+
+        int watch = mem->WatchPage[i];
+
+        mem->ReadPage[i] = (watch & GB_WATCH_READ) ? NULL : page;
+        mem->WritePage[i] = (writable && !(watch & GB_WATCH_WRITE)) ?
+                            page : NULL;
+    }
+}
+
+static int GB_MemIsDMG(void)
+{
+    return GameBoy.Memory.MemWrite == GB_MemWrite8_DMG;
+}
+
+void GB_MemUpdatePagesROM(void)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    // Writes go to the mapper
+    GB_MemMapPages(0x00, 0x3F, mem->ROM_Base, 0);
+    GB_MemMapPages(0x40, 0x7F, mem->ROM_Curr, 0);
+
+    // The boot ROM overlays the first pages of the cartridge ROM (GBC boot
+    // ROMs have a hole in 0100h-01FFh, but it doesn't matter much)
+    if (GameBoy.Emulator.enable_boot_rom)
+        GB_MemMapPages(0x00, 0x08, NULL, 0);
+}
+
+void GB_MemUpdatePagesVRAM(void)
+{
+#ifdef VRAM_MEM_CHECKING
+    GB_MemMapPages(0x80, 0x9F, NULL, 0);
+#else
+    GB_MemMapPages(0x80, 0x9F, GameBoy.Memory.VideoRAM_Curr, 1);
+#endif
+}
+
+void GB_MemUpdatePagesWRAM(void)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    GB_MemMapPages(0xD0, 0xDF, mem->WorkRAM_Curr, 1);
+
+    // Echo RAM. In GBC mode writes are also sent to the mapper.
+    GB_MemMapPages(0xF0, 0xFD, mem->WorkRAM_Curr, GB_MemIsDMG());
+}
+
+void GB_MemUpdatePages(void)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    // Cartridge RAM, OAM, I/O and HRAM always use the slow path
+    GB_MemMapPages(0x00, 0xFF, NULL, 0);
+
+    GB_MemUpdatePagesROM();
+    GB_MemUpdatePagesVRAM();
+    GB_MemUpdatePagesWRAM();
+
+    if (GB_MemIsDMG())
+    {
+        GB_MemMapPages(0xC0, 0xCF, mem->WorkRAM, 1);
+    }
+    else
+    {
+        // Reads have to check for OAM DMA, echo RAM writes go to the mapper
+        GB_MemMapPages(0xE0, 0xEF, mem->WorkRAM, 0);
+        for (u32 i = 0xC0; i <= 0xCF; i++)
+        {
+            if ((mem->WatchPage[i] & GB_WATCH_WRITE) == 0)
+                mem->WritePage[i] = mem->WorkRAM + ((i - 0xC0) << 8);
+        }
+    }
 }
 
 void GB_MemInit(void)
@@ -146,6 +233,7 @@ void GB_MemInit(void)
     {
         memset_rand(mem->ObjAttrMem, 0xA0);
     }
+    GB_VideoSpriteListsInvalidate();
 
     memset(mem->IO_Ports, 0x00, 0x80);
     memset(mem->HighRAM, 0, 0x80);
@@ -161,6 +249,8 @@ void GB_MemInit(void)
     mem->RAM_Curr = mem->ExternRAM[0];
     mem->WorkRAM_Curr = mem->WorkRAM_Switch[0];
 
+    GB_MemUpdatePages();
+
     // Prepare registers
     // -----------------
 
@@ -211,7 +301,12 @@ void GB_MemWrite16(u32 address, u32 value)
 
 void GB_MemWrite8(u32 address, u32 value)
 {
-    GameBoy.Memory.MemWrite(address, value);
+    u8 *page = GameBoy.Memory.WritePage[(address >> 8) & 0xFF];
+
+    if ((page != NULL) && (address <= 0xFFFF))
+        page[address & 0xFF] = value;
+    else
+        GameBoy.Memory.MemWrite(address, value);
 }
 
 void GB_MemWriteReg8(u32 address, u32 value)
@@ -228,6 +323,11 @@ u32 GB_MemRead16(u32 address)
 
 u32 GB_MemRead8(u32 address)
 {
+    const u8 *page = GameBoy.Memory.ReadPage[(address >> 8) & 0xFF];
+
+    if ((page != NULL) && (address <= 0xFFFF))
+        return page[address & 0xFF];
+
     return GameBoy.Memory.MemRead(address);
 }
 
@@ -236,6 +336,60 @@ u32 GB_MemReadReg8(u32 address)
     return GameBoy.Memory.MemReadReg(address);
 }
 
+u32 GB_MemPeek8(u32 address)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    address &= 0xFFFF;
+
+    switch (address >> 12)
+    {
+        case 0x0:
+        case 0x1:
+        case 0x2:
+        case 0x3:
+            if (GameBoy.Emulator.enable_boot_rom)
+            {
+                if (address < 0x100)
+                    return GameBoy.Emulator.boot_rom[address];
+                if ((mem->MemRead == GB_MemRead8_GBC_BootEnabled)
+                    && (address >= 0x200) && (address < 0x900))
+                    return GameBoy.Emulator.boot_rom[address];
+            }
+            return mem->ROM_Base[address];
+        case 0x4:
+        case 0x5:
+        case 0x6:
+        case 0x7:
+            return mem->ROM_Curr[address - 0x4000];
+        case 0x8:
+        case 0x9:
+            return mem->VideoRAM_Curr[address - 0x8000];
+        case 0xA:
+        case 0xB:
+            // The mapper may have registers here, like the RTC. Only return
+            // the contents of the RAM bank.
+            if (mem->RAMEnabled && (mem->RAM_Curr != NULL))
+                return mem->RAM_Curr[address - 0xA000];
+            return 0xFF;
+        case 0xC:
+        case 0xE:
+            return mem->WorkRAM[address & 0xFFF];
+        case 0xD:
+            return mem->WorkRAM_Curr[address - 0xD000];
+        default: // 0xF
+            if (address < 0xFE00)
+                return mem->WorkRAM_Curr[address - 0xF000];
+            if (address < 0xFEA0)
+                return mem->ObjAttrMem[address - 0xFE00];
+            if (address < 0xFF00) // Reading this area has no side effects
+                return mem->MemRead(address);
+            if (address < 0xFF80)
+                return mem->IO_Ports[address - 0xFF00];
+            return mem->HighRAM[address - 0xFF80];
+    }
+}
+
 //----------------------------------------------------------------
 
 // This assumes that address is in 0xFE00-0xFEA0
@@ -246,6 +400,8 @@ void GB_MemWriteDMA8(u32 address, u32 value)
         return;
 #endif
     GameBoy.Memory.ObjAttrMem[address - 0xFE00] = value;
+    if ((address & 3) == 0) // Y coordinate
+        GB_VideoSpriteListsInvalidate();
 }
 
 u32 GB_MemReadDMA8(u32 address) // Not verified yet - different for GBC and DMG
@@ -382,6 +538,7 @@ void GB_MemoryWriteSVBK(int value) // reference_clocks not needed
 
     mem->selected_wram = value - 1;
     mem->WorkRAM_Curr = mem->WorkRAM_Switch[mem->selected_wram];
+    GB_MemUpdatePagesWRAM();
 }
 
 void GB_MemoryWriteVBK(int value) // reference_clocks not needed
@@ -396,4 +553,6 @@ void GB_MemoryWriteVBK(int value) // reference_clocks not needed
         mem->VideoRAM_Curr = &mem->VideoRAM[0x2000];
     else
         mem->VideoRAM_Curr = &mem->VideoRAM[0x0000];
+
+    GB_MemUpdatePagesVRAM();
 }
@@ -12,6 +12,13 @@ void GB_MemEnd(void);
 
 void GB_MemUpdateReadWriteFunctionPointers(void);
 
+// Update the page tables used for direct accesses to memory. They have to be
+// called whenever the corresponding bank changes.
+void GB_MemUpdatePages(void);
+void GB_MemUpdatePagesROM(void);
+void GB_MemUpdatePagesVRAM(void);
+void GB_MemUpdatePagesWRAM(void);
+
 void GB_MemWrite16(u32 address, u32 value); // Only used by debugger
 void GB_MemWrite8(u32 address, u32 value);
 void GB_MemWriteReg8(u32 address, u32 value);
@@ -20,6 +27,11 @@ u32 GB_MemRead16(u32 address); // Only used by debugger
 u32 GB_MemRead8(u32 address);
 u32 GB_MemReadReg8(u32 address);
 
+// Reads memory without any side effect, for the debugger. The result can be
+// different from what the CPU would read: OAM is returned even when the PPU
+// blocks it, and mapper registers in the cartridge RAM area are ignored.
+u32 GB_MemPeek8(u32 address);
+
 // This assumes that address is 0xFE00-0xFEA0
 void GB_MemWriteDMA8(u32 address, u32 value);
 u32 GB_MemReadDMA8(u32 address);
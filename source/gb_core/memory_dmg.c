@@ -234,6 +234,8 @@ void GB_MemWrite8_DMG(u32 address, u32 value)
                 }
 #endif
                 mem->ObjAttrMem[address - 0xFE00] = value;
+                if ((address & 3) == 0) // Y coordinate
+                    GB_VideoSpriteListsInvalidate();
                 return;
             }
             else if (address < 0xFF00) // Not Usable
@@ -270,6 +270,8 @@ void GB_MemWrite8_GBC(u32 address, u32 value)
                     return;
 #endif
                 mem->ObjAttrMem[address - 0xFE00] = value;
+                if ((address & 3) == 0) // Y coordinate
+                    GB_VideoSpriteListsInvalidate();
                 return;
             }
             else if (address < 0xFF00) // Not Usable
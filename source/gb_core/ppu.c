@@ -17,6 +17,7 @@
 #include "ppu.h"
 #include "ppu_dmg.h"
 #include "ppu_gbc.h"
+#include "state.h"
 #include "video.h"
 
 //----------------------------------------------------------------
@@ -281,3 +282,8 @@ void GB_PPUCheckLYC(void)
         GameBoy.Memory.IO_Ports[STAT_REG - 0xFF00] &= ~I_LY_EQUALS_LYC;
     }
 }
+
+void GB_PPUStateRegister(void)
+{
+    GB_StateRegister(&gb_ppu_clock_counter, sizeof(gb_ppu_clock_counter));
+}
@@ -8,12 +8,14 @@
 #include "../debug_utils.h"
 
 #include "cpu.h"
+#include "debug.h"
 #include "gameboy.h"
 #include "gb_main.h"
 #include "general.h"
 #include "interrupts.h"
 #include "memory.h"
 #include "ppu.h"
+#include "timing.h"
 #include "video.h"
 
 //----------------------------------------------------------------
@@ -135,8 +137,10 @@ void GB_PPUUpdateClocks_DMG(int increment_clocks)
             case 3:
                 if (GameBoy.Emulator.ly_clocks >= 252)
                 {
+                    GB_TIMING_BEGIN(GB_TIMING_VIDEO);
                     GameBoy.Emulator.DrawScanlineFn(
                             GameBoy.Emulator.CurrentScanLine);
+                    GB_TIMING_END(GB_TIMING_VIDEO);
 
                     GameBoy.Emulator.ScreenMode = 0;
                     mem->IO_Ports[STAT_REG - 0xFF00] &= 0xFC;
@@ -162,6 +166,7 @@ void GB_PPUUpdateClocks_DMG(int increment_clocks)
                             mem->IO_Ports[STAT_REG - 0xFF00] |= 0x01;
 
                             GB_InterruptsSetFlag(I_VBLANK);
+                            GB_DebugVBlankHook();
                         }
                         else
                         {
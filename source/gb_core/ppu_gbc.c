@@ -8,12 +8,14 @@
 #include "../debug_utils.h"
 
 #include "cpu.h"
+#include "debug.h"
 #include "gameboy.h"
 #include "gb_main.h"
 #include "general.h"
 #include "interrupts.h"
 #include "memory.h"
 #include "ppu.h"
+#include "timing.h"
 #include "video.h"
 
 //----------------------------------------------------------------
@@ -118,7 +120,9 @@ void GB_PPUUpdateClocks_GBC(int increment_clocks)
                 if (GameBoy.Emulator.ly_clocks >=
                                         (252 << GameBoy.Emulator.DoubleSpeed))
                 {
+                    GB_TIMING_BEGIN(GB_TIMING_VIDEO);
                     GameBoy.Emulator.DrawScanlineFn(GameBoy.Emulator.CurrentScanLine);
+                    GB_TIMING_END(GB_TIMING_VIDEO);
 
                     GameBoy.Emulator.ScreenMode = 0;
                     mem->IO_Ports[STAT_REG - 0xFF00] &= 0xFC;
@@ -146,6 +150,7 @@ void GB_PPUUpdateClocks_GBC(int increment_clocks)
                             mem->IO_Ports[STAT_REG - 0xFF00] |= 0x01;
 
                             GB_InterruptsSetFlag(I_VBLANK);
+                            GB_DebugVBlankHook();
                         }
                         else
                         {
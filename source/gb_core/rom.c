@@ -726,53 +726,37 @@ void GB_Cardridge_Set_Filename(const char *filename)
 
 //--------------------------------------------------------------------------
 
-void GB_RTC_Save(FILE *savefile)
+// Returns the number of bytes written to the buffer (GB_RTC_SAVE_SIZE if the
+// cartridge has a timer, 0 if not).
+static size_t GB_RTC_SaveToBuffer(u8 *buffer)
 {
     if (GameBoy.Emulator.HasTimer == 0)
-        return;
+        return 0;
 
     time_t current_time = time(NULL);
 
-    int error = 0;
+    u32 data[GB_RTC_SAVE_SIZE / sizeof(u32)];
 
     // Time
 
-    if (fwrite(&GameBoy.Emulator.Timer.sec, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&GameBoy.Emulator.Timer.min, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&GameBoy.Emulator.Timer.hour, 1, 4, savefile) != 4)
-        error = 1;
-
-    u32 days_low = GameBoy.Emulator.Timer.days & 0xFF;
-    u32 days_hi = (GameBoy.Emulator.Timer.days >> 8)
-                  | (GameBoy.Emulator.Timer.halt << 6)
-                  | (GameBoy.Emulator.Timer.carry << 7);
-
-    if (fwrite(&days_low, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&days_hi, 1, 4, savefile) != 4)
-        error = 1;
+    data[0] = GameBoy.Emulator.Timer.sec;
+    data[1] = GameBoy.Emulator.Timer.min;
+    data[2] = GameBoy.Emulator.Timer.hour;
+    data[3] = GameBoy.Emulator.Timer.days & 0xFF;
+    data[4] = (GameBoy.Emulator.Timer.days >> 8)
+              | (GameBoy.Emulator.Timer.halt << 6)
+              | (GameBoy.Emulator.Timer.carry << 7);
 
     // Latched time
 
-    if (fwrite(&GameBoy.Emulator.LatchedTime.sec, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&GameBoy.Emulator.LatchedTime.min, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&GameBoy.Emulator.LatchedTime.hour, 1, 4, savefile) != 4)
-        error = 1;
-
-    days_low = GameBoy.Emulator.LatchedTime.days & 0xFF;
-    days_hi = (GameBoy.Emulator.LatchedTime.days >> 8)
+    data[5] = GameBoy.Emulator.LatchedTime.sec;
+    data[6] = GameBoy.Emulator.LatchedTime.min;
+    data[7] = GameBoy.Emulator.LatchedTime.hour;
+    data[8] = GameBoy.Emulator.LatchedTime.days & 0xFF;
+    data[9] = (GameBoy.Emulator.LatchedTime.days >> 8)
               | (GameBoy.Emulator.LatchedTime.halt << 6)
               | (GameBoy.Emulator.LatchedTime.carry << 7);
 
-    if (fwrite(&days_low, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&days_hi, 1, 4, savefile) != 4)
-        error = 1;
-
     // Timestamp
 
     u32 timestamp_low, timestamp_hi;
@@ -795,13 +779,12 @@ void GB_RTC_Save(FILE *savefile)
         timestamp_hi = (current_time >> 32);
     }
 
-    if (fwrite(&timestamp_low, 1, 4, savefile) != 4)
-        error = 1;
-    if (fwrite(&timestamp_hi, 1, 4, savefile) != 4)
-        error = 1;
+    data[10] = timestamp_low;
+    data[11] = timestamp_hi;
 
-    if (error)
-        Debug_ErrorMsgArg("Error while saving RTC data!");
+    memcpy(buffer, data, sizeof(data));
+
+    return sizeof(data);
 }
 
 void GB_RTC_Load(FILE *savefile)
@@ -909,56 +892,77 @@ void GB_RTC_Load(FILE *savefile)
 
 //--------------------------------------------------------------------------
 
-void GB_SRAM_Save(void)
+int GB_SRAM_IsDirty(void)
 {
-    if ((GameBoy.Emulator.RAM_Banks == 0) || (GameBoy.Emulator.HasBattery == 0))
-        return;
+    return GameBoy.Emulator.sram_dirty;
+}
 
-    size_t size = strlen(GameBoy.Emulator.save_filename) + 5;
-    char *name = malloc(size);
-    snprintf(name, size, "%s.sav", GameBoy.Emulator.save_filename);
+void GB_SRAM_ClearDirty(void)
+{
+    GameBoy.Emulator.sram_dirty = 0;
+}
 
-    FILE *savefile = fopen(name, "wb+");
+void GB_SRAM_GetFilename(char *path, size_t size)
+{
+    snprintf(path, size, "%s.sav", GameBoy.Emulator.save_filename);
+}
 
-    if (!savefile)
-    {
-        Debug_ErrorMsgArg("Couldn't save SRAM.");
-        free(name);
-        return;
-    }
+size_t GB_SRAM_GetData(u8 *buffer)
+{
+    if ((GameBoy.Emulator.RAM_Banks == 0) || (GameBoy.Emulator.HasBattery == 0))
+        return 0;
+
+    size_t size;
 
     if (GameBoy.Emulator.MemoryController == MEM_MBC2)
     {
         // 512 * 4 bits
-        size_t n = fwrite(GameBoy.Memory.ExternRAM[0], 1, 512, savefile);
-        if (n != 512)
-            Debug_ErrorMsgArg("Error while writing SRAM: %zu bytes written.", n);
+        memcpy(buffer, GameBoy.Memory.ExternRAM[0], 512);
+        size = 512;
     }
     //else if (((_GB_ROM_HEADER_ *)GameBoy.Emulator.Rom_Pointer)->ram_size == 1)
     //{
     //    // 2 KB
-    //    fwrite(GameBoy.Memory.ExternRAM[0], 1, 2 * 1024, savefile);
+    //    memcpy(buffer, GameBoy.Memory.ExternRAM[0], 2 * 1024);
+    //    size = 2 * 1024;
     //}
     else
     {
         // Complete banks
+        size = 0;
         for (u32 a = 0; a < GameBoy.Emulator.RAM_Banks; a++)
         {
-            size_t n = fwrite(GameBoy.Memory.ExternRAM[a], 1, 8 * 1024, savefile);
-            if (n != (8 * 1024))
-                Debug_ErrorMsgArg("Error while writing SRAM bank %u: %zu bytes written",
-                                  a, n);
+            memcpy(&buffer[size], GameBoy.Memory.ExternRAM[a], 8 * 1024);
+            size += 8 * 1024;
         }
     }
 
-    GB_RTC_Save(savefile);
+    size += GB_RTC_SaveToBuffer(&buffer[size]);
 
-    fclose(savefile);
-    free(name);
+    return size;
+}
+
+void GB_SRAM_Save(void)
+{
+    static u8 buffer[GB_SRAM_SAVE_MAX_SIZE];
+
+    size_t size = GB_SRAM_GetData(buffer);
+    if (size == 0)
+        return;
+
+    char name[MAX_PATHLEN + 4];
+    GB_SRAM_GetFilename(name, sizeof(name));
+
+    if (FileSaveAtomic(name, buffer, size) == 0)
+        Debug_ErrorMsgArg("Couldn't save SRAM.");
+
+    GameBoy.Emulator.sram_dirty = 0;
 }
 
 void GB_SRAM_Load(void)
 {
+    GameBoy.Emulator.sram_dirty = 0;
+
     if ((GameBoy.Emulator.RAM_Banks == 0) || (GameBoy.Emulator.HasBattery == 0))
         return;
 
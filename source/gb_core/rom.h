@@ -67,6 +67,21 @@ void GB_Cartridge_Unload(void);
 
 void GB_Cardridge_Set_Filename(const char *filename);
 
+// Size of the RTC data appended to the save file by MBC3 cartridges
+#define GB_RTC_SAVE_SIZE (12 * 4)
+
+#define GB_SRAM_SAVE_MAX_SIZE ((16 * 8 * 1024) + GB_RTC_SAVE_SIZE)
+
+// The dirty flag is set whenever the game writes to the cartridge RAM area
+int GB_SRAM_IsDirty(void);
+void GB_SRAM_ClearDirty(void);
+
+// Copies the data that goes to the save file to the buffer, which must be
+// GB_SRAM_SAVE_MAX_SIZE bytes long. Returns the size of the data (0 if the
+// cartridge doesn't have battery-backed RAM).
+size_t GB_SRAM_GetData(u8 *buffer);
+void GB_SRAM_GetFilename(char *path, size_t size);
+
 void GB_SRAM_Save(void);
 void GB_SRAM_Load(void);
 
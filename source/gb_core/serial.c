@@ -14,6 +14,7 @@
 #include "../debug_utils.h"
 #include "../file_utils.h"
 #include "../general_utils.h"
+#include "../link_cable.h"
 #include "../png_utils.h"
 
 #include "cpu.h"
@@ -22,6 +23,7 @@
 #include "general.h"
 #include "interrupts.h"
 #include "serial.h"
+#include "state.h"
 
 extern _GB_CONTEXT_ GameBoy;
 
@@ -48,6 +50,50 @@ static void GB_SerialSendBit(void)
     }
 }
 
+// When the other Game Boy is the master, the link cable is checked this often
+// while a transfer with external clock is active.
+#define GB_SERIAL_LINK_POLL_CLOCKS 456
+
+static int GB_SerialLinkSlaveIsWaiting(void)
+{
+    if (GameBoy.Emulator.serial_device != SERIAL_GAMEBOY)
+        return 0;
+
+    if (GameBoy.Emulator.serial_enabled == 0)
+        return 0;
+
+    return (GameBoy.Memory.IO_Ports[SC_REG - 0xFF00] & 0x01) == 0;
+}
+
+static void GB_SerialLinkSlaveUpdate(void)
+{
+    _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+    u32 value;
+    if (!LinkCable_SlaveGetReceived(&value))
+        return;
+
+    GameBoy.Emulator.serial_enabled = 0;
+
+    GB_InterruptsSetFlag(I_SERIAL);
+
+    mem->IO_Ports[SC_REG - 0xFF00] &= ~0x80;
+    mem->IO_Ports[SB_REG - 0xFF00] = value & 0xFF;
+
+    GB_CPUBreakLoop();
+}
+
+static void GB_SerialLinkSlaveSetReady(void)
+{
+    if (GameBoy.Emulator.serial_device != SERIAL_GAMEBOY)
+        return;
+
+    if (GB_SerialLinkSlaveIsWaiting())
+        LinkCable_SlaveSetReady(1, GameBoy.Memory.IO_Ports[SB_REG - 0xFF00]);
+    else
+        LinkCable_SlaveSetReady(0, 0);
+}
+
 //------------------------------------------------------------------------------
 
 static int gb_serial_clock_counter = 0;
@@ -94,6 +140,10 @@ void GB_SerialUpdateClocksCounterReference(int reference_clocks)
                     GB_SerialSendBit();
             }
         }
+        else if (GameBoy.Emulator.serial_device == SERIAL_GAMEBOY)
+        {
+            GB_SerialLinkSlaveUpdate();
+        }
     }
 
     GameBoy.Emulator.serial_clocks += increment_clocks;
@@ -114,6 +164,10 @@ int GB_SerialGetClocksToNextEvent(void)
 
             return clocks - (GameBoy.Emulator.serial_clocks & (clocks - 1));
         }
+        else if (GameBoy.Emulator.serial_device == SERIAL_GAMEBOY)
+        {
+            return GB_SERIAL_LINK_POLL_CLOCKS;
+        }
     }
 
     return 0x7FFFFFFF;
@@ -125,6 +179,7 @@ void GB_SerialWriteSB(int reference_clocks, int value)
 {
     GB_SerialUpdateClocksCounterReference(reference_clocks);
     GameBoy.Memory.IO_Ports[SB_REG - 0xFF00] = value;
+    GB_SerialLinkSlaveSetReady();
 }
 
 void GB_SerialWriteSC(int reference_clocks, int value)
@@ -181,6 +236,7 @@ void GB_SerialWriteSC(int reference_clocks, int value)
     }
 
     GameBoy.Memory.IO_Ports[SC_REG - 0xFF00] = value;
+    GB_SerialLinkSlaveSetReady();
     GB_CPUBreakLoop();
 }
 
@@ -494,6 +550,24 @@ static u32 GB_RecvPrinter(void)
     return GB_Printer.output;
 }
 
+//------------------------------------------------------------------------------
+//                                GAME BOY
+
+// The other Game Boy runs in another instance of the emulator. The master
+// blocks at the end of each transfer until the other side answers.
+
+static u32 gb_link_received = 0xFF;
+
+static void GB_SendLink(u32 data)
+{
+    gb_link_received = LinkCable_MasterExchange(data) & 0xFF;
+}
+
+static u32 GB_RecvLink(void)
+{
+    return gb_link_received;
+}
+
 //------------------------------------------------------------------------------
 
 void GB_SerialPlug(int device)
@@ -514,8 +588,11 @@ void GB_SerialPlug(int device)
             GameBoy.Emulator.SerialRecv_Fn = &GB_RecvPrinter;
             GB_PrinterReset();
             break;
-        case SERIAL_GAMEBOY: // TODO
-            //break;
+        case SERIAL_GAMEBOY:
+            GameBoy.Emulator.SerialSend_Fn = &GB_SendLink;
+            GameBoy.Emulator.SerialRecv_Fn = &GB_RecvLink;
+            LinkCable_Start();
+            break;
         default:
             GameBoy.Emulator.SerialSend_Fn = &GB_SendNone;
             GameBoy.Emulator.SerialRecv_Fn = &GB_RecvNone;
@@ -613,7 +690,11 @@ void GB_SerialEnd(void)
         GB_PrinterReset();
 
     if (GameBoy.Emulator.serial_device == SERIAL_GAMEBOY)
-    {
-        // TODO
-    }
+        LinkCable_Stop();
+}
+
+void GB_SerialStateRegister(void)
+{
+    GB_StateRegister(&gb_serial_clock_counter, sizeof(gb_serial_clock_counter));
+    GB_StateRegister(&gb_link_received, sizeof(gb_link_received));
 }
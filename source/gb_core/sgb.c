@@ -17,6 +17,7 @@
 #include "gb_main.h"
 #include "general.h"
 #include "sgb.h"
+#include "state.h"
 #include "video.h"
 
 extern _GB_CONTEXT_ GameBoy;
@@ -158,7 +159,7 @@ void SGB_Init(void)
 
     SGBInfo.freeze_screen = 0;
 
-    SGBInfo.sgb_bank0_ram = NULL; // Only allocate memory if used
+    memset(SGBInfo.sgb_bank0_ram, 0, sizeof(SGBInfo.sgb_bank0_ram));
 
     const u32 gbpalettes[4] = {
         GB_RGB(31, 31, 31), GB_RGB(21, 21, 21), GB_RGB(10, 10, 10),
@@ -203,11 +204,7 @@ void SGB_Init(void)
 
 void SGB_End(void)
 {
-    if (SGBInfo.sgb_bank0_ram)
-    {
-        free(SGBInfo.sgb_bank0_ram);
-        SGBInfo.sgb_bank0_ram = NULL;
-    }
+    // Nothing to do
 }
 
 //------------------------------------------------------------------------------
@@ -564,9 +561,6 @@ static void SGB_DATA_SND(void)
             return;
         }
 
-        if (SGBInfo.sgb_bank0_ram == NULL)
-            SGBInfo.sgb_bank0_ram = malloc(0x2000);
-
         for (u32 i = 0; i < numbytes; i++)
         {
             SGBInfo.sgb_bank0_ram[address + i] = SGBInfo.data[0][5 + i];
@@ -1034,3 +1028,9 @@ u32 SGB_ReadP1(void)
         return result;
     }
 }
+
+void GB_SGBStateRegister(void)
+{
+    GB_StateRegister(&SGBInfo, sizeof(SGBInfo));
+    GB_StateRegister(sgb_screenbuffer, sizeof(sgb_screenbuffer));
+}
@@ -68,7 +68,8 @@ typedef struct
 
     //--------------------------------------------------------------------------
 
-    u8 *sgb_bank0_ram;
+    // It's part of the struct so that it's saved in state snapshots
+    u8 sgb_bank0_ram[0x2000];
 
     //--------------------------------------------------------------------------
 
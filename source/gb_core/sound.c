@@ -18,6 +18,7 @@
 #include "gameboy.h"
 #include "general.h"
 #include "memory.h"
+#include "state.h"
 
 // Quite a big buffer, but it works fine this way.  The bigger, the less
 // possibilities to underflow, but the more delay between actions and sound
@@ -192,9 +193,6 @@ typedef struct
 
     u32 nextsample_clocks;
 
-    s16 buffer[GB_SAMPLE_RATE];
-    u32 buffer_write_ptr;
-
     // Some temporary variables to avoid doing the same calculations every time
     // a sample is going to be generated:
     int leftvol_1, rightvol_1;
@@ -207,6 +205,11 @@ typedef struct
 
 static _GB_SOUND_HARDWARE_ Sound;
 
+// The output buffer isn't part of the emulated hardware, so it's kept out of
+// "Sound" to leave it out of the state snapshots.
+static s16 sound_buffer[GB_SAMPLE_RATE];
+static u32 sound_buffer_write_ptr;
+
 static int output_enabled;
 
 int GB_SoundHardwareIsOn(void)
@@ -242,11 +245,11 @@ void GB_SoundPowerOn(void)
 
 void GB_SoundSaveToWAV(void)
 {
-    size_t available_size = Sound.buffer_write_ptr * sizeof(s16);
+    size_t available_size = sound_buffer_write_ptr * sizeof(s16);
 
     // Save all available samples to a WAV file if a recording is active
     if (WAV_FileIsOpen())
-        WAV_FileStream(Sound.buffer, available_size);
+        WAV_FileStream(sound_buffer, available_size);
 }
 
 // This function is supposed to return all the samples taken during a frame. If
@@ -254,22 +257,32 @@ void GB_SoundSaveToWAV(void)
 // anyway, to prepare it for next frame.
 size_t GB_SoundGetSamplesFrame(void *buffer, size_t buffer_size)
 {
-    size_t available_size = Sound.buffer_write_ptr * 2;
+    size_t available_size = sound_buffer_write_ptr * 2;
 
     size_t copy_size = (available_size < buffer_size) ?
                        available_size : buffer_size;
 
-    memcpy(buffer, Sound.buffer, copy_size);
+    memcpy(buffer, sound_buffer, copy_size);
 
     // Reset pointer
-    Sound.buffer_write_ptr = 0;
+    sound_buffer_write_ptr = 0;
 
     return copy_size;
 }
 
 void GB_SoundResetBufferPointers(void)
 {
-    Sound.buffer_write_ptr = 0;
+    sound_buffer_write_ptr = 0;
+}
+
+u32 GB_SoundGetBufferPointer(void)
+{
+    return sound_buffer_write_ptr;
+}
+
+void GB_SoundSetBufferPointer(u32 ptr)
+{
+    sound_buffer_write_ptr = ptr;
 }
 
 void GB_SoundInit(void)
@@ -414,8 +427,8 @@ void GB_SoundMix(void)
 
     if (Sound.master_enable == 0)
     {
-        Sound.buffer[Sound.buffer_write_ptr++] = 0;
-        Sound.buffer[Sound.buffer_write_ptr++] = 0;
+        sound_buffer[sound_buffer_write_ptr++] = 0;
+        sound_buffer[sound_buffer_write_ptr++] = 0;
         return;
     }
 #if 0
@@ -477,8 +490,8 @@ void GB_SoundMix(void)
     outvalue_left = (outvalue_left * EmulatorConfig.volume) / 128;
     outvalue_right = (outvalue_right * EmulatorConfig.volume) / 128;
 
-    Sound.buffer[Sound.buffer_write_ptr++] = outvalue_left;
-    Sound.buffer[Sound.buffer_write_ptr++] = outvalue_right;
+    sound_buffer[sound_buffer_write_ptr++] = outvalue_left;
+    sound_buffer[sound_buffer_write_ptr++] = outvalue_right;
 }
 
 void GB_SoundRegWrite(u32 address, u32 value)
@@ -1317,3 +1330,10 @@ void GB_SoundSetConfig(int vol, int chn_flags)
     EmulatorConfig.chn_flags &= 0x30;
     EmulatorConfig.chn_flags |= chn_flags;
 }
+
+void GB_SoundStateRegister(void)
+{
+    GB_StateRegister(&Sound, sizeof(Sound));
+    GB_StateRegister(GB_WavePattern, sizeof(GB_WavePattern));
+    GB_StateRegister(&gb_sound_clock_counter, sizeof(gb_sound_clock_counter));
+}
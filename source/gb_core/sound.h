@@ -19,6 +19,10 @@ void GB_SoundEnd(void);
 void GB_SoundSaveToWAV(void);
 size_t GB_SoundGetSamplesFrame(void *buffer, size_t buffer_size);
 void GB_SoundResetBufferPointers(void);
+// Used to discard the samples generated after reading the pointer. The output
+// buffer isn't included in the state snapshots.
+u32 GB_SoundGetBufferPointer(void);
+void GB_SoundSetBufferPointer(u32 ptr);
 
 void GB_SoundClockCounterReset(void);
 void GB_SoundUpdateClocksCounterReference(int reference_clocks);
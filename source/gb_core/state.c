@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <string.h>
+
+#include "../debug_utils.h"
+#include "../general_utils.h"
+
+#include "state.h"
+#include "video.h"
+
+#define GB_STATE_MAX_REGIONS 32
+
+typedef struct
+{
+    void *data;
+    size_t size;
+} _gb_state_region_t;
+
+static _gb_state_region_t gb_state_regions[GB_STATE_MAX_REGIONS];
+static int gb_state_num_regions = 0;
+static size_t gb_state_size = 0;
+
+void GB_StateRegister(void *data, size_t size)
+{
+    if (gb_state_num_regions == GB_STATE_MAX_REGIONS)
+    {
+        Debug_LogMsgArg("%s(): Too many regions", __func__);
+        return;
+    }
+
+    _gb_state_region_t *r = &gb_state_regions[gb_state_num_regions++];
+    r->data = data;
+    r->size = size;
+
+    gb_state_size += size;
+}
+
+// All the variables are static, so the list only needs to be built once
+static void _gb_state_init(void)
+{
+    if (gb_state_num_regions > 0)
+        return;
+
+    GB_CameraStateRegister();
+    GB_CPUStateRegister();
+    GB_DMAStateRegister();
+    GB_GeneralStateRegister();
+    GB_InterruptsStateRegister();
+    GB_PPUStateRegister();
+    GB_SerialStateRegister();
+    GB_SGBStateRegister();
+    GB_SoundStateRegister();
+    GB_VideoStateRegister();
+}
+
+size_t GB_StateSize(void)
+{
+    _gb_state_init();
+
+    return gb_state_size;
+}
+
+void GB_StateSave(void *buffer)
+{
+    _gb_state_init();
+
+    u8 *dst = buffer;
+
+    for (int i = 0; i < gb_state_num_regions; i++)
+    {
+        _gb_state_region_t *r = &gb_state_regions[i];
+        memcpy(dst, r->data, r->size);
+        dst += r->size;
+    }
+}
+
+void GB_StateLoad(const void *buffer)
+{
+    _gb_state_init();
+
+    const u8 *src = buffer;
+
+    for (int i = 0; i < gb_state_num_regions; i++)
+    {
+        _gb_state_region_t *r = &gb_state_regions[i];
+        memcpy(r->data, src, r->size);
+        src += r->size;
+    }
+
+    // Caches built from the state
+    GB_VideoSpriteListsInvalidate();
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GB_STATE__
+#define GB_STATE__
+
+#include <stddef.h>
+
+// Snapshots of the state of the emulated machine in memory. The variables of
+// the core are copied as they are, including pointers, so a snapshot can only
+// be loaded while the same ROM is loaded. They don't include the state of the
+// boot ROM, the cartridge ROM or the screen buffers.
+
+// Size of the buffers passed to GB_StateSave() and GB_StateLoad()
+size_t GB_StateSize(void);
+
+void GB_StateSave(void *buffer);
+void GB_StateLoad(const void *buffer);
+
+// Used by the functions below to add their variables to the snapshots
+void GB_StateRegister(void *data, size_t size);
+
+// Implemented by each module of the core that has any state
+void GB_CameraStateRegister(void);
+void GB_CPUStateRegister(void);
+void GB_DMAStateRegister(void);
+void GB_GeneralStateRegister(void);
+void GB_InterruptsStateRegister(void);
+void GB_PPUStateRegister(void);
+void GB_SerialStateRegister(void);
+void GB_SGBStateRegister(void);
+void GB_SoundStateRegister(void);
+void GB_VideoStateRegister(void);
+
+#endif // GB_STATE__
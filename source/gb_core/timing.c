@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stddef.h>
+
+#include "../general_utils.h"
+
+#include "timing.h"
+
+#ifdef ENABLE_TIMING
+
+gb_timing_begin_fn gb_timing_begin_callback = NULL;
+gb_timing_end_fn gb_timing_end_callback = NULL;
+
+void GB_TimingSetCallbacks(gb_timing_begin_fn begin, gb_timing_end_fn end)
+{
+    gb_timing_begin_callback = begin;
+    gb_timing_end_callback = end;
+}
+
+#else // ENABLE_TIMING
+
+void GB_TimingSetCallbacks(unused__ gb_timing_begin_fn begin,
+                           unused__ gb_timing_end_fn end)
+{
+}
+
+#endif // ENABLE_TIMING
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GB_TIMING__
+#define GB_TIMING__
+
+// Scopes used to measure the host time spent in each subsystem of the core.
+// The callbacks are set by the frontend while it is measuring times. The only
+// cost of a scope while they aren't set is a pointer check. If ENABLE_TIMING
+// isn't defined, the scopes are compiled out.
+
+#define GB_TIMING_CPU      0
+#define GB_TIMING_VIDEO    1
+#define GB_TIMING_DMA      2
+#define GB_TIMING_TIMERS   3
+#define GB_TIMING_SOUND    4
+
+typedef void (*gb_timing_begin_fn)(int id);
+typedef void (*gb_timing_end_fn)(void);
+void GB_TimingSetCallbacks(gb_timing_begin_fn begin, gb_timing_end_fn end);
+
+#ifdef ENABLE_TIMING
+
+extern gb_timing_begin_fn gb_timing_begin_callback;
+extern gb_timing_end_fn gb_timing_end_callback;
+
+#define GB_TIMING_BEGIN(id)                 \
+    do {                                    \
+        if (gb_timing_begin_callback)       \
+            gb_timing_begin_callback(id);   \
+    } while (0)
+
+#define GB_TIMING_END(id)                   \
+    do {                                    \
+        if (gb_timing_end_callback)         \
+            gb_timing_end_callback();       \
+    } while (0)
+
+#else
+
+#define GB_TIMING_BEGIN(id) do { } while (0)
+#define GB_TIMING_END(id)   do { } while (0)
+
+#endif
+
+#endif // GB_TIMING__
@@ -10,8 +10,8 @@
 #include <string.h>
 
 #include "../build_options.h"
+#include "../capture.h"
 #include "../file_utils.h"
-#include "../png_utils.h"
 
 #include "debug.h"
 #include "gameboy.h"
@@ -19,6 +19,7 @@
 #include "memory.h"
 #include "sgb.h"
 #include "sound.h"
+#include "state.h"
 #include "video.h"
 
 extern _GB_CONTEXT_ GameBoy;
@@ -46,6 +47,57 @@ int GB_HasToSkipFrame(void)
 
 //-----------------------------------------------------------
 
+// First 10 sprites of the OAM that are displayed in each scanline. They only
+// depend on the Y coordinate of the sprites and their height, so they are only
+// built again after they change.
+static u8 gb_spr_line_list[144][10];
+static u8 gb_spr_line_count[144];
+static s32 gb_spr_lists_height = 0; // 0 if the lists have to be built
+
+void GB_VideoSpriteListsInvalidate(void)
+{
+    gb_spr_lists_height = 0;
+}
+
+static void gb_sprites_build_lists(s32 spriteheight)
+{
+    _GB_OAM_ *GB_OAM = (void *)GameBoy.Memory.ObjAttrMem;
+
+    memset(gb_spr_line_count, 0, sizeof(gb_spr_line_count));
+
+    for (int a = 0; a < 40; a++)
+    {
+        s32 real_y = GB_OAM->Sprite[a].Y - 16;
+
+        s32 start = (real_y < 0) ? 0 : real_y;
+        s32 end = real_y + spriteheight;
+        if (end > 144)
+            end = 144;
+
+        for (s32 ly = start; ly < end; ly++)
+        {
+            if (gb_spr_line_count[ly] < 10)
+                gb_spr_line_list[ly][gb_spr_line_count[ly]++] = a;
+        }
+    }
+
+    gb_spr_lists_height = spriteheight;
+}
+
+static int gb_sprites_get_line(u32 y, s32 spriteheight, const u8 **list)
+{
+    if (y >= 144)
+        return 0;
+
+    if (gb_spr_lists_height != spriteheight)
+        gb_sprites_build_lists(spriteheight);
+
+    *list = gb_spr_line_list[y];
+    return gb_spr_line_count[y];
+}
+
+//-----------------------------------------------------------
+
 void GB_EnableBlur(int enable)
 {
     gb_blur = enable;
@@ -277,96 +329,75 @@ void GB_ScreenDrawScanline(u32 y)
             // For 8x16 sprites, last bit is ignored
             u32 tilemask = ((spriteheight == 16) ? 0xFE : 0xFF);
 
-            u32 spritesdrawn = 0; // For the 10-sprites-per-scanline limit
-            u32 drawsprite[40];
+            const u8 *list;
+            int count = gb_sprites_get_line(y, spriteheight, &list);
 
-            for (int a = 0; a < 40; a++)
+            // Sprites with lower OAM indices are drawn on top of the others
+            for (int n = count - 1; n >= 0; n--)
             {
-                GB_Sprite = &GB_OAM->Sprite[a];
+                // TODO: Fix.
+                // When sprites with different x coordinate values overlap, the
+                // one with the smaller x coordinate (closer to the left) will
+                // have priority and appear above any others. This applies in
+                // Non CGB Mode only.
 
-                drawsprite[a] = 0;
+                GB_Sprite = &GB_OAM->Sprite[list[n]];
 
                 u32 spr_y = GB_Sprite->Y;
                 u32 off_y = y + 16;
 
                 if ((spr_y <= off_y) && ((spr_y + spriteheight) > off_y))
                 {
-                    if (spritesdrawn < 10)
-                    {
-                        drawsprite[a] = 1;
-                        spritesdrawn++;
-                    }
-                }
-            }
-
-            for (int a = 39; a >= 0; a--)
-            {
-                // TODO: Fix.
-                // When sprites with different x coordinate values overlap, the
-                // one with the smaller x coordinate (closer to the left) will
-                // have priority and appear above any others. This applies in
-                // Non CGB Mode only.
+                    u32 tile = GB_Sprite->Tile & tilemask;
 
-                if (drawsprite[a])
-                {
-                    GB_Sprite = &GB_OAM->Sprite[a];
+                    u8 *data = &mem->VideoRAM[tile << 4];
 
-                    u32 spr_y = GB_Sprite->Y;
-                    u32 off_y = y + 16;
+                    // Flip Y
+                    s32 real_y = GB_Sprite->Y - 16;
+                    if (GB_Sprite->Info & (1 << 6))
+                        data += (spriteheight - y + real_y - 1) * 2;
+                    else
+                        data += (y - real_y) * 2;
 
-                    if ((spr_y <= off_y) && ((spr_y + spriteheight) > off_y))
+                    // Lets draw the sprite...
+                    s32 real_x = GB_Sprite->X - 8;
+                    for (int x__ = 0; x__ < 8; x__++)
                     {
-                        u32 tile = GB_Sprite->Tile & tilemask;
-
-                        u8 *data = &mem->VideoRAM[tile << 4];
-
-                        // Flip Y
-                        s32 real_y = GB_Sprite->Y - 16;
-                        if (GB_Sprite->Info & (1 << 6))
-                            data += (spriteheight - y + real_y - 1) * 2;
-                        else
-                            data += (y - real_y) * 2;
+                        u32 color = ((*data >> x__) & 1)
+                                    | ((((*(data + 1)) >> x__) << 1) & 2);
 
-                        // Lets draw the sprite...
-                        s32 real_x = GB_Sprite->X - 8;
-                        for (int x__ = 0; x__ < 8; x__++)
+                        if (color != 0) // Color 0 is transparent
                         {
-                            u32 color = ((*data >> x__) & 1)
-                                        | ((((*(data + 1)) >> x__) << 1) & 2);
-
-                            if (color != 0) // Color 0 is transparent
-                            {
-                                if (GB_Sprite->Info & (1 << 4))
-                                    color = spr_pal1[color];
-                                else
-                                    color = spr_pal0[color];
+                            if (GB_Sprite->Info & (1 << 4))
+                                color = spr_pal1[color];
+                            else
+                                color = spr_pal0[color];
 
-                                s32 x_ = real_x;
+                            s32 x_ = real_x;
 
-                                // Flip X
-                                if (GB_Sprite->Info & (1 << 5))
-                                    x_ = x_ + x__;
-                                else
-                                    x_ += 7 - x__;
+                            // Flip X
+                            if (GB_Sprite->Info & (1 << 5))
+                                x_ = x_ + x__;
+                            else
+                                x_ += 7 - x__;
 
-                                if (x_ >= 0 && x_ < 160)
+                            if (x_ >= 0 && x_ < 160)
+                            {
+                                // If BG has priority and it is enabled...
+                                if ((GB_Sprite->Info & (1 << 7))
+                                    && (lcd_reg & (1 << 0)))
                                 {
-                                    // If BG has priority and it is enabled...
-                                    if ((GB_Sprite->Info & (1 << 7))
-                                        && (lcd_reg & (1 << 0)))
-                                    {
-                                        if (gb_framebuffer_bgcolor0[x_])
-                                        {
-                                            gb_framebuffer[gb_cur_fb]
-                                                          [base_index + x_] = color;
-                                        }
-                                    }
-                                    else
+                                    if (gb_framebuffer_bgcolor0[x_])
                                     {
                                         gb_framebuffer[gb_cur_fb]
                                                       [base_index + x_] = color;
                                     }
                                 }
+                                else
+                                {
+                                    gb_framebuffer[gb_cur_fb]
+                                                  [base_index + x_] = color;
+                                }
                             }
                         }
                     }
@@ -590,34 +621,13 @@ void GBC_ScreenDrawScanline(u32 y)
             // For 8x16 sprites, last bit is ignored
             u32 tilemask = ((spriteheight == 16) ? 0xFE : 0xFF);
 
-            u32 spritesdrawn = 0; // For the 10-sprites-per-scanline limit
-            u32 drawsprite[40];
+            const u8 *list;
+            int count = gb_sprites_get_line(y, spriteheight, &list);
 
-            for (int a = 0; a < 40; a++)
+            // Sprites with lower OAM indices are drawn on top of the others
+            for (int n = count - 1; n >= 0; n--)
             {
-                GB_Sprite = &GB_OAM->Sprite[a];
-
-                drawsprite[a] = 0;
-
-                u32 spr_y = GB_Sprite->Y;
-                u32 off_y = y + 16;
-
-                if ((spr_y <= off_y) && ((spr_y + spriteheight) > off_y))
-                {
-                    if (spritesdrawn < 10)
-                    {
-                        drawsprite[a] = 1;
-                        spritesdrawn++;
-                    }
-                }
-            }
-
-            for (int a = 39; a >= 0; a--)
-            {
-                if (!drawsprite[a])
-                    continue;
-
-                GB_Sprite = &GB_OAM->Sprite[a];
+                GB_Sprite = &GB_OAM->Sprite[list[n]];
 
                 u32 spr_y = GB_Sprite->Y;
                 u32 off_y = y + 16;
@@ -895,29 +905,11 @@ void GBC_GB_ScreenDrawScanline(u32 y)
             // For 8x16 sprites, last bit is ignored
             u32 tilemask = ((spriteheight == 16) ? 0xFE : 0xFF);
 
-            u32 spritesdrawn = 0; // For the 10-sprites-per-scanline limit
-            u32 drawsprite[40];
-
-            for (int a = 0; a < 40; a++)
-            {
-                GB_Sprite = &GB_OAM->Sprite[a];
-
-                drawsprite[a] = 0;
-
-                u32 spr_y = GB_Sprite->Y;
-                u32 off_y = y + 16;
-
-                if ((spr_y <= off_y) && ((spr_y + spriteheight) > off_y))
-                {
-                    if (spritesdrawn < 10)
-                    {
-                        drawsprite[a] = 1;
-                        spritesdrawn++;
-                    }
-                }
-            }
+            const u8 *list;
+            int count = gb_sprites_get_line(y, spriteheight, &list);
 
-            for (int a = 39; a >= 0; a--)
+            // Sprites with lower OAM indices are drawn on top of the others
+            for (int n = count - 1; n >= 0; n--)
             {
                 // TODO: Fix.
                 // When sprites with different x coordinate values overlap, the
@@ -925,10 +917,7 @@ void GBC_GB_ScreenDrawScanline(u32 y)
                 // have priority and appear above any others. This applies in
                 // Non CGB Mode only.
 
-                if (!drawsprite[a])
-                    continue;
-
-                GB_Sprite = &GB_OAM->Sprite[a];
+                GB_Sprite = &GB_OAM->Sprite[list[n]];
 
                 u32 spr_y = GB_Sprite->Y;
                 u32 off_y = y + 16;
@@ -1352,29 +1341,11 @@ void SGB_ScreenDrawScanline(u32 y)
             // For 8x16 sprites, last bit is ignored
             u32 tilemask = ((spriteheight == 16) ? 0xFE : 0xFF);
 
-            u32 spritesdrawn = 0; // For the 10-sprites-per-scanline limit
-            u32 drawsprite[40];
-
-            for (int a = 0; a < 40; a++)
-            {
-                GB_Sprite = &GB_OAM->Sprite[a];
-
-                drawsprite[a] = 0;
-
-                u32 spr_y = GB_Sprite->Y;
-                u32 off_y = y + 16;
-
-                if ((spr_y <= off_y) && ((spr_y + spriteheight) > off_y))
-                {
-                    if (spritesdrawn < 10)
-                    {
-                        drawsprite[a] = 1;
-                        spritesdrawn++;
-                    }
-                }
-            }
+            const u8 *list;
+            int count = gb_sprites_get_line(y, spriteheight, &list);
 
-            for (int a = 39; a >= 0; a--)
+            // Sprites with lower OAM indices are drawn on top of the others
+            for (int n = count - 1; n >= 0; n--)
             {
                 // TODO: Fix.
                 // When sprites with different x coordinate values overlap, the
@@ -1382,10 +1353,7 @@ void SGB_ScreenDrawScanline(u32 y)
                 // have priority and appear above any others. This applies in
                 // Non CGB Mode only.
 
-                if (!drawsprite[a])
-                    continue;
-
-                GB_Sprite = &GB_OAM->Sprite[a];
+                GB_Sprite = &GB_OAM->Sprite[list[n]];
 
                 u32 spr_y = GB_Sprite->Y;
                 u32 off_y = y + 16;
@@ -1474,222 +1442,190 @@ void SGB_ScreenDrawScanline(u32 y)
 // -------------------------------------------------------------
 // -------------------------------------------------------------
 
-int GB_Screen_Init(void)
-{
-    memset(gb_framebuffer, 0, sizeof(gb_framebuffer));
-    return 0;
-}
+// Lookup tables that convert a BGR555 color to 24 bit RGB. The DMG palette is
+// applied when the scanlines are drawn, so it doesn't need a table here.
+#define GB_SCR_LUT_PLAIN        0
+#define GB_SCR_LUT_REALCOLORS   1
+#define GB_SCR_LUT_NUM          2
 
-static void GB_Screen_WritePixel(unsigned char *buffer, int x, int y,
-                                 int r, int g, int b)
-{
-    u8 *p = (u8 *)buffer + (y * 160 + x) * 3;
-    *p++ = r;
-    *p++ = g;
-    *p = b;
-}
+static u8 gb_scr_lut[GB_SCR_LUT_NUM][32768][3];
+static int gb_scr_lut_ready = 0;
 
-static void GB_Screen_WritePixelSGB(unsigned char *buffer, int x, int y,
-                                    int r, int g, int b)
-{
-    u8 *p = (u8 *)buffer + (y * (160 + 96) + x) * 3;
-    *p++ = r;
-    *p++ = g;
-    *p = b;
-}
+// Real colors:
+// R = ((r * 13 + g * 2 + b) >> 1)
+// G = ((g * 3 + b) << 1)
+// B = ((r * 3 + g * 2 + b * 11) >> 1)
 
-static void gb_scr_writebuffer_sgb(unsigned char *buffer)
+static void gb_scr_lut_init(void)
 {
-    int last_fb = gb_cur_fb ^ 1;
-    for (int i = 0; i < 256; i++)
+    for (int data = 0; data < 32768; data++)
     {
-        for (int j = 0; j < 224; j++)
-        {
-            int data = gb_framebuffer[last_fb][j * 256 + i];
-            int r = data & 0x1F;
-            int g = (data >> 5) & 0x1F;
-            int b = (data >> 10) & 0x1F;
-            GB_Screen_WritePixelSGB(buffer, i, j, r << 3, g << 3, b << 3);
-        }
+        int r = data & 0x1F;
+        int g = (data >> 5) & 0x1F;
+        int b = (data >> 10) & 0x1F;
+
+        u8 *p = gb_scr_lut[GB_SCR_LUT_PLAIN][data];
+        p[0] = r << 3;
+        p[1] = g << 3;
+        p[2] = b << 3;
+
+        p = gb_scr_lut[GB_SCR_LUT_REALCOLORS][data];
+        p[0] = (r * 13 + g * 2 + b) >> 1;
+        p[1] = (g * 3 + b) << 1;
+        p[2] = (r * 3 + g * 2 + b * 11) >> 1;
     }
+
+    gb_scr_lut_ready = 1;
 }
 
-static void gb_scr_writebuffer_dmg_cgb(unsigned char *buffer)
+int GB_Screen_Init(void)
 {
-    int last_fb = gb_cur_fb ^ 1;
-    for (int i = 0; i < 160; i++)
-    {
-        for (int j = 0; j < 144; j++)
-        {
-            int data = gb_framebuffer[last_fb][j * 256 + i];
-            int r = data & 0x1F;
-            int g = (data >> 5) & 0x1F;
-            int b = (data >> 10) & 0x1F;
-            GB_Screen_WritePixel(buffer, i, j, r << 3, g << 3, b << 3);
-        }
-    }
+    memset(gb_framebuffer, 0, sizeof(gb_framebuffer));
+
+    if (!gb_scr_lut_ready)
+        gb_scr_lut_init();
+
+    return 0;
 }
 
-static void gb_scr_writebuffer_dmg_cgb_blur(unsigned char *buffer)
+// Converts the last complete frame, row by row. The width must be even.
+static void gb_scr_writebuffer(u8 *dst, int w, int h, const u8 *lut)
 {
-    for (int i = 0; i < 160; i++)
+    int last_fb = gb_cur_fb ^ 1;
+
+    for (int j = 0; j < h; j++)
     {
-        for (int j = 0; j < 144; j++)
+        const u16 *src = &gb_framebuffer[last_fb][j * 256];
+
+        for (int i = 0; i < w; i++)
         {
-            int data1 = gb_framebuffer[0][j * 256 + i];
-            int r1 = data1 & 0x1F;
-            int g1 = (data1 >> 5) & 0x1F;
-            int b1 = (data1 >> 10) & 0x1F;
-
-            int data2 = gb_framebuffer[1][j * 256 + i];
-            int r2 = data2 & 0x1F;
-            int g2 = (data2 >> 5) & 0x1F;
-            int b2 = (data2 >> 10) & 0x1F;
-            int r = (r1 + r2) << 2;
-            int g = (g1 + g2) << 2;
-            int b = (b1 + b2) << 2;
-            GB_Screen_WritePixel(buffer, i, j, r, g, b);
+            const u8 *c = &lut[(src[i] & 0x7FFF) * 3];
+            *dst++ = c[0];
+            *dst++ = c[1];
+            *dst++ = c[2];
         }
     }
 }
 
-// Real colors:
-// R = ((r * 13 + g * 2 + b) >> 1)
-// G = ((g * 3 + b) << 1)
-// B = ((r * 3 + g * 2 + b * 11) >> 1)
-
-static void gb_scr_writebuffer_dmg_cgb_realcolors(unsigned char *buffer)
+// Averages both framebuffers after converting them to RGB. The components of
+// the plain table are multiples of 8, so nothing is lost when averaging them.
+static void gb_scr_writebuffer_blur(u8 *dst, int w, int h, const u8 *lut)
 {
-    int last_fb = gb_cur_fb ^ 1;
-    for (int i = 0; i < 160; i++)
+    for (int j = 0; j < h; j++)
     {
-        for (int j = 0; j < 144; j++)
+        const u16 *src0 = &gb_framebuffer[0][j * 256];
+        const u16 *src1 = &gb_framebuffer[1][j * 256];
+
+        for (int i = 0; i < w; i++)
         {
-            int data = gb_framebuffer[last_fb][j * 256 + i];
-            int r = data & 0x1F;
-            int g = (data >> 5) & 0x1F;
-            int b = (data >> 10) & 0x1F;
-
-            int _r = ((r * 13 + g * 2 + b) >> 1);
-            int _g = (g * 3 + b) << 1;
-            int _b = ((r * 3 + g * 2 + b * 11) >> 1);
-            GB_Screen_WritePixel(buffer, i, j, _r, _g, _b);
+            const u8 *c0 = &lut[(src0[i] & 0x7FFF) * 3];
+            const u8 *c1 = &lut[(src1[i] & 0x7FFF) * 3];
+            *dst++ = (c0[0] + c1[0]) >> 1;
+            *dst++ = (c0[1] + c1[1]) >> 1;
+            *dst++ = (c0[2] + c1[2]) >> 1;
         }
     }
 }
 
-static void gb_scr_writebuffer_dmg_cgb_blur_realcolors(unsigned char *buffer)
+// Averages both framebuffers before converting them to RGB, as the real colors
+// formula is applied to the averaged color. Two pixels are averaged at the same
+// time, each 5 bit component is rounded down.
+static void gb_scr_writebuffer_blur_realcolors(u8 *dst, int w, int h,
+                                               const u8 *lut)
 {
-    for (int i = 0; i < 160; i++)
+    for (int j = 0; j < h; j++)
     {
-        for (int j = 0; j < 144; j++)
+        const u16 *src0 = &gb_framebuffer[0][j * 256];
+        const u16 *src1 = &gb_framebuffer[1][j * 256];
+
+        for (int i = 0; i < w; i += 2)
         {
-            int data1 = gb_framebuffer[0][j * 256 + i];
-            int r1 = data1 & 0x1F;
-            int g1 = (data1 >> 5) & 0x1F;
-            int b1 = (data1 >> 10) & 0x1F;
-            int data2 = gb_framebuffer[1][j * 256 + i];
-            int r2 = data2 & 0x1F;
-            int g2 = (data2 >> 5) & 0x1F;
-            int b2 = (data2 >> 10) & 0x1F;
-            int r = (r1 + r2) >> 1;
-            int g = (g1 + g2) >> 1;
-            int b = (b1 + b2) >> 1;
-            int _r = ((r * 13 + g * 2 + b) >> 1);
-            int _g = (g * 3 + b) << 1;
-            int _b = ((r * 3 + g * 2 + b * 11) >> 1);
-            GB_Screen_WritePixel(buffer, i, j, _r, _g, _b);
+            u32 a, b;
+            memcpy(&a, &src0[i], sizeof(a));
+            memcpy(&b, &src1[i], sizeof(b));
+
+            u32 avg = (a & b) + (((a ^ b) & 0x7BDE7BDE) >> 1);
+
+            u16 pair[2];
+            memcpy(pair, &avg, sizeof(pair));
+
+            const u8 *c = &lut[(pair[0] & 0x7FFF) * 3];
+            *dst++ = c[0];
+            *dst++ = c[1];
+            *dst++ = c[2];
+
+            c = &lut[(pair[1] & 0x7FFF) * 3];
+            *dst++ = c[0];
+            *dst++ = c[1];
+            *dst++ = c[2];
         }
     }
 }
 
-typedef void (*draw_to_buf_fn)(unsigned char *);
+// Used to shift the screen when rumble is active
+static u8 gb_scr_rumble_buffer[256 * 224 * 3];
 
 void GB_Screen_WriteBuffer_24RGB(unsigned char *buffer)
 {
-    draw_to_buf_fn draw_fn = NULL;
+    int w, h;
+    int blur = 0;
+    int lut_index = GB_SCR_LUT_PLAIN;
 
     if ((GameBoy.Emulator.HardwareType == HW_SGB)
         || (GameBoy.Emulator.HardwareType == HW_SGB2))
     {
-        draw_fn = &gb_scr_writebuffer_sgb;
-    }
-    else if ((GameBoy.Emulator.HardwareType == HW_GBA)
-             || (GameBoy.Emulator.HardwareType == HW_GBA_SP))
-    {
-        if (gb_blur)
-            draw_fn = &gb_scr_writebuffer_dmg_cgb_blur;
-        else
-            draw_fn = &gb_scr_writebuffer_dmg_cgb;
+        w = 256;
+        h = 224;
     }
     else
     {
-        if (gb_blur)
-        {
-            if (gb_realcolors)
-                draw_fn = &gb_scr_writebuffer_dmg_cgb_blur_realcolors;
-            else
-                draw_fn = &gb_scr_writebuffer_dmg_cgb_blur;
-        }
-        else
+        w = 160;
+        h = 144;
+
+        blur = gb_blur;
+
+        // The GBA screen doesn't need color correction
+        if ((GameBoy.Emulator.HardwareType != HW_GBA)
+            && (GameBoy.Emulator.HardwareType != HW_GBA_SP))
         {
             if (gb_realcolors)
-                draw_fn = &gb_scr_writebuffer_dmg_cgb_realcolors;
-            else
-                draw_fn = &gb_scr_writebuffer_dmg_cgb;
+                lut_index = GB_SCR_LUT_REALCOLORS;
         }
     }
 
+    if (!gb_scr_lut_ready)
+        gb_scr_lut_init();
+
+    const u8 *lut = &gb_scr_lut[lut_index][0][0];
+
+    u8 *dst = GameBoy.Emulator.rumble ? gb_scr_rumble_buffer : buffer;
+
+    if (blur && (lut_index == GB_SCR_LUT_REALCOLORS))
+        gb_scr_writebuffer_blur_realcolors(dst, w, h, lut);
+    else if (blur)
+        gb_scr_writebuffer_blur(dst, w, h, lut);
+    else
+        gb_scr_writebuffer(dst, w, h, lut);
+
     if (GameBoy.Emulator.rumble)
     {
         int rand_ = rand();
         int mov_x = (rand_ % 3) - 1;
         int mov_y = ((rand_ >> 8) % 3) - 1;
 
-        int w, h;
-
-        if ((GameBoy.Emulator.HardwareType == HW_SGB)
-            || (GameBoy.Emulator.HardwareType == HW_SGB2))
-        {
-            w = 256;
-            h = 224;
-        }
-        else
-        {
-            w = 160;
-            h = 144;
-        }
-
-        unsigned char *buf = malloc(w * h * 3);
-        if (buf == NULL)
-            return;
-        draw_fn(buf);
-
         for (int j = 0; j < h; j++)
         {
-            for (int i = 0; i < w; i++)
-            {
-                int y_dst = j + mov_y;
-                if ((y_dst >= 0) && (y_dst < h))
-                {
-                    int x_dst = i + mov_x;
+            int y_dst = j + mov_y;
+            if ((y_dst < 0) || (y_dst >= h))
+                continue;
 
-                    if ((x_dst >= 0) && (x_dst < w))
-                    {
-                        int dst = (y_dst * w + x_dst) * 3;
-                        buffer[dst + 0] = buf[(j * w + i) * 3 + 0];
-                        buffer[dst + 1] = buf[(j * w + i) * 3 + 1];
-                        buffer[dst + 2] = buf[(j * w + i) * 3 + 2];
-                    }
-                }
-            }
-        }
+            int x_src = (mov_x < 0) ? -mov_x : 0;
+            int x_dst = (mov_x > 0) ? mov_x : 0;
+            int count = w - ((mov_x != 0) ? 1 : 0);
 
-        free(buf);
-    }
-    else
-    {
-        draw_fn(buffer);
+            memcpy(&buffer[(y_dst * w + x_dst) * 3],
+                   &gb_scr_rumble_buffer[(j * w + x_src) * 3], count * 3);
+        }
     }
 }
 
@@ -1699,38 +1635,54 @@ void GB_Screen_WriteBuffer_24RGB(unsigned char *buffer)
 // -------------------------------------------------------------
 // -------------------------------------------------------------
 
-void GB_Screenshot(void)
+void GB_ConvertScreenBufferTo24RGB(unsigned char *buffer,
+                                   int *width, int *height)
 {
-    char *name = FU_GetNewTimestampFilename("gb_screenshot");
-
-    int width, height;
+    int w, h;
 
     if (GameBoy.Emulator.SGBEnabled)
     {
-        width = 256;
-        height = 224;
+        w = 256;
+        h = 224;
     }
     else
     {
-        width = 160;
-        height = 144;
+        w = 160;
+        h = 144;
     }
 
-    unsigned char *buf_temp = calloc(width * height * 3, 1);
     int last_fb = gb_cur_fb ^ 1;
 
-    for (int y = 0; y < height; y++)
+    for (int y = 0; y < h; y++)
     {
-        for (int x = 0; x < width; x++)
+        for (int x = 0; x < w; x++)
         {
             u32 data = gb_framebuffer[last_fb][y * 256 + x];
 
-            int index = (y * width + x) * 3;
-            buf_temp[index + 0] = (data & 0x1F) << 3;
-            buf_temp[index + 1] = ((data >> 5) & 0x1F) << 3;
-            buf_temp[index + 2] = ((data >> 10) & 0x1F) << 3;
+            int index = (y * w + x) * 3;
+            buffer[index + 0] = (data & 0x1F) << 3;
+            buffer[index + 1] = ((data >> 5) & 0x1F) << 3;
+            buffer[index + 2] = ((data >> 10) & 0x1F) << 3;
         }
     }
-    Save_PNG(name, buf_temp, width, height, 0);
-    free(buf_temp);
+
+    *width = w;
+    *height = h;
+}
+
+void GB_Screenshot(void)
+{
+    // The PNG file is encoded by the capture threads
+    unsigned char *buffer = Capture_ScreenshotBegin();
+
+    int width, height;
+    GB_ConvertScreenBufferTo24RGB(buffer, &width, &height);
+
+    char *name = FU_GetNewTimestampFilename("gb_screenshot");
+    Capture_ScreenshotEnd(buffer, name, width, height);
+}
+
+void GB_VideoStateRegister(void)
+{
+    GB_StateRegister(&window_current_line, sizeof(window_current_line));
 }
@@ -28,6 +28,9 @@ u32 GB_GameBoyGetGray(u32 number);
 u32 gbc_getbgpalcolor(int pal, int color);
 u32 gbc_getsprpalcolor(int pal, int color);
 
+// Must be called when the Y coordinate of any sprite is modified
+void GB_VideoSpriteListsInvalidate(void);
+
 void GB_ScreenDrawScanline(u32 y);
 void GBC_ScreenDrawScanline(u32 y);
 void GBC_GB_ScreenDrawScanline(u32 y); // GBC when switched to GB mode.
@@ -39,6 +42,10 @@ void SGB_ScreenDrawScanline(u32 y);
 
 // Write to buffer in 24 bit format
 void GB_Screen_WriteBuffer_24RGB(unsigned char *buffer);
+// Converts the last frame to RGB24 without any of the screen effects. The
+// buffer must have space for 256x224 pixels.
+void GB_ConvertScreenBufferTo24RGB(unsigned char *buffer,
+                                   int *width, int *height);
 void GB_Screenshot(void);
 
 #endif // GB_VIDEO__
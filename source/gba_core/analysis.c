@@ -0,0 +1,604 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../debug_utils.h"
+
+#include "analysis.h"
+#include "gba.h"
+
+#define GBA_ANALYSIS_ROM_BASE   0x08000000
+
+typedef struct {
+    u32 from;
+    u32 to;
+} gba_analysis_xref;
+
+static const u8 *analysis_rom = NULL;
+static u32 analysis_rom_size;
+
+// One entry per halfword of the ROM
+static u8 *analysis_flags = NULL;
+
+// Blocks of code waiting to be analysed. Bit 0 is set for THUMB code.
+static u32 *analysis_queue = NULL;
+static u32 analysis_queue_count, analysis_queue_max;
+
+// Sorted by destination once the analysis is finished
+static gba_analysis_xref *analysis_xrefs = NULL;
+static u32 analysis_xrefs_count, analysis_xrefs_max;
+static int analysis_xrefs_sorted;
+
+static u32 analysis_instructions;
+
+static int _gba_analysis_get_offset(u32 address, u32 *offset)
+{
+    if ((address < 0x08000000) || (address >= 0x0E000000))
+        return 0;
+
+    // The ROM is mirrored in the 3 wait state areas
+    u32 off = address & 0x01FFFFFF;
+    if (off >= analysis_rom_size)
+        return 0;
+
+    *offset = off;
+    return 1;
+}
+
+static void *_gba_analysis_grow(void *array, u32 *max, size_t element_size)
+{
+    u32 new_max = (*max == 0) ? 1024 : (*max * 2);
+
+    void *new_array = realloc(array, new_max * element_size);
+    if (new_array == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return NULL;
+    }
+
+    *max = new_max;
+    return new_array;
+}
+
+static void _gba_analysis_add_xref(u32 from, u32 to)
+{
+    if (analysis_xrefs_count == analysis_xrefs_max)
+    {
+        gba_analysis_xref *array =
+                _gba_analysis_grow(analysis_xrefs, &analysis_xrefs_max,
+                                   sizeof(gba_analysis_xref));
+        if (array == NULL)
+            return;
+        analysis_xrefs = array;
+    }
+
+    analysis_xrefs[analysis_xrefs_count].from = from;
+    analysis_xrefs[analysis_xrefs_count].to = to;
+    analysis_xrefs_count++;
+
+    analysis_xrefs_sorted = 0;
+}
+
+// The flag is added to the destination even if it has already been analysed
+static void _gba_analysis_queue(u32 address, int thumb, u32 from, u8 flag)
+{
+    u32 offset;
+
+    address &= thumb ? ~1 : ~3;
+
+    if (_gba_analysis_get_offset(address, &offset) == 0)
+        return;
+
+    u8 *flags = &analysis_flags[offset >> 1];
+
+    *flags |= flag;
+
+    if (from != 0)
+        _gba_analysis_add_xref(from, GBA_ANALYSIS_ROM_BASE + offset);
+
+    if (*flags & (thumb ? GBA_ANALYSIS_THUMB : GBA_ANALYSIS_ARM))
+        return;
+
+    if (analysis_queue_count == analysis_queue_max)
+    {
+        u32 *array = _gba_analysis_grow(analysis_queue, &analysis_queue_max,
+                                        sizeof(u32));
+        if (array == NULL)
+            return;
+        analysis_queue = array;
+    }
+
+    analysis_queue[analysis_queue_count++] = offset | (thumb ? 1 : 0);
+}
+
+// Reads a word loaded by a PC-relative load and marks it as data
+static int _gba_analysis_read_literal(u32 address, u32 *value)
+{
+    u32 offset;
+
+    if (_gba_analysis_get_offset(address, &offset) == 0)
+        return 0;
+
+    if ((offset & 3) || (offset + 4 > analysis_rom_size))
+        return 0;
+
+    analysis_flags[offset >> 1] |= GBA_ANALYSIS_DATA;
+    analysis_flags[(offset >> 1) + 1] |= GBA_ANALYSIS_DATA;
+
+    *value = *(const u32 *)&analysis_rom[offset];
+    return 1;
+}
+
+// Returns the number of instructions decoded. The code is followed until the
+// end of the block or until the limit of instructions is reached. In that
+// case, the rest of the block is queued again.
+static int _gba_analysis_arm(u32 offset, int max_instructions)
+{
+    // Registers with a known value, used to follow "ldr rN,=addr ; bx rN"
+    u32 regs[16];
+    u32 known = 0;
+    int call = 0; // Set after "mov lr,pc"
+    int count = 0;
+
+    while (offset + 4 <= analysis_rom_size)
+    {
+        u8 *flags = &analysis_flags[offset >> 1];
+
+        if (*flags & GBA_ANALYSIS_ARM)
+            break;
+
+        if (count == max_instructions)
+        {
+            _gba_analysis_queue(GBA_ANALYSIS_ROM_BASE + offset, 0, 0, 0);
+            break;
+        }
+
+        u32 opcode = *(const u32 *)&analysis_rom[offset];
+        u32 cond = opcode >> 28;
+
+        if (cond == 0xF) // Invalid in ARMv4
+            break;
+
+        *flags |= GBA_ANALYSIS_ARM;
+        count++;
+
+        u32 address = GBA_ANALYSIS_ROM_BASE + offset;
+        u32 pc = address + 8;
+        int always = (cond == 0xE);
+        int rd = (opcode >> 12) & 0xF;
+        int end = 0;
+        int was_call = call;
+
+        call = 0;
+
+        if ((opcode & 0x0E000000) == 0x0A000000) // B, BL
+        {
+            u32 target = pc + ((s32)(opcode << 8) >> 6);
+
+            if (opcode & BIT(24))
+            {
+                _gba_analysis_queue(target, 0, address, GBA_ANALYSIS_FUNCTION);
+            }
+            else
+            {
+                _gba_analysis_queue(target, 0, address, GBA_ANALYSIS_LABEL);
+                end = always;
+            }
+            known = 0;
+        }
+        else if ((opcode & 0x0FFFFFF0) == 0x012FFF10) // BX
+        {
+            int rm = opcode & 0xF;
+
+            if (known & BIT(rm))
+            {
+                _gba_analysis_queue(regs[rm], regs[rm] & 1, address,
+                                    was_call ? GBA_ANALYSIS_FUNCTION :
+                                    GBA_ANALYSIS_LABEL);
+            }
+            end = always && !was_call;
+            known = 0;
+        }
+        else if ((opcode & 0x0F7F0000) == 0x051F0000) // LDR rd,[pc,#imm]
+        {
+            u32 imm = opcode & 0xFFF;
+            u32 value;
+
+            if (_gba_analysis_read_literal((opcode & BIT(23)) ?
+                                           pc + imm : pc - imm, &value))
+            {
+                regs[rd] = value;
+                known |= BIT(rd);
+
+                if (rd == 15) // ldr pc,=addr
+                {
+                    _gba_analysis_queue(value, 0, address,
+                                        GBA_ANALYSIS_LABEL);
+                }
+            }
+            else
+            {
+                known &= ~BIT(rd);
+            }
+            end = always && (rd == 15);
+        }
+        else if (((opcode & 0x0FFF0000) == 0x028F0000) // ADD rd,pc,#imm
+                 || ((opcode & 0x0FFF0000) == 0x024F0000)) // SUB rd,pc,#imm
+        {
+            u32 imm = opcode & 0xFF;
+            u32 rot = ((opcode >> 8) & 0xF) * 2;
+
+            if (rot)
+                imm = (imm >> rot) | (imm << (32 - rot));
+
+            regs[rd] = (opcode & BIT(23)) ? pc + imm : pc - imm;
+            known |= BIT(rd);
+            end = always && (rd == 15);
+        }
+        else if (opcode == 0xE1A0E00F) // mov lr,pc
+        {
+            call = 1;
+            known &= ~BIT(14);
+        }
+        else
+        {
+            if ((opcode & 0x0C000000) == 0) // Data processing and similar
+            {
+                // Skip comparisons, PSR transfers, multiplications and
+                // halfword transfers, which don't write to PC.
+                if (((opcode & 0x01800000) != 0x01000000)
+                    && ((opcode & 0x02000090) != 0x00000090)
+                    && (rd == 15))
+                {
+                    end = always;
+                }
+            }
+            else if ((opcode & 0x0C100000) == 0x04100000) // LDR
+            {
+                end = always && (rd == 15);
+            }
+            else if ((opcode & 0x0E108000) == 0x08108000) // LDM with PC
+            {
+                end = always;
+            }
+            known = 0;
+        }
+
+        if (end)
+            break;
+
+        offset += 4;
+    }
+
+    return count;
+}
+
+static int _gba_analysis_thumb(u32 offset, int max_instructions)
+{
+    u32 regs[16];
+    u32 known = 0;
+    int call = 0; // Set after "mov lr,pc"
+    int count = 0;
+
+    while (offset + 2 <= analysis_rom_size)
+    {
+        u8 *flags = &analysis_flags[offset >> 1];
+
+        if (*flags & GBA_ANALYSIS_THUMB)
+            break;
+
+        if (count == max_instructions)
+        {
+            _gba_analysis_queue(GBA_ANALYSIS_ROM_BASE + offset, 1, 0, 0);
+            break;
+        }
+
+        u16 opcode = *(const u16 *)&analysis_rom[offset];
+
+        if ((opcode & 0xFF00) == 0xDE00) // Undefined
+            break;
+
+        *flags |= GBA_ANALYSIS_THUMB;
+        count++;
+
+        u32 address = GBA_ANALYSIS_ROM_BASE + offset;
+        u32 pc = address + 4;
+        u32 size = 2;
+        int end = 0;
+        int was_call = call;
+
+        call = 0;
+
+        if ((opcode & 0xF000) == 0xD000) // Conditional branch, SWI
+        {
+            if ((opcode & 0x0F00) != 0x0F00)
+            {
+                u32 target = pc + ((s32)(s8)(opcode & 0xFF) * 2);
+                _gba_analysis_queue(target, 1, address, GBA_ANALYSIS_LABEL);
+            }
+            known = 0;
+        }
+        else if ((opcode & 0xF800) == 0xE000) // B
+        {
+            u32 target = pc + ((s32)((u32)opcode << 21) >> 20);
+            _gba_analysis_queue(target, 1, address, GBA_ANALYSIS_LABEL);
+            end = 1;
+        }
+        else if (((opcode & 0xF800) == 0xF000)
+                 && (offset + 4 <= analysis_rom_size)
+                 && ((analysis_rom[offset + 3] & 0xF8) == 0xF8)) // BL
+        {
+            u16 low = *(const u16 *)&analysis_rom[offset + 2];
+            u32 target = pc + ((s32)((u32)opcode << 21) >> 9)
+                       + ((low & 0x7FF) << 1);
+
+            _gba_analysis_queue(target, 1, address, GBA_ANALYSIS_FUNCTION);
+
+            analysis_flags[(offset >> 1) + 1] |= GBA_ANALYSIS_THUMB;
+            size = 4;
+            known = 0;
+        }
+        else if ((opcode & 0xFF80) == 0x4700) // BX
+        {
+            int rm = (opcode >> 3) & 0xF;
+
+            if (rm == 15) // bx pc
+            {
+                _gba_analysis_queue(pc, 0, address, GBA_ANALYSIS_LABEL);
+            }
+            else if (known & BIT(rm))
+            {
+                _gba_analysis_queue(regs[rm], regs[rm] & 1, address,
+                                    was_call ? GBA_ANALYSIS_FUNCTION :
+                                    GBA_ANALYSIS_LABEL);
+            }
+            end = !was_call;
+            known = 0;
+        }
+        else if (opcode == 0x46FE) // mov lr,pc
+        {
+            call = 1;
+            known &= ~BIT(14);
+        }
+        else if ((opcode & 0xFC00) == 0x4400) // Hi register operations
+        {
+            int op = (opcode >> 8) & 3;
+            int rd = (opcode & 7) | ((opcode >> 4) & 8);
+
+            // add pc,rs and mov pc,rs
+            if ((rd == 15) && ((op == 0) || (op == 2)))
+                end = 1;
+            known = 0;
+        }
+        else if ((opcode & 0xFF00) == 0xBD00) // pop {...,pc}
+        {
+            end = 1;
+        }
+        else if ((opcode & 0xF800) == 0x4800) // ldr rd,[pc,#imm]
+        {
+            int rd = (opcode >> 8) & 7;
+            u32 value;
+
+            if (_gba_analysis_read_literal((pc & ~3) + (opcode & 0xFF) * 4,
+                                           &value))
+            {
+                regs[rd] = value;
+                known |= BIT(rd);
+            }
+            else
+            {
+                known &= ~BIT(rd);
+            }
+        }
+        else if ((opcode & 0xF800) == 0xA000) // add rd,pc,#imm
+        {
+            int rd = (opcode >> 8) & 7;
+
+            regs[rd] = (pc & ~3) + (opcode & 0xFF) * 4;
+            known |= BIT(rd);
+        }
+        else
+        {
+            known = 0;
+        }
+
+        if (end)
+            break;
+
+        offset += size;
+    }
+
+    return count;
+}
+
+static int _gba_analysis_xref_compare(const void *a, const void *b)
+{
+    const gba_analysis_xref *xa = a;
+    const gba_analysis_xref *xb = b;
+
+    if (xa->to != xb->to)
+        return (xa->to < xb->to) ? -1 : 1;
+    if (xa->from != xb->from)
+        return (xa->from < xb->from) ? -1 : 1;
+    return 0;
+}
+
+int GBA_AnalysisInit(const u8 *rom, u32 size)
+{
+    GBA_AnalysisEnd();
+
+    analysis_flags = calloc(1, (size + 1) / 2);
+    if (analysis_flags == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    analysis_rom = rom;
+    analysis_rom_size = size;
+
+    GBA_AnalysisAddEntry(GBA_ANALYSIS_ROM_BASE, 0);
+
+    return 1;
+}
+
+void GBA_AnalysisEnd(void)
+{
+    free(analysis_flags);
+    analysis_flags = NULL;
+    free(analysis_queue);
+    analysis_queue = NULL;
+    free(analysis_xrefs);
+    analysis_xrefs = NULL;
+
+    analysis_rom = NULL;
+    analysis_rom_size = 0;
+    analysis_queue_count = 0;
+    analysis_queue_max = 0;
+    analysis_xrefs_count = 0;
+    analysis_xrefs_max = 0;
+    analysis_xrefs_sorted = 0;
+    analysis_instructions = 0;
+}
+
+void GBA_AnalysisAddEntry(u32 address, int thumb)
+{
+    if (analysis_flags == NULL)
+        return;
+
+    _gba_analysis_queue(address, thumb, 0, GBA_ANALYSIS_ENTRY);
+}
+
+int GBA_AnalysisStep(int max_instructions)
+{
+    if (analysis_flags == NULL)
+        return 0;
+
+    while ((analysis_queue_count > 0) && (max_instructions > 0))
+    {
+        u32 entry = analysis_queue[--analysis_queue_count];
+        int count;
+
+        if (entry & 1)
+            count = _gba_analysis_thumb(entry & ~1, max_instructions);
+        else
+            count = _gba_analysis_arm(entry, max_instructions);
+
+        analysis_instructions += count;
+        max_instructions -= count;
+    }
+
+    if (analysis_queue_count > 0)
+        return 1;
+
+    if (analysis_xrefs_sorted == 0)
+    {
+        qsort(analysis_xrefs, analysis_xrefs_count, sizeof(gba_analysis_xref),
+              _gba_analysis_xref_compare);
+        analysis_xrefs_sorted = 1;
+    }
+
+    return 0;
+}
+
+u8 GBA_AnalysisGetFlags(u32 address)
+{
+    u32 offset;
+
+    if (analysis_flags == NULL)
+        return 0;
+
+    if (_gba_analysis_get_offset(address, &offset) == 0)
+        return 0;
+
+    return analysis_flags[offset >> 1];
+}
+
+int GBA_AnalysisGetXrefs(u32 address, u32 *from, int max)
+{
+    u32 offset;
+
+    if (analysis_flags == NULL)
+        return 0;
+
+    if (_gba_analysis_get_offset(address, &offset) == 0)
+        return 0;
+
+    address = GBA_ANALYSIS_ROM_BASE + offset;
+
+    u32 start = 0;
+    u32 end = analysis_xrefs_count;
+
+    if (analysis_xrefs_sorted)
+    {
+        // Look for the first reference to the address
+        while (start < end)
+        {
+            u32 middle = (start + end) / 2;
+
+            if (analysis_xrefs[middle].to < address)
+                start = middle + 1;
+            else
+                end = middle;
+        }
+        end = analysis_xrefs_count;
+    }
+
+    int count = 0;
+
+    for (u32 i = start; i < end; i++)
+    {
+        if (analysis_xrefs[i].to != address)
+        {
+            if (analysis_xrefs_sorted)
+                break;
+            continue;
+        }
+
+        if (count < max)
+            from[count] = analysis_xrefs[i].from;
+        count++;
+    }
+
+    return count;
+}
+
+u32 GBA_AnalysisFindLabel(u32 address, int direction, int functions_only)
+{
+    u32 offset;
+
+    if (analysis_flags == NULL)
+        return 0;
+
+    if (_gba_analysis_get_offset(address, &offset) == 0)
+        return 0;
+
+    u8 mask = GBA_ANALYSIS_FUNCTION | GBA_ANALYSIS_ENTRY;
+    if (functions_only == 0)
+        mask |= GBA_ANALYSIS_LABEL;
+
+    s32 index = offset >> 1;
+    s32 count = (analysis_rom_size + 1) / 2;
+
+    while (1)
+    {
+        index += (direction > 0) ? 1 : -1;
+
+        if ((index < 0) || (index >= count))
+            return 0;
+
+        if (analysis_flags[index] & mask)
+            return GBA_ANALYSIS_ROM_BASE + (index << 1);
+    }
+}
+
+void GBA_AnalysisGetStats(u32 *instructions, u32 *pending)
+{
+    *instructions = analysis_instructions;
+    *pending = analysis_queue_count;
+}
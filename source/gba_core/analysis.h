@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GBA_ANALYSIS__
+#define GBA_ANALYSIS__
+
+#include "gba.h"
+
+// Static analysis of the code of the ROM. Starting from the entry points, it
+// follows the flow of the code (recursive descent) and marks which halfwords
+// of the ROM are ARM or THUMB instructions, the data read by PC-relative
+// loads, and the targets of jumps and calls. It is done in small steps so that
+// it can run in the background. This module doesn't lock anything, the caller
+// has to make sure that the queries don't happen at the same time as a step.
+
+#define GBA_ANALYSIS_ARM        (1 << 0) // Start of an ARM instruction
+#define GBA_ANALYSIS_THUMB      (1 << 1) // Start of a THUMB instruction
+#define GBA_ANALYSIS_DATA       (1 << 2) // Read by a PC-relative load
+#define GBA_ANALYSIS_LABEL      (1 << 3) // Target of a jump
+#define GBA_ANALYSIS_FUNCTION   (1 << 4) // Target of a call
+#define GBA_ANALYSIS_ENTRY      (1 << 5) // Entry point
+
+// The ROM must stay allocated until GBA_AnalysisEnd() is called. Returns 1 on
+// success. The reset vector is added as first entry point.
+int GBA_AnalysisInit(const u8 *rom, u32 size);
+void GBA_AnalysisEnd(void);
+
+// Addresses outside of the ROM are ignored
+void GBA_AnalysisAddEntry(u32 address, int thumb);
+
+// Decodes up to the specified number of instructions. Returns 1 if there is
+// still code left to analyse.
+int GBA_AnalysisStep(int max_instructions);
+
+// Returns the GBA_ANALYSIS_* flags of a ROM address, or 0 if it is outside of
+// the ROM or it hasn't been analysed.
+u8 GBA_AnalysisGetFlags(u32 address);
+
+// Fills "from" with up to "max" addresses of the instructions that jump to the
+// specified address. Returns the total number of them.
+int GBA_AnalysisGetXrefs(u32 address, u32 *from, int max);
+
+// Returns the address of the next (direction > 0) or previous label starting
+// from the specified address (not included). Only functions are considered if
+// functions_only is 1. Returns 0 if there aren't more labels.
+u32 GBA_AnalysisFindLabel(u32 address, int direction, int functions_only);
+
+// Number of instructions found so far and number of blocks of code waiting to
+// be analysed.
+void GBA_AnalysisGetStats(u32 *instructions, u32 *pending);
+
+#endif // GBA_ANALYSIS__
@@ -13,6 +13,7 @@
 #include "gba.h"
 #include "interrupts.h"
 #include "memory.h"
+#include "profiler.h"
 #include "shifts.h"
 
 #include "../gui/win_gba_debugger.h"
@@ -123,9 +124,13 @@ extern u32 cpu_loop_break;
 // Returns residual clocks
 s32 GBA_ExecuteARM(s32 clocks)
 {
+    // Breakpoints can't be added while the CPU is running
+    int check_breakpoints = GBA_DebugAnyBreakpoint();
+    int profile = GBA_ProfilerIsEnabled();
+
     while (clocks > 0)
     {
-        if (GBA_DebugCPUIsBreakpoint(CPU.R[R_PC]))
+        if (check_breakpoints && GBA_DebugCPUIsBreakpoint(CPU.R[R_PC]))
         {
             cpu_loop_break = 1;
             GBA_RunFor_ExecutionBreak();
@@ -138,6 +143,9 @@ s32 GBA_ExecuteARM(s32 clocks)
             return clocks;
         }
 
+        if (profile)
+            GBA_ProfilerStep(CPU.R[R_PC], clocks, 4);
+
         //CPU.R[R_PC] &= ~3;
 
         u32 PCseq = ((CPU.OldPC + 4) == CPU.R[R_PC]);
@@ -15,6 +15,7 @@
 #include "dma.h"
 #include "memory.h"
 #include "sound.h"
+#include "video.h"
 
 #ifndef M_PI
 #define M_PI (3.14159265358979323846)
@@ -113,6 +114,7 @@ static void GBA_SWI_RegisterRamReset(void)
     if (r0 & BIT(4)) // OAM
     {
         memset(Mem.oam, 0, sizeof(Mem.oam));
+        GBA_VideoSpriteListsInvalidate();
     }
     if (r0 & BIT(5)) // Reset SIO registers
     {
@@ -200,10 +202,184 @@ static void GBA_SWI_RegisterRamReset(void)
     GBA_MemoryWrite16(DISPCNT, 0x0080);
 }
 
+// The fast paths can be disabled to check that they give the same results as
+// the code that goes through the memory bus.
+static int gba_swi_direct_access = 1;
+
+void GBA_SwiSetDirectAccess(int enable)
+{
+    gba_swi_direct_access = enable;
+}
+
+static const u8 *swi_get_read_pointer(u32 address, u32 *available)
+{
+    if (!gba_swi_direct_access)
+        return NULL;
+
+    return GBA_MemoryGetReadPointer(address, available);
+}
+
+static u8 *swi_get_write_pointer(u32 address, u32 *available, int is_8bit)
+{
+    if (!gba_swi_direct_access)
+        return NULL;
+
+    return GBA_MemoryGetWritePointer(address, available, is_8bit);
+}
+
+// Stream of data read from the GBA address space. As long as the data is in a
+// region that can be accessed directly, reads go straight to the host buffer.
+// They fall back to the regular memory bus functions if the end of the region
+// is reached or if an access isn't aligned.
+typedef struct {
+    u32 address;
+    const u8 *ptr;
+    u32 available;
+} swi_stream_t;
+
+static void swi_stream_init(swi_stream_t *s, u32 address)
+{
+    s->address = address;
+    s->ptr = swi_get_read_pointer(address, &s->available);
+    if (s->ptr == NULL)
+        s->available = 0;
+}
+
+static inline u8 swi_stream_read8(swi_stream_t *s)
+{
+    if (s->available > 0)
+    {
+        s->available--;
+        s->address++;
+        return *s->ptr++;
+    }
+
+    return GBA_MemoryRead8(s->address++);
+}
+
+static inline u16 swi_stream_read16(swi_stream_t *s)
+{
+    u16 data;
+
+    if ((s->available >= 2) && ((s->address & 1) == 0))
+    {
+        data = *(const u16 *)s->ptr;
+        s->ptr += 2;
+        s->available -= 2;
+    }
+    else
+    {
+        s->available = 0;
+        data = GBA_MemoryRead16(s->address);
+    }
+
+    s->address += 2;
+    return data;
+}
+
+static inline u32 swi_stream_read32(swi_stream_t *s)
+{
+    u32 data;
+
+    if ((s->available >= 4) && ((s->address & 3) == 0))
+    {
+        data = *(const u32 *)s->ptr;
+        s->ptr += 4;
+        s->available -= 4;
+    }
+    else
+    {
+        s->available = 0;
+        data = GBA_MemoryRead32(s->address);
+    }
+
+    s->address += 4;
+    return data;
+}
+
+// Copies data the same way as a loop of 16 or 32-bit transfers going forwards,
+// even if the source and destination overlap.
+static void swi_copy_forward(u8 *dst, const u8 *src, u32 size, u32 unit)
+{
+    if ((dst <= src) || (dst >= (src + size)))
+    {
+        memmove(dst, src, size);
+        return;
+    }
+
+    if (unit == 4)
+    {
+        u32 *d = (u32 *)dst;
+        const u32 *s = (const u32 *)src;
+        for (u32 i = 0; i < size / 4; i++)
+            d[i] = s[i];
+    }
+    else
+    {
+        u16 *d = (u16 *)dst;
+        const u16 *s = (const u16 *)src;
+        for (u32 i = 0; i < size / 2; i++)
+            d[i] = s[i];
+    }
+}
+
+static void swi_fill(u8 *dst, u32 value, u32 size, u32 unit)
+{
+    if (unit == 4)
+    {
+        u32 *d = (u32 *)dst;
+        for (u32 i = 0; i < size / 4; i++)
+            d[i] = value;
+    }
+    else
+    {
+        u16 *d = (u16 *)dst;
+        for (u32 i = 0; i < size / 2; i++)
+            d[i] = (u16)value;
+    }
+}
+
+// Fast path of CpuSet and CpuFastSet for when both source and destination can
+// be accessed directly. It returns 0 if the transfer needs to go through the
+// memory bus, 1 if it has been done (and registers have been updated).
+static int GBA_SWI_CpuSetDirect(u32 src, u32 dst, u32 size, u32 unit, int fill)
+{
+    u32 dst_available;
+    u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 0);
+    if ((dst_ptr == NULL) || (dst_available < size))
+        return 0;
+
+    if (fill)
+    {
+        u32 value = (unit == 4) ? GBA_MemoryRead32(src) : GBA_MemoryRead16(src);
+        swi_fill(dst_ptr, value, size, unit);
+        CPU.R[0] = src;
+    }
+    else
+    {
+        u32 src_available;
+        const u8 *src_ptr = swi_get_read_pointer(src, &src_available);
+        if ((src_ptr == NULL) || (src_available < size))
+            return 0;
+
+        swi_copy_forward(dst_ptr, src_ptr, size, unit);
+        CPU.R[0] = src + size;
+    }
+
+    CPU.R[1] = dst + size;
+
+    return 1;
+}
+
 static void GBA_SWI_CpuSet(void)
 {
     int count = CPU.R[2] & 0x001FFFFF;
 
+    u32 unit = (CPU.R[2] & BIT(26)) ? 4 : 2;
+    if (GBA_SWI_CpuSetDirect(CPU.R[0] & ~(unit - 1), CPU.R[1] & ~(unit - 1),
+                             count * unit, unit, CPU.R[2] & BIT(24)))
+        return;
+
     if (CPU.R[2] & BIT(26)) // 32 bit
     {
         CPU.R[0] &= ~3;
@@ -259,6 +435,14 @@ static void GBA_SWI_CpuFastSet(void)
     uint32_t size = (CPU.R[2] & 0x001FFFFF) * sizeof(uint32_t);
     uint32_t end_address = CPU.R[1] + size;
 
+    // Transfers are done in blocks of 8 words
+    if (((CPU.R[0] | CPU.R[1]) & 3) == 0)
+    {
+        if (GBA_SWI_CpuSetDirect(CPU.R[0], CPU.R[1], (size + 31) & ~31, 4,
+                                 CPU.R[2] & BIT(24)))
+            return;
+    }
+
     if (CPU.R[2] & BIT(24)) // Fill
     {
         u32 fill = GBA_MemoryRead32(CPU.R[0]);
@@ -464,6 +648,60 @@ static void GBA_SWI_BitUnPack(void)
     }
 }
 
+// The regular paths of the LZ77 and Huffman functions decode the data to a
+// temporary buffer before copying it to the destination. Decoding it straight
+// into the destination is only equivalent if it can't overwrite the source.
+static int swi_regions_differ(u32 src, u32 dst)
+{
+    return (src >> 24) != (dst >> 24);
+}
+
+// Decodes LZ77 data straight into the host buffer of the destination. The
+// caller must make sure that there is space for 'size' bytes in 'dst'.
+static void GBA_SWI_LZ77DecodeDirect(u32 src, u8 *dst, u32 size, int swi)
+{
+    swi_stream_t s;
+    swi_stream_init(&s, src);
+
+    u32 total = 0;
+    while (size > total)
+    {
+        u8 flag = swi_stream_read8(&s);
+        for (int i = 0; i < 8; i++)
+        {
+            if (flag & 0x80)
+            {
+                // Compressed - Copy N+3 Bytes from Dest-Disp-1 to Dest
+                u16 info = ((u16)swi_stream_read8(&s)) << 8;
+                info |= (u16)swi_stream_read8(&s);
+                u32 displacement = (info & 0x0FFF);
+                u32 num = 3 + ((info >> 12) & 0xF);
+                if (displacement + 1 > total)
+                {
+                    Debug_ErrorMsgArg("SWI %02X - Error while decoding", swi);
+                    GBA_ExecutionBreak();
+                    return;
+                }
+                if (num > size - total)
+                    num = size - total;
+                // The regions can overlap, it has to be copied byte by byte
+                const u8 *from = &dst[total - displacement - 1];
+                for (u32 j = 0; j < num; j++)
+                    dst[total + j] = from[j];
+                total += num;
+            }
+            else
+            {
+                // Uncompressed - Copy 1 Byte from Source to Dest
+                dst[total++] = swi_stream_read8(&s);
+            }
+            if (size <= total)
+                break;
+            flag <<= 1;
+        }
+    }
+}
+
 static void GBA_SWI_LZ77UnCompWram(void)
 {
     int src = CPU.R[0];
@@ -477,6 +715,18 @@ static void GBA_SWI_LZ77UnCompWram(void)
     //    return;
     //}
     u32 size = (header >> 8) & 0x00FFFFFF;
+
+    if (swi_regions_differ(src, dst))
+    {
+        u32 dst_available;
+        u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 1);
+        if ((dst_ptr != NULL) && (dst_available >= size))
+        {
+            GBA_SWI_LZ77DecodeDirect(src, dst_ptr, size, 0x11);
+            return;
+        }
+    }
+
     u8 *buffer = malloc(size + 2);
     if (buffer == NULL)
     {
@@ -546,7 +796,22 @@ static void GBA_SWI_LZ77UnCompVram(void)
     //    return;
     //}
     u32 size = (header >> 8) & 0x00FFFFFF;
-    u16 *buffer = malloc(size + 2);
+
+    // Odd sizes are left to the slow path, the last halfword is padded with
+    // whatever is left in the temporary buffer.
+    if ((((size | dst) & 1) == 0) && swi_regions_differ(src, dst))
+    {
+        u32 dst_available;
+        u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 0);
+        if ((dst_ptr != NULL) && (dst_available >= size))
+        {
+            GBA_SWI_LZ77DecodeDirect(src, dst_ptr, size, 0x12);
+            return;
+        }
+    }
+
+    // Cleared so that the padding of odd sizes is always the same
+    u16 *buffer = calloc(1, size + 2);
     if (buffer == NULL)
     {
         Debug_ErrorMsgArg("SWI 12 - Couldn't allocate memory");
@@ -594,17 +859,95 @@ static void GBA_SWI_LZ77UnCompVram(void)
             flag <<= 1;
         }
     }
-    // Copy to destination in 16 bit blocks
+    // Copy to destination in 16 bit blocks. If the size is odd, the last
+    // halfword is padded with the byte after the end of the data.
     u16 *dstbuf = buffer;
-    while (size > 0)
+    for (u32 i = 0; i < size; i += 2)
     {
         GBA_MemoryWrite16(dst, *dstbuf++);
         dst += 2;
-        size -= 2;
     }
     free(buffer);
 }
 
+// Decodes Huffman data straight into the host buffer of the destination. The
+// caller must make sure that there is space for 'size' bytes in 'dst', and that
+// 'size' is a non-zero multiple of 4.
+static void GBA_SWI_HuffDecodeDirect(u32 src, u8 *dst, int size,
+                                     int chunk_size)
+{
+    u32 treesize = (((u32)GBA_MemoryRead8(src++)) * 2) + 1;
+    u32 treetable = src;
+
+    u32 tree_available;
+    const u8 *tree = swi_get_read_pointer(treetable, &tree_available);
+    if (tree == NULL)
+        tree_available = 0;
+    if (tree_available > treesize)
+        tree_available = treesize;
+
+    swi_stream_t s;
+    swi_stream_init(&s, src + treesize); // Bitstream
+
+    int total = 0;
+    int bit4index = 0;
+    int bitsleft = 0;
+    u32 bitstream = 0;
+
+    while (1)
+    {
+        u32 nodeaddr = treetable;
+        u8 nodeinfo;
+        while (1)
+        {
+            if (bitsleft == 0)
+            {
+                bitstream = swi_stream_read32(&s);
+                bitsleft = 32;
+            }
+            int node = bitstream >> 31; // Get bit 31
+            bitstream <<= 1;
+            bitsleft--;
+
+            u32 offset = nodeaddr - treetable;
+            if (offset < tree_available)
+                nodeinfo = tree[offset];
+            else
+                nodeinfo = GBA_MemoryRead8(nodeaddr);
+
+            nodeaddr = (nodeaddr & ~1)
+                       + ((int)(nodeinfo & 0x3F)) * 2 + 2 + node;
+
+            if (node && (nodeinfo & BIT(6)))
+                break;
+            if ((node == 0) && (nodeinfo & BIT(7)))
+                break;
+        }
+
+        u32 offset = nodeaddr - treetable;
+        u8 data;
+        if (offset < tree_available)
+            data = tree[offset];
+        else
+            data = GBA_MemoryRead8(nodeaddr);
+
+        if (chunk_size == 8)
+        {
+            dst[total++] = data;
+        }
+        else //if (chunk_size == 4)
+        {
+            if (bit4index & 1)
+                dst[total++] |= data << 4;
+            else
+                dst[total] = data;
+            bit4index ^= 1;
+        }
+        if (size <= total)
+            break;
+    }
+}
+
 static void GBA_SWI_HuffUnComp(void)
 {
     int src = CPU.R[0] & ~3;
@@ -625,7 +968,23 @@ static void GBA_SWI_HuffUnComp(void)
         return;
     }
     int size = (header >> 8) & 0x00FFFFFF;
-    u32 *buffer = malloc(size + 2);
+
+    // Sizes that aren't a multiple of 4 are left to the slow path, the last
+    // word is padded with whatever is left in the temporary buffer.
+    if ((size > 0) && (((size | dst) & 3) == 0)
+        && swi_regions_differ(src, dst))
+    {
+        u32 dst_available;
+        u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 0);
+        if ((dst_ptr != NULL) && (dst_available >= (u32)size))
+        {
+            GBA_SWI_HuffDecodeDirect(src, dst_ptr, size, chunk_size);
+            return;
+        }
+    }
+
+    // The last word is padded with zeroes if the size isn't a multiple of 4
+    u32 *buffer = calloc(1, (size + 4) & ~3);
     if (buffer == NULL)
     {
         Debug_ErrorMsgArg("SWI 13 - Couldn't allocate memory");
@@ -700,6 +1059,66 @@ static void GBA_SWI_HuffUnComp(void)
     free(buffer);
 }
 
+// Decodes RL data straight into the host buffer of the destination. Like the
+// regular path, it can write up to one run past the end of the data, so the
+// caller must make sure that there is space for 'size' + 0x82 bytes.
+static void GBA_SWI_RLDecodeDirect(u32 src, u8 *dst, int size)
+{
+    swi_stream_t s;
+    swi_stream_init(&s, src);
+
+    while (size > 0)
+    {
+        u8 flg = swi_stream_read8(&s);
+        int len;
+        if (flg & BIT(7)) // Compressed - 1 byte repeated N times
+        {
+            len = (flg & 0x7F) + 3;
+            memset(dst, swi_stream_read8(&s), len);
+        }
+        else // N uncompressed bytes
+        {
+            len = (flg & 0x7F) + 1;
+            for (int i = 0; i < len; i++)
+                dst[i] = swi_stream_read8(&s);
+        }
+        dst += len;
+        size -= len;
+    }
+}
+
+// Same as GBA_SWI_RLDecodeDirect(), but it only writes complete halfwords.
+static void GBA_SWI_RLDecodeDirectVram(u32 src, u16 *dst, int size)
+{
+    swi_stream_t s;
+    swi_stream_init(&s, src);
+
+    u16 writedata = 0;
+    int curbyte = 0;
+
+    while (size > 0)
+    {
+        u8 flg = swi_stream_read8(&s);
+        int compressed = flg & BIT(7);
+        int len = compressed ? (flg & 0x7F) + 3 : (flg & 0x7F) + 1;
+        u8 data = compressed ? swi_stream_read8(&s) : 0;
+
+        size -= len;
+
+        while (len--)
+        {
+            if (!compressed)
+                data = swi_stream_read8(&s);
+
+            if (curbyte & 1)
+                *dst++ = writedata | (((u16)data) << 8);
+            else
+                writedata = (u16)data;
+            curbyte ^= 1;
+        }
+    }
+}
+
 static void GBA_SWI_RLUnCompWram(void)
 {
     int src = CPU.R[0];
@@ -713,6 +1132,15 @@ static void GBA_SWI_RLUnCompWram(void)
     //    return;
     //}
     int size = (header >> 8) & 0x00FFFFFF;
+
+    u32 dst_available;
+    u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 1);
+    if ((dst_ptr != NULL) && (dst_available >= (u32)size + 0x82))
+    {
+        GBA_SWI_RLDecodeDirect(src, dst_ptr, size);
+        return;
+    }
+
     while (size > 0)
     {
         u8 flg = GBA_MemoryRead8(src);
@@ -759,6 +1187,17 @@ static void GBA_SWI_RLUnCompVram(void)
     //}
     int size = (header >> 8) & 0x00FFFFFF;
 
+    if ((dst & 1) == 0)
+    {
+        u32 dst_available;
+        u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 0);
+        if ((dst_ptr != NULL) && (dst_available >= (u32)size + 0x82))
+        {
+            GBA_SWI_RLDecodeDirectVram(src, (u16 *)dst_ptr, size);
+            return;
+        }
+    }
+
     u16 writedata = 0;
     int curbyte = 0;
 
@@ -833,6 +1272,25 @@ static void GBA_SWI_Diff8bitUnFilterWram(void)
     //    return;
     //}
     int size = (header >> 8) & 0x00FFFFFF;
+
+    // At least 2 bytes are written, even if the size is smaller
+    int count = (size < 2) ? 2 : size;
+    u32 dst_available;
+    u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 1);
+    if ((dst_ptr != NULL) && (dst_available >= (u32)count))
+    {
+        swi_stream_t s;
+        swi_stream_init(&s, src);
+
+        u8 value = 0;
+        for (int i = 0; i < count; i++)
+        {
+            value += swi_stream_read8(&s);
+            dst_ptr[i] = value;
+        }
+        return;
+    }
+
     u8 value = GBA_MemoryRead8(src);
     src++;
     GBA_MemoryWrite8(dst, value);
@@ -868,6 +1326,31 @@ static void GBA_SWI_Diff8bitUnFilterVram(void)
     //    return;
     //}
     int size = (header >> 8) & 0x00FFFFFF;
+
+    // At least 1 halfword is written, even if the size is smaller
+    if ((dst & 1) == 0)
+    {
+        int count = (size < 2) ? 1 : (size + 1) / 2;
+        u32 dst_available;
+        u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 0);
+        if ((dst_ptr != NULL) && (dst_available >= (u32)count * 2))
+        {
+            swi_stream_t s;
+            swi_stream_init(&s, src);
+
+            u16 *dst16 = (u16 *)dst_ptr;
+            u8 value = 0;
+            for (int i = 0; i < count; i++)
+            {
+                value += swi_stream_read8(&s);
+                u16 writeval = value;
+                value += swi_stream_read8(&s);
+                dst16[i] = writeval | (((u16)value) << 8);
+            }
+            return;
+        }
+    }
+
     u8 value = 0;
     u16 writeval = 0;
     int bytewrite = 0;
@@ -911,6 +1394,29 @@ static void GBA_SWI_Diff16bitUnFilter(void)
     //    return;
     //}
     int size = (header >> 8) & 0x00FFFFFF;
+
+    // At least 2 halfwords are written, even if the size is smaller
+    if ((dst & 1) == 0)
+    {
+        int count = (size < 4) ? 2 : (size + 1) / 2;
+        u32 dst_available;
+        u8 *dst_ptr = swi_get_write_pointer(dst, &dst_available, 0);
+        if ((dst_ptr != NULL) && (dst_available >= (u32)count * 2))
+        {
+            swi_stream_t s;
+            swi_stream_init(&s, src);
+
+            u16 *dst16 = (u16 *)dst_ptr;
+            u16 value = 0;
+            for (int i = 0; i < count; i++)
+            {
+                value += swi_stream_read16(&s);
+                dst16[i] = value;
+            }
+            return;
+        }
+    }
+
     u16 value = GBA_MemoryRead16(src);
     src += 2;
     GBA_MemoryWrite16(dst, value);
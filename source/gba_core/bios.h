@@ -16,4 +16,8 @@ void GBA_BiosEmulatedLoad(void);
 
 void GBA_Swi(u8 number);
 
+// Enables or disables the fast paths of the copy and decompression functions
+// that access memory directly. They are enabled by default.
+void GBA_SwiSetDirectAccess(int enable);
+
 #endif // GBA_BIOS__
@@ -13,6 +13,9 @@
 #include "cpu.h"
 #include "gba.h"
 #include "memory.h"
+#include "profiler.h"
+#include "state.h"
+#include "timing.h"
 
 //------------------------------------------------------------------------------
 
@@ -260,15 +263,37 @@ void GBA_CPUClearHalted(void)
 s32 GBA_Execute(s32 clocks) // Returns total clocks not executed
 {
     if (GBA_CPUGetHalted()) // Execute all clocks
+    {
+        if (GBA_ProfilerIsEnabled())
+            GBA_ProfilerHalted(clocks);
         return 0;
+    }
+
+    s32 residual;
+
+    GBA_TIMING_BEGIN(GBA_TIMING_CPU);
 
     if (CPU.EXECUTION_MODE == EXEC_ARM)
-        return GBA_ExecuteARM(clocks);
+        residual = GBA_ExecuteARM(clocks);
     else
-        return GBA_ExecuteTHUMB(clocks);
+        residual = GBA_ExecuteTHUMB(clocks);
+
+    GBA_TIMING_END(GBA_TIMING_CPU);
+
+    if (GBA_ProfilerIsEnabled())
+        GBA_ProfilerFlush(residual);
+
+    return residual;
 }
 
 void GBA_ExecutionBreak(void)
 {
     cpu_loop_break = 1;
 }
+
+void GBA_CPUStateRegister(void)
+{
+    GBA_StateRegister(&CPU, sizeof(CPU));
+    GBA_StateRegister(&cpu_loop_break, sizeof(cpu_loop_break));
+    GBA_StateRegister(&gba_halt, sizeof(gba_halt));
+}
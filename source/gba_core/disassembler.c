@@ -5,115 +5,391 @@
 // GiiBiiAdvance - GBA/GB emulator
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../build_options.h"
+#include "../debug_utils.h"
 #include "../font_utils.h"
 
 #include "cpu.h"
+#include "disassembler.h"
 #include "gba.h"
 #include "memory.h"
 #include "shifts.h"
 
+#include "../gui/win_gba_debugger.h"
+
 //------------------------------------------------------------------------------
 
-#define GBA_MAX_BREAKPOINTS 20
+// Breakpoints are stored in a bitmap with one bit per halfword. The address
+// space is split in 1 MB pages, and only the pages that have breakpoints are
+// allocated.
+#define GBA_BRKPOINT_PAGE_SHIFT 20
+#define GBA_BRKPOINT_PAGES      (1 << (32 - GBA_BRKPOINT_PAGE_SHIFT))
+#define GBA_BRKPOINT_PAGE_WORDS ((1 << GBA_BRKPOINT_PAGE_SHIFT) / 2 / 32)
 
-static u32 gba_brkpoint_addrlist[GBA_MAX_BREAKPOINTS];
-static int gba_brkpoint_used[GBA_MAX_BREAKPOINTS];
-static int gba_any_breakpoint_used = 0;
+static u32 *gba_brkpoint_pages[GBA_BRKPOINT_PAGES];
+static int gba_brkpoint_count = 0;
 
-int GBA_DebugIsBreakpoint(u32 addr)
+// Execution hooks use the same kind of bitmap as breakpoints
+static u32 *gba_pchook_pages[GBA_BRKPOINT_PAGES];
+static int gba_pchook_count = 0;
+static gba_pc_hook_fn gba_pchook_callback = NULL;
+
+int GBA_DebugAnyBreakpoint(void)
 {
-    if (gba_any_breakpoint_used == 0)
-        return 0;
+    return (gba_brkpoint_count > 0) || (gba_pchook_count > 0);
+}
 
-    for (int i = 0; i < GBA_MAX_BREAKPOINTS; i++)
+// Returns a pointer to the word of the bitmap that contains the address
+static u32 *gba_bitmap_get_word(u32 **pages, u32 addr, int allocate)
+{
+    u32 **page = &pages[addr >> GBA_BRKPOINT_PAGE_SHIFT];
+
+    if (*page == NULL)
     {
-        if (gba_brkpoint_used[i])
+        if (allocate == 0)
+            return NULL;
+
+        *page = calloc(GBA_BRKPOINT_PAGE_WORDS, sizeof(u32));
+        if (*page == NULL)
         {
-            if (gba_brkpoint_addrlist[i] == addr)
-            {
-                return 1;
-            }
+            Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+            return NULL;
         }
     }
-    return 0;
+
+    u32 offset = (addr & ((1 << GBA_BRKPOINT_PAGE_SHIFT) - 1)) >> 1;
+
+    return &((*page)[offset >> 5]);
 }
 
-static u32 gba_last_executed_opcode = 1;
+static u32 *gba_brkpoint_get_word(u32 addr, int allocate)
+{
+    return gba_bitmap_get_word(gba_brkpoint_pages, addr, allocate);
+}
 
-int GBA_DebugCPUIsBreakpoint(u32 addr)
+static int gba_pchook_is_set(u32 addr)
+{
+    u32 *word = gba_bitmap_get_word(gba_pchook_pages, addr, 0);
+    if (word == NULL)
+        return 0;
+
+    return (*word >> ((addr >> 1) & 31)) & 1;
+}
+
+int GBA_DebugIsBreakpoint(u32 addr)
 {
-    if (gba_any_breakpoint_used == 0)
+    if (gba_brkpoint_count == 0)
+        return 0;
+
+    u32 *word = gba_brkpoint_get_word(addr, 0);
+    if (word == NULL)
         return 0;
 
+    return (*word >> ((addr >> 1) & 31)) & 1;
+}
+
+static u32 gba_last_executed_opcode = 1;
+
+int GBA_DebugCPUIsBreakpoint(u32 addr)
+{
+    // When resuming from a breakpoint, the hook has already been called
     if (gba_last_executed_opcode == addr)
     {
         gba_last_executed_opcode = 1;
         return 0;
     }
 
-    for (int i = 0; i < GBA_MAX_BREAKPOINTS; i++)
+    if ((gba_pchook_count > 0) && gba_pchook_is_set(addr))
     {
-        if (gba_brkpoint_used[i])
-        {
-            if (gba_brkpoint_addrlist[i] == addr)
-            {
-                gba_last_executed_opcode = addr;
-                return 1;
-            }
-        }
+        if (gba_pchook_callback != NULL)
+            gba_pchook_callback(addr);
+    }
+
+    if (gba_brkpoint_count == 0)
+        return 0;
+
+    if (GBA_DebugIsBreakpoint(addr))
+    {
+        gba_last_executed_opcode = addr;
+        return 1;
     }
+
     return 0;
 }
 
 void GBA_DebugAddBreakpoint(u32 addr)
 {
+    addr &= ~1;
+
     if (GBA_DebugIsBreakpoint(addr))
         return;
 
-    for (int i = 0; i < GBA_MAX_BREAKPOINTS; i++)
+    u32 *word = gba_brkpoint_get_word(addr, 1);
+    if (word == NULL)
+        return;
+
+    *word |= 1U << ((addr >> 1) & 31);
+    gba_brkpoint_count++;
+}
+
+void GBA_DebugClearBreakpoint(u32 addr)
+{
+    addr &= ~1;
+
+    if (GBA_DebugIsBreakpoint(addr) == 0)
+        return;
+
+    u32 *word = gba_brkpoint_get_word(addr, 0);
+
+    *word &= ~(1U << ((addr >> 1) & 31));
+    gba_brkpoint_count--;
+}
+
+void GBA_DebugClearBreakpointAll(void)
+{
+    for (int i = 0; i < GBA_BRKPOINT_PAGES; i++)
     {
-        if (gba_brkpoint_used[i] == 0)
-        {
-            gba_brkpoint_addrlist[i] = addr;
-            gba_brkpoint_used[i] = 1;
-            gba_any_breakpoint_used = 1;
-            return;
-        }
+        free(gba_brkpoint_pages[i]);
+        gba_brkpoint_pages[i] = NULL;
     }
+
+    gba_brkpoint_count = 0;
 }
 
-void GBA_DebugClearBreakpoint(u32 addr)
+//------------------------------------------------------------------------------
+
+void GBA_DebugSetPCHookCallback(gba_pc_hook_fn fn)
+{
+    gba_pchook_callback = fn;
+}
+
+void GBA_DebugAddPCHook(u32 addr)
+{
+    addr &= ~1;
+
+    if (gba_pchook_is_set(addr))
+        return;
+
+    u32 *word = gba_bitmap_get_word(gba_pchook_pages, addr, 1);
+    if (word == NULL)
+        return;
+
+    *word |= 1U << ((addr >> 1) & 31);
+    gba_pchook_count++;
+}
+
+void GBA_DebugClearPCHookAll(void)
 {
-    for (int i = 0; i < GBA_MAX_BREAKPOINTS; i++)
+    for (int i = 0; i < GBA_BRKPOINT_PAGES; i++)
     {
-        if (gba_brkpoint_used[i])
+        free(gba_pchook_pages[i]);
+        gba_pchook_pages[i] = NULL;
+    }
+
+    gba_pchook_count = 0;
+}
+
+static gba_vblank_hook_fn gba_vblank_callback = NULL;
+
+void GBA_DebugSetVBlankHookCallback(gba_vblank_hook_fn fn)
+{
+    gba_vblank_callback = fn;
+}
+
+void GBA_DebugVBlankHook(void)
+{
+    if (gba_vblank_callback != NULL)
+        gba_vblank_callback();
+}
+
+//------------------------------------------------------------------------------
+
+#define GBA_MAX_WATCHPOINTS 16
+
+typedef struct
+{
+    u32 start, end;
+    int flags;
+    int has_value;
+    u32 value;
+} _gba_watchpoint_t;
+
+static _gba_watchpoint_t gba_watchpoints[GBA_MAX_WATCHPOINTS];
+static int gba_watch_count = 0;
+
+// Watchpoint flags of each memory region (address >> 24) and of each page
+static u8 gba_watch_region_flags[16];
+static u8 gba_watch_page_flags[GBA_WATCH_NUM_PAGES];
+
+#define GBA_WATCH_LOG_SIZE 4096 // Must be a power of 2
+
+typedef struct
+{
+    u32 pc;
+    u32 vcount;
+    u32 address;
+    u32 old_value;
+    u32 new_value;
+    u8 size;
+    u8 flags;
+} _gba_watch_log_entry_t;
+
+static _gba_watch_log_entry_t gba_watch_log[GBA_WATCH_LOG_SIZE];
+static u32 gba_watch_log_count = 0; // Total number of entries ever logged
+
+static void gba_watch_update_regions(void)
+{
+    memset(gba_watch_region_flags, 0, sizeof(gba_watch_region_flags));
+    memset(gba_watch_page_flags, 0, sizeof(gba_watch_page_flags));
+
+    for (int i = 0; i < gba_watch_count; i++)
+    {
+        _gba_watchpoint_t *w = &gba_watchpoints[i];
+
+        u32 end = w->end;
+        if (end > 0x0FFFFFFF)
+            end = 0x0FFFFFFF;
+
+        u32 first = w->start >> GBA_WATCH_PAGE_SHIFT;
+        u32 last = end >> GBA_WATCH_PAGE_SHIFT;
+
+        for (u32 p = first; p <= last; p++)
         {
-            if (gba_brkpoint_addrlist[i] == addr)
-            {
-                gba_brkpoint_used[i] = 0;
-                break;
-            }
+            gba_watch_page_flags[p] |=
+                    w->flags & (GBA_WATCH_READ | GBA_WATCH_WRITE);
         }
     }
 
-    for (int i = 0; i < GBA_MAX_BREAKPOINTS; i++)
+    for (u32 p = 0; p < GBA_WATCH_NUM_PAGES; p++)
     {
-        if (gba_brkpoint_used[i])
-            return;
+        u32 r = p >> (24 - GBA_WATCH_PAGE_SHIFT);
+        gba_watch_region_flags[r] |= gba_watch_page_flags[p];
     }
+}
+
+int GBA_DebugAddWatchpoint(u32 start, u32 end, int flags, int has_value,
+                           u32 value)
+{
+    if ((start > end) || (start > 0x0FFFFFFF))
+        return 0;
+
+    if ((flags & (GBA_WATCH_READ | GBA_WATCH_WRITE)) == 0)
+        return 0;
+
+    if (gba_watch_count == GBA_MAX_WATCHPOINTS)
+        return 0;
+
+    _gba_watchpoint_t *w = &gba_watchpoints[gba_watch_count++];
+
+    w->start = start;
+    w->end = end;
+    w->flags = flags;
+    w->has_value = has_value;
+    w->value = value;
 
-    gba_any_breakpoint_used = 0;
+    gba_watch_update_regions();
+
+    return 1;
 }
 
-void GBA_DebugClearBreakpointAll(void)
+void GBA_DebugClearWatchpointAll(void)
 {
-    for (int i = 0; i < GBA_MAX_BREAKPOINTS; i++)
-        gba_brkpoint_used[i] = 0;
+    gba_watch_count = 0;
+
+    gba_watch_update_regions();
+}
+
+int GBA_DebugAnyWatchpoint(void)
+{
+    return gba_watch_count > 0;
+}
+
+void GBA_DebugWatchArm(int enable)
+{
+    if (enable && (gba_watch_count > 0))
+        GBA_MemoryWatchSetFlags(gba_watch_region_flags, gba_watch_page_flags);
+    else
+        GBA_MemoryWatchSetFlags(NULL, NULL);
+}
+
+void GBA_DebugWatchAccess(u32 address, int size, u32 old_value, u32 new_value,
+                          int type)
+{
+    u32 last = address + size - 1;
+
+    for (int i = 0; i < gba_watch_count; i++)
+    {
+        _gba_watchpoint_t *w = &gba_watchpoints[i];
+
+        if ((w->flags & type) == 0)
+            continue;
+
+        if ((last < w->start) || (address > w->end))
+            continue;
+
+        if (w->has_value && (w->value != new_value))
+            continue;
+
+        _gba_watch_log_entry_t *e =
+                &gba_watch_log[gba_watch_log_count & (GBA_WATCH_LOG_SIZE - 1)];
+        gba_watch_log_count++;
+
+        e->pc = CPU.OldPC;
+        e->vcount = REG_VCOUNT;
+        e->address = address;
+        e->old_value = old_value;
+        e->new_value = new_value;
+        e->size = size;
+        e->flags = type;
+
+        if (w->flags & GBA_WATCH_BREAK)
+        {
+            // The current instruction is finished before breaking
+            GBA_ExecutionBreak();
+            GBA_RunFor_ExecutionBreak();
+            Win_GBADisassemblerSetFocus();
+        }
+
+        return;
+    }
+}
+
+void GBA_DebugWatchLogClear(void)
+{
+    gba_watch_log_count = 0;
+}
+
+int GBA_DebugWatchLogSave(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        Debug_ErrorMsgArg("Couldn't open %s for writing.", path);
+        return 0;
+    }
+
+    fprintf(f, "pc,vcount,access,address,size,old,new\n");
+
+    u32 first = 0;
+    if (gba_watch_log_count > GBA_WATCH_LOG_SIZE)
+        first = gba_watch_log_count - GBA_WATCH_LOG_SIZE;
+
+    for (u32 i = first; i < gba_watch_log_count; i++)
+    {
+        _gba_watch_log_entry_t *e =
+                &gba_watch_log[i & (GBA_WATCH_LOG_SIZE - 1)];
+
+        fprintf(f, "%08X,%u,%c,%08X,%d,%08X,%08X\n", e->pc, e->vcount,
+                (e->flags & GBA_WATCH_WRITE) ? 'W' : 'R', e->address,
+                e->size, e->old_value, e->new_value);
+    }
+
+    fclose(f);
 
-    gba_any_breakpoint_used = 0;
+    return 1;
 }
 
 //------------------------------------------------------------------------------
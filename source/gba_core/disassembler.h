@@ -14,6 +14,49 @@ void GBA_DebugClearBreakpoint(u32 addr);
 int GBA_DebugIsBreakpoint(u32 addr);    // Used in debugger
 int GBA_DebugCPUIsBreakpoint(u32 addr); // Used in CPU loop
 void GBA_DebugClearBreakpointAll(void);
+int GBA_DebugAnyBreakpoint(void); // The CPU loop skips checks if this is 0
+
+// Hooks
+// -----
+
+// The PC hook callback is called right before executing an instruction at any
+// of the hook addresses. Like breakpoints, hooks added while the CPU is running
+// may not be checked until the CPU loop is entered again.
+typedef void (*gba_pc_hook_fn)(u32 addr);
+void GBA_DebugSetPCHookCallback(gba_pc_hook_fn fn);
+void GBA_DebugAddPCHook(u32 addr);
+void GBA_DebugClearPCHookAll(void);
+
+// The VBlank hook callback is called when the PPU enters the VBlank period
+typedef void (*gba_vblank_hook_fn)(void);
+void GBA_DebugSetVBlankHookCallback(gba_vblank_hook_fn fn);
+void GBA_DebugVBlankHook(void); // Called by the PPU
+
+// Watchpoints
+// -----------
+
+#define GBA_WATCH_READ  (1 << 0)
+#define GBA_WATCH_WRITE (1 << 1)
+#define GBA_WATCH_BREAK (1 << 2) // Break to the debugger when triggered
+
+// Watch accesses to the range [start, end]. If has_value is set, it only
+// triggers when the value read or written is equal to value. Returns 1 on
+// success.
+int GBA_DebugAddWatchpoint(u32 start, u32 end, int flags, int has_value,
+                           u32 value);
+void GBA_DebugClearWatchpointAll(void);
+int GBA_DebugAnyWatchpoint(void);
+
+// Enables watchpoint checks in the memory access functions while the CPU runs
+void GBA_DebugWatchArm(int enable);
+
+// Called by the memory access functions for regions with watchpoints
+void GBA_DebugWatchAccess(u32 address, int size, u32 old_value, u32 new_value,
+                          int type);
+
+// Saves the log of triggered watchpoints as text. Returns 1 on success.
+int GBA_DebugWatchLogSave(const char *path);
+void GBA_DebugWatchLogClear(void);
 
 void GBA_DisassembleARM(u32 opcode, u32 address, char *dest, int dest_size);
 
@@ -12,6 +12,7 @@
 #include "gba.h"
 #include "interrupts.h"
 #include "memory.h"
+#include "state.h"
 #include "video.h"
 
 typedef struct
@@ -961,3 +962,11 @@ void GBA_DMASoundRequestData(int A, int B)
         }
     }
 }
+
+void GBA_DMAStateRegister(void)
+{
+    GBA_StateRegister(DMA, sizeof(DMA));
+    GBA_StateRegister(&gba_dmaworking, sizeof(gba_dmaworking));
+    GBA_StateRegister(&gba_dma_extra_clocks_elapsed,
+                      sizeof(gba_dma_extra_clocks_elapsed));
+}
@@ -6,22 +6,28 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../build_options.h"
+#include "../capture.h"
 #include "../debug_utils.h"
 #include "../file_utils.h"
-#include "../png_utils.h"
 
 #include "bios.h"
 #include "cpu.h"
+#include "disassembler.h"
 #include "dma.h"
 #include "gba.h"
 #include "interrupts.h"
 #include "memory.h"
+#include "profiler.h"
 #include "rom.h"
 #include "save.h"
+#include "serial.h"
 #include "sound.h"
+#include "state.h"
 #include "timers.h"
+#include "timing.h"
 #include "video.h"
 
 static s32 clocks_to_next_event;
@@ -41,39 +47,57 @@ _cpu_t *GBA_CPUGet(void)
 }
 
 int GBA_InitRom(void *bios_ptr, void *rom_ptr, u32 romsize)
+{
+    u8 *rom_buffer = calloc(1, GBA_ROM_BUFFER_SIZE);
+    if (rom_buffer == NULL)
+    {
+        Debug_ErrorMsgArg("Not enough memory to load the ROM");
+        return 0;
+    }
+
+    if (romsize > GBA_ROM_BUFFER_SIZE)
+        memcpy(rom_buffer, rom_ptr, GBA_ROM_BUFFER_SIZE);
+    else
+        memcpy(rom_buffer, rom_ptr, romsize);
+
+    return GBA_InitRomBuffer(bios_ptr, rom_buffer, romsize);
+}
+
+int GBA_InitRomBuffer(void *bios_ptr, void *rom_buffer, u32 romsize)
 {
     if (inited)
         GBA_EndRom(1); // Shouldn't be needed here
 
-    if (romsize > 0x02000000)
+    if (romsize > GBA_ROM_BUFFER_SIZE)
     {
         Debug_ErrorMsgArg("Rom too big!\n"
                           "Size = 0x%08X bytes\n"
                           "Max = 0x02000000 bytes",
                           romsize);
-        GBA_ROM_SIZE = 0x02000000;
+        GBA_ROM_SIZE = GBA_ROM_BUFFER_SIZE;
     }
     else
     {
         GBA_ROM_SIZE = romsize;
     }
 
-    GBA_DetectSaveType(rom_ptr, romsize);
+    GBA_DetectSaveType(rom_buffer, GBA_ROM_SIZE);
     GBA_ResetSaveBuffer();
     GBA_SaveReadFile();
 
-    GBA_HeaderCheck(rom_ptr);
+    GBA_HeaderCheck(rom_buffer);
 
     GBA_CPUInit();
     GBA_InterruptInit();
     GBA_TimerInitAll();
-    GBA_MemoryInit(bios_ptr, rom_ptr, GBA_ROM_SIZE);
+    GBA_MemoryInit(bios_ptr, rom_buffer);
     GBA_UpdateDrawScanlineFn();
     GBA_DMA0Setup();
     GBA_DMA1Setup();
     GBA_DMA2Setup();
     GBA_DMA3Setup();
     GBA_SoundInit();
+    GBA_SerialInit();
     GBA_FillFadeTables();
 
     GBA_SkipFrame(0);
@@ -102,6 +126,10 @@ int GBA_EndRom(int save)
     if (save)
         GBA_SaveWriteFile();
 
+    GBA_ProfilerStop();
+    GBA_ProfilerClear();
+
+    GBA_SerialEnd();
     GBA_MemoryEnd();
 
     inited = 0;
@@ -152,26 +180,15 @@ void GBA_HandleInputFlags(u16 flags)
 
 void GBA_Screenshot(const char *path)
 {
-    unsigned char *buffer = malloc(240 * 160 * 3);
-    if (buffer == NULL)
-    {
-        Debug_ErrorMsgArg("%s(): Not enough memory.");
-        return;
-    }
+    // The PNG file is encoded by the capture threads
+    unsigned char *buffer = Capture_ScreenshotBegin();
 
     GBA_ConvertScreenBufferTo24RGB(buffer);
 
-    if (path)
-    {
-        Save_PNG(path, buffer, 240, 160, 0);
-    }
-    else
-    {
-        char *name = FU_GetNewTimestampFilename("gba_screenshot");
-        Save_PNG(name, buffer, 240, 160, 0);
-    }
+    if (path == NULL)
+        path = FU_GetNewTimestampFilename("gba_screenshot");
 
-    free(buffer);
+    Capture_ScreenshotEnd(buffer, path, 240, 160);
 }
 
 static s32 min_(s32 a, s32 b)
@@ -192,7 +209,37 @@ void GBA_RunForOneFrame(void)
     GBA_RunFor(280896); // Clocksperframe = 280896
 }
 
-u32 GBA_RunFor(s32 totalclocks)
+// Returns the clocks to the next event
+static s32 gba_update_subsystems(s32 executedclocks)
+{
+    s32 clocks, tmp;
+
+    GBA_TIMING_BEGIN(GBA_TIMING_VIDEO);
+    clocks = GBA_UpdateScreenTimings(executedclocks);
+    GBA_TIMING_END(GBA_TIMING_VIDEO);
+
+    GBA_TIMING_BEGIN(GBA_TIMING_DMA);
+    tmp = GBA_DMAUpdate(executedclocks);
+    clocks = min_(tmp, clocks);
+    GBA_TIMING_END(GBA_TIMING_DMA);
+
+    GBA_TIMING_BEGIN(GBA_TIMING_TIMERS);
+    tmp = GBA_TimersUpdate(executedclocks);
+    clocks = min_(tmp, clocks);
+    GBA_TIMING_END(GBA_TIMING_TIMERS);
+
+    GBA_TIMING_BEGIN(GBA_TIMING_SOUND);
+    tmp = GBA_SoundUpdate(executedclocks);
+    clocks = min_(tmp, clocks);
+    GBA_TIMING_END(GBA_TIMING_SOUND);
+
+    tmp = GBA_SerialUpdate(executedclocks);
+    clocks = min_(tmp, clocks);
+
+    return clocks;
+}
+
+static u32 gba_run_for(s32 totalclocks)
 {
     s32 residualclocks, executedclocks;
     totalclocks += lastresidualclocks;
@@ -223,14 +270,8 @@ u32 GBA_RunFor(s32 totalclocks)
             has_executed = executedclocks && !GBA_CPUGetHalted();
         }
 
-        clocks_to_next_event = GBA_UpdateScreenTimings(executedclocks);
-        int tmp = GBA_DMAUpdate(executedclocks);
-        clocks_to_next_event = min_(tmp, clocks_to_next_event);
-        tmp = GBA_TimersUpdate(executedclocks);
-        clocks_to_next_event = min_(tmp, clocks_to_next_event);
-        tmp = GBA_SoundUpdate(executedclocks);
-        clocks_to_next_event = min_(tmp, clocks_to_next_event);
         // Check if any other event is going to happen before
+        clocks_to_next_event = gba_update_subsystems(executedclocks);
 
         totalclocks -= executedclocks;
 
@@ -267,14 +308,8 @@ u32 GBA_RunFor(s32 totalclocks)
             has_executed = executedclocks && !GBA_CPUGetHalted();
         }
 
-        clocks_to_next_event = GBA_UpdateScreenTimings(executedclocks);
-        clocks_to_next_event = min_(GBA_DMAUpdate(executedclocks),
-                                   clocks_to_next_event);
-        clocks_to_next_event = min_(GBA_TimersUpdate(executedclocks),
-                                   clocks_to_next_event);
-        clocks_to_next_event = min_(GBA_SoundUpdate(executedclocks),
-                                   clocks_to_next_event);
         // Check if other events are going to happen earlier
+        clocks_to_next_event = gba_update_subsystems(executedclocks);
 
         totalclocks -= executedclocks;
 
@@ -291,6 +326,15 @@ u32 GBA_RunFor(s32 totalclocks)
     return has_executed;
 }
 
+u32 GBA_RunFor(s32 totalclocks)
+{
+    GBA_DebugWatchArm(1);
+    u32 has_executed = gba_run_for(totalclocks);
+    GBA_DebugWatchArm(0);
+
+    return has_executed;
+}
+
 void GBA_DebugStep(void)
 {
     // Hack to make it always execute ONLY one instruction
@@ -309,3 +353,10 @@ void GBA_DebugStep(void)
 
     lastresidualclocks += saved_lastresidualclocks;
 }
+
+void GBA_RunStateRegister(void)
+{
+    GBA_StateRegister(&clocks_to_next_event, sizeof(clocks_to_next_event));
+    GBA_StateRegister(&lastresidualclocks, sizeof(lastresidualclocks));
+    GBA_StateRegister(&gba_execution_break, sizeof(gba_execution_break));
+}
@@ -155,7 +155,14 @@ typedef struct
 
 int GBA_GetRomSize(void);
 
+// Size of the buffer used for the ROM, it covers the whole cartridge space
+#define GBA_ROM_BUFFER_SIZE (32 * 1024 * 1024)
+
 int GBA_InitRom(void *bios_ptr, void *rom_ptr, u32 romsize);
+// Like GBA_InitRom(), but it uses the buffer as ROM instead of making a copy.
+// It must have been allocated with malloc() and have GBA_ROM_BUFFER_SIZE
+// bytes. The core frees it when the ROM is unloaded.
+int GBA_InitRomBuffer(void *bios_ptr, void *rom_buffer, u32 romsize);
 int GBA_EndRom(int save);
 void GBA_Reset(void);
 
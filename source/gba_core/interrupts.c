@@ -8,8 +8,10 @@
 
 #include "bios.h"
 #include "cpu.h"
+#include "disassembler.h"
 #include "gba.h"
 #include "memory.h"
+#include "state.h"
 #include "video.h"
 
 #define SCR_DRAW      (0)
@@ -103,10 +105,10 @@ int GBA_ScreenJustChangedMode(void)
     return justchangedscreenmode;
 }
 
+static int hblinterruptexecuted = 0;
+
 s32 GBA_UpdateScreenTimings(s32 clocks)
 {
-    static int hblinterruptexecuted = 0;
-
     scrclocks -= clocks;
     justchangedscreenmode = 0;
     switch (screenmode)
@@ -142,6 +144,7 @@ s32 GBA_UpdateScreenTimings(s32 clocks)
                 {
                     REG_DISPSTAT |= BIT(0);
                     GBA_InterruptLCD(BIT(3));
+                    GBA_DebugVBlankHook();
                     screenmode = SCR_VBL_DRAW;
                     scrclocks = HDRAW_CLOCKS + scrclocks;
                 }
@@ -247,3 +250,12 @@ void GBA_InterruptInit(void)
     ly = 0;
     justchangedscreenmode = 0;
 }
+
+void GBA_InterruptsStateRegister(void)
+{
+    GBA_StateRegister(&screenmode, sizeof(screenmode));
+    GBA_StateRegister(&scrclocks, sizeof(scrclocks));
+    GBA_StateRegister(&ly, sizeof(ly));
+    GBA_StateRegister(&justchangedscreenmode, sizeof(justchangedscreenmode));
+    GBA_StateRegister(&hblinterruptexecuted, sizeof(hblinterruptexecuted));
+}
@@ -13,13 +13,16 @@
 
 #include "bios.h"
 #include "cpu.h"
+#include "disassembler.h"
 #include "dma.h"
 #include "gba.h"
 #include "interrupts.h"
 #include "memory.h"
 #include "save.h"
+#include "serial.h"
 #include "shifts.h"
 #include "sound.h"
+#include "state.h"
 #include "timers.h"
 #include "video.h"
 
@@ -132,7 +135,7 @@ static void GBA_MemoryReadFastFillArray(void)
 
 //------------------------------------------------------------------------------
 
-void GBA_MemoryInit(u32 *bios_ptr, u32 *rom_ptr, u32 romsize)
+void GBA_MemoryInit(u32 *bios_ptr, u8 *rom_buffer)
 {
     Mem.rom_bios = (u8 *)calloc(1, 16 * 1024);
     if (bios_ptr)
@@ -147,9 +150,8 @@ void GBA_MemoryInit(u32 *bios_ptr, u32 *rom_ptr, u32 romsize)
     memset(Mem.pal_ram, 0, sizeof(Mem.pal_ram));
     memset(Mem.vram, 0, sizeof(Mem.vram));
     memset(Mem.oam, 0, sizeof(Mem.oam));
+    GBA_VideoSpriteListsInvalidate();
 
-    u8 *rom_buffer = calloc(1, 0x02000000); // 32 * 1024 * 1024);
-    memcpy(rom_buffer, rom_ptr, romsize);
     Mem.rom_wait0 = rom_buffer;
     Mem.rom_wait1 = rom_buffer;
     Mem.rom_wait2 = rom_buffer;
@@ -271,7 +273,7 @@ void GBA_MemoryEnd(void)
 
 //------------------------------------------------------------------------------
 
-u32 GBA_MemoryRead32(u32 address)
+static u32 gba_memory_read32(u32 address)
 {
     register u32 data;
 
@@ -345,7 +347,7 @@ u32 GBA_MemoryRead32(u32 address)
 #endif
 }
 
-void GBA_MemoryWrite32(u32 address, u32 data)
+static void gba_memory_write32(u32 address, u32 data)
 {
     if (address < 0x02000000)
         return;
@@ -379,6 +381,8 @@ void GBA_MemoryWrite32(u32 address, u32 data)
     if (address < 0x08000000)
     {
         *((u32 *)&(Mem.oam[address & 0x3FC])) = data;
+        if ((address & 4) == 0)
+            GBA_VideoSpriteListsInvalidate();
         return;
     }
 
@@ -393,7 +397,7 @@ void GBA_MemoryWrite32(u32 address, u32 data)
     return;
 }
 
-u16 GBA_MemoryRead16(u32 address)
+static u16 gba_memory_read16(u32 address)
 {
     if (address < 0x00004000)
     {
@@ -443,7 +447,7 @@ u16 GBA_MemoryRead16(u32 address)
     return 0;
 }
 
-void GBA_MemoryWrite16(u32 address, u16 data)
+static void gba_memory_write16(u32 address, u16 data)
 {
     if (address < 0x02000000)
         return;
@@ -477,6 +481,8 @@ void GBA_MemoryWrite16(u32 address, u16 data)
     if (address < 0x08000000)
     {
         *((u16 *)&(Mem.oam[address & 0x3FE])) = data;
+        if ((address & 4) == 0)
+            GBA_VideoSpriteListsInvalidate();
         return;
     }
 
@@ -497,7 +503,7 @@ void GBA_MemoryWrite16(u32 address, u16 data)
     return;
 }
 
-u8 GBA_MemoryRead8(u32 address)
+static u8 gba_memory_read8(u32 address)
 {
     if (address < 0x00004000)
     {
@@ -553,7 +559,7 @@ static u16 expand8to16(u8 data)
     return ((u16)data) | (((u16)data) << 8);
 }
 
-void GBA_MemoryWrite8(u32 address, u8 data)
+static void gba_memory_write8(u32 address, u8 data)
 {
     if (address < 0x02000000)
         return;
@@ -587,6 +593,8 @@ void GBA_MemoryWrite8(u32 address, u8 data)
     if (address < 0x08000000)
     {
         *((u16 *)&(Mem.oam[address & 0x3FE])) = expand8to16(data);
+        if ((address & 4) == 0)
+            GBA_VideoSpriteListsInvalidate();
         return;
     }
 
@@ -615,6 +623,249 @@ void GBA_MemoryWrite8(u32 address, u8 data)
 
 //------------------------------------------------------------------------------
 
+// Watchpoint flags of each memory region and of each page. They are only set
+// while the CPU is running, so accesses done by the debugger windows don't
+// trigger them. The page flags are only checked in regions with watchpoints.
+static const u8 gba_watch_no_flags[16];
+static const u8 *gba_watch_region_flags = gba_watch_no_flags;
+static const u8 *gba_watch_page_flags;
+static int gba_watch_enabled = 0;
+
+void GBA_MemoryWatchSetFlags(const u8 *region_flags, const u8 *page_flags)
+{
+    if (region_flags && page_flags)
+    {
+        gba_watch_region_flags = region_flags;
+        gba_watch_page_flags = page_flags;
+        gba_watch_enabled = 1;
+    }
+    else
+    {
+        gba_watch_region_flags = gba_watch_no_flags;
+        gba_watch_page_flags = NULL;
+        gba_watch_enabled = 0;
+    }
+}
+
+static inline int GBA_WATCH_FLAGS(u32 address)
+{
+    if (gba_watch_region_flags[(address >> 24) & 0xF] == 0)
+        return 0;
+
+    return gba_watch_page_flags[(address & 0x0FFFFFFF) >> GBA_WATCH_PAGE_SHIFT];
+}
+
+// Reduces the number of bytes that can be accessed directly so that it stops
+// before the first page with watchpoints of the specified type. Returns 0 if
+// the page of the address itself has watchpoints.
+static int gba_watch_limit_direct(u32 address, u32 *available, int type)
+{
+    if ((gba_watch_region_flags[(address >> 24) & 0xF] & type) == 0)
+        return 1;
+
+    u32 offset = address & 0x0FFFFFFF;
+    u32 first = offset >> GBA_WATCH_PAGE_SHIFT;
+    u32 last = (offset + *available - 1) >> GBA_WATCH_PAGE_SHIFT;
+
+    for (u32 page = first; page <= last; page++)
+    {
+        if (gba_watch_page_flags[page] & type)
+        {
+            if (page == first)
+                return 0;
+
+            *available = (page << GBA_WATCH_PAGE_SHIFT) - offset;
+            return 1;
+        }
+    }
+
+    return 1;
+}
+
+u32 GBA_MemoryRead32(u32 address)
+{
+    u32 data = gba_memory_read32(address);
+
+    if (GBA_WATCH_FLAGS(address) & GBA_WATCH_READ)
+        GBA_DebugWatchAccess(address, 4, data, data, GBA_WATCH_READ);
+
+    return data;
+}
+
+void GBA_MemoryWrite32(u32 address, u32 data)
+{
+    if (GBA_WATCH_FLAGS(address) & GBA_WATCH_WRITE)
+    {
+        u32 old = GBA_MemoryReadFast32(address & ~3);
+        GBA_DebugWatchAccess(address & ~3, 4, old, data, GBA_WATCH_WRITE);
+    }
+
+    gba_memory_write32(address, data);
+}
+
+u16 GBA_MemoryRead16(u32 address)
+{
+    u16 data = gba_memory_read16(address);
+
+    if (GBA_WATCH_FLAGS(address) & GBA_WATCH_READ)
+        GBA_DebugWatchAccess(address, 2, data, data, GBA_WATCH_READ);
+
+    return data;
+}
+
+void GBA_MemoryWrite16(u32 address, u16 data)
+{
+    if (GBA_WATCH_FLAGS(address) & GBA_WATCH_WRITE)
+    {
+        u16 old = GBA_MemoryReadFast16(address & ~1);
+        GBA_DebugWatchAccess(address & ~1, 2, old, data, GBA_WATCH_WRITE);
+    }
+
+    gba_memory_write16(address, data);
+}
+
+u8 GBA_MemoryRead8(u32 address)
+{
+    u8 data = gba_memory_read8(address);
+
+    if (GBA_WATCH_FLAGS(address) & GBA_WATCH_READ)
+        GBA_DebugWatchAccess(address, 1, data, data, GBA_WATCH_READ);
+
+    return data;
+}
+
+void GBA_MemoryWrite8(u32 address, u8 data)
+{
+    if (GBA_WATCH_FLAGS(address) & GBA_WATCH_WRITE)
+    {
+        u8 old = GBA_MemoryReadFast8(address);
+        GBA_DebugWatchAccess(address, 1, old, data, GBA_WATCH_WRITE);
+    }
+
+    gba_memory_write8(address, data);
+}
+
+//------------------------------------------------------------------------------
+
+static const u8 *gba_memory_get_read_pointer(u32 address, u32 *available)
+{
+    u32 offset;
+
+    switch (address >> 24)
+    {
+        case 2:
+            offset = address & 0x3FFFF;
+            *available = sizeof(Mem.ewram) - offset;
+            return &(Mem.ewram[offset]);
+        case 3:
+            offset = address & 0x7FFF;
+            *available = sizeof(Mem.iwram) - offset;
+            return &(Mem.iwram[offset]);
+        case 5:
+            offset = address & 0x3FF;
+            *available = sizeof(Mem.pal_ram) - offset;
+            return &(Mem.pal_ram[offset]);
+        case 6:
+            if (address < 0x06018000)
+            {
+                *available = 0x06018000 - address;
+                return &(Mem.vram[address - 0x06000000]);
+            }
+            return NULL;
+        case 7:
+            offset = address & 0x3FF;
+            *available = sizeof(Mem.oam) - offset;
+            return &(Mem.oam[offset]);
+        case 8:
+        case 9:
+        case 0xA:
+        case 0xB:
+            offset = address & 0x01FFFFFF;
+            *available = 0x02000000 - offset;
+            return &(Mem.rom_wait2[offset]);
+        case 0xC:
+            // Stop before 0x0D000000, EEPROM may be mapped there
+            offset = address & 0x01FFFFFF;
+            *available = 0x01000000 - offset;
+            return &(Mem.rom_wait2[offset]);
+        default:
+            return NULL;
+    }
+}
+
+static u8 *gba_memory_get_write_pointer(u32 address, u32 *available,
+                                       int is_8bit)
+{
+    u32 offset;
+
+    switch (address >> 24)
+    {
+        case 2:
+            offset = address & 0x3FFFF;
+            *available = sizeof(Mem.ewram) - offset;
+            return &(Mem.ewram[offset]);
+        case 3:
+            offset = address & 0x7FFF;
+            *available = sizeof(Mem.iwram) - offset;
+            return &(Mem.iwram[offset]);
+        case 5:
+            if (is_8bit)
+                return NULL;
+            offset = address & 0x3FF;
+            *available = sizeof(Mem.pal_ram) - offset;
+            return &(Mem.pal_ram[offset]);
+        case 6:
+            if (is_8bit)
+                return NULL;
+            if (address < 0x06018000)
+            {
+                *available = 0x06018000 - address;
+                return &(Mem.vram[address - 0x06000000]);
+            }
+            return NULL;
+        case 7:
+            if (is_8bit)
+                return NULL;
+            // The caller may write to any sprite
+            GBA_VideoSpriteListsInvalidate();
+            offset = address & 0x3FF;
+            *available = sizeof(Mem.oam) - offset;
+            return &(Mem.oam[offset]);
+        default:
+            return NULL;
+    }
+}
+
+const u8 *GBA_MemoryGetReadPointer(u32 address, u32 *available)
+{
+    const u8 *ptr = gba_memory_get_read_pointer(address, available);
+
+    // Direct accesses would skip watchpoints
+    if ((ptr != NULL) && gba_watch_enabled)
+    {
+        if (!gba_watch_limit_direct(address, available, GBA_WATCH_READ))
+            return NULL;
+    }
+
+    return ptr;
+}
+
+u8 *GBA_MemoryGetWritePointer(u32 address, u32 *available, int is_8bit)
+{
+    u8 *ptr = gba_memory_get_write_pointer(address, available, is_8bit);
+
+    // Direct accesses would skip watchpoints
+    if ((ptr != NULL) && gba_watch_enabled)
+    {
+        if (!gba_watch_limit_direct(address, available, GBA_WATCH_WRITE))
+            return NULL;
+    }
+
+    return ptr;
+}
+
+//------------------------------------------------------------------------------
+
 void GBA_RegisterWrite32(u32 address, u32 data)
 {
     GBA_RegisterWrite16(address, (u16)data);
@@ -932,7 +1183,15 @@ void GBA_RegisterWrite16(u32 address, u16 data)
             GBA_ExecutionBreak();
             return;
 
-        case 0x4000128 - REG_BASE:
+        case SIODATA32 + 0 - REG_BASE:
+        case SIODATA32 + 2 - REG_BASE:
+        case SIOMLT_SEND - REG_BASE:
+        case RCNT - REG_BASE:
+            REG_16(address) = data;
+            GBA_SerialRegistersUpdated();
+            return;
+        case SIOCNT - REG_BASE:
+            GBA_SerialWriteSIOCNT(data);
             return;
 
         default:
@@ -1103,3 +1362,17 @@ void GBA_MemoryAccessCyclesUpdate(void)
     // 14    Game Pak Prefetch Buffer (Pipe) (0=Disable, 1=Enable)
     // 15    Game Pak Type Flag (Read Only) (0=GBA, 1=CGB) (IN35 signal)
 }
+
+void GBA_MemoryStateRegister(void)
+{
+    // The BIOS and the ROM can't be modified
+    GBA_StateRegister(Mem.ewram, sizeof(Mem.ewram));
+    GBA_StateRegister(Mem.iwram, sizeof(Mem.iwram));
+    GBA_StateRegister(Mem.io_regs, sizeof(Mem.io_regs));
+    GBA_StateRegister(Mem.pal_ram, sizeof(Mem.pal_ram));
+    GBA_StateRegister(Mem.vram, sizeof(Mem.vram));
+    GBA_StateRegister(Mem.oam, sizeof(Mem.oam));
+
+    GBA_StateRegister(wait_table_seq, sizeof(wait_table_seq));
+    GBA_StateRegister(wait_table_nonseq, sizeof(wait_table_nonseq));
+}
@@ -13,7 +13,8 @@ extern _mem_t Mem;
 
 //----------------------------------------------------------------------
 
-void GBA_MemoryInit(u32 *bios_ptr, u32 *rom_ptr, u32 romsize);
+// The ROM buffer is owned by the memory until GBA_MemoryEnd() is called
+void GBA_MemoryInit(u32 *bios_ptr, u8 *rom_buffer);
 void GBA_MemoryEnd(void);
 
 //----------------------------------------------------------------------
@@ -34,6 +35,28 @@ void GBA_MemoryWrite16(u32 address, u16 data);
 u8 GBA_MemoryRead8(u32 address);
 void GBA_MemoryWrite8(u32 address, u8 data);
 
+// They return a pointer to the host buffer that backs the specified address if
+// it belongs to a region that can be accessed directly (RAM or ROM, not I/O
+// registers, BIOS or save memory), or NULL otherwise. The number of bytes that
+// can be accessed from the pointer before reaching the end of the region or a
+// mirror is returned in 'available'. VRAM, palette and OAM are only returned
+// for writes that aren't 8-bit, as 8-bit writes to them behave differently.
+// While watchpoints are enabled, 'available' also stops before the first page
+// that has watchpoints of that type.
+const u8 *GBA_MemoryGetReadPointer(u32 address, u32 *available);
+u8 *GBA_MemoryGetWritePointer(u32 address, u32 *available, int is_8bit);
+
+// Watchpoints are checked in pages of 4 KB of the 28-bit address space
+#define GBA_WATCH_PAGE_SHIFT    12
+#define GBA_WATCH_NUM_PAGES     (0x10000000 >> GBA_WATCH_PAGE_SHIFT)
+
+// Sets the watchpoint flags (GBA_WATCH_READ, GBA_WATCH_WRITE) of each of the
+// 16 memory regions (address >> 24) and of each page. The flags of a region
+// must be the combination of the flags of all its pages. The arrays aren't
+// copied, they must remain valid until the flags are changed again. NULL
+// disables all watchpoint checks.
+void GBA_MemoryWatchSetFlags(const u8 *region_flags, const u8 *page_flags);
+
 //----------------------------------------------------------------------
 
 void GBA_RegisterWrite32(u32 address, u32 data);
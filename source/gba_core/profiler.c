@@ -0,0 +1,967 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../build_options.h"
+#include "../debug_utils.h"
+#include "../file_utils.h"
+
+#include "cpu.h"
+#include "gba.h"
+#include "profiler.h"
+
+//------------------------------------------------------------------------------
+
+// The cycles are accumulated in 16-byte buckets of code. The address space is
+// split in pages, and only the pages with code that has been executed are
+// allocated.
+#define GBA_PROF_BUCKET_SHIFT 4
+#define GBA_PROF_PAGE_SHIFT   16
+#define GBA_PROF_PAGES        (1 << (32 - GBA_PROF_PAGE_SHIFT))
+#define GBA_PROF_PAGE_BUCKETS \
+        (1 << (GBA_PROF_PAGE_SHIFT - GBA_PROF_BUCKET_SHIFT))
+
+static u64 *gba_prof_pages[GBA_PROF_PAGES];
+
+// Call tree. Each node is a function called from the function of the parent
+// node. Node 0 is the root, it gets the cycles spent outside of any call that
+// has been detected (for example, before the first call).
+#define GBA_PROF_MAX_NODES 32768
+
+typedef struct {
+    u32 addr;    // Entry address of the function
+    s32 parent;
+    s32 child;   // First child
+    s32 sibling; // Next child of the parent
+    u64 self;
+} _gba_prof_node_t;
+
+static _gba_prof_node_t *gba_prof_nodes = NULL;
+static int gba_prof_num_nodes = 0;
+static int gba_prof_current = 0; // Node of the code being executed
+
+// Calls that haven't returned yet
+#define GBA_PROF_MAX_DEPTH 256
+
+typedef struct {
+    s32 caller; // Node to go back to when returning
+    u32 ret;    // Return address
+} _gba_prof_frame_t;
+
+static _gba_prof_frame_t gba_prof_stack[GBA_PROF_MAX_DEPTH];
+static int gba_prof_depth = 0;
+
+static int gba_prof_enabled = 0;
+
+static u64 gba_prof_halted = 0;
+
+// Instruction that is being executed. Its cycles are known when the CPU loop
+// starts the next instruction or returns.
+static int gba_prof_pending = 0;
+static u32 gba_prof_pc = 0;
+static u32 gba_prof_size = 0;
+static s32 gba_prof_clocks = 0;
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+    u32 addr;
+    u32 size; // 0 if unknown
+    char *name;
+} _gba_prof_symbol_t;
+
+// Symbols loaded from a file, sorted by address
+static _gba_prof_symbol_t *gba_prof_symbols = NULL;
+static int gba_prof_num_symbols = 0;
+static int gba_prof_symbols_capacity = 0;
+
+void GBA_ProfilerClearSymbols(void)
+{
+    for (int i = 0; i < gba_prof_num_symbols; i++)
+        free(gba_prof_symbols[i].name);
+
+    free(gba_prof_symbols);
+    gba_prof_symbols = NULL;
+    gba_prof_num_symbols = 0;
+    gba_prof_symbols_capacity = 0;
+}
+
+// Returns the index of the symbol that contains the address, or -1
+static int gba_prof_symbol_find(const _gba_prof_symbol_t *syms, int count,
+                                u32 addr)
+{
+    int min = 0;
+    int max = count - 1;
+    int found = -1;
+
+    while (min <= max)
+    {
+        int mid = (min + max) / 2;
+
+        if (syms[mid].addr <= addr)
+        {
+            found = mid;
+            min = mid + 1;
+        }
+        else
+        {
+            max = mid - 1;
+        }
+    }
+
+    if (found == -1)
+        return -1;
+
+    // Map files don't have the size of the symbols
+    if (syms[found].size == 0)
+        return found;
+
+    if (addr - syms[found].addr < syms[found].size)
+        return found;
+
+    return -1;
+}
+
+static int gba_prof_symbol_is_start(u32 addr)
+{
+    int i = gba_prof_symbol_find(gba_prof_symbols, gba_prof_num_symbols, addr);
+    if (i == -1)
+        return 0;
+
+    return gba_prof_symbols[i].addr == addr;
+}
+
+//------------------------------------------------------------------------------
+
+void GBA_ProfilerClear(void)
+{
+    for (int i = 0; i < GBA_PROF_PAGES; i++)
+    {
+        free(gba_prof_pages[i]);
+        gba_prof_pages[i] = NULL;
+    }
+
+    if (gba_prof_nodes)
+    {
+        _gba_prof_node_t *root = &gba_prof_nodes[0];
+
+        root->addr = 0;
+        root->parent = -1;
+        root->child = -1;
+        root->sibling = -1;
+        root->self = 0;
+
+        gba_prof_num_nodes = 1;
+    }
+
+    gba_prof_current = 0;
+    gba_prof_depth = 0;
+    gba_prof_halted = 0;
+
+    gba_prof_pending = 0;
+    gba_prof_pc = 0;
+    gba_prof_size = 0;
+}
+
+int GBA_ProfilerStart(void)
+{
+    if (gba_prof_nodes == NULL)
+    {
+        gba_prof_nodes = malloc(GBA_PROF_MAX_NODES * sizeof(_gba_prof_node_t));
+        if (gba_prof_nodes == NULL)
+        {
+            Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+            return 0;
+        }
+    }
+
+    GBA_ProfilerClear();
+
+    gba_prof_enabled = 1;
+
+    return 1;
+}
+
+void GBA_ProfilerStop(void)
+{
+    gba_prof_enabled = 0;
+    gba_prof_pending = 0;
+}
+
+int GBA_ProfilerIsEnabled(void)
+{
+    return gba_prof_enabled;
+}
+
+//------------------------------------------------------------------------------
+
+static void gba_prof_add_cycles(s32 cycles)
+{
+    if (cycles <= 0)
+        return;
+
+    u64 **page = &gba_prof_pages[gba_prof_pc >> GBA_PROF_PAGE_SHIFT];
+
+    if (*page == NULL)
+    {
+        *page = calloc(GBA_PROF_PAGE_BUCKETS, sizeof(u64));
+        if (*page == NULL)
+        {
+            Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+            GBA_ProfilerStop();
+            return;
+        }
+    }
+
+    u32 offset = gba_prof_pc & ((1 << GBA_PROF_PAGE_SHIFT) - 1);
+    (*page)[offset >> GBA_PROF_BUCKET_SHIFT] += cycles;
+
+    gba_prof_nodes[gba_prof_current].self += cycles;
+}
+
+// Returns the child of the node for the function at the specified address. If
+// there is no space for new nodes, it returns the parent.
+static int gba_prof_get_child(int parent, u32 addr)
+{
+    for (int n = gba_prof_nodes[parent].child; n != -1;
+         n = gba_prof_nodes[n].sibling)
+    {
+        if (gba_prof_nodes[n].addr == addr)
+            return n;
+    }
+
+    if (gba_prof_num_nodes == GBA_PROF_MAX_NODES)
+        return parent;
+
+    int n = gba_prof_num_nodes++;
+    _gba_prof_node_t *node = &gba_prof_nodes[n];
+
+    node->addr = addr;
+    node->parent = parent;
+    node->child = -1;
+    node->sibling = gba_prof_nodes[parent].child;
+    node->self = 0;
+
+    gba_prof_nodes[parent].child = n;
+
+    return n;
+}
+
+// Called when the PC isn't the address after the previous instruction
+static void gba_prof_branch(u32 pc)
+{
+    if (gba_prof_size == 0) // No previous instruction
+        return;
+
+    // Check if this returns to any of the callers. Normally it is the last one,
+    // but functions like longjmp() can return to any of them.
+    for (int i = gba_prof_depth - 1; i >= 0; i--)
+    {
+        if (gba_prof_stack[i].ret == pc)
+        {
+            gba_prof_current = gba_prof_stack[i].caller;
+            gba_prof_depth = i;
+            return;
+        }
+    }
+
+    u32 lr = CPU.R[R_LR];
+    u32 ret;
+
+    if (pc == 0x18) // IRQ vector. Handlers return with "subs pc, lr, #4"
+    {
+        ret = lr - 4;
+    }
+    else if (pc == 0x08) // SWI vector
+    {
+        ret = lr;
+    }
+    else if ((lr & ~1) == (gba_prof_pc + gba_prof_size))
+    {
+        // BL, or "mov lr, pc" followed by "bx rn"
+        ret = lr & ~1;
+    }
+    else
+    {
+        // Regular jump. If it jumps to the start of a function it is a tail
+        // call, which replaces the current function.
+        if (gba_prof_symbol_is_start(pc))
+        {
+            int parent = 0;
+            if (gba_prof_depth > 0)
+                parent = gba_prof_stack[gba_prof_depth - 1].caller;
+
+            gba_prof_current = gba_prof_get_child(parent, pc);
+        }
+        return;
+    }
+
+    if (gba_prof_depth == GBA_PROF_MAX_DEPTH)
+        return;
+
+    gba_prof_stack[gba_prof_depth].caller = gba_prof_current;
+    gba_prof_stack[gba_prof_depth].ret = ret;
+    gba_prof_depth++;
+
+    gba_prof_current = gba_prof_get_child(gba_prof_current, pc);
+}
+
+void GBA_ProfilerStep(u32 pc, s32 clocks, u32 instr_size)
+{
+    if (gba_prof_pending)
+        gba_prof_add_cycles(gba_prof_clocks - clocks);
+
+    if (pc != gba_prof_pc + gba_prof_size)
+        gba_prof_branch(pc);
+
+    gba_prof_pending = 1;
+    gba_prof_pc = pc;
+    gba_prof_size = instr_size;
+    gba_prof_clocks = clocks;
+}
+
+void GBA_ProfilerFlush(s32 clocks)
+{
+    if (gba_prof_pending)
+        gba_prof_add_cycles(gba_prof_clocks - clocks);
+
+    gba_prof_pending = 0;
+}
+
+void GBA_ProfilerHalted(s32 clocks)
+{
+    gba_prof_halted += clocks;
+}
+
+//------------------------------------------------------------------------------
+
+static u32 gba_prof_read16(const u8 *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static u32 gba_prof_read32(const u8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static int gba_prof_symbol_add(u32 addr, u32 size, const char *name,
+                               size_t name_len)
+{
+    if (gba_prof_num_symbols == gba_prof_symbols_capacity)
+    {
+        int capacity = gba_prof_symbols_capacity ?
+                       gba_prof_symbols_capacity * 2 : 1024;
+
+        _gba_prof_symbol_t *syms = realloc(gba_prof_symbols,
+                                           capacity * sizeof(*syms));
+        if (syms == NULL)
+            return 0;
+
+        gba_prof_symbols = syms;
+        gba_prof_symbols_capacity = capacity;
+    }
+
+    char *copy = malloc(name_len + 1);
+    if (copy == NULL)
+        return 0;
+
+    memcpy(copy, name, name_len);
+    copy[name_len] = '\0';
+
+    _gba_prof_symbol_t *s = &gba_prof_symbols[gba_prof_num_symbols++];
+    s->addr = addr & ~1; // Remove the THUMB bit
+    s->size = size;
+    s->name = copy;
+
+    return 1;
+}
+
+static int gba_prof_symbol_compare(const void *a, const void *b)
+{
+    const _gba_prof_symbol_t *sa = a;
+    const _gba_prof_symbol_t *sb = b;
+
+    return (sa->addr > sb->addr) - (sa->addr < sb->addr);
+}
+
+// Sorts the symbols and removes duplicated addresses
+static void gba_prof_symbols_sort(void)
+{
+    if (gba_prof_num_symbols == 0)
+        return;
+
+    qsort(gba_prof_symbols, gba_prof_num_symbols, sizeof(_gba_prof_symbol_t),
+          gba_prof_symbol_compare);
+
+    int out = 1;
+    for (int i = 1; i < gba_prof_num_symbols; i++)
+    {
+        if (gba_prof_symbols[i].addr == gba_prof_symbols[out - 1].addr)
+        {
+            // Keep the one with a size, if any
+            if (gba_prof_symbols[out - 1].size == 0)
+            {
+                free(gba_prof_symbols[out - 1].name);
+                gba_prof_symbols[out - 1] = gba_prof_symbols[i];
+            }
+            else
+            {
+                free(gba_prof_symbols[i].name);
+            }
+            continue;
+        }
+
+        gba_prof_symbols[out++] = gba_prof_symbols[i];
+    }
+
+    gba_prof_num_symbols = out;
+}
+
+#define ELF_SHT_SYMTAB  2
+#define ELF_STT_NOTYPE  0
+#define ELF_STT_FUNC    2
+
+static int gba_prof_load_elf(const u8 *data, size_t size)
+{
+    if ((size < 52) || (memcmp(data, "\x7F" "ELF", 4) != 0))
+    {
+        Debug_ErrorMsgArg("Not an ELF file");
+        return 0;
+    }
+
+    if ((data[4] != 1) || (data[5] != 1)) // 32-bit, little endian
+    {
+        Debug_ErrorMsgArg("Unsupported ELF file: Not 32-bit little endian");
+        return 0;
+    }
+
+    u32 shoff = gba_prof_read32(&data[0x20]);
+    u32 shentsize = gba_prof_read16(&data[0x2E]);
+    u32 shnum = gba_prof_read16(&data[0x30]);
+
+    if ((shentsize < 40) || (shoff > size)
+        || ((size - shoff) / shentsize < shnum))
+    {
+        Debug_ErrorMsgArg("Invalid ELF section headers");
+        return 0;
+    }
+
+    for (u32 i = 0; i < shnum; i++)
+    {
+        const u8 *sh = &data[shoff + i * shentsize];
+
+        if (gba_prof_read32(&sh[4]) != ELF_SHT_SYMTAB)
+            continue;
+
+        u32 sym_offset = gba_prof_read32(&sh[0x10]);
+        u32 sym_size = gba_prof_read32(&sh[0x14]);
+        u32 link = gba_prof_read32(&sh[0x18]);
+        u32 entsize = gba_prof_read32(&sh[0x24]);
+
+        if ((link >= shnum) || (entsize < 16) || (sym_offset > size)
+            || (sym_size > size - sym_offset))
+            continue;
+
+        const u8 *strsh = &data[shoff + link * shentsize];
+        u32 str_offset = gba_prof_read32(&strsh[0x10]);
+        u32 str_size = gba_prof_read32(&strsh[0x14]);
+
+        if ((str_offset > size) || (str_size > size - str_offset))
+            continue;
+
+        const char *strtab = (const char *)&data[str_offset];
+
+        for (u32 j = 0; j + entsize <= sym_size; j += entsize)
+        {
+            const u8 *sym = &data[sym_offset + j];
+
+            u32 name = gba_prof_read32(&sym[0]);
+            u32 value = gba_prof_read32(&sym[4]);
+            u32 sym_len = gba_prof_read32(&sym[8]);
+            int type = sym[12] & 0xF;
+            u32 shndx = gba_prof_read16(&sym[14]);
+
+            // Functions written in assembly are usually NOTYPE
+            if ((type != ELF_STT_FUNC) && (type != ELF_STT_NOTYPE))
+                continue;
+
+            if ((shndx == 0) || (name >= str_size))
+                continue;
+
+            const char *end = memchr(&strtab[name], '\0', str_size - name);
+            if (end == NULL)
+                continue;
+
+            size_t len = end - &strtab[name];
+
+            // Skip ARM mapping symbols ($a, $t, $d) and local labels
+            if ((len == 0) || (strtab[name] == '$') || (strtab[name] == '.'))
+                continue;
+
+            if (gba_prof_symbol_add(value, sym_len, &strtab[name], len) == 0)
+            {
+                Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int gba_prof_is_identifier(const char *name)
+{
+    if (!(((name[0] >= 'a') && (name[0] <= 'z'))
+          || ((name[0] >= 'A') && (name[0] <= 'Z')) || (name[0] == '_')))
+        return 0;
+
+    for (const char *c = name; *c != '\0'; c++)
+    {
+        if (!(((*c >= 'a') && (*c <= 'z')) || ((*c >= 'A') && (*c <= 'Z'))
+              || ((*c >= '0') && (*c <= '9')) || (*c == '_') || (*c == '.')))
+            return 0;
+    }
+
+    return 1;
+}
+
+// GNU ld map files have symbols in lines with the format "0xADDRESS name"
+static int gba_prof_load_map(const u8 *data, size_t size)
+{
+    char *text = malloc(size + 1);
+    if (text == NULL)
+    {
+        Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    memcpy(text, data, size);
+    text[size] = '\0';
+
+    char *line = text;
+
+    while (*line != '\0')
+    {
+        char *next = strchr(line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        else
+            next = line + strlen(line);
+
+        unsigned int addr;
+        char name[128];
+        char extra;
+
+        if (sscanf(line, " 0x%x %127s %c", &addr, name, &extra) == 2)
+        {
+            if (gba_prof_is_identifier(name))
+            {
+                if (gba_prof_symbol_add(addr, 0, name, strlen(name)) == 0)
+                {
+                    Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+                    free(text);
+                    return 0;
+                }
+            }
+        }
+
+        line = next;
+    }
+
+    free(text);
+
+    return 1;
+}
+
+int GBA_ProfilerLoadSymbols(const char *path)
+{
+    GBA_ProfilerClearSymbols();
+
+    void *data;
+    size_t size;
+    FileLoad_NoError(path, &data, &size);
+    if (data == NULL)
+    {
+        Debug_ErrorMsgArg("Couldn't load symbols from %s", path);
+        return 0;
+    }
+
+    int ret;
+    size_t len = strlen(path);
+
+    if ((len > 4) && (strcmp(&path[len - 4], ".map") == 0))
+        ret = gba_prof_load_map(data, size);
+    else
+        ret = gba_prof_load_elf(data, size);
+
+    free(data);
+
+    if (ret == 0)
+    {
+        GBA_ProfilerClearSymbols();
+        return 0;
+    }
+
+    gba_prof_symbols_sort();
+
+    Debug_LogMsgArg("Loaded %d symbols from %s", gba_prof_num_symbols, path);
+
+    return 1;
+}
+
+int GBA_ProfilerLoadSymbolsForROM(const char *rom_path)
+{
+    GBA_ProfilerClearSymbols();
+
+    char path[MAX_PATHLEN];
+    s_strncpy(path, rom_path, sizeof(path) - 4);
+
+    // Remove the extension of the ROM, if any
+    char *dot = strrchr(path, '.');
+    if ((dot != NULL) && (strchr(dot, '/') == NULL)
+        && (strchr(dot, '\\') == NULL))
+        *dot = '\0';
+
+    size_t len = strlen(path);
+
+    s_strncpy(&path[len], ".elf", sizeof(path) - len);
+    if (FileExists(path))
+        return GBA_ProfilerLoadSymbols(path);
+
+    s_strncpy(&path[len], ".map", sizeof(path) - len);
+    if (FileExists(path))
+        return GBA_ProfilerLoadSymbols(path);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// Symbols used to show the results. If no symbols have been loaded, there is
+// one symbol for each function that has been called.
+static _gba_prof_symbol_t *gba_prof_view_symbols;
+static int gba_prof_view_num_symbols;
+static char (*gba_prof_view_names)[16];
+
+static int gba_prof_view_prepare(void)
+{
+    if (gba_prof_num_symbols > 0)
+    {
+        gba_prof_view_symbols = gba_prof_symbols;
+        gba_prof_view_num_symbols = gba_prof_num_symbols;
+        gba_prof_view_names = NULL;
+        return 1;
+    }
+
+    gba_prof_view_symbols = malloc(gba_prof_num_nodes *
+                                   sizeof(_gba_prof_symbol_t));
+    gba_prof_view_names = malloc(gba_prof_num_nodes *
+                                 sizeof(*gba_prof_view_names));
+
+    if ((gba_prof_view_symbols == NULL) || (gba_prof_view_names == NULL))
+    {
+        Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+        free(gba_prof_view_symbols);
+        free(gba_prof_view_names);
+        return 0;
+    }
+
+    // Skip the root node
+    for (int n = 1; n < gba_prof_num_nodes; n++)
+    {
+        _gba_prof_symbol_t *s = &gba_prof_view_symbols[n - 1];
+
+        snprintf(gba_prof_view_names[n - 1], sizeof(gba_prof_view_names[0]),
+                 "sub_%08X", (unsigned int)gba_prof_nodes[n].addr);
+
+        s->addr = gba_prof_nodes[n].addr;
+        s->size = 0;
+        s->name = gba_prof_view_names[n - 1];
+    }
+
+    int count = gba_prof_num_nodes - 1;
+
+    if (count > 0)
+    {
+        qsort(gba_prof_view_symbols, count, sizeof(_gba_prof_symbol_t),
+              gba_prof_symbol_compare);
+    }
+
+    // The same function can be in several nodes
+    int out = (count > 0) ? 1 : 0;
+    for (int i = 1; i < count; i++)
+    {
+        _gba_prof_symbol_t *s = &gba_prof_view_symbols[i];
+
+        if (s->addr != gba_prof_view_symbols[out - 1].addr)
+            gba_prof_view_symbols[out++] = *s;
+    }
+
+    gba_prof_view_num_symbols = out;
+
+    return 1;
+}
+
+static void gba_prof_view_end(void)
+{
+    if (gba_prof_view_names != NULL)
+    {
+        free(gba_prof_view_symbols);
+        free(gba_prof_view_names);
+        gba_prof_view_names = NULL;
+    }
+
+    gba_prof_view_symbols = NULL;
+    gba_prof_view_num_symbols = 0;
+}
+
+// Returns an array with the index of the view symbol of each node, or -1
+static int *gba_prof_view_node_symbols(void)
+{
+    int *node_sym = malloc(gba_prof_num_nodes * sizeof(int));
+    if (node_sym == NULL)
+        return NULL;
+
+    node_sym[0] = -1;
+    for (int n = 1; n < gba_prof_num_nodes; n++)
+    {
+        node_sym[n] = gba_prof_symbol_find(gba_prof_view_symbols,
+                                           gba_prof_view_num_symbols,
+                                           gba_prof_nodes[n].addr);
+    }
+
+    return node_sym;
+}
+
+typedef struct {
+    u64 self;
+    u64 total;
+    int sym;
+} _gba_prof_top_t;
+
+static int gba_prof_top_compare(const void *a, const void *b)
+{
+    const _gba_prof_top_t *ta = a;
+    const _gba_prof_top_t *tb = b;
+
+    if (ta->self != tb->self)
+        return (ta->self < tb->self) ? 1 : -1;
+
+    return (ta->total < tb->total) - (ta->total > tb->total);
+}
+
+int GBA_ProfilerGetTop(gba_profiler_entry *entries, int max,
+                       u64 *total_cycles)
+{
+    *total_cycles = 0;
+
+    if (gba_prof_nodes == NULL)
+        return 0;
+
+    if (gba_prof_view_prepare() == 0)
+        return 0;
+
+    // The last two entries are for unknown code and for the halted CPU
+    int count = gba_prof_view_num_symbols;
+    int unknown = count;
+    int halted = count + 1;
+
+    _gba_prof_top_t *top = calloc(count + 2, sizeof(_gba_prof_top_t));
+    u64 *node_total = malloc(gba_prof_num_nodes * sizeof(u64));
+    int *node_sym = gba_prof_view_node_symbols();
+
+    if ((top == NULL) || (node_total == NULL) || (node_sym == NULL))
+    {
+        Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+        free(top);
+        free(node_total);
+        free(node_sym);
+        gba_prof_view_end();
+        return 0;
+    }
+
+    for (int i = 0; i < count + 2; i++)
+        top[i].sym = i;
+
+    // Self cycles come from the buckets, so they don't depend on the calls
+    // being detected correctly.
+    for (u32 p = 0; p < GBA_PROF_PAGES; p++)
+    {
+        u64 *page = gba_prof_pages[p];
+        if (page == NULL)
+            continue;
+
+        for (u32 b = 0; b < GBA_PROF_PAGE_BUCKETS; b++)
+        {
+            if (page[b] == 0)
+                continue;
+
+            u32 addr = (p << GBA_PROF_PAGE_SHIFT)
+                     | (b << GBA_PROF_BUCKET_SHIFT);
+            int s = gba_prof_symbol_find(gba_prof_view_symbols, count, addr);
+            if (s == -1)
+                s = unknown;
+
+            top[s].self += page[b];
+            *total_cycles += page[b];
+        }
+    }
+
+    top[halted].self = gba_prof_halted;
+    top[halted].total = gba_prof_halted;
+    *total_cycles += gba_prof_halted;
+
+    // Total cycles come from the call tree. Children are always created after
+    // their parents, so they have higher indices.
+    for (int n = 0; n < gba_prof_num_nodes; n++)
+        node_total[n] = gba_prof_nodes[n].self;
+
+    for (int n = gba_prof_num_nodes - 1; n > 0; n--)
+        node_total[gba_prof_nodes[n].parent] += node_total[n];
+
+    for (int n = 1; n < gba_prof_num_nodes; n++)
+    {
+        int s = node_sym[n];
+        if (s == -1)
+            s = unknown;
+
+        // Don't count recursive calls twice
+        int recursive = 0;
+        for (int a = gba_prof_nodes[n].parent; a > 0;
+             a = gba_prof_nodes[a].parent)
+        {
+            if (node_sym[a] == node_sym[n])
+            {
+                recursive = 1;
+                break;
+            }
+        }
+
+        if (!recursive)
+            top[s].total += node_total[n];
+    }
+
+    // A function can't take less time than its own code
+    for (int i = 0; i < count + 1; i++)
+    {
+        if (top[i].total < top[i].self)
+            top[i].total = top[i].self;
+    }
+
+    qsort(top, count + 2, sizeof(_gba_prof_top_t), gba_prof_top_compare);
+
+    int filled = 0;
+
+    for (int i = 0; (i < count + 2) && (filled < max); i++)
+    {
+        if (top[i].self == 0)
+            break;
+
+        gba_profiler_entry *e = &entries[filled++];
+
+        if (top[i].sym == unknown)
+            s_strncpy(e->name, "[unknown]", sizeof(e->name));
+        else if (top[i].sym == halted)
+            s_strncpy(e->name, "[halted]", sizeof(e->name));
+        else
+            s_strncpy(e->name, gba_prof_view_symbols[top[i].sym].name,
+                      sizeof(e->name));
+
+        e->self = top[i].self;
+        e->total = top[i].total;
+    }
+
+    free(top);
+    free(node_total);
+    free(node_sym);
+    gba_prof_view_end();
+
+    return filled;
+}
+
+static void gba_prof_node_name(int n, const int *node_sym, char *dest,
+                               size_t size)
+{
+    if (n == 0)
+        s_strncpy(dest, "[root]", size);
+    else if (node_sym[n] != -1)
+        s_strncpy(dest, gba_prof_view_symbols[node_sym[n]].name, size);
+    else
+        snprintf(dest, size, "0x%08X", (unsigned int)gba_prof_nodes[n].addr);
+}
+
+int GBA_ProfilerSaveFolded(const char *path)
+{
+    if (gba_prof_nodes == NULL)
+    {
+        Debug_ErrorMsgArg("The profiler hasn't been started");
+        return 0;
+    }
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+    {
+        Debug_ErrorMsgArg("Couldn't open %s for writing.", path);
+        return 0;
+    }
+
+    if (gba_prof_view_prepare() == 0)
+    {
+        fclose(f);
+        return 0;
+    }
+
+    int *node_sym = gba_prof_view_node_symbols();
+    if (node_sym == NULL)
+    {
+        Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+        gba_prof_view_end();
+        fclose(f);
+        return 0;
+    }
+
+    // Tail calls don't make the tree deeper than the call stack
+    static int path_nodes[GBA_PROF_MAX_DEPTH + 2];
+    char name[128];
+
+    for (int n = 0; n < gba_prof_num_nodes; n++)
+    {
+        if (gba_prof_nodes[n].self == 0)
+            continue;
+
+        int depth = 0;
+        for (int a = n; (a > 0) && (depth < GBA_PROF_MAX_DEPTH + 2);
+             a = gba_prof_nodes[a].parent)
+        {
+            path_nodes[depth++] = a;
+        }
+
+        if (depth == 0) // Root node
+            path_nodes[depth++] = 0;
+
+        for (int i = depth - 1; i >= 0; i--)
+        {
+            gba_prof_node_name(path_nodes[i], node_sym, name, sizeof(name));
+            fprintf(f, "%s%c", name, (i > 0) ? ';' : ' ');
+        }
+
+        fprintf(f, "%llu\n", (unsigned long long)gba_prof_nodes[n].self);
+    }
+
+    if (gba_prof_halted > 0)
+        fprintf(f, "[halted] %llu\n", (unsigned long long)gba_prof_halted);
+
+    free(node_sym);
+    gba_prof_view_end();
+
+    fclose(f);
+
+    return 1;
+}
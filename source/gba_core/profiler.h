@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GBA_PROFILER__
+#define GBA_PROFILER__
+
+#include "gba.h"
+
+// Guest code profiler. It accumulates the cycles executed in 16-byte buckets
+// of code and follows calls and returns to build a call tree. Symbols can be
+// loaded from an ELF file or from a GNU ld map file.
+
+// Like breakpoints, the CPU loop only checks if the profiler is enabled when
+// the loop is entered, so starting or stopping it while the CPU is running may
+// take effect a bit later.
+int GBA_ProfilerStart(void); // Returns 1 on success. Clears previous results.
+void GBA_ProfilerStop(void);
+int GBA_ProfilerIsEnabled(void);
+void GBA_ProfilerClear(void);
+
+// Called by the CPU loop right before executing an instruction
+void GBA_ProfilerStep(u32 pc, s32 clocks, u32 instr_size);
+// Called when the CPU loop returns the residual clocks
+void GBA_ProfilerFlush(s32 clocks);
+// Called for the clocks that the CPU spends halted
+void GBA_ProfilerHalted(s32 clocks);
+
+// Loads symbols from an ELF file or, if the name ends in ".map", from a GNU ld
+// map file. Returns 1 on success.
+int GBA_ProfilerLoadSymbols(const char *path);
+// Looks for "<rom name>.elf" or "<rom name>.map" and loads the symbols if any
+// of them exists. Returns 1 if symbols were loaded.
+int GBA_ProfilerLoadSymbolsForROM(const char *rom_path);
+void GBA_ProfilerClearSymbols(void);
+
+typedef struct {
+    char name[64];
+    u64 self;  // Cycles spent in the function itself
+    u64 total; // Cycles including the functions it calls
+} gba_profiler_entry;
+
+// Fills the array with the functions with the most self cycles, sorted. It
+// returns the number of entries filled. The total number of profiled cycles
+// is returned in total_cycles.
+int GBA_ProfilerGetTop(gba_profiler_entry *entries, int max,
+                       u64 *total_cycles);
+
+// Saves the call tree as folded stacks ("main;foo;bar 1234" per line), which
+// can be used to generate flame graphs. Returns 1 on success.
+int GBA_ProfilerSaveFolded(const char *path);
+
+#endif // GBA_PROFILER__
@@ -11,12 +11,14 @@
 
 #include "../build_options.h"
 #include "../debug_utils.h"
+#include "../file_utils.h"
 
 #include "cpu.h"
 #include "dma.h"
 #include "gba.h"
 #include "memory.h"
 #include "save.h"
+#include "state.h"
 #include "video.h"
 
 static const char *save_type_strings[5] = {
@@ -164,6 +166,24 @@ void GBA_ResetSaveBuffer(void)
 
 char SAVE_PATH[MAX_PATHLEN];
 
+// Set whenever the game writes to the save memory, used for autosave.
+static int save_dirty;
+
+int GBA_SaveIsDirty(void)
+{
+    return save_dirty;
+}
+
+void GBA_SaveClearDirty(void)
+{
+    save_dirty = 0;
+}
+
+void GBA_SaveGetFilename(char *path, size_t size)
+{
+    s_strncpy(path, SAVE_PATH, size);
+}
+
 void GBA_SaveSetFilename(char *rom_path)
 {
     if (strlen(rom_path) > (MAX_PATHLEN - 1))
@@ -338,6 +358,8 @@ u16 GBA_SaveRead16(unused__ u32 address)
 
 void GBA_SaveWrite8(u32 address, u8 data)
 {
+    save_dirty = 1;
+
     if (SAVE_TYPE == SAV_AUTODETECT)
     {
         //Debug_DebugMsgArg("Autodetect: Write 8bit [%08X]=%02X", address,
@@ -605,6 +627,8 @@ void GBA_SaveWrite8(u32 address, u8 data)
 
 void GBA_SaveWrite16(u32 address, u16 data)
 {
+    save_dirty = 1;
+
     if (SAVE_TYPE == SAV_AUTODETECT)
     {
         //Debug_DebugMsgArg("Autodetect: Write 16bit [%08X]=%04X", address, data);
@@ -739,80 +763,49 @@ void GBA_SaveWrite16(u32 address, u16 data)
 
 //---------------------------------------------------------------
 
-void GBA_SaveWriteFile(void)
+size_t GBA_SaveGetData(u8 *buffer)
 {
     switch (SAVE_TYPE)
     {
         case SAV_SRAM:
-        {
-            FILE *f = fopen(SAVE_PATH, "wb");
-            if (f == NULL)
-            {
-                Debug_ErrorMsgArg("Couldn't open file for saving.");
-                return;
-            }
-            if (fwrite(SRAM_BUFFER, sizeof(SRAM_BUFFER), 1, f) != 1)
-            {
-                Debug_ErrorMsgArg("Couldn't save data to file.");
-            }
-            fclose(f);
-            return;
-        }
+            memcpy(buffer, SRAM_BUFFER, sizeof(SRAM_BUFFER));
+            return sizeof(SRAM_BUFFER);
         case SAV_FLASH:
         case SAV_FLASH512:
-        {
-            FILE *f = fopen(SAVE_PATH, "wb");
-            if (f == NULL)
-            {
-                Debug_ErrorMsgArg("Couldn't open file for saving.");
-                return;
-            }
-            if (fwrite(FLASH_BUFFER512, sizeof(FLASH_BUFFER512), 1, f) != 1)
-            {
-                Debug_ErrorMsgArg("Couldn't save data to file.");
-            }
-            fclose(f);
-            return;
-        }
+            memcpy(buffer, FLASH_BUFFER512, sizeof(FLASH_BUFFER512));
+            return sizeof(FLASH_BUFFER512);
         case SAV_FLASH1M:
-        {
-            FILE *f = fopen(SAVE_PATH, "wb");
-            if (f == NULL)
-            {
-                Debug_ErrorMsgArg("Couldn't open file for saving.");
-                return;
-            }
-            if (fwrite(FLASH_BUFFER1M, sizeof(FLASH_BUFFER1M), 1, f) != 1)
-            {
-                Debug_ErrorMsgArg("Couldn't save data to file.");
-            }
-            fclose(f);
-            return;
-        }
+            memcpy(buffer, FLASH_BUFFER1M, sizeof(FLASH_BUFFER1M));
+            return sizeof(FLASH_BUFFER1M);
         case SAV_EEPROM:
-        {
-            FILE *f = fopen(SAVE_PATH, "wb");
-            if (f == NULL)
-            {
-                Debug_ErrorMsgArg("Couldn't open file for saving.");
-                return;
-            }
-            if (fwrite(EEPROM_BUFFER, 1, EEPROM_SIZE, f) != EEPROM_SIZE)
-            {
-                Debug_ErrorMsgArg("Couldn't save data to file.");
-            }
-            fclose(f);
-            return;
-        }
+            // This is 0 if the game hasn't accessed the EEPROM yet
+            memcpy(buffer, EEPROM_BUFFER, EEPROM_SIZE);
+            return EEPROM_SIZE;
         case SAV_NONE:
         case SAV_AUTODETECT:
         default:
-            return;
+            return 0;
     }
 }
 
+void GBA_SaveWriteFile(void)
+{
+    static u8 buffer[GBA_SAVE_MAX_SIZE];
+
+    size_t size = GBA_SaveGetData(buffer);
+    if (size == 0)
+        return;
+
+    if (FileSaveAtomic(SAVE_PATH, buffer, size) == 0)
+        Debug_ErrorMsgArg("Couldn't save data to file.");
+
+    save_dirty = 0;
+}
+
 void GBA_SaveReadFile(void)
 {
+    save_dirty = 0;
+
     switch (SAVE_TYPE)
     {
         case SAV_SRAM:
@@ -880,3 +873,29 @@ void GBA_SaveReadFile(void)
             return;
     }
 }
+
+void GBA_SaveStateRegister(void)
+{
+    GBA_StateRegister(&SAVE_TYPE, sizeof(SAVE_TYPE));
+    GBA_StateRegister(&save_dirty, sizeof(save_dirty));
+
+    GBA_StateRegister(SRAM_BUFFER, sizeof(SRAM_BUFFER));
+
+    GBA_StateRegister(FLASH_BUFFER512, sizeof(FLASH_BUFFER512));
+    GBA_StateRegister(FLASH_BUFFER1M, sizeof(FLASH_BUFFER1M));
+    GBA_StateRegister(&FLASH_1M_PTR, sizeof(FLASH_1M_PTR));
+    GBA_StateRegister(&FLASH_STATE, sizeof(FLASH_STATE));
+    GBA_StateRegister(&FLASH_CMD, sizeof(FLASH_CMD));
+    GBA_StateRegister(&FLASH_CMD_STATE, sizeof(FLASH_CMD_STATE));
+
+    GBA_StateRegister(&eeprom_detect_size, sizeof(eeprom_detect_size));
+    GBA_StateRegister(EEPROM_BUFFER, sizeof(EEPROM_BUFFER));
+    GBA_StateRegister(&EEPROM_SIZE, sizeof(EEPROM_SIZE));
+    GBA_StateRegister(&EEPROM_ADDRESS_BUS, sizeof(EEPROM_ADDRESS_BUS));
+    GBA_StateRegister(&EEPROM_ADDRESS, sizeof(EEPROM_ADDRESS));
+    GBA_StateRegister(&EEPROM_ADDRESS_MASK, sizeof(EEPROM_ADDRESS_MASK));
+    GBA_StateRegister(&EEPROM_CMD, sizeof(EEPROM_CMD));
+    GBA_StateRegister(&EEPROM_CMD_LEN, sizeof(EEPROM_CMD_LEN));
+    GBA_StateRegister(&EEPROM_DATA_STREAMING, sizeof(EEPROM_DATA_STREAMING));
+    GBA_StateRegister(&EEPROM_READ_BUFFER, sizeof(EEPROM_READ_BUFFER));
+}
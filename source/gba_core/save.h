@@ -22,6 +22,18 @@ u16 GBA_SaveRead16(u32 address);
 void GBA_SaveWrite8(u32 address, u8 data);
 void GBA_SaveWrite16(u32 address, u16 data);
 
+// Size of the biggest save memory (FLASH 128KB)
+#define GBA_SAVE_MAX_SIZE (128 * 1024)
+
+// The dirty flag is set whenever the game writes to the save memory
+int GBA_SaveIsDirty(void);
+void GBA_SaveClearDirty(void);
+
+// Copies the current contents of the save memory to the buffer, which must be
+// GBA_SAVE_MAX_SIZE bytes long. Returns the size of the data (0 if none).
+size_t GBA_SaveGetData(u8 *buffer);
+void GBA_SaveGetFilename(char *path, size_t size);
+
 void GBA_SaveWriteFile(void);
 void GBA_SaveReadFile(void);
 
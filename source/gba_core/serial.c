@@ -0,0 +1,360 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include "../build_options.h"
+#include "../config.h"
+#include "../link_cable.h"
+
+#include "cpu.h"
+#include "gba.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "serial.h"
+#include "state.h"
+
+// Only Normal and Multi-Player modes are emulated. The other GBA is another
+// instance of the emulator connected with the link cable, so Multi-Player mode
+// only supports 2 players.
+
+#define SIO_MODE_NORMAL_8BIT    0
+#define SIO_MODE_NORMAL_32BIT   1
+#define SIO_MODE_MULTIPLAYER    2
+#define SIO_MODE_UART           3
+#define SIO_MODE_GENERAL        4 // General purpose or JOY BUS
+
+#define SIOCNT_INTERNAL_CLOCK   BIT(0)
+#define SIOCNT_CLOCK_2MHZ       BIT(1)
+#define SIOCNT_SI               BIT(2) // Normal: SI. Multi-Player: Child
+#define SIOCNT_SD               BIT(3) // Multi-Player: All GBAs ready
+#define SIOCNT_ID_SHIFT         4
+#define SIOCNT_ERROR            BIT(6)
+#define SIOCNT_START            BIT(7)
+#define SIOCNT_IRQ_ENABLE       BIT(14)
+
+// Read-only bits of SIOCNT in Multi-Player mode
+#define SIOCNT_MULTI_READONLY   (SIOCNT_SI | SIOCNT_SD | (3 << SIOCNT_ID_SHIFT) \
+                                 | SIOCNT_ERROR)
+
+// When the other GBA drives the clock, the link cable is checked this often
+#define GBA_SERIAL_LINK_POLL_CLOCKS 1232
+
+static int gba_serial_link_enabled = 0;
+
+// Clocks left for the transfer started by this GBA. 0 if there isn't one.
+static s32 gba_serial_transfer_clocks = 0;
+
+// Value that the link cable sends if the other GBA starts a transfer
+static int gba_serial_slave_ready = 0;
+static u32 gba_serial_slave_value = 0;
+
+//----------------------------------------------------------------
+
+static int gba_serial_get_mode(void)
+{
+    if (REG_RCNT & BIT(15))
+        return SIO_MODE_GENERAL;
+
+    return (REG_SIOCNT >> 12) & 3;
+}
+
+static void gba_serial_slave_set_ready(int ready, u32 value)
+{
+    if (!gba_serial_link_enabled)
+        return;
+
+    if ((ready == gba_serial_slave_ready) && (value == gba_serial_slave_value))
+        return;
+
+    gba_serial_slave_ready = ready;
+    gba_serial_slave_value = value;
+
+    LinkCable_SlaveSetReady(ready, value);
+}
+
+static void gba_serial_multi_update_status(void)
+{
+    u16 cnt = REG_SIOCNT & ~(SIOCNT_SI | SIOCNT_SD);
+
+    if (LinkCable_IsConnected())
+    {
+        cnt |= SIOCNT_SD;
+
+        // The instance that waits for the connection is the parent
+        if (!LinkCable_IsHost())
+            cnt |= SIOCNT_SI;
+    }
+
+    REG_SIOCNT = cnt;
+}
+
+// Update the value that is sent if the other GBA starts a transfer
+static void gba_serial_update_slave(void)
+{
+    if (!gba_serial_link_enabled)
+        return;
+
+    int mode = gba_serial_get_mode();
+
+    if (mode == SIO_MODE_MULTIPLAYER)
+    {
+        gba_serial_multi_update_status();
+
+        int is_child = (REG_SIOCNT & SIOCNT_SI) != 0;
+        gba_serial_slave_set_ready(is_child, REG_SIOMLT_SEND);
+    }
+    else if ((mode == SIO_MODE_NORMAL_8BIT) || (mode == SIO_MODE_NORMAL_32BIT))
+    {
+        int waiting = (REG_SIOCNT & SIOCNT_START)
+                      && !(REG_SIOCNT & SIOCNT_INTERNAL_CLOCK);
+
+        u32 value;
+        if (mode == SIO_MODE_NORMAL_8BIT)
+            value = REG_SIODATA8 & 0xFF;
+        else
+            value = REG_SIODATA32;
+
+        gba_serial_slave_set_ready(waiting, value);
+    }
+    else
+    {
+        gba_serial_slave_set_ready(0, 0);
+    }
+}
+
+static void gba_serial_transfer_end(void)
+{
+    REG_SIOCNT &= ~SIOCNT_START;
+
+    if (REG_SIOCNT & SIOCNT_IRQ_ENABLE)
+        GBA_CallInterrupt(BIT(7));
+}
+
+//----------------------------------------------------------------
+
+// Called when the transfer started by this GBA ends
+static void gba_serial_master_end(void)
+{
+    gba_serial_transfer_clocks = 0;
+
+    int mode = gba_serial_get_mode();
+
+    if (mode == SIO_MODE_MULTIPLAYER)
+    {
+        u16 send = REG_SIOMLT_SEND;
+        u32 reply = LINK_CABLE_NO_DATA;
+        if (gba_serial_link_enabled)
+            reply = LinkCable_MasterExchange(send);
+
+        REG_SIOMULTI0 = send;
+        REG_SIOMULTI1 = reply & 0xFFFF;
+        REG_SIOMULTI2 = 0xFFFF;
+        REG_SIOMULTI3 = 0xFFFF;
+
+        REG_SIOCNT &= ~(3 << SIOCNT_ID_SHIFT); // Parent is player 0
+    }
+    else if (mode == SIO_MODE_NORMAL_8BIT)
+    {
+        u32 reply = LINK_CABLE_NO_DATA;
+        if (gba_serial_link_enabled)
+            reply = LinkCable_MasterExchange(REG_SIODATA8 & 0xFF);
+
+        REG_SIODATA8 = (REG_SIODATA8 & 0xFF00) | (reply & 0xFF);
+    }
+    else if (mode == SIO_MODE_NORMAL_32BIT)
+    {
+        u32 reply = LINK_CABLE_NO_DATA;
+        if (gba_serial_link_enabled)
+            reply = LinkCable_MasterExchange(REG_SIODATA32);
+
+        REG_SIODATA32 = reply;
+    }
+    else
+    {
+        return;
+    }
+
+    gba_serial_transfer_end();
+    gba_serial_update_slave();
+}
+
+// Called regularly while the other GBA is expected to start a transfer
+static void gba_serial_slave_check(void)
+{
+    u32 value;
+    if (!LinkCable_SlaveGetReceived(&value))
+        return;
+
+    // The link cable isn't ready after a transfer until it's set again
+    gba_serial_slave_ready = 0;
+
+    int mode = gba_serial_get_mode();
+
+    if (mode == SIO_MODE_MULTIPLAYER)
+    {
+        REG_SIOMULTI0 = value & 0xFFFF;
+        REG_SIOMULTI1 = REG_SIOMLT_SEND;
+        REG_SIOMULTI2 = 0xFFFF;
+        REG_SIOMULTI3 = 0xFFFF;
+
+        REG_SIOCNT = (REG_SIOCNT & ~(3 << SIOCNT_ID_SHIFT))
+                     | (1 << SIOCNT_ID_SHIFT);
+    }
+    else if (mode == SIO_MODE_NORMAL_8BIT)
+    {
+        REG_SIODATA8 = (REG_SIODATA8 & 0xFF00) | (value & 0xFF);
+    }
+    else if (mode == SIO_MODE_NORMAL_32BIT)
+    {
+        REG_SIODATA32 = value;
+    }
+    else
+    {
+        // The mode has changed since the transfer was prepared
+        gba_serial_update_slave();
+        return;
+    }
+
+    gba_serial_transfer_end();
+    gba_serial_update_slave();
+
+    GBA_ExecutionBreak();
+}
+
+//----------------------------------------------------------------
+
+static s32 gba_serial_transfer_duration(int mode)
+{
+    if (mode == SIO_MODE_MULTIPLAYER)
+    {
+        static const s32 baud_rates[4] = { 9600, 38400, 57600, 115200 };
+        s32 baud = baud_rates[REG_SIOCNT & 3];
+
+        // Each GBA sends a start bit, 16 data bits and a stop bit
+        return (16 * 1024 * 1024 / baud) * 18 * 2;
+    }
+
+    s32 bits = (mode == SIO_MODE_NORMAL_32BIT) ? 32 : 8;
+    s32 clocks_per_bit = (REG_SIOCNT & SIOCNT_CLOCK_2MHZ) ? 8 : 64;
+
+    return bits * clocks_per_bit;
+}
+
+void GBA_SerialWriteSIOCNT(u16 data)
+{
+    u16 old = REG_SIOCNT;
+    int start = !(old & SIOCNT_START) && (data & SIOCNT_START);
+
+    if (((data >> 12) & 3) == SIO_MODE_MULTIPLAYER)
+    {
+        REG_SIOCNT = (old & SIOCNT_MULTI_READONLY)
+                     | (data & ~SIOCNT_MULTI_READONLY);
+
+        if (gba_serial_link_enabled)
+            gba_serial_multi_update_status();
+
+        // Only the parent can start a transfer
+        if (REG_SIOCNT & SIOCNT_SI)
+        {
+            REG_SIOCNT = (REG_SIOCNT & ~SIOCNT_START) | (old & SIOCNT_START);
+            start = 0;
+        }
+    }
+    else
+    {
+        REG_SIOCNT = (old & SIOCNT_SI) | (data & ~SIOCNT_SI);
+    }
+
+    int mode = gba_serial_get_mode();
+
+    if ((REG_SIOCNT & SIOCNT_START) == 0)
+    {
+        gba_serial_transfer_clocks = 0;
+    }
+    else if (start)
+    {
+        if (mode == SIO_MODE_MULTIPLAYER)
+        {
+            gba_serial_transfer_clocks = gba_serial_transfer_duration(mode);
+        }
+        else if ((mode == SIO_MODE_NORMAL_8BIT)
+                 || (mode == SIO_MODE_NORMAL_32BIT))
+        {
+            if (REG_SIOCNT & SIOCNT_INTERNAL_CLOCK)
+                gba_serial_transfer_clocks = gba_serial_transfer_duration(mode);
+        }
+    }
+
+    gba_serial_update_slave();
+
+    GBA_ExecutionBreak();
+}
+
+void GBA_SerialRegistersUpdated(void)
+{
+    gba_serial_update_slave();
+}
+
+s32 GBA_SerialUpdate(s32 clocks)
+{
+    if (gba_serial_transfer_clocks > 0)
+    {
+        gba_serial_transfer_clocks -= clocks;
+        if (gba_serial_transfer_clocks > 0)
+            return gba_serial_transfer_clocks;
+
+        gba_serial_master_end();
+    }
+
+    if (gba_serial_link_enabled)
+    {
+        // Connections and disconnections can happen at any point
+        if (gba_serial_get_mode() == SIO_MODE_MULTIPLAYER)
+            gba_serial_update_slave();
+
+        if (gba_serial_slave_ready)
+        {
+            gba_serial_slave_check();
+            return GBA_SERIAL_LINK_POLL_CLOCKS;
+        }
+
+        if (gba_serial_get_mode() == SIO_MODE_MULTIPLAYER)
+            return GBA_SERIAL_LINK_POLL_CLOCKS;
+    }
+
+    return 0x7FFFFFFF;
+}
+
+//----------------------------------------------------------------
+
+void GBA_SerialInit(void)
+{
+    gba_serial_transfer_clocks = 0;
+    gba_serial_slave_ready = 0;
+    gba_serial_slave_value = 0;
+
+    gba_serial_link_enabled = EmulatorConfig.gba_link_cable;
+    if (gba_serial_link_enabled)
+    {
+        if (!LinkCable_Start())
+            gba_serial_link_enabled = 0;
+    }
+}
+
+void GBA_SerialEnd(void)
+{
+    if (gba_serial_link_enabled)
+        LinkCable_Stop();
+
+    gba_serial_link_enabled = 0;
+}
+
+void GBA_SerialStateRegister(void)
+{
+    GBA_StateRegister(&gba_serial_transfer_clocks,
+                      sizeof(gba_serial_transfer_clocks));
+    GBA_StateRegister(&gba_serial_slave_ready, sizeof(gba_serial_slave_ready));
+    GBA_StateRegister(&gba_serial_slave_value, sizeof(gba_serial_slave_value));
+}
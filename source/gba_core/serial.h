@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GBA_SERIAL__
+#define GBA_SERIAL__
+
+#include "gba.h"
+
+void GBA_SerialInit(void);
+void GBA_SerialEnd(void);
+
+void GBA_SerialWriteSIOCNT(u16 data);
+// Called after writing to SIODATA32, SIOMLT_SEND/SIODATA8 or RCNT
+void GBA_SerialRegistersUpdated(void);
+
+s32 GBA_SerialUpdate(s32 clocks);
+
+#endif // GBA_SERIAL__
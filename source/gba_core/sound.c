@@ -17,6 +17,7 @@
 #include "dma.h"
 #include "memory.h"
 #include "sound.h"
+#include "state.h"
 
 // Quite a big buffer, but it works fine this way.  The bigger, the less
 // possibilities to underflow, but the more delay between actions and sound
@@ -231,9 +232,6 @@ typedef struct
 
     u32 nextsample_clocks;
 
-    s16 buffer[GBA_SAMPLE_RATE];
-    u32 buffer_write_ptr;
-
     // Some temporary variables to avoid doing the same calculations every time
     // a sample is going to be generated:
     int leftvol_1, rightvol_1;
@@ -249,6 +247,11 @@ typedef struct
 
 static _GBA_SOUND_HARDWARE_ Sound;
 
+// The output buffer isn't part of the emulated hardware, so it's kept out of
+// "Sound" to leave it out of the state snapshots.
+static s16 sound_buffer[GBA_SAMPLE_RATE];
+static u32 sound_buffer_write_ptr;
+
 static int output_enabled;
 
 int GBA_SoundHardwareIsOn(void)
@@ -339,11 +342,11 @@ u16 *GBA_SoundGetWaveRAMTwoBuffers(void)
 
 void GBA_SoundSaveToWAV(void)
 {
-    size_t available_size = Sound.buffer_write_ptr * sizeof(s16);
+    size_t available_size = sound_buffer_write_ptr * sizeof(s16);
 
     // Save all available samples to a WAV file if a recording is active
     if (WAV_FileIsOpen())
-        WAV_FileStream(Sound.buffer, available_size);
+        WAV_FileStream(sound_buffer, available_size);
 }
 
 // This function is supposed to return all the samples taken during a frame. If
@@ -351,22 +354,32 @@ void GBA_SoundSaveToWAV(void)
 // anyway, to prepare it for next frame.
 size_t GBA_SoundGetSamplesFrame(void *buffer, size_t buffer_size)
 {
-    size_t available_size = Sound.buffer_write_ptr * sizeof(s16);
+    size_t available_size = sound_buffer_write_ptr * sizeof(s16);
 
     size_t copy_size = (available_size < buffer_size) ?
                        available_size : buffer_size;
 
-    memcpy(buffer, Sound.buffer, copy_size);
+    memcpy(buffer, sound_buffer, copy_size);
 
     // Reset pointer
-    Sound.buffer_write_ptr = 0;
+    sound_buffer_write_ptr = 0;
 
     return copy_size;
 }
 
 void GBA_SoundResetBufferPointers(void)
 {
-    Sound.buffer_write_ptr = 0;
+    sound_buffer_write_ptr = 0;
+}
+
+u32 GBA_SoundGetBufferPointer(void)
+{
+    return sound_buffer_write_ptr;
+}
+
+void GBA_SoundSetBufferPointer(u32 ptr)
+{
+    sound_buffer_write_ptr = ptr;
 }
 
 void GBA_SoundInit(void)
@@ -483,8 +496,8 @@ void GBA_SoundMix(void)
 
     if (Sound.master_enable == 0)
     {
-        Sound.buffer[Sound.buffer_write_ptr++] = 0;
-        Sound.buffer[Sound.buffer_write_ptr++] = 0;
+        sound_buffer[sound_buffer_write_ptr++] = 0;
+        sound_buffer[sound_buffer_write_ptr++] = 0;
         return;
     }
 
@@ -553,8 +566,8 @@ void GBA_SoundMix(void)
     outvalue_left = (outvalue_left * EmulatorConfig.volume) / 128;
     outvalue_right = (outvalue_right * EmulatorConfig.volume) / 128;
 
-    Sound.buffer[Sound.buffer_write_ptr++] = outvalue_left;
-    Sound.buffer[Sound.buffer_write_ptr++] = outvalue_right;
+    sound_buffer[sound_buffer_write_ptr++] = outvalue_left;
+    sound_buffer[sound_buffer_write_ptr++] = outvalue_right;
 }
 
 static u32 min4(u32 a, u32 b, u32 c, u32 d)
@@ -1594,3 +1607,9 @@ int gba_debug_get_psg_vol(int chan)
             return 0;
     }
 }
+
+void GBA_SoundStateRegister(void)
+{
+    GBA_StateRegister(&Sound, sizeof(Sound));
+    GBA_StateRegister(GBA_WavePattern, sizeof(GBA_WavePattern));
+}
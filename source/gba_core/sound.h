@@ -22,6 +22,10 @@ u16 GBA_SoundRegRead16(u32 address);
 void GBA_SoundSaveToWAV(void);
 size_t GBA_SoundGetSamplesFrame(void *buffer, size_t buffer_size);
 void GBA_SoundResetBufferPointers(void);
+// Used to discard the samples generated after reading the pointer. The output
+// buffer isn't included in the state snapshots.
+u32 GBA_SoundGetBufferPointer(void);
+void GBA_SoundSetBufferPointer(u32 ptr);
 void GBA_SoundEnd(void);
 void GBA_SoundTimerCheck(u32 number);
 
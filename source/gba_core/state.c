@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <string.h>
+
+#include "../debug_utils.h"
+#include "../general_utils.h"
+
+#include "state.h"
+#include "video.h"
+
+#define GBA_STATE_MAX_REGIONS 128
+
+typedef struct
+{
+    void *data;
+    size_t size;
+} _gba_state_region_t;
+
+static _gba_state_region_t gba_state_regions[GBA_STATE_MAX_REGIONS];
+static int gba_state_num_regions = 0;
+static size_t gba_state_size = 0;
+
+void GBA_StateRegister(void *data, size_t size)
+{
+    if (gba_state_num_regions == GBA_STATE_MAX_REGIONS)
+    {
+        Debug_LogMsgArg("%s(): Too many regions", __func__);
+        return;
+    }
+
+    _gba_state_region_t *r = &gba_state_regions[gba_state_num_regions++];
+    r->data = data;
+    r->size = size;
+
+    gba_state_size += size;
+}
+
+// All the variables are static, so the list only needs to be built once
+static void _gba_state_init(void)
+{
+    if (gba_state_num_regions > 0)
+        return;
+
+    GBA_CPUStateRegister();
+    GBA_DMAStateRegister();
+    GBA_InterruptsStateRegister();
+    GBA_MemoryStateRegister();
+    GBA_RunStateRegister();
+    GBA_SaveStateRegister();
+    GBA_SerialStateRegister();
+    GBA_SoundStateRegister();
+    GBA_TimersStateRegister();
+    GBA_VideoStateRegister();
+}
+
+size_t GBA_StateSize(void)
+{
+    _gba_state_init();
+
+    return gba_state_size;
+}
+
+void GBA_StateSave(void *buffer)
+{
+    _gba_state_init();
+
+    u8 *dst = buffer;
+
+    for (int i = 0; i < gba_state_num_regions; i++)
+    {
+        _gba_state_region_t *r = &gba_state_regions[i];
+        memcpy(dst, r->data, r->size);
+        dst += r->size;
+    }
+}
+
+void GBA_StateLoad(const void *buffer)
+{
+    _gba_state_init();
+
+    const u8 *src = buffer;
+
+    for (int i = 0; i < gba_state_num_regions; i++)
+    {
+        _gba_state_region_t *r = &gba_state_regions[i];
+        memcpy(r->data, src, r->size);
+        src += r->size;
+    }
+
+    // Caches built from the state
+    GBA_VideoSpriteListsInvalidate();
+}
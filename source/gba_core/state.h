@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GBA_STATE__
+#define GBA_STATE__
+
+#include <stddef.h>
+
+// Snapshots of the state of the emulated machine in memory. The variables of
+// the core are copied as they are, including pointers, so a snapshot can only
+// be loaded while the same ROM is loaded. They don't include the state of the
+// BIOS, the ROM or the screen buffers.
+
+// Size of the buffers passed to GBA_StateSave() and GBA_StateLoad()
+size_t GBA_StateSize(void);
+
+void GBA_StateSave(void *buffer);
+void GBA_StateLoad(const void *buffer);
+
+// Used by the functions below to add their variables to the snapshots
+void GBA_StateRegister(void *data, size_t size);
+
+// Implemented by each module of the core that has any state
+void GBA_CPUStateRegister(void);
+void GBA_DMAStateRegister(void);
+void GBA_InterruptsStateRegister(void);
+void GBA_MemoryStateRegister(void);
+void GBA_RunStateRegister(void);
+void GBA_SaveStateRegister(void);
+void GBA_SerialStateRegister(void);
+void GBA_SoundStateRegister(void);
+void GBA_TimersStateRegister(void);
+void GBA_VideoStateRegister(void);
+
+#endif // GBA_STATE__
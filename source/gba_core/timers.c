@@ -12,6 +12,7 @@
 #include "interrupts.h"
 #include "memory.h"
 #include "sound.h"
+#include "state.h"
 #include "timers.h"
 
 typedef struct
@@ -289,3 +290,8 @@ s32 GBA_TimersUpdate(s32 clocks)
 
     return returnclocks;
 }
+
+void GBA_TimersStateRegister(void)
+{
+    GBA_StateRegister(Timer, sizeof(Timer));
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stddef.h>
+
+#include "../general_utils.h"
+
+#include "timing.h"
+
+#ifdef ENABLE_TIMING
+
+gba_timing_begin_fn gba_timing_begin_callback = NULL;
+gba_timing_end_fn gba_timing_end_callback = NULL;
+
+void GBA_TimingSetCallbacks(gba_timing_begin_fn begin, gba_timing_end_fn end)
+{
+    gba_timing_begin_callback = begin;
+    gba_timing_end_callback = end;
+}
+
+#else // ENABLE_TIMING
+
+void GBA_TimingSetCallbacks(unused__ gba_timing_begin_fn begin,
+                            unused__ gba_timing_end_fn end)
+{
+}
+
+#endif // ENABLE_TIMING
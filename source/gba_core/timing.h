@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef GBA_TIMING__
+#define GBA_TIMING__
+
+// Scopes used to measure the host time spent in each subsystem of the core.
+// The callbacks are set by the frontend while it is measuring times. The only
+// cost of a scope while they aren't set is a pointer check. If ENABLE_TIMING
+// isn't defined, the scopes are compiled out.
+
+#define GBA_TIMING_CPU      0
+#define GBA_TIMING_VIDEO    1
+#define GBA_TIMING_DMA      2
+#define GBA_TIMING_TIMERS   3
+#define GBA_TIMING_SOUND    4
+
+typedef void (*gba_timing_begin_fn)(int id);
+typedef void (*gba_timing_end_fn)(void);
+void GBA_TimingSetCallbacks(gba_timing_begin_fn begin, gba_timing_end_fn end);
+
+#ifdef ENABLE_TIMING
+
+extern gba_timing_begin_fn gba_timing_begin_callback;
+extern gba_timing_end_fn gba_timing_end_callback;
+
+#define GBA_TIMING_BEGIN(id)                \
+    do {                                    \
+        if (gba_timing_begin_callback)      \
+            gba_timing_begin_callback(id);  \
+    } while (0)
+
+#define GBA_TIMING_END(id)                  \
+    do {                                    \
+        if (gba_timing_end_callback)        \
+            gba_timing_end_callback();      \
+    } while (0)
+
+#else
+
+#define GBA_TIMING_BEGIN(id) do { } while (0)
+#define GBA_TIMING_END(id)   do { } while (0)
+
+#endif
+
+#endif // GBA_TIMING__
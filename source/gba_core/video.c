@@ -10,6 +10,7 @@
 
 #include "gba.h"
 #include "memory.h"
+#include "state.h"
 #include "video.h"
 
 extern _mem_t Mem;
@@ -159,12 +160,73 @@ static const int spr_size[4][4][2] = { // Inputs = [Shape][Size][{x, y}]
     { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } }        // Prohibited
 };
 
-static void gba_sprites_draw_mode012(s32 ly)
+// Sprites that are displayed in each scanline, in OAM order. They only depend
+// on the attributes 0 and 1 of the sprites, so they are only built again after
+// any of them is written.
+static u8 spr_line_list[160][128];
+static u8 spr_line_count[160];
+static int spr_lists_dirty = 1;
+
+void GBA_VideoSpriteListsInvalidate(void)
+{
+    spr_lists_dirty = 1;
+}
+
+static void gba_sprites_build_lists(void)
 {
     _oam_spr_entry_t *spr = (_oam_spr_entry_t *)Mem.oam;
 
+    memset(spr_line_count, 0, sizeof(spr_line_count));
+
     for (int i = 0; i < 128; i++)
     {
+        u16 attr0 = spr[i].attr0;
+        u16 attr1 = spr[i].attr1;
+
+        // For regular sprites this is the disable flag, for affine sprites it
+        // is the double size flag.
+        int bit9 = attr0 & BIT(9);
+
+        if (((attr0 & BIT(8)) == 0) && bit9)
+            continue;
+
+        u16 shape = attr0 >> 14;
+        u16 size = attr1 >> 14;
+        int sy = spr_size[shape][size][1];
+        if (bit9)
+            sy <<= 1;
+
+        int y = (attr0 & 0xFF);
+        y |= (y < 160) ? 0 : 0xFFFFFF00;
+
+        int start = (y < 0) ? 0 : y;
+        int end = ((y + sy) > 160) ? 160 : (y + sy);
+
+        for (int ly = start; ly < end; ly++)
+            spr_line_list[ly][spr_line_count[ly]++] = i;
+    }
+
+    spr_lists_dirty = 0;
+}
+
+static int gba_sprites_get_line(s32 ly, const u8 **list)
+{
+    if (spr_lists_dirty)
+        gba_sprites_build_lists();
+
+    *list = spr_line_list[ly];
+    return spr_line_count[ly];
+}
+
+static void gba_sprites_draw_mode012(s32 ly)
+{
+    const u8 *list;
+    int count = gba_sprites_get_line(ly, &list);
+
+    for (int n = 0; n < count; n++)
+    {
+        _oam_spr_entry_t *spr = &((_oam_spr_entry_t *)Mem.oam)[list[n]];
+
         u16 attr0 = spr->attr0;
 
         if (attr0 & BIT(8)) // Affine sprite -- No H flip or V flip
@@ -524,16 +586,18 @@ static void gba_sprites_draw_mode012(s32 ly)
                 }
             }
         }
-        spr++;
     }
 }
 
 static void gba_sprites_draw_mode345(s32 ly)
 {
-    _oam_spr_entry_t *spr = (_oam_spr_entry_t *)Mem.oam;
+    const u8 *list;
+    int count = gba_sprites_get_line(ly, &list);
 
-    for (int i = 0; i < 128; i++)
+    for (int n = 0; n < count; n++)
     {
+        _oam_spr_entry_t *spr = &((_oam_spr_entry_t *)Mem.oam)[list[n]];
+
         u16 attr0 = spr->attr0;
 
         if (attr0 & BIT(8)) // Affine sprite -- No H flip or V flip
@@ -909,7 +973,6 @@ static void gba_sprites_draw_mode345(s32 ly)
                 }
             }
         }
-        spr++;
     }
 }
 
@@ -1322,6 +1385,100 @@ static const u32 affine_bg_size[4] = {
     128, 256, 512, 1024
 };
 
+// Lines with PC = 0 read a single row of the BG. If PA is also 1.0 the pixels
+// are read in order, so each tile only needs to be looked up once.
+static void gba_bgdrawaffine_row(u16 control, s32 currx, s32 curry, s32 A,
+                                 u16 *fb, int *visptr)
+{
+    u8 *charbaseblockptr = (u8 *)&Mem.vram[((control >> 2) & 3) * (16 * 1024)];
+    u8 *scrbaseblockptr = (u8 *)&Mem.vram[((control >> 8) & 0x1F) * (2 * 1024)];
+
+    u32 size = affine_bg_size[control >> 14];
+    u32 sizemask = size - 1;
+    u32 tilesize = size / 8;
+
+    int wrap = control & BIT(13);
+
+    u16 *pal = (u16 *)Mem.pal_ram;
+
+    u32 _y = (curry >> 8);
+    if (wrap)
+        _y &= sizemask;
+
+    if (_y >= size)
+    {
+        for (int i = 0; i < 240; i++)
+        {
+            fb[i] = pal[0];
+            visptr[i] = 0;
+        }
+        return;
+    }
+
+    u8 *maprowptr = &scrbaseblockptr[se_index_affine(0, _y / 8, tilesize)];
+    u32 tilerow = (_y & 7) * 8;
+
+    if (A != 0x100) // Scaled
+    {
+        for (int i = 0; i < 240; i++)
+        {
+            u32 _x = (currx >> 8);
+            if (wrap)
+                _x &= sizemask;
+
+            u8 data = 0;
+            if (_x < size)
+            {
+                u8 SE = maprowptr[_x / 8];
+                data = charbaseblockptr[(SE * 64) + tilerow + (_x & 7)];
+            }
+
+            fb[i] = pal[data];
+            visptr[i] = data;
+
+            currx += A;
+        }
+        return;
+    }
+
+    u32 _x = (currx >> 8);
+
+    int i = 0;
+    while (i < 240)
+    {
+        if (wrap)
+            _x &= sizemask;
+
+        if (_x >= size)
+        {
+            fb[i] = pal[0];
+            visptr[i] = 0;
+            i++;
+            _x++;
+            continue;
+        }
+
+        // Draw until the end of the tile. The size of the BG is a multiple of
+        // the size of the tiles, so it can't wrap in the middle of one.
+        u8 SE = maprowptr[_x / 8];
+        u8 *tileptr = &charbaseblockptr[(SE * 64) + tilerow];
+
+        int n = 8 - (_x & 7);
+        if (n > (240 - i))
+            n = 240 - i;
+
+        for (int j = 0; j < n; j++)
+        {
+            u8 data = tileptr[(_x & 7) + j];
+            fb[i + j] = pal[data];
+            visptr[i + j] = data;
+        }
+
+        i += n;
+        _x += n;
+    }
+}
+
 static s32 mosBG2lastx, mosBG2lasty, mos2A, mos2C;
 
 static void gba_bg2drawaffine(s32 y)
@@ -1366,6 +1523,11 @@ static void gba_bg2drawaffine(s32 y)
             C = mos2C;
         }
     }
+    else if (C == 0)
+    {
+        gba_bgdrawaffine_row(control, currx, curry, A, fb, visptr);
+        return;
+    }
 
     u8 data = 0;
     for (int i = 0; i < 240; i++) // Always 256 colors
@@ -1450,6 +1612,11 @@ static void gba_bg3drawaffine(s32 y)
             C = mos3C;
         }
     }
+    else if (C == 0)
+    {
+        gba_bgdrawaffine_row(control, currx, curry, A, fb, visptr);
+        return;
+    }
 
     u8 data = 0;
     for (int i = 0; i < 240; i++) // Always 256 colors
@@ -1493,6 +1660,21 @@ static void gba_bg3drawaffine(s32 y)
 
 //------------------------------------------------------------------------------
 
+// Bitmap lines with PC = 0 read a single row of the bitmap. If PA is also 1.0
+// the pixels are read in order, so only the range of the line that is inside
+// the bitmap needs to be calculated. It returns the range [start, end) of the
+// line that comes from the bitmap, which starts at column x.
+static int gba_bitmap_line_range(s32 x, s32 width, int *start, int *end)
+{
+    if ((x <= -240) || (x >= width))
+        return 0;
+
+    *start = (x < 0) ? -x : 0;
+    *end = ((width - x) > 240) ? 240 : (width - x);
+
+    return 1;
+}
+
 static void gba_bg2drawbitmapmode3(unused__ s32 y)
 {
     s32 currx = BG2lastx;
@@ -1509,6 +1691,42 @@ static void gba_bg2drawbitmapmode3(unused__ s32 y)
     u16 *fb = bgfb[2];
     int *visptr = bgvisible[2];
 
+    if (C == 0) // All the pixels come from the same row
+    {
+        u32 _y = (curry >> 8);
+        if (_y > 159)
+            return;
+
+        u16 *rowptr = &srcptr[240 * _y];
+
+        if (A == 0x100) // Not scaled, copy the row
+        {
+            s32 x = currx >> 8;
+            int start, end;
+            if (!gba_bitmap_line_range(x, 240, &start, &end))
+                return;
+
+            memcpy(&fb[start], &rowptr[x + start], (end - start) * sizeof(u16));
+            for (int i = start; i < end; i++)
+                visptr[i] = 1;
+
+            return;
+        }
+
+        for (int i = 0; i < 240; i++)
+        {
+            u32 _x = (currx >> 8);
+            if (_x <= 239)
+            {
+                fb[i] = rowptr[_x];
+                visptr[i] = 1;
+            }
+            currx += A;
+        }
+
+        return;
+    }
+
     for (int i = 0; i < 240; i++)
     {
         u32 _x = (currx >> 8);
@@ -1541,6 +1759,45 @@ static void gba_bg2drawbitmapmode4(unused__ s32 y)
     u16 *fb = bgfb[2];
     int *visptr = bgvisible[2];
 
+    if (C == 0) // All the pixels come from the same row
+    {
+        u32 _y = (curry >> 8);
+        if (_y > 159)
+            return;
+
+        u8 *rowptr = &srcptr[240 * _y];
+        u16 *pal = (u16 *)Mem.pal_ram;
+
+        if (A == 0x100) // Not scaled
+        {
+            s32 x = currx >> 8;
+            int start, end;
+            if (!gba_bitmap_line_range(x, 240, &start, &end))
+                return;
+
+            for (int i = start; i < end; i++)
+            {
+                fb[i] = pal[rowptr[x + i]];
+                visptr[i] = 1;
+            }
+
+            return;
+        }
+
+        for (int i = 0; i < 240; i++)
+        {
+            u32 _x = (currx >> 8);
+            if (_x <= 239)
+            {
+                fb[i] = pal[rowptr[_x]];
+                visptr[i] = 1;
+            }
+            currx += A;
+        }
+
+        return;
+    }
+
     for (int i = 0; i < 240; i++)
     {
         u32 _x = (currx >> 8);
@@ -1573,6 +1830,42 @@ static void gba_bg2drawbitmapmode5(unused__ s32 y)
     u16 *fb = bgfb[2];
     int *visptr = bgvisible[2];
 
+    if (C == 0) // All the pixels come from the same row
+    {
+        u32 _y = (curry >> 8);
+        if (_y > 127)
+            return;
+
+        u16 *rowptr = &srcptr[160 * _y];
+
+        if (A == 0x100) // Not scaled, copy the row
+        {
+            s32 x = currx >> 8;
+            int start, end;
+            if (!gba_bitmap_line_range(x, 160, &start, &end))
+                return;
+
+            memcpy(&fb[start], &rowptr[x + start], (end - start) * sizeof(u16));
+            for (int i = start; i < end; i++)
+                visptr[i] = 1;
+
+            return;
+        }
+
+        for (int i = 0; i < 240; i++)
+        {
+            u32 _x = (currx >> 8);
+            if (_x <= 159)
+            {
+                fb[i] = rowptr[_x];
+                visptr[i] = 1;
+            }
+            currx += A;
+        }
+
+        return;
+    }
+
     for (int i = 0; i < 240; i++)
     {
         u32 _x = (currx >> 8);
@@ -3025,3 +3318,40 @@ void GBA_ConvertScreenBufferTo24RGB(void *dst)
         *dest++ = (data & (0x1F << 10)) >> 7;
     }
 }
+
+void GBA_VideoStateRegister(void)
+{
+    // The rest of the variables only hold values used while drawing a line.
+    // The ones below are calculated when the registers are written, but they
+    // are saved as well so that they don't need to be calculated again.
+
+    GBA_StateRegister(&DrawScanlineFn, sizeof(DrawScanlineFn));
+
+    GBA_StateRegister(&BG2lastx, sizeof(BG2lastx));
+    GBA_StateRegister(&BG2lasty, sizeof(BG2lasty));
+    GBA_StateRegister(&BG3lastx, sizeof(BG3lastx));
+    GBA_StateRegister(&BG3lasty, sizeof(BG3lasty));
+
+    GBA_StateRegister(&MosSprX, sizeof(MosSprX));
+    GBA_StateRegister(&MosSprY, sizeof(MosSprY));
+    GBA_StateRegister(&MosBgX, sizeof(MosBgX));
+    GBA_StateRegister(&MosBgY, sizeof(MosBgY));
+
+    GBA_StateRegister(&Win0X1, sizeof(Win0X1));
+    GBA_StateRegister(&Win0X2, sizeof(Win0X2));
+    GBA_StateRegister(&Win0Y1, sizeof(Win0Y1));
+    GBA_StateRegister(&Win0Y2, sizeof(Win0Y2));
+    GBA_StateRegister(&Win1X1, sizeof(Win1X1));
+    GBA_StateRegister(&Win1X2, sizeof(Win1X2));
+    GBA_StateRegister(&Win1Y1, sizeof(Win1Y1));
+    GBA_StateRegister(&Win1Y2, sizeof(Win1Y2));
+
+    GBA_StateRegister(&mosBG2lastx, sizeof(mosBG2lastx));
+    GBA_StateRegister(&mosBG2lasty, sizeof(mosBG2lasty));
+    GBA_StateRegister(&mos2A, sizeof(mos2A));
+    GBA_StateRegister(&mos2C, sizeof(mos2C));
+    GBA_StateRegister(&mosBG3lastx, sizeof(mosBG3lastx));
+    GBA_StateRegister(&mosBG3lasty, sizeof(mosBG3lasty));
+    GBA_StateRegister(&mos3A, sizeof(mos3A));
+    GBA_StateRegister(&mos3C, sizeof(mos3C));
+}
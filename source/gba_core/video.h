@@ -21,6 +21,9 @@ void GBA_UpdateDrawScanlineFn(void);
 
 void GBA_VideoUpdateRegister(u32 address);
 
+// Must be called when the attributes 0 or 1 of any sprite are modified
+void GBA_VideoSpriteListsInvalidate(void);
+
 void GBA_DrawScanline(s32 y);
 void GBA_DrawScanlineWhite(s32 y);
 
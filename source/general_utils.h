@@ -33,6 +33,12 @@ typedef int8_t s8;
 # define ALIGNED(x) __attribute__((aligned(x)))
 #endif
 
+#if defined(_MSC_VER)
+# define NOINLINE __declspec(noinline)
+#else
+# define NOINLINE __attribute__((noinline))
+#endif
+
 // Safe versions of strncpy and strncat that set a terminating character if
 // needed.
 void s_strncpy(char *dest, const char *src, size_t _size);
@@ -9,6 +9,8 @@
 #include <SDL2/SDL.h>
 
 #include "../debug_utils.h"
+#include "../disasm_db.h"
+#include "../emu_thread.h"
 #include "../font_utils.h"
 #include "../general_utils.h"
 #include "../window_handler.h"
@@ -17,6 +19,7 @@
 #include "win_main.h"
 #include "win_utils.h"
 
+#include "../gb_core/analysis.h"
 #include "../gb_core/cpu.h"
 #include "../gb_core/debug.h"
 #include "../gb_core/gameboy.h"
@@ -76,6 +79,121 @@ static void _win_gb_disassembler_goto(void);
 
 //------------------------------------------------------------------------------
 
+// Returns the ROM offset of an address with the banks that are mapped right
+// now, or -1 if it isn't in the ROM.
+static s32 _win_gb_disassembler_rom_offset(u32 address)
+{
+    if (address < 0x4000)
+        return address;
+
+    if (address < 0x8000)
+    {
+        u32 bank = GameBoy.Memory.selected_rom;
+        if (bank >= GameBoy.Emulator.ROM_Banks)
+            return -1;
+
+        return (bank * 0x4000) + (address - 0x4000);
+    }
+
+    return -1;
+}
+
+// Uses the results of the code analysis to find where the previous instruction
+// starts. If it isn't known, it goes back one byte. The disassembly database
+// must be locked.
+static u16 _win_gb_disassembler_prev_address(u16 address)
+{
+    for (int i = 1; i <= 3; i++)
+    {
+        u16 prev = address - i;
+        s32 offset = _win_gb_disassembler_rom_offset(prev);
+
+        if (offset < 0)
+            break;
+
+        if ((GB_AnalysisGetFlags(offset) & GB_ANALYSIS_CODE) == 0)
+            continue;
+
+        if (gb_debug_get_instruction_size(GB_MemRead8(prev)) == i)
+            return prev;
+    }
+
+    return address - 1;
+}
+
+static void _win_gb_disassembler_scroll(int lines)
+{
+    DisasmDB_Lock();
+
+    u16 address = gb_disassembler_start_address;
+
+    for (int i = 0; i < lines; i++)
+        address += gb_debug_get_address_increment(address);
+
+    for (int i = 0; i > lines; i--)
+        address = _win_gb_disassembler_prev_address(address);
+
+    DisasmDB_Unlock();
+
+    gb_disassembler_start_address = address;
+}
+
+static void _win_gb_disassembler_jump_to_function(int direction)
+{
+    s32 offset = _win_gb_disassembler_rom_offset(gb_disassembler_start_address);
+    if (offset < 0)
+        return;
+
+    DisasmDB_Lock();
+    offset = GB_AnalysisFindLabel(offset, direction, 1);
+    DisasmDB_Unlock();
+
+    if (offset < 0)
+        return;
+
+    // Only go to functions of the banks that are mapped
+    u32 address = (offset < 0x4000) ? offset : (0x4000 + (offset & 0x3FFF));
+    if (_win_gb_disassembler_rom_offset(address) == offset)
+        gb_disassembler_start_address = address;
+}
+
+// Prints the name of a label and the addresses that jump to it. The
+// disassembly database must be locked.
+static void _win_gb_disassembler_print_label(int line, s32 offset, u8 flags)
+{
+    const char *prefix = (flags & (GB_ANALYSIS_FUNCTION | GB_ANALYSIS_ENTRY))
+                       ? "sub" : "loc";
+    u32 from;
+
+    int count = GB_AnalysisGetXrefs(offset, &from, 1);
+
+    char name[16];
+    snprintf(name, sizeof(name), "%s_%02X_%04X:", prefix, offset / 0x4000,
+             (offset < 0x4000) ? offset : (0x4000 + (offset & 0x3FFF)));
+
+    u32 from_bank = from / 0x4000;
+    u32 from_addr = (from < 0x4000) ? from : (0x4000 + (from & 0x3FFF));
+
+    if (count == 0)
+    {
+        GUI_ConsoleModePrintf(&gb_disassembly_con, 0, line, "%s", name);
+    }
+    else if (count == 1)
+    {
+        GUI_ConsoleModePrintf(&gb_disassembly_con, 0, line,
+                              "%s  ; from %02X:%04X", name, from_bank,
+                              from_addr);
+    }
+    else
+    {
+        GUI_ConsoleModePrintf(&gb_disassembly_con, 0, line,
+                              "%s  ; from %02X:%04X and %d more", name,
+                              from_bank, from_addr, count - 1);
+    }
+
+    GUI_ConsoleColorizeLine(&gb_disassembly_con, line, 0xFFE0E0E0);
+}
+
 void Win_GBDisassemblerStartAddressSetDefault(void)
 {
     gb_disassembler_set_default_address = 1;
@@ -110,6 +228,28 @@ void Win_GBDisassemblerUpdate(void)
 
     // DISASSEMBLER
 
+    // Code reached while running is analysed too
+    s32 pc_offset = _win_gb_disassembler_rom_offset(GameBoy.CPU.R16.PC);
+    if (pc_offset >= 0)
+        DisasmDB_GBAddEntry(pc_offset);
+
+    if (gb_disassembler_set_default_address && (pc_offset >= 0))
+    {
+        DisasmDB_Lock();
+        u8 pc_flags = GB_AnalysisGetFlags(pc_offset);
+        DisasmDB_Unlock();
+
+        // If the instructions before the PC are known, it isn't needed to
+        // guess where they start.
+        if (pc_flags & GB_ANALYSIS_CODE)
+        {
+            gb_disassembler_set_default_address = 0;
+            gb_disassembler_start_address = GameBoy.CPU.R16.PC;
+            _win_gb_disassembler_scroll(
+                                -((CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) - 2));
+        }
+    }
+
     if (gb_disassembler_set_default_address)
     {
         gb_disassembler_set_default_address = 0;
@@ -169,8 +309,24 @@ void Win_GBDisassemblerUpdate(void)
     u16 address = gb_disassembler_start_address;
     char opcode_text[128];
 
+    DisasmDB_Lock();
+
     for (int i = 0; i < CPU_DISASSEMBLER_MAX_INSTRUCTIONS; i++)
     {
+        s32 offset = _win_gb_disassembler_rom_offset(address);
+        u8 line_flags = (offset >= 0) ? GB_AnalysisGetFlags(offset) : 0;
+
+        if (line_flags & (GB_ANALYSIS_LABEL | GB_ANALYSIS_FUNCTION
+                          | GB_ANALYSIS_ENTRY))
+        {
+            _win_gb_disassembler_print_label(i, offset, line_flags);
+            gb_cpu_line_address[i] = address;
+
+            i++;
+            if (i == CPU_DISASSEMBLER_MAX_INSTRUCTIONS)
+                break;
+        }
+
         int step;
         s_strncpy(opcode_text, GB_Dissasemble(address, &step),
                   sizeof(opcode_text));
@@ -192,6 +348,8 @@ void Win_GBDisassemblerUpdate(void)
         address += step;
     }
 
+    DisasmDB_Unlock();
+
     address = GameBoy.CPU.R16.SP - ((CPU_STACK_MAX_LINES / 2) * 2);
     for (int i = 0; i < CPU_STACK_MAX_LINES; i++)
     {
@@ -229,7 +387,7 @@ static int _win_gb_disassembler_callback(SDL_Event *e)
     {
         if (e->type == SDL_MOUSEWHEEL)
         {
-            gb_disassembler_start_address -= e->wheel.y * 3;
+            _win_gb_disassembler_scroll(-e->wheel.y * 3);
             redraw = 1;
         }
         else if (e->type == SDL_KEYDOWN)
@@ -246,12 +404,34 @@ static int _win_gb_disassembler_callback(SDL_Event *e)
                     break;
 
                 case SDLK_DOWN:
-                    gb_disassembler_start_address += 1;
+                    _win_gb_disassembler_scroll(1);
                     redraw = 1;
                     break;
 
                 case SDLK_UP:
-                    gb_disassembler_start_address -= 1;
+                    _win_gb_disassembler_scroll(-1);
+                    redraw = 1;
+                    break;
+
+                case SDLK_PAGEDOWN:
+                    _win_gb_disassembler_scroll(
+                                        CPU_DISASSEMBLER_MAX_INSTRUCTIONS);
+                    redraw = 1;
+                    break;
+
+                case SDLK_PAGEUP:
+                    _win_gb_disassembler_scroll(
+                                        -CPU_DISASSEMBLER_MAX_INSTRUCTIONS);
+                    redraw = 1;
+                    break;
+
+                case SDLK_n: // Next function
+                    _win_gb_disassembler_jump_to_function(1);
+                    redraw = 1;
+                    break;
+
+                case SDLK_p: // Previous function
+                    _win_gb_disassembler_jump_to_function(-1);
                     redraw = 1;
                     break;
             }
@@ -305,7 +485,12 @@ static int _win_gb_disassembler_callback(SDL_Event *e)
 
 static void _win_gb_disassembly_textbox_callback(unused__ int x, int y)
 {
-    u32 addr = gb_cpu_line_address[y / FONT_HEIGHT];
+    int line = y / FONT_HEIGHT;
+
+    if ((line < 0) || (line >= CPU_DISASSEMBLER_MAX_INSTRUCTIONS))
+        return;
+
+    u32 addr = gb_cpu_line_address[line];
 
     if (GB_DebugIsBreakpoint(addr) == 0)
         GB_DebugAddBreakpoint(addr);
@@ -336,8 +521,9 @@ static void _win_gb_disassembly_inputwindow_callback(char *text, int is_valid)
             GameBoy.CPU.R16.PC = newvalue;
         else if (gb_debugger_register_to_change == 100)
         {
-            gb_disassembler_start_address =
-                    newvalue - CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2;
+            gb_disassembler_start_address = newvalue;
+            _win_gb_disassembler_scroll(
+                                -(CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2));
         }
     }
 }
@@ -462,6 +648,13 @@ int Win_GBDisassemblerCreate(void)
 
 void Win_GBDisassemblerSetFocus(void)
 {
+    // Windows can only be opened from the main thread
+    if (EmuThread_IsCurrent())
+    {
+        EmuThread_Defer(Win_GBDisassemblerSetFocus);
+        return;
+    }
+
     if (GBDisassemblerCreated == 0)
         Win_GBDisassemblerCreate();
 
@@ -8,7 +8,9 @@
 
 #include <SDL2/SDL.h>
 
+#include "../build_options.h"
 #include "../debug_utils.h"
+#include "../file_utils.h"
 #include "../font_utils.h"
 #include "../general_utils.h"
 #include "../window_handler.h"
@@ -17,6 +19,7 @@
 #include "win_main.h"
 #include "win_utils.h"
 
+#include "../gb_core/debug.h"
 #include "../gb_core/memory.h"
 
 //------------------------------------------------------------------------------
@@ -50,12 +53,15 @@ static _gui_console gb_memview_con;
 static _gui_element gb_memview_textbox;
 
 static _gui_element gb_memview_goto_btn;
+static _gui_element gb_memview_watch_btn, gb_memview_log_btn;
 
 static _gui_element gb_memview_mode_8_radbtn, gb_memview_mode_16_radbtn;
 
 static _gui_element *gb_memviwer_window_gui_elements[] = {
     &gb_memview_textbox,
     &gb_memview_goto_btn,
+    &gb_memview_watch_btn,
+    &gb_memview_log_btn,
     &gb_memview_mode_8_radbtn,
     &gb_memview_mode_16_radbtn,
     NULL
@@ -165,6 +171,8 @@ void Win_GBMemViewerUpdate(void)
 //----------------------------------------------------------------
 
 static void _win_gb_mem_viewer_goto(void);
+static void _win_gb_mem_viewer_watch(void);
+static void _win_gb_mem_viewer_save_log(void);
 
 //----------------------------------------------------------------
 
@@ -205,6 +213,15 @@ static int _win_gba_mem_viewer_callback(SDL_Event *e)
                     redraw = 1;
                     break;
 
+                case SDLK_F9:
+                    _win_gb_mem_viewer_watch();
+                    redraw = 1;
+                    break;
+
+                case SDLK_F10:
+                    _win_gb_mem_viewer_save_log();
+                    break;
+
                 case SDLK_DOWN:
                     gb_memviewer_start_address += GB_MEMVIEWER_ADDRESS_JUMP_LINE;
                     redraw = 1;
@@ -370,6 +387,64 @@ static void _win_gb_mem_viewer_goto(void)
                         _win_gb_mem_viewer_inputwindow_callback);
 }
 
+// The text is "SSSSEEEEM" or "SSSSEEEEMVV": Start and end address, mode (1 =
+// read, 2 = write, 4 = break, they can be combined) and optional value. A mode
+// of 0 clears all watchpoints.
+static void _win_gb_mem_viewer_watch_callback(char *text, int is_valid)
+{
+    if (is_valid == 0)
+        return;
+
+    char start[5], end[5], mode[2], value[3];
+
+    if (strlen(text) < 9)
+    {
+        Debug_ErrorMsgArg("Invalid watchpoint: %s", text);
+        return;
+    }
+
+    s_strncpy(start, &text[0], sizeof(start));
+    s_strncpy(end, &text[4], sizeof(end));
+    s_strncpy(mode, &text[8], sizeof(mode));
+    s_strncpy(value, &text[9], sizeof(value));
+
+    int flags = asciihex_to_int(mode);
+    if (flags == 0)
+    {
+        GB_DebugClearWatchpointAll();
+        return;
+    }
+
+    int has_value = strlen(value) > 0;
+
+    if (GB_DebugAddWatchpoint(asciihex_to_int(start), asciihex_to_int(end),
+                              flags, has_value, asciihex_to_int(value)) == 0)
+    {
+        Debug_ErrorMsgArg("Couldn't add watchpoint: %s", text);
+    }
+}
+
+static void _win_gb_mem_viewer_watch(void)
+{
+    if (GBMemViewerCreated == 0)
+        return;
+
+    if (Win_MainRunningGB() == 0)
+        return;
+
+    GUI_InputWindowOpen(&gui_iw_gb_memviewer, "Watch: start end mode [value]",
+                        _win_gb_mem_viewer_watch_callback);
+}
+
+static void _win_gb_mem_viewer_save_log(void)
+{
+    char path[MAX_PATHLEN];
+    snprintf(path, sizeof(path), "%sgb_watch_log.csv", DirGetRunningPath());
+
+    if (GB_DebugWatchLogSave(path))
+        Debug_DebugMsgArg("Watchpoint log saved to %s", path);
+}
+
 //----------------------------------------------------------------
 
 int Win_GBMemViewerCreate(void)
@@ -404,6 +479,13 @@ int Win_GBMemViewerCreate(void)
                   68 + 39 * FONT_WIDTH + 36, 6, 16 * FONT_WIDTH, 24,
                   "Goto (F8)", _win_gb_mem_viewer_goto);
 
+    GUI_SetButton(&gb_memview_watch_btn,
+                  150, 6, 14 * FONT_WIDTH, 24,
+                  "Watch (F9)", _win_gb_mem_viewer_watch);
+    GUI_SetButton(&gb_memview_log_btn,
+                  150 + 14 * FONT_WIDTH + 6, 6, 14 * FONT_WIDTH, 24,
+                  "Log (F10)", _win_gb_mem_viewer_save_log);
+
     GUI_SetTextBox(&gb_memview_textbox, &gb_memview_con,
                    6, 36, 69 * FONT_WIDTH, GB_MEMVIEWER_MAX_LINES * FONT_HEIGHT,
                    _win_gb_mem_view_textbox_callback);
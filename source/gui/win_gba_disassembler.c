@@ -8,7 +8,11 @@
 
 #include <SDL2/SDL.h>
 
+#include "../build_options.h"
 #include "../debug_utils.h"
+#include "../disasm_db.h"
+#include "../emu_thread.h"
+#include "../file_utils.h"
 #include "../font_utils.h"
 #include "../general_utils.h"
 #include "../window_handler.h"
@@ -17,17 +21,19 @@
 #include "win_main.h"
 #include "win_utils.h"
 
+#include "../gba_core/analysis.h"
 #include "../gba_core/cpu.h"
 #include "../gba_core/disassembler.h"
 #include "../gba_core/gba.h"
 #include "../gba_core/memory.h"
+#include "../gba_core/profiler.h"
 
 //------------------------------------------------------------------------------
 
 static int WinIDGBADis;
 
 #define WIN_GBA_DISASSEMBLER_WIDTH  600
-#define WIN_GBA_DISASSEMBLER_HEIGHT 480
+#define WIN_GBA_DISASSEMBLER_HEIGHT 650
 
 static int GBADisassemblerCreated = 0;
 
@@ -40,9 +46,16 @@ static unsigned char *gba_disasm_buffer = NULL;
 #define GBA_DISASM_CPU_AUTO  0
 #define GBA_DISASM_CPU_ARM   1
 #define GBA_DISASM_CPU_THUMB 2
+#define GBA_DISASM_DATA      3 // Only used for lines, not selectable
 
 static int disassemble_mode = GBA_DISASM_CPU_AUTO;
 
+// Address of the instruction shown in each line, used to set breakpoints
+static u32 gba_cpu_line_address[CPU_DISASSEMBLER_MAX_INSTRUCTIONS];
+
+// Number of functions shown in the profiler table
+#define GBA_PROFILER_TOP_ROWS 10
+
 static u32 gba_disassembler_set_default_address = 0;
 static u32 gba_disassembler_start_address;
 
@@ -58,6 +71,13 @@ static _gui_element gba_disassembler_disassembly_mode_label;
 static _gui_element gba_disassembler_auto_radbtn, gba_disassembler_arm_radbtn,
                     gba_disassembler_thumb_radbtn;
 
+static _gui_element gba_disassembler_analysis_label;
+
+static _gui_console gba_profiler_con;
+static _gui_element gba_profiler_textbox;
+
+static _gui_element gba_profiler_start_btn, gba_profiler_save_btn;
+
 static _gui_element *gba_disassembler_window_gui_elements[] = {
     &gba_disassembly_textbox,
     &gba_regs_textbox,
@@ -67,6 +87,10 @@ static _gui_element *gba_disassembler_window_gui_elements[] = {
     &gba_disassembler_auto_radbtn,
     &gba_disassembler_arm_radbtn,
     &gba_disassembler_thumb_radbtn,
+    &gba_disassembler_analysis_label,
+    &gba_profiler_start_btn,
+    &gba_profiler_save_btn,
+    &gba_profiler_textbox,
     NULL
 };
 
@@ -82,14 +106,203 @@ static _gui gba_disassembler_window_gui = {
 
 static void _win_gba_disassembler_step(void);
 static void _win_gba_disassembler_goto(void);
+static void _win_gba_profiler_start_stop(void);
+static void _win_gba_profiler_save(void);
 
 //------------------------------------------------------------------------------
 
+// Returns the way the instruction at the specified address is shown. In auto
+// mode, the results of the code analysis are used if the address has been
+// analysed. If not, the current mode of the CPU is used. The disassembly
+// database must be locked.
+static int _win_gba_disassembler_line_mode(u32 address)
+{
+    if (disassemble_mode != GBA_DISASM_CPU_AUTO)
+        return disassemble_mode;
+
+    u8 flags = GBA_AnalysisGetFlags(address);
+
+    if (flags & GBA_ANALYSIS_ARM)
+        return GBA_DISASM_CPU_ARM;
+    if (flags & GBA_ANALYSIS_THUMB)
+        return GBA_DISASM_CPU_THUMB;
+    if (flags & GBA_ANALYSIS_DATA)
+        return GBA_DISASM_DATA;
+
+    if (GBA_CPUGet()->EXECUTION_MODE == EXEC_ARM)
+        return GBA_DISASM_CPU_ARM;
+
+    return GBA_DISASM_CPU_THUMB;
+}
+
+// The disassembly database must be locked
+static u32 _win_gba_disassembler_next_address(u32 address)
+{
+    if (_win_gba_disassembler_line_mode(address) == GBA_DISASM_CPU_THUMB)
+        return address + 2;
+
+    return address + 4;
+}
+
+// The disassembly database must be locked
+static u32 _win_gba_disassembler_prev_address(u32 address)
+{
+    if (disassemble_mode == GBA_DISASM_CPU_AUTO)
+    {
+        if (GBA_AnalysisGetFlags(address - 2) & GBA_ANALYSIS_THUMB)
+            return address - 2;
+        if (GBA_AnalysisGetFlags(address - 4)
+            & (GBA_ANALYSIS_ARM | GBA_ANALYSIS_DATA))
+        {
+            return address - 4;
+        }
+    }
+
+    if (_win_gba_disassembler_line_mode(address) == GBA_DISASM_CPU_THUMB)
+        return address - 2;
+
+    return address - 4;
+}
+
+static void _win_gba_disassembler_scroll(int lines)
+{
+    DisasmDB_Lock();
+
+    for (int i = 0; i < lines; i++)
+    {
+        gba_disassembler_start_address =
+            _win_gba_disassembler_next_address(gba_disassembler_start_address);
+    }
+
+    for (int i = 0; i > lines; i--)
+    {
+        gba_disassembler_start_address =
+            _win_gba_disassembler_prev_address(gba_disassembler_start_address);
+    }
+
+    DisasmDB_Unlock();
+}
+
+// Sets the start address so that the specified address is shown after the
+// specified number of lines.
+static void _win_gba_disassembler_show_address(u32 address, int lines)
+{
+    DisasmDB_Lock();
+
+    for (int i = 0; i < lines; i++)
+    {
+        u32 prev = _win_gba_disassembler_prev_address(address);
+        if (prev > address)
+            break;
+        address = prev;
+    }
+
+    DisasmDB_Unlock();
+
+    gba_disassembler_start_address = address;
+}
+
+static void _win_gba_disassembler_jump_to_function(int direction)
+{
+    DisasmDB_Lock();
+    u32 address = GBA_AnalysisFindLabel(gba_disassembler_start_address,
+                                        direction, 1);
+    DisasmDB_Unlock();
+
+    if (address != 0)
+        gba_disassembler_start_address = address;
+}
+
 void Win_GBADisassemblerStartAddressSetDefault(void)
 {
     gba_disassembler_set_default_address = 1;
 }
 
+static void _win_gba_profiler_update(void)
+{
+    static gba_profiler_entry entries[GBA_PROFILER_TOP_ROWS];
+    u64 total;
+
+    GUI_ConsoleClear(&gba_profiler_con);
+
+    GUI_ConsoleModePrintf(&gba_profiler_con, 0, 0,
+                          " Self%%  Total%%  Self cycles  Function");
+
+    int count = GBA_ProfilerGetTop(entries, GBA_PROFILER_TOP_ROWS, &total);
+
+    if (count == 0)
+    {
+        GUI_ConsoleModePrintf(&gba_profiler_con, 0, 1,
+                              GBA_ProfilerIsEnabled() ? "No samples yet" :
+                              "Profiler stopped");
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        gba_profiler_entry *e = &entries[i];
+
+        GUI_ConsoleModePrintf(&gba_profiler_con, 0, i + 1,
+                              "%6.2f %6.2f %12llu  %s",
+                              (double)e->self * 100.0 / (double)total,
+                              (double)e->total * 100.0 / (double)total,
+                              (unsigned long long)e->self, e->name);
+    }
+}
+
+// Prints the name of a label and the addresses that jump to it. The
+// disassembly database must be locked.
+static void _win_gba_disassembler_print_label(int line, u32 address, u8 flags)
+{
+    const char *prefix = (flags & (GBA_ANALYSIS_FUNCTION | GBA_ANALYSIS_ENTRY))
+                       ? "sub" : "loc";
+    u32 from;
+
+    int count = GBA_AnalysisGetXrefs(address, &from, 1);
+
+    if (count == 0)
+    {
+        GUI_ConsoleModePrintf(&gba_disassembly_con, 0, line, "%s_%08X:",
+                              prefix, address);
+    }
+    else if (count == 1)
+    {
+        GUI_ConsoleModePrintf(&gba_disassembly_con, 0, line,
+                              "%s_%08X:        ; from %08X", prefix, address,
+                              from);
+    }
+    else
+    {
+        GUI_ConsoleModePrintf(&gba_disassembly_con, 0, line,
+                              "%s_%08X:        ; from %08X and %d more",
+                              prefix, address, from, count - 1);
+    }
+
+    GUI_ConsoleColorizeLine(&gba_disassembly_con, line, 0xFFE0E0E0);
+}
+
+static void _win_gba_disassembler_analysis_update(void)
+{
+    char text[32];
+
+    if (DisasmDB_IsBusy())
+    {
+        snprintf(text, sizeof(text), "Analysing...");
+    }
+    else
+    {
+        u32 instructions, pending;
+
+        DisasmDB_Lock();
+        GBA_AnalysisGetStats(&instructions, &pending);
+        DisasmDB_Unlock();
+
+        snprintf(text, sizeof(text), "Code: %u", instructions);
+    }
+
+    GUI_SetLabelCaption(&gba_disassembler_analysis_label, text);
+}
+
 void Win_GBADisassemblerUpdate(void)
 {
     if (GBADisassemblerCreated == 0)
@@ -107,27 +320,20 @@ void Win_GBADisassemblerUpdate(void)
     {
         gba_disassembler_set_default_address = 0;
 
-        u32 address = cpu->R[R_PC];
-
-        if (((disassemble_mode == GBA_DISASM_CPU_AUTO)
-             && (cpu->EXECUTION_MODE == EXEC_ARM))
-            || (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
-        {
-            if (address > ((CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) - 2) * 4)
-                address -= ((CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) - 2) * 4;
-            else
-                address = 0;
-        }
-        else // THUMB
-        {
-            if (address > ((CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) - 2) * 2)
-                address -= ((CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) - 2) * 2;
-            else
-                address = 0;
-        }
-        gba_disassembler_start_address = address;
+        _win_gba_disassembler_show_address(cpu->R[R_PC],
+                                (CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) - 2);
     }
 
+    // Code reached while running is analysed too, as well as the interrupt
+    // handler set by the game.
+    DisasmDB_GBAAddEntry(cpu->R[R_PC], cpu->EXECUTION_MODE == EXEC_THUMB);
+    u32 irq_handler = GBA_MemoryReadFast32(0x03007FFC);
+    DisasmDB_GBAAddEntry(irq_handler, irq_handler & 1);
+
+    _win_gba_disassembler_analysis_update();
+
+    _win_gba_profiler_update();
+
     // REGISTERS
     for (int i = 0; i < 10; i++)
         GUI_ConsoleModePrintf(&gba_regs_con, 0, i, "r%d:   %08X", i, cpu->R[i]);
@@ -160,82 +366,77 @@ void Win_GBADisassemblerUpdate(void)
     // DISASSEMBLER
 
     char opcode_text[128];
-    char final_text[156];
 
-    if (((disassemble_mode == GBA_DISASM_CPU_AUTO) &&
-         (cpu->EXECUTION_MODE == EXEC_ARM)) ||
-        (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
+    u32 address = gba_disassembler_start_address;
+    int line = 0;
+
+    DisasmDB_Lock();
+
+    while (line < CPU_DISASSEMBLER_MAX_INSTRUCTIONS)
     {
-        u32 address = gba_disassembler_start_address; // Start address
+        u8 flags = GBA_AnalysisGetFlags(address);
 
-        for (int i = 0; i < CPU_DISASSEMBLER_MAX_INSTRUCTIONS; i++)
+        if (flags & (GBA_ANALYSIS_LABEL | GBA_ANALYSIS_FUNCTION
+                     | GBA_ANALYSIS_ENTRY))
         {
-            u32 opcode = GBA_MemoryReadFast32(address);
+            _win_gba_disassembler_print_label(line, address, flags);
+            gba_cpu_line_address[line] = address;
 
-            GBA_DisassembleARM(opcode, address, opcode_text,
-                               sizeof(opcode_text));
-            snprintf(final_text, sizeof(final_text), "%08X:%08X %s", address,
-                     opcode, opcode_text);
+            line++;
+            if (line == CPU_DISASSEMBLER_MAX_INSTRUCTIONS)
+                break;
+        }
 
-            GUI_ConsoleModePrintf(&gba_disassembly_con, 0, i, final_text);
+        int mode = _win_gba_disassembler_line_mode(address);
 
-            if (GBA_DebugIsBreakpoint(address))
-            {
-                if (address == cpu->R[R_PC])
-                {
-                    GUI_ConsoleColorizeLine(&gba_disassembly_con, i,
-                                            0xFFFF8000);
-                }
-                else
-                {
-                    GUI_ConsoleColorizeLine(&gba_disassembly_con, i,
-                                            0xFF0000FF);
-                }
-            }
-            else if (address == cpu->R[R_PC])
-            {
-                GUI_ConsoleColorizeLine(&gba_disassembly_con, i, 0xFFFFFF00);
-            }
+        if (mode == GBA_DISASM_CPU_ARM)
+        {
+            u32 opcode = GBA_MemoryReadFast32(address);
 
-            address += 4;
+            GBA_DisassembleARM(opcode, address, opcode_text,
+                               sizeof(opcode_text));
+            GUI_ConsoleModePrintf(&gba_disassembly_con, 0, line,
+                                  "%08X:%08X %s", address, opcode,
+                                  opcode_text);
         }
-    }
-    else // THUMB
-    {
-        u32 address = gba_disassembler_start_address; // Start address
-
-        for (int i = 0; i < CPU_DISASSEMBLER_MAX_INSTRUCTIONS; i++)
+        else if (mode == GBA_DISASM_CPU_THUMB)
         {
             u16 opcode = GBA_MemoryReadFast16(address);
 
             GBA_DisassembleTHUMB(opcode, address, opcode_text,
                                  sizeof(opcode_text));
-            snprintf(final_text, sizeof(final_text), "%08X:%04X %s", address,
-                     opcode, opcode_text);
+            GUI_ConsoleModePrintf(&gba_disassembly_con, 0, line,
+                                  "%08X:%04X %s", address, opcode,
+                                  opcode_text);
+        }
+        else // Data
+        {
+            u32 data = GBA_MemoryReadFast32(address);
 
-            GUI_ConsoleModePrintf(&gba_disassembly_con, 0, i, final_text);
+            GUI_ConsoleModePrintf(&gba_disassembly_con, 0, line,
+                                  "%08X:%08X .word 0x%08X", address, data,
+                                  data);
+        }
 
-            if (GBA_DebugIsBreakpoint(address))
-            {
-                if (address == cpu->R[R_PC])
-                {
-                    GUI_ConsoleColorizeLine(&gba_disassembly_con, i,
-                                            0xFFFF8000);
-                }
-                else
-                {
-                    GUI_ConsoleColorizeLine(&gba_disassembly_con, i,
-                                            0xFF0000FF);
-                }
-            }
-            else if (address == cpu->R[R_PC])
-            {
-                GUI_ConsoleColorizeLine(&gba_disassembly_con, i, 0xFFFFFF00);
-            }
+        gba_cpu_line_address[line] = address;
 
-            address += 2;
+        if (GBA_DebugIsBreakpoint(address))
+        {
+            if (address == cpu->R[R_PC])
+                GUI_ConsoleColorizeLine(&gba_disassembly_con, line, 0xFFFF8000);
+            else
+                GUI_ConsoleColorizeLine(&gba_disassembly_con, line, 0xFF0000FF);
+        }
+        else if (address == cpu->R[R_PC])
+        {
+            GUI_ConsoleColorizeLine(&gba_disassembly_con, line, 0xFFFFFF00);
         }
+
+        line++;
+        address += (mode == GBA_DISASM_CPU_THUMB) ? 2 : 4;
     }
+
+    DisasmDB_Unlock();
 }
 
 static void _win_gba_disassembler_render(void)
@@ -256,23 +457,13 @@ static int _win_gba_disassembler_callback(SDL_Event *e)
 
     int redraw = GUI_SendEvent(&gba_disassembler_window_gui, e);
 
-    _cpu_t *cpu = GBA_CPUGet();
     int close_this = 0;
 
     if (GUI_InputWindowIsEnabled(&gui_iw_gba_disassembler) == 0)
     {
         if (e->type == SDL_MOUSEWHEEL)
         {
-            if (((disassemble_mode == GBA_DISASM_CPU_AUTO) &&
-                 (cpu->EXECUTION_MODE == EXEC_ARM)) ||
-                (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
-            {
-                gba_disassembler_start_address -= e->wheel.y * 3 * 4;
-            }
-            else // THUMB
-            {
-                gba_disassembler_start_address -= e->wheel.y * 3 * 2;
-            }
+            _win_gba_disassembler_scroll(-e->wheel.y * 3);
             redraw = 1;
         }
         else if (e->type == SDL_KEYDOWN)
@@ -287,32 +478,44 @@ static int _win_gba_disassembler_callback(SDL_Event *e)
                     _win_gba_disassembler_goto();
                     redraw = 1;
                     break;
+                case SDLK_F9:
+                    _win_gba_profiler_start_stop();
+                    redraw = 1;
+                    break;
+                case SDLK_F10:
+                    _win_gba_profiler_save();
+                    redraw = 1;
+                    break;
 
                 case SDLK_DOWN:
-                    if (((disassemble_mode == GBA_DISASM_CPU_AUTO) &&
-                         (cpu->EXECUTION_MODE == EXEC_ARM)) ||
-                        (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
-                    {
-                        gba_disassembler_start_address += 4;
-                    }
-                    else // THUMB
-                    {
-                        gba_disassembler_start_address += 2;
-                    }
+                    _win_gba_disassembler_scroll(1);
                     redraw = 1;
                     break;
 
                 case SDLK_UP:
-                    if (((disassemble_mode == GBA_DISASM_CPU_AUTO) &&
-                         (cpu->EXECUTION_MODE == EXEC_ARM)) ||
-                        (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
-                    {
-                        gba_disassembler_start_address -= 4;
-                    }
-                    else // THUMB
-                    {
-                        gba_disassembler_start_address -= 2;
-                    }
+                    _win_gba_disassembler_scroll(-1);
+                    redraw = 1;
+                    break;
+
+                case SDLK_PAGEDOWN:
+                    _win_gba_disassembler_scroll(
+                                        CPU_DISASSEMBLER_MAX_INSTRUCTIONS);
+                    redraw = 1;
+                    break;
+
+                case SDLK_PAGEUP:
+                    _win_gba_disassembler_scroll(
+                                        -CPU_DISASSEMBLER_MAX_INSTRUCTIONS);
+                    redraw = 1;
+                    break;
+
+                case SDLK_n: // Next function
+                    _win_gba_disassembler_jump_to_function(1);
+                    redraw = 1;
+                    break;
+
+                case SDLK_p: // Previous function
+                    _win_gba_disassembler_jump_to_function(-1);
                     redraw = 1;
                     break;
             }
@@ -369,23 +572,12 @@ static int _win_gba_disassembler_callback(SDL_Event *e)
 
 static void _win_gba_disassembly_textbox_callback(unused__ int x, int y)
 {
-    _cpu_t *cpu = GBA_CPUGet();
-
-    int instr_size;
+    int line = y / FONT_HEIGHT;
 
-    if (((disassemble_mode == GBA_DISASM_CPU_AUTO) &&
-         (cpu->EXECUTION_MODE == EXEC_ARM)) ||
-        (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
-    {
-        instr_size = 4;
-    }
-    else // THUMB
-    {
-        instr_size = 2;
-    }
+    if ((line < 0) || (line >= CPU_DISASSEMBLER_MAX_INSTRUCTIONS))
+        return;
 
-    u32 addr = gba_disassembler_start_address
-             + ((y / FONT_HEIGHT) * instr_size);
+    u32 addr = gba_cpu_line_address[line];
 
     if(GBA_DebugIsBreakpoint(addr) == 0)
         GBA_DebugAddBreakpoint(addr);
@@ -425,20 +617,8 @@ static void _win_gba_disassembly_inputwindow_callback(char *text, int is_valid)
         }
         else if (gba_debugger_register_to_change == 100)
         {
-            int increment;
-            if (((disassemble_mode == GBA_DISASM_CPU_AUTO) &&
-                 (cpu->EXECUTION_MODE == EXEC_ARM)) ||
-                (disassemble_mode == GBA_DISASM_CPU_ARM)) // ARM
-            {
-                increment = 4;
-            }
-            else // THUMB
-            {
-                increment = 2;
-            }
-
-            gba_disassembler_start_address = newvalue
-                        - ((CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2) * increment);
+            _win_gba_disassembler_show_address(newvalue,
+                                        CPU_DISASSEMBLER_MAX_INSTRUCTIONS / 2);
         }
     }
 }
@@ -504,6 +684,39 @@ static void _win_gba_disassembler_goto(void)
                         _win_gba_disassembly_inputwindow_callback);
 }
 
+static void _win_gba_profiler_start_stop(void)
+{
+    if (GBADisassemblerCreated == 0)
+        return;
+
+    if (Win_MainRunningGBA() == 0)
+        return;
+
+    if (GBA_ProfilerIsEnabled())
+    {
+        GBA_ProfilerStop();
+        GUI_SetButtonText(&gba_profiler_start_btn, "Profile (F9)");
+    }
+    else if (GBA_ProfilerStart())
+    {
+        GUI_SetButtonText(&gba_profiler_start_btn, "Stop (F9)");
+    }
+
+    Win_GBADisassemblerUpdate();
+}
+
+static void _win_gba_profiler_save(void)
+{
+    if (GBADisassemblerCreated == 0)
+        return;
+
+    char path[MAX_PATHLEN];
+    snprintf(path, sizeof(path), "%sgba_profile.folded", DirGetRunningPath());
+
+    if (GBA_ProfilerSaveFolded(path))
+        Debug_DebugMsgArg("Profile saved to %s", path);
+}
+
 //----------------------------------------------------------------
 
 int Win_GBADisassemblerCreate(void)
@@ -558,6 +771,19 @@ int Win_GBADisassemblerCreate(void)
                        "THUMB", 0, GBA_DISASM_CPU_THUMB, 0,
                        _win_gba_cpu_mode_radbtn_callback);
 
+    GUI_SetLabel(&gba_disassembler_analysis_label,
+                 6 + 66 * FONT_WIDTH + 12, 480, 16 * FONT_WIDTH, 24, " ");
+
+    GUI_SetButton(&gba_profiler_start_btn, 6, 480, 16 * FONT_WIDTH, 24,
+                  GBA_ProfilerIsEnabled() ? "Stop (F9)" : "Profile (F9)",
+                  _win_gba_profiler_start_stop);
+    GUI_SetButton(&gba_profiler_save_btn, 6 + 16 * FONT_WIDTH + 12, 480,
+                  16 * FONT_WIDTH, 24, "Save (F10)", _win_gba_profiler_save);
+
+    GUI_SetTextBox(&gba_profiler_textbox, &gba_profiler_con, 6, 510,
+                   84 * FONT_WIDTH, (GBA_PROFILER_TOP_ROWS + 1) * FONT_HEIGHT,
+                   NULL);
+
     GUI_InputWindowClose(&gui_iw_gba_disassembler);
 
     GBADisassemblerCreated = 1;
@@ -580,6 +806,13 @@ int Win_GBADisassemblerCreate(void)
 
 void Win_GBADisassemblerSetFocus(void)
 {
+    // Windows can only be opened from the main thread
+    if (EmuThread_IsCurrent())
+    {
+        EmuThread_Defer(Win_GBADisassemblerSetFocus);
+        return;
+    }
+
     if (GBADisassemblerCreated == 0)
         Win_GBADisassemblerCreate();
 
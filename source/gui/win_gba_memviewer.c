@@ -8,7 +8,9 @@
 
 #include <SDL2/SDL.h>
 
+#include "../build_options.h"
 #include "../debug_utils.h"
+#include "../file_utils.h"
 #include "../font_utils.h"
 #include "../general_utils.h"
 #include "../window_handler.h"
@@ -17,6 +19,7 @@
 #include "win_main.h"
 #include "win_utils.h"
 
+#include "../gba_core/disassembler.h"
 #include "../gba_core/memory.h"
 
 //------------------------------------------------------------------------------
@@ -51,6 +54,7 @@ static _gui_console gba_memview_con;
 static _gui_element gba_memview_textbox;
 
 static _gui_element gba_memview_goto_btn;
+static _gui_element gba_memview_watch_btn, gba_memview_log_btn;
 
 static _gui_element gba_memview_mode_8_radbtn, gba_memview_mode_16_radbtn,
                     gba_memview_mode_32_radbtn;
@@ -58,6 +62,8 @@ static _gui_element gba_memview_mode_8_radbtn, gba_memview_mode_16_radbtn,
 static _gui_element *gba_memviwer_window_gui_elements[] = {
     &gba_memview_textbox,
     &gba_memview_goto_btn,
+    &gba_memview_watch_btn,
+    &gba_memview_log_btn,
     &gba_memview_mode_8_radbtn,
     &gba_memview_mode_16_radbtn,
     &gba_memview_mode_32_radbtn,
@@ -215,6 +221,8 @@ void Win_GBAMemViewerUpdate(void)
 //----------------------------------------------------------------
 
 static void _win_gba_mem_viewer_goto(void);
+static void _win_gba_mem_viewer_watch(void);
+static void _win_gba_mem_viewer_save_log(void);
 
 //----------------------------------------------------------------
 
@@ -255,6 +263,15 @@ static int _win_gba_mem_viewer_callback(SDL_Event *e)
                     redraw = 1;
                     break;
 
+                case SDLK_F9:
+                    _win_gba_mem_viewer_watch();
+                    redraw = 1;
+                    break;
+
+                case SDLK_F10:
+                    _win_gba_mem_viewer_save_log();
+                    break;
+
                 case SDLK_DOWN:
                     gba_memviewer_start_address +=
                             GBA_MEMVIEWER_ADDRESS_JUMP_LINE;
@@ -446,6 +463,65 @@ static void _win_gba_mem_viewer_goto(void)
                         _win_gba_mem_viewer_inputwindow_callback);
 }
 
+// The text is "SSSSSSSSEEEEEEEEM" or "SSSSSSSSEEEEEEEEMVVVVVVVV": Start and end
+// address, mode (1 = read, 2 = write, 4 = break, they can be combined) and
+// optional value. A mode of 0 clears all watchpoints.
+static void _win_gba_mem_viewer_watch_callback(char *text, int is_valid)
+{
+    if (is_valid == 0)
+        return;
+
+    char start[9], end[9], mode[2], value[9];
+
+    if (strlen(text) < 17)
+    {
+        Debug_ErrorMsgArg("Invalid watchpoint: %s", text);
+        return;
+    }
+
+    s_strncpy(start, &text[0], sizeof(start));
+    s_strncpy(end, &text[8], sizeof(end));
+    s_strncpy(mode, &text[16], sizeof(mode));
+    s_strncpy(value, &text[17], sizeof(value));
+
+    int flags = asciihex_to_int(mode);
+    if (flags == 0)
+    {
+        GBA_DebugClearWatchpointAll();
+        return;
+    }
+
+    int has_value = strlen(value) > 0;
+
+    if (GBA_DebugAddWatchpoint(asciihex_to_int(start), asciihex_to_int(end),
+                               flags, has_value, asciihex_to_int(value)) == 0)
+    {
+        Debug_ErrorMsgArg("Couldn't add watchpoint: %s", text);
+    }
+}
+
+static void _win_gba_mem_viewer_watch(void)
+{
+    if (GBAMemViewerCreated == 0)
+        return;
+
+    if (Win_MainRunningGBA() == 0)
+        return;
+
+    GUI_InputWindowOpen(&gui_iw_gba_memviewer,
+                        "Watch: start end mode [value]",
+                        _win_gba_mem_viewer_watch_callback);
+}
+
+static void _win_gba_mem_viewer_save_log(void)
+{
+    char path[MAX_PATHLEN];
+    snprintf(path, sizeof(path), "%sgba_watch_log.csv", DirGetRunningPath());
+
+    if (GBA_DebugWatchLogSave(path))
+        Debug_DebugMsgArg("Watchpoint log saved to %s", path);
+}
+
 //------------------------------------------------------------------------------
 
 int Win_GBAMemViewerCreate(void)
@@ -484,6 +560,13 @@ int Win_GBAMemViewerCreate(void)
                   68 + 39 * FONT_WIDTH + 36, 6, 16 * FONT_WIDTH, 24,
                   "Goto (F8)", _win_gba_mem_viewer_goto);
 
+    GUI_SetButton(&gba_memview_watch_btn,
+                  226, 6, 10 * FONT_WIDTH, 24,
+                  "Watch", _win_gba_mem_viewer_watch);
+    GUI_SetButton(&gba_memview_log_btn,
+                  226 + 10 * FONT_WIDTH + 6, 6, 9 * FONT_WIDTH, 24,
+                  "Log", _win_gba_mem_viewer_save_log);
+
     GUI_SetTextBox(&gba_memview_textbox, &gba_memview_con,
                    6, 36,
                    69 * FONT_WIDTH, GBA_MEMVIEWER_MAX_LINES * FONT_HEIGHT,
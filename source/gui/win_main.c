@@ -14,16 +14,27 @@
 #include "win_main_config_input.h"
 #include "win_utils.h"
 
+#include "../autosave.h"
 #include "../build_options.h"
+#include "../capture.h"
 #include "../config.h"
 #include "../debug_utils.h"
+#include "../disasm_db.h"
+#include "../emu_thread.h"
 #include "../file_explorer.h"
 #include "../file_utils.h"
 #include "../font_utils.h"
 #include "../general_utils.h"
 #include "../input_utils.h"
+#include "../link_cable.h"
 #include "../lua_handler.h"
+#include "../movie.h"
+#include "../netplay.h"
+#include "../rom_archive.h"
+#include "../rom_library.h"
+#include "../run_ahead.h"
 #include "../sound_utils.h"
+#include "../timing_utils.h"
 #include "../window_handler.h"
 
 #include "../gb_core/camera.h"
@@ -38,6 +49,7 @@
 #include "../gba_core/bios.h"
 #include "../gba_core/disassembler.h"
 #include "../gba_core/gba.h"
+#include "../gba_core/profiler.h"
 #include "../gba_core/rom.h"
 #include "../gba_core/save.h"
 #include "../gba_core/sound.h"
@@ -77,6 +89,10 @@ static void _win_main_update_frameskip(void)
 
 static int _win_main_has_to_frameskip(void)
 {
+    // All frames are needed when recording a video
+    if (Capture_VideoIsRecording())
+        return 0;
+
     return (_win_main_frameskipcount != 0); // skip when not 0
 }
 
@@ -91,16 +107,20 @@ static int WIN_MAIN_RUNNING = RUNNING_NONE;
 //------------------------------------------------------------------
 
 static int current_fps, old_fps;
-static int frames_drawn = 0;
+static SDL_atomic_t frames_drawn; // Incremented by the emulation thread
 static SDL_TimerID fps_timer;
 
+// Seconds that the RTC of GB cartridges has to be advanced. They are handled
+// by the thread that emulates the frames so that the RTC is never modified
+// while run-ahead has saved the state of the machine.
+static SDL_atomic_t gb_rtc_seconds;
+
 static Uint32 fps_callback_function(Uint32 interval, unused__ void *param)
 {
     if (WIN_MAIN_RUNNING == RUNNING_GB)
-        GB_HandleRTC();
+        SDL_AtomicAdd(&gb_rtc_seconds, 1);
 
-    current_fps = frames_drawn;
-    frames_drawn = 0;
+    current_fps = SDL_AtomicSet(&frames_drawn, 0);
 
     return interval;
 }
@@ -112,7 +132,7 @@ static void fps_update_caption(void)
 
     old_fps = current_fps;
 
-    char caption[60];
+    char caption[100];
     if (_win_main_frameskip > 0)
     {
         snprintf(caption, sizeof(caption),
@@ -125,6 +145,26 @@ static void fps_update_caption(void)
                  "GiiBiiAdvance: %d fps - %.2f%%", current_fps,
                  (float)current_fps * 10.0f / 6.0f);
     }
+
+    if (EmulatorConfig.run_ahead > 0)
+    {
+        int frames, max_frames;
+        RunAhead_GetBudget(&frames, &max_frames);
+
+        size_t len = strlen(caption);
+        snprintf(caption + len, sizeof(caption) - len,
+                 " - Run-ahead %d (max %d)", frames, max_frames);
+    }
+
+    if (Netplay_IsEnabled())
+    {
+        netplay_stats_t stats;
+        Netplay_GetStats(&stats);
+
+        size_t len = strlen(caption);
+        snprintf(caption + len, sizeof(caption) - len,
+                 " - Netplay: %u rollbacks", stats.rollbacks);
+    }
     WH_SetCaption(WinIDMain, caption);
 }
 
@@ -307,7 +347,7 @@ static void _win_main_switch_to_menu_delayed(void)
 
 //------------------------------------------------------------------
 
-static int _win_main_get_rom_type(char *name)
+static int _win_main_get_rom_type_from_name(const char *name)
 {
     char extension[4];
     int len = strlen(name);
@@ -340,23 +380,46 @@ static int _win_main_get_rom_type(char *name)
     return RUNNING_NONE;
 }
 
+static int _win_main_get_rom_type(char *path)
+{
+    if (RomArchive_GetType(path) == ROM_ARCHIVE_NONE)
+        return _win_main_get_rom_type_from_name(path);
+
+    // Use the name of the ROM inside of the archive
+    static char name[MAX_PATHLEN];
+    size_t size;
+    if (RomArchive_GetInfo(path, name, sizeof(name), &size) == 0)
+        return RUNNING_NONE;
+
+    if (strlen(name) < 3)
+        return RUNNING_NONE;
+
+    return _win_main_get_rom_type_from_name(name);
+}
+
 static void *bios_buffer = NULL;
-static void *rom_buffer = NULL;
-static size_t rom_size;
 
 static void _win_main_unload_rom(int save_data)
 {
     _win_main_clear_message();
 
+    Autosave_Cancel();
+    Capture_VideoStop();
+    Movie_ROMUnloaded();
+    Netplay_ROMUnloaded();
+    DisasmDB_ROMUnloaded();
+
     if (WIN_MAIN_RUNNING == RUNNING_GBA)
     {
         GBA_EndRom(save_data);
         GBA_DebugClearBreakpointAll();
+        GBA_DebugClearWatchpointAll();
     }
     else if (WIN_MAIN_RUNNING == RUNNING_GB)
     {
         GB_End(save_data);
         GB_DebugClearBreakpointAll();
+        GB_DebugClearWatchpointAll();
     }
     else
     {
@@ -365,11 +428,11 @@ static void _win_main_unload_rom(int save_data)
 
     if (bios_buffer)
         free(bios_buffer);
-    if (rom_buffer)
-        free(rom_buffer);
 
     bios_buffer = NULL;
-    rom_buffer = NULL;
+
+    // Drop the last frame drawn by the emulation thread, if any
+    EmuThread_GetFrame();
 
     // Clear screen buffer
     memset(WIN_MAIN_GAME_SCREEN_BUFFER, 0, sizeof(WIN_MAIN_GAME_SCREEN_BUFFER));
@@ -436,6 +499,11 @@ static int _win_main_load_rom_autodetect(char *path)
                 _win_main_set_game_screen(SCREEN_GB);
 
             WIN_MAIN_RUNNING = RUNNING_GB;
+            SDL_AtomicSet(&gb_rtc_seconds, 0);
+
+            Movie_ROMLoaded(path, MOVIE_SYSTEM_GB);
+            Netplay_ROMLoaded(NETPLAY_SYSTEM_GB);
+            DisasmDB_ROMLoaded(DISASM_DB_SYSTEM_GB);
 
             _win_main_switch_to_game_delayed();
 
@@ -460,12 +528,34 @@ static int _win_main_load_rom_autodetect(char *path)
         else
             GBA_BiosLoaded(1);
 
-        FileLoad(path, &rom_buffer, &rom_size);
-        GBA_SaveSetFilename(path);
-        GBA_InitRom(bios_buffer, rom_buffer, rom_size);
+        // The ROM is decompressed or read straight into the buffer used by
+        // the core, which takes ownership of it.
+        void *rom_buffer = calloc(1, GBA_ROM_BUFFER_SIZE);
+        size_t rom_size;
+        if ((rom_buffer == NULL) ||
+            (RomArchive_Read(path, rom_buffer, GBA_ROM_BUFFER_SIZE,
+                             &rom_size) == 0))
+        {
+            Debug_ErrorMsgArg("Couldn't load data from %s.", path);
+            free(rom_buffer);
+            free(bios_buffer);
+            bios_buffer = NULL;
+            return 0;
+        }
+
+        static char base_path[MAX_PATHLEN];
+        RomArchive_GetBasePath(path, base_path, sizeof(base_path));
+
+        GBA_SaveSetFilename(base_path);
+        GBA_InitRomBuffer(bios_buffer, rom_buffer, rom_size);
+        GBA_ProfilerLoadSymbolsForROM(base_path);
 
         WIN_MAIN_RUNNING = RUNNING_GBA;
 
+        Movie_ROMLoaded(path, MOVIE_SYSTEM_GBA);
+        Netplay_ROMLoaded(NETPLAY_SYSTEM_GBA);
+        DisasmDB_ROMLoaded(DISASM_DB_SYSTEM_GBA);
+
         _win_main_set_game_screen(SCREEN_GBA);
 
         _win_main_switch_to_game_delayed();
@@ -577,15 +667,29 @@ static int _win_main_file_explorer_get_starting_drawing_index(void)
     return start_print_index;
 }
 
-static void _win_main_file_explorer_refresh(void)
+static const char *_win_main_file_explorer_system_name(int system)
+{
+    switch (system)
+    {
+        case ROM_LIBRARY_SYSTEM_GB:
+            return "GB";
+        case ROM_LIBRARY_SYSTEM_GBC:
+            return "GBC";
+        case ROM_LIBRARY_SYSTEM_GBA:
+            return "GBA";
+        default:
+            return "?";
+    }
+}
+
+// Redraws the list without reading the folder again
+static void _win_main_file_explorer_draw(void)
 {
     if (GUI_WindowGetEnabled(&mainwindow_fileexplorer_win) == 0)
         return;
 
     GUI_ConsoleClear(&win_main_fileexpoler_con);
 
-    FileExplorer_LoadFolder();
-
     int numfiles = FileExplorer_GetNumFiles();
 
     int start_print_index = _win_main_file_explorer_get_starting_drawing_index();
@@ -602,15 +706,90 @@ static void _win_main_file_explorer_refresh(void)
                                         0xFFFFFF00);
             }
 
-            GUI_ConsoleModePrintf(&win_main_fileexpoler_con, 0, i, "%s %s",
-                    FileExplorer_GetIsDir(selected_file) ?  "<DIR>" : "     ",
-                    FileExplorer_GetName(selected_file));
+            rom_library_info info;
+
+            if (FileExplorer_GetIsDir(selected_file))
+            {
+                GUI_ConsoleModePrintf(&win_main_fileexpoler_con, 0, i,
+                        "<DIR> %s", FileExplorer_GetName(selected_file));
+            }
+            else if (FileExplorer_GetInfo(selected_file, &info))
+            {
+                GUI_ConsoleModePrintf(&win_main_fileexpoler_con, 0, i,
+                        "%-5s %-41.41s %.16s",
+                        _win_main_file_explorer_system_name(info.system),
+                        FileExplorer_GetName(selected_file), info.title);
+            }
+            else
+            {
+                GUI_ConsoleModePrintf(&win_main_fileexpoler_con, 0, i,
+                        "      %s", FileExplorer_GetName(selected_file));
+            }
         }
     }
 
+    static const char *sort_names[] = { "name", "title", "system", "size" };
+    static const char *filter_names[] = { "all", "GB", "GBA" };
+
     GUI_ConsoleClear(&win_main_fileexpoler_path_con);
     GUI_ConsoleModePrintf(&win_main_fileexpoler_path_con, 0, 0,
                           FileExplorer_GetCurrentPath());
+    GUI_ConsoleModePrintf(&win_main_fileexpoler_path_con, 0, 1,
+                          "F2: Sort by %s - F3: Show %s",
+                          sort_names[FileExplorer_GetSortMode()],
+                          filter_names[FileExplorer_GetFilter()]);
+}
+
+// Reads the folder again and redraws the list
+static void _win_main_file_explorer_refresh(void)
+{
+    if (GUI_WindowGetEnabled(&mainwindow_fileexplorer_win) == 0)
+        return;
+
+    FileExplorer_LoadFolder();
+    _win_main_file_explorer_draw();
+}
+
+static void _win_main_file_explorer_sort_next(void)
+{
+    FileExplorer_SetSortMode((FileExplorer_GetSortMode() + 1)
+                             % FILE_EXPLORER_SORT_NUM);
+    _win_main_file_explorer_windows_selection = 0;
+    _win_main_file_explorer_draw();
+}
+
+static void _win_main_file_explorer_filter_next(void)
+{
+    FileExplorer_SetFilter((FileExplorer_GetFilter() + 1)
+                           % FILE_EXPLORER_FILTER_NUM);
+    _win_main_file_explorer_windows_selection = 0;
+    _win_main_file_explorer_draw();
+}
+
+// Called every frame. The list is sorted and drawn again if the ROM library has
+// found more information about the files.
+static void _win_main_file_explorer_handle_library(void)
+{
+    static int last_generation = -1;
+    static Uint32 last_ticks = 0;
+
+    if (GUI_WindowGetEnabled(&mainwindow_fileexplorer_win) == 0)
+        return;
+
+    // Sorting thousands of files every frame would be too slow
+    Uint32 ticks = SDL_GetTicks();
+    if ((ticks - last_ticks) < 250)
+        return;
+    last_ticks = ticks;
+
+    int generation = RomLibrary_GetGeneration();
+    if (generation == last_generation)
+        return;
+    last_generation = generation;
+
+    FileExplorer_UpdateOrder();
+    _win_main_file_explorer_draw();
+    WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
 }
 
 static void _win_main_file_explorer_close(void)
@@ -623,7 +802,7 @@ static void _win_main_file_explorer_up(void)
 {
     FileExplorer_SelectEntry("..");
     _win_main_file_explorer_windows_selection = 0;
-    _win_main_file_explorer_refresh();
+    _win_main_file_explorer_draw();
 }
 
 static void _win_main_file_explorer_open_index(int i)
@@ -637,7 +816,8 @@ static void _win_main_file_explorer_open_index(int i)
     //                         "GiiBiiAdvance - Debug",
     //                         FileExplorer_GetName(i), NULL);
 
-    _win_main_file_explorer_refresh();
+    // The folder has already been read if it was a directory
+    _win_main_file_explorer_draw();
 
     if (is_dir == 0)
     {
@@ -708,6 +888,14 @@ static void _win_main_screenshot(void)
         GB_Screenshot();
 }
 
+static void _win_main_record_video(void)
+{
+    if (Capture_VideoIsRecording())
+        Capture_VideoStop();
+    else if (WIN_MAIN_RUNNING != RUNNING_NONE)
+        Capture_VideoStart();
+}
+
 static void _win_main_menu_exit(void)
 {
     Win_MainCloseAllSubwindows();
@@ -732,6 +920,9 @@ static void _win_main_reset(void)
         if (WIN_MAIN_MENU_ENABLED)
             _win_main_switch_to_game();
 
+        // Movies start when the ROM is loaded, they can't survive a reset
+        Movie_End();
+
         if (WIN_MAIN_RUNNING == RUNNING_GBA)
             GBA_Reset();
         else if (WIN_MAIN_RUNNING == RUNNING_GB)
@@ -851,6 +1042,9 @@ static _gui_menu_entry mmfile_rominfo = {
 static _gui_menu_entry mmfile_screenshot = {
     "Screenshot (F12)", _win_main_screenshot, 1
 };
+static _gui_menu_entry mmfile_record_video = {
+    "Record Video (F10)", _win_main_record_video, 1
+};
 static _gui_menu_entry mmfile_exit = {
     "Exit (CTRL+E)", _win_main_menu_exit, 1
 };
@@ -858,7 +1052,8 @@ static _gui_menu_entry mmfile_exit = {
 static _gui_menu_entry *mmfile_elements[] = {
     &mmfile_open, &mmfile_close, &mmfile_closenosav, &mm_separator,
     &mmfile_reset, &mmfile_pause, &mm_separator, &mmfile_rominfo,
-    &mmfile_screenshot, &mm_separator, &mmfile_exit, NULL
+    &mmfile_screenshot, &mmfile_record_video, &mm_separator, &mmfile_exit,
+    NULL
 };
 
 static _gui_menu_list main_menu_file = {
@@ -1045,9 +1240,28 @@ static _gui mainwindow_window_gui = {
 
 //------------------------------------------------------------------
 
+static int win_main_deferred_message_type;
+static char win_main_deferred_message[2000];
+
+static void _win_main_show_deferred_message(void)
+{
+    Win_MainShowMessage(win_main_deferred_message_type,
+                        win_main_deferred_message);
+}
+
 // Type: 0 = error, 1 = debug, 2 = console, 3 = sys info
 void Win_MainShowMessage(int type, const char *text)
 {
+    // The GUI can only be modified from the main thread
+    if (EmuThread_IsCurrent())
+    {
+        win_main_deferred_message_type = type;
+        s_strncpy(win_main_deferred_message, text,
+                  sizeof(win_main_deferred_message));
+        EmuThread_Defer(_win_main_show_deferred_message);
+        return;
+    }
+
     _win_main_switch_to_menu();
 
     if (type == 0)
@@ -1193,6 +1407,12 @@ static int Win_MainEventCallback(SDL_Event *e)
             case SDLK_F7:
                 _win_main_menu_open_io_viewer();
                 break;
+            case SDLK_F11:
+                Timing_OverlaySet(!Timing_OverlayGet());
+                break;
+            case SDLK_F10:
+                _win_main_record_video();
+                break;
             case SDLK_F12:
                 _win_main_screenshot();
                 break;
@@ -1204,7 +1424,7 @@ static int Win_MainEventCallback(SDL_Event *e)
                     {
                         _win_main_file_explorer_windows_selection--;
                     }
-                    _win_main_file_explorer_refresh();
+                    _win_main_file_explorer_draw();
                     WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
                 }
                 break;
@@ -1216,7 +1436,7 @@ static int Win_MainEventCallback(SDL_Event *e)
                     {
                         _win_main_file_explorer_windows_selection++;
                     }
-                    _win_main_file_explorer_refresh();
+                    _win_main_file_explorer_draw();
                     WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
                 }
                 break;
@@ -1235,6 +1455,20 @@ static int Win_MainEventCallback(SDL_Event *e)
                     WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
                 }
                 break;
+            case SDLK_F2:
+                if (GUI_WindowGetEnabled(&mainwindow_fileexplorer_win))
+                {
+                    _win_main_file_explorer_sort_next();
+                    WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
+                }
+                break;
+            case SDLK_F3:
+                if (GUI_WindowGetEnabled(&mainwindow_fileexplorer_win))
+                {
+                    _win_main_file_explorer_filter_next();
+                    WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
+                }
+                break;
             case SDLK_p:
                 if (SDL_GetModState() & KMOD_CTRL)
                     _win_main_menu_toggle_pause();
@@ -1294,7 +1528,7 @@ static int Win_MainEventCallback(SDL_Event *e)
         }
 
         WIN_MAIN_MENU_HAS_TO_UPDATE = 1;
-        _win_main_file_explorer_refresh();
+        _win_main_file_explorer_draw();
     }
     else if (e->type == SDL_MOUSEBUTTONDOWN)
     {
@@ -1359,6 +1593,8 @@ static int Win_MainEventCallback(SDL_Event *e)
     return 0;
 }
 
+static int _win_main_run_frame(unsigned char *buffer); // Below in this file
+
 int Win_MainCreate(char *rom_path)
 {
     _win_main_file_explorer_create();
@@ -1393,6 +1629,11 @@ int Win_MainCreate(char *rom_path)
     FPS_TimerInit();
     atexit(FPS_TimerEnd);
 
+    atexit(RunAhead_End);
+
+    if (EmuThread_Init(_win_main_run_frame))
+        atexit(EmuThread_End);
+
     WIN_MAIN_RUNNING = RUNNING_NONE;
 
     // If the emulator was started with a game as argument...
@@ -1419,11 +1660,21 @@ void Win_MainRender(void)
     {
         if (WIN_MAIN_RUNNING != RUNNING_NONE)
         {
+            // Timing scopes can only be used from the thread that emulates
+            // the frames.
+            int timed = !EmuThread_IsRunning();
+
+            if (timed)
+                TIMING_BEGIN(TIMING_RENDER);
             WH_Render(WinIDMain, WIN_MAIN_GAME_SCREEN_BUFFER);
+            if (timed)
+                TIMING_END(TIMING_RENDER);
         }
     }
     else
     {
+        _win_main_file_explorer_handle_library();
+
         if (WIN_MAIN_MENU_HAS_TO_UPDATE)
         {
             WIN_MAIN_MENU_HAS_TO_UPDATE = 0;
@@ -1448,133 +1699,280 @@ int Win_MainRunningGB(void)
 
 static int16_t samples[32 * 1024];
 
-void Win_MainLoopHandle(void)
+// Sends the frame that has just been emulated to the video capture, if any
+static void _win_main_capture_video_frame(void)
 {
-    int speedup = Input_Speedup_Enabled();
+    unsigned char *frame = Capture_VideoFrameBegin();
+    if (frame == NULL)
+        return;
+
+    if (WIN_MAIN_RUNNING == RUNNING_GBA)
+    {
+        GBA_ConvertScreenBufferTo24RGB(frame);
+        Capture_VideoFrameEnd(frame, 240, 160);
+    }
+    else
+    {
+        int width, height;
+        GB_ConvertScreenBufferTo24RGB(frame, &width, &height);
+        Capture_VideoFrameEnd(frame, width, height);
+    }
+}
+
+// Emulates one frame of the loaded game. It's called from the main thread or
+// from the emulation thread with the emulation lock held. The screen is drawn
+// to the buffer unless the frame is skipped.
+static int _win_main_run_frame(unsigned char *buffer)
+{
+    int speedup = Input_SnapshotSpeedup();
 
     if (speedup)
         Win_MainSetFrameskip(10);
     else
         Win_MainSetFrameskip(EmulatorConfig.frameskip);
 
-    if (WH_HasKeyboardFocus(WinIDMain) && (WIN_MAIN_MENU_ENABLED == 0))
+    int flags = 0;
+
+    if (WIN_MAIN_RUNNING == RUNNING_GBA)
     {
-        //if (GUI_WindowGetEnabled(&mainwindow_configwin)
-        //    || GUI_WindowGetEnabled(&mainwindow_fileexplorer_win)
-        //    || GUI_ScrollableTextWindowGetEnabled(
-        //                                  &mainwindow_scrollable_text_window)
-        //    || GUI_MessageBoxGetEnabled(&mainwindow_show_message_win))
+        Win_GBADisassemblerStartAddressSetDefault();
+
+        if (speedup)
+            GBA_SoundResetBufferPointers();
+
+        int netplay = Netplay_IsEnabled();
+        if (netplay && !Netplay_FrameReady())
+            return 0; // Waiting for the other side
 
-        if (GUI_MessageBoxGetEnabled(&mainwindow_show_message_win))
+        Script_HookFrame();
+
+        if (!Script_ControlsInput())
+            Input_ApplySnapshot_GBA();
+
+        Movie_HandleFrameGBA();
+
+        if (netplay)
         {
-            _win_main_switch_to_menu();
-            Sound_Disable();
-            return;
+            Netplay_FrameGBA(_win_main_has_to_frameskip());
+        }
+        else
+        {
+            RunAhead_FrameGBA(_win_main_has_to_frameskip());
         }
 
-        Sound_Enable();
+        GBA_SoundSaveToWAV();
 
-        if (WIN_MAIN_RUNNING == RUNNING_GBA)
+        Autosave_HandleGBA();
+
+        _win_main_capture_video_frame();
+
+        if (_win_main_has_to_frameskip() == 0)
         {
-            if (GBA_ShowConsoleRequested())
-            {
-                ConsoleShow();
-                return;
-            }
+            TIMING_BEGIN(TIMING_CONVERT);
+            GBA_ConvertScreenBufferTo24RGB(buffer);
+            TIMING_END(TIMING_CONVERT);
 
-            Win_GBADisassemblerStartAddressSetDefault();
+            flags |= EMU_THREAD_FRAME_DRAWN;
+        }
+    }
+    else if (WIN_MAIN_RUNNING == RUNNING_GB)
+    {
+        if (speedup)
+            GB_SoundResetBufferPointers();
 
-            if (speedup)
-                GBA_SoundResetBufferPointers();
+        int netplay = Netplay_IsEnabled();
+        if (netplay && !Netplay_FrameReady())
+            return 0; // Waiting for the other side
 
-            GBA_SkipFrame(_win_main_has_to_frameskip());
+        // The RTC would make both sides of a netplay session desync
+        for (int i = SDL_AtomicSet(&gb_rtc_seconds, 0); i > 0; i--)
+        {
+            if (!netplay)
+                GB_HandleRTC();
+        }
 
-            if (!Script_IsRunning())
-            {
-                Input_Update_GBA();
-                GBA_RunForOneFrame();
-            }
+        if (GB_RumbleEnabled())
+            Input_RumbleRequest();
 
-            if (_win_main_has_to_frameskip() == 0)
-                GBA_ConvertScreenBufferTo24RGB(WIN_MAIN_GAME_SCREEN_BUFFER);
+        Script_HookFrame();
 
-            _win_main_update_frameskip();
+        if (!Script_ControlsInput())
+            Input_ApplySnapshot_GB();
 
-            frames_drawn++;
+        Movie_HandleFrameGB();
 
-            fps_update_caption();
+        if (netplay)
+        {
+            Netplay_FrameGB(_win_main_has_to_frameskip());
+        }
+        else
+        {
+            RunAhead_FrameGB(_win_main_has_to_frameskip());
+        }
 
-            // Get audio output
-            if (!speedup && !Script_IsRunning())
-            {
-                size_t size = GBA_SoundGetSamplesFrame(samples, sizeof(samples));
+        GB_SoundSaveToWAV();
+        GB_CameraWebcamDelayDecrease();
 
-                if (Sound_IsBufferTooBig())
-                {
-                    Sound_ClearBuffer();
-                }
-                else if (Sound_IsBufferOverThreshold())
-                {
-                    if (size > 8) // This should always be true
-                        size -= 8;
-                }
+        Autosave_HandleGB();
 
-                Sound_SendSamples(samples, size);
-            }
+        _win_main_capture_video_frame();
+
+        if (_win_main_has_to_frameskip() == 0)
+        {
+            TIMING_BEGIN(TIMING_CONVERT);
+            GB_Screen_WriteBuffer_24RGB(buffer);
+            TIMING_END(TIMING_CONVERT);
+
+            flags |= EMU_THREAD_FRAME_DRAWN;
         }
-        else if (WIN_MAIN_RUNNING == RUNNING_GB)
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (flags & EMU_THREAD_FRAME_DRAWN)
+    {
+        Timing_OverlayDraw(buffer,
+                           _win_main_get_game_screen_texture_width(),
+                           _win_main_get_game_screen_texture_height());
+    }
+
+    _win_main_update_frameskip();
+
+    SDL_AtomicIncRef(&frames_drawn);
+
+    Timing_FrameEnd();
+
+    // Send audio output
+    if (speedup)
+    {
+        flags |= EMU_THREAD_NO_WAIT;
+    }
+    else
+    {
+        size_t size;
+
+        if (WIN_MAIN_RUNNING == RUNNING_GBA)
+            size = GBA_SoundGetSamplesFrame(samples, sizeof(samples));
+        else
+            size = GB_SoundGetSamplesFrame(samples, sizeof(samples));
+
+        if (Sound_IsBufferTooBig())
         {
-            if (GB_ShowConsoleRequested())
-            {
-                ConsoleShow();
-                return;
-            }
+            Sound_ClearBuffer();
+        }
+        else if (Sound_IsBufferOverThreshold())
+        {
+            if (size > 8) // This should always be true
+                size -= 8;
+        }
 
-            if (speedup)
-                GB_SoundResetBufferPointers();
+        Sound_SendSamples(samples, size);
+    }
 
-            GB_SkipFrame(_win_main_has_to_frameskip());
+    return flags;
+}
 
-            if (GB_RumbleEnabled())
-                Input_RumbleEnable();
+// Returns 1 if the game can be emulated right now
+static int _win_main_can_run_frame(void)
+{
+    // An instance linked to another one keeps running without focus, or the
+    // other instance would stall waiting for it.
+    int linked = LinkCable_IsConnected() || Netplay_IsEnabled();
 
-            if (!Script_IsRunning())
-            {
-                Input_Update_GB();
-                GB_RunForOneFrame();
-                GB_CameraWebcamDelayDecrease();
-            }
+    if ((!WH_HasKeyboardFocus(WinIDMain) && !linked)
+        || (WIN_MAIN_MENU_ENABLED != 0))
+    {
+        Sound_Disable();
+        return 0;
+    }
 
-            if (_win_main_has_to_frameskip() == 0)
-                GB_Screen_WriteBuffer_24RGB(WIN_MAIN_GAME_SCREEN_BUFFER);
+    //if (GUI_WindowGetEnabled(&mainwindow_configwin)
+    //    || GUI_WindowGetEnabled(&mainwindow_fileexplorer_win)
+    //    || GUI_ScrollableTextWindowGetEnabled(
+    //                                  &mainwindow_scrollable_text_window)
+    //    || GUI_MessageBoxGetEnabled(&mainwindow_show_message_win))
 
-            _win_main_update_frameskip();
+    if (GUI_MessageBoxGetEnabled(&mainwindow_show_message_win))
+    {
+        _win_main_switch_to_menu();
+        Sound_Disable();
+        return 0;
+    }
 
-            frames_drawn++;
+    Sound_Enable();
 
-            fps_update_caption();
+    if (WIN_MAIN_RUNNING == RUNNING_GBA)
+    {
+        if (GBA_ShowConsoleRequested())
+        {
+            ConsoleShow();
+            return 0;
+        }
+    }
+    else if (WIN_MAIN_RUNNING == RUNNING_GB)
+    {
+        if (GB_ShowConsoleRequested())
+        {
+            ConsoleShow();
+            return 0;
+        }
+    }
+    else
+    {
+        return 0;
+    }
 
-            // Get audio output
-            if (!speedup && !Script_IsRunning())
-            {
-                size_t size = GB_SoundGetSamplesFrame(samples, sizeof(samples));
+    return 1;
+}
 
-                if (Sound_IsBufferTooBig())
-                {
-                    Sound_ClearBuffer();
-                }
-                else if (Sound_IsBufferOverThreshold())
-                {
-                    if (size > 8) // This should always be true
-                        size -= 8;
-                }
+// Lua scripts interact with the GUI from the frame hooks, so they always run
+// in the main thread.
+static int _win_main_use_emulation_thread(void)
+{
+    return EmulatorConfig.emulation_thread && EmuThread_IsStarted()
+           && !Script_IsLoaded();
+}
 
-                Sound_SendSamples(samples, size);
-            }
+void Win_MainLoopHandle(void)
+{
+    Input_Snapshot();
+
+    if (_win_main_use_emulation_thread())
+    {
+        // Run anything the thread needs from the main thread
+        EmuThread_HandleDeferred();
+
+        EmuThread_Lock();
+
+        int run = _win_main_can_run_frame();
+        EmuThread_SetRunning(run);
+
+        if (run)
+            fps_update_caption();
+
+        EmuThread_Unlock();
+
+        const unsigned char *frame = EmuThread_GetFrame();
+        if (run && (frame != NULL))
+        {
+            memcpy(WIN_MAIN_GAME_SCREEN_BUFFER, frame,
+                   sizeof(WIN_MAIN_GAME_SCREEN_BUFFER));
         }
     }
     else
     {
-        Sound_Disable();
+        EmuThread_Lock();
+        EmuThread_SetRunning(0);
+        EmuThread_Unlock();
+
+        if (_win_main_can_run_frame())
+        {
+            _win_main_run_frame(WIN_MAIN_GAME_SCREEN_BUFFER);
+            fps_update_caption();
+        }
     }
+
+    Input_RumbleHandleRequest();
 }
@@ -507,9 +507,6 @@ void Win_MainCreateConfigWindow(void)
                        "Game Boy", 4, SERIAL_GAMEBOY,
                        EmulatorConfig.serial_device == SERIAL_GAMEBOY,
                        _win_main_config_serial_device_radbtn_callback);
-    // Game Boy serial to another Game Boy not implemented, disable it.
-    GUI_RadioButtonSetEnabled(
-            &mainwindow_configwin_gameboy_serial_device_gameboy_radbtn, 0);
 
     GUI_SetCheckBox(&mainwindow_configwin_gameboy_enableblur_checkbox,
                     12, 302, -1, 12, "Enable blur", EmulatorConfig.enableblur,
@@ -259,7 +259,52 @@ void Input_GetJoystickElementName(char *name, int namelen, int btncode)
 
 //------------------------------------------------------------------------------
 
-void Input_Update_GB(void)
+// The state of the controls is read by the main thread and packed in atomic
+// variables, one bit per key (in _key_config_enum_ order). The emulation thread
+// passes it to the emulated system when it starts a frame.
+static SDL_atomic_t input_snapshot_player[4];
+static SDL_atomic_t input_snapshot_mbc7; // Up, down, right, left
+static SDL_atomic_t input_snapshot_speedup;
+static SDL_atomic_t input_rumble_requested;
+
+void Input_Snapshot(void)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        int keys = 0;
+
+        for (int k = 0; k < P_NUM_KEYS; k++)
+        {
+            if (Input_IsGameBoyKeyPressed(i, k))
+                keys |= 1 << k;
+        }
+
+        SDL_AtomicSet(&input_snapshot_player[i], keys);
+    }
+
+    const Uint8 *state = SDL_GetKeyboardState(NULL);
+
+    int mbc7 = 0;
+    if (state[SDL_SCANCODE_KP_8])
+        mbc7 |= 1 << 0;
+    if (state[SDL_SCANCODE_KP_2])
+        mbc7 |= 1 << 1;
+    if (state[SDL_SCANCODE_KP_6])
+        mbc7 |= 1 << 2;
+    if (state[SDL_SCANCODE_KP_4])
+        mbc7 |= 1 << 3;
+
+    SDL_AtomicSet(&input_snapshot_mbc7, mbc7);
+
+    SDL_AtomicSet(&input_snapshot_speedup, Input_Speedup_Enabled());
+}
+
+static int _input_snapshot_key(int keys, _key_config_enum_ keyindex)
+{
+    return (keys >> keyindex) & 1;
+}
+
+void Input_ApplySnapshot_GB(void)
 {
     int players = 1;
 
@@ -267,47 +312,77 @@ void Input_Update_GB(void)
         players = 4;
 
     for (int i = 0; i < players; i++)
-    {
-        int a = Input_IsGameBoyKeyPressed(i, P_KEY_A);
-        int b = Input_IsGameBoyKeyPressed(i, P_KEY_B);
-        int st = Input_IsGameBoyKeyPressed(i, P_KEY_START);
-        int se = Input_IsGameBoyKeyPressed(i, P_KEY_SELECT);
-        int dr = Input_IsGameBoyKeyPressed(i, P_KEY_RIGHT);
-        int dl = Input_IsGameBoyKeyPressed(i, P_KEY_LEFT);
-        int du = Input_IsGameBoyKeyPressed(i, P_KEY_UP);
-        int dd = Input_IsGameBoyKeyPressed(i, P_KEY_DOWN);
-
-        GB_InputSet(i, a, b, st, se, dr, dl, du, dd);
-    }
+        Input_ApplyKeys_GB(i, SDL_AtomicGet(&input_snapshot_player[i]));
 
-    const Uint8 *state = SDL_GetKeyboardState(NULL);
+    int mbc7 = SDL_AtomicGet(&input_snapshot_mbc7);
 
-    int accr = state[SDL_SCANCODE_KP_6];
-    int accl = state[SDL_SCANCODE_KP_4];
-    int accu = state[SDL_SCANCODE_KP_8];
-    int accd = state[SDL_SCANCODE_KP_2];
+    int accu = (mbc7 >> 0) & 1;
+    int accd = (mbc7 >> 1) & 1;
+    int accr = (mbc7 >> 2) & 1;
+    int accl = (mbc7 >> 3) & 1;
 
     GB_InputSetMBC7Buttons(accu, accd, accr, accl);
     //void GB_InputSetMBC7Joystick(int x, int y); // -200 to 200
     //void GB_InputSetMBC7Buttons(int up, int down, int right, int left);
 }
 
-void Input_Update_GBA(void)
+void Input_ApplySnapshot_GBA(void)
 {
-    int a = Input_IsGameBoyKeyPressed(0, P_KEY_A);
-    int b = Input_IsGameBoyKeyPressed(0, P_KEY_B);
-    int l = Input_IsGameBoyKeyPressed(0, P_KEY_L);
-    int r = Input_IsGameBoyKeyPressed(0, P_KEY_R);
-    int st = Input_IsGameBoyKeyPressed(0, P_KEY_START);
-    int se = Input_IsGameBoyKeyPressed(0, P_KEY_SELECT);
-    int dr = Input_IsGameBoyKeyPressed(0, P_KEY_RIGHT);
-    int dl = Input_IsGameBoyKeyPressed(0, P_KEY_LEFT);
-    int du = Input_IsGameBoyKeyPressed(0, P_KEY_UP);
-    int dd = Input_IsGameBoyKeyPressed(0, P_KEY_DOWN);
+    Input_ApplyKeys_GBA(SDL_AtomicGet(&input_snapshot_player[0]));
+}
+
+int Input_SnapshotGetKeys(int player)
+{
+    return SDL_AtomicGet(&input_snapshot_player[player]);
+}
+
+void Input_ApplyKeys_GB(int player, int keys)
+{
+    int a = _input_snapshot_key(keys, P_KEY_A);
+    int b = _input_snapshot_key(keys, P_KEY_B);
+    int st = _input_snapshot_key(keys, P_KEY_START);
+    int se = _input_snapshot_key(keys, P_KEY_SELECT);
+    int dr = _input_snapshot_key(keys, P_KEY_RIGHT);
+    int dl = _input_snapshot_key(keys, P_KEY_LEFT);
+    int du = _input_snapshot_key(keys, P_KEY_UP);
+    int dd = _input_snapshot_key(keys, P_KEY_DOWN);
+
+    GB_InputSet(player, a, b, st, se, dr, dl, du, dd);
+}
+
+void Input_ApplyKeys_GBA(int keys)
+{
+    int a = _input_snapshot_key(keys, P_KEY_A);
+    int b = _input_snapshot_key(keys, P_KEY_B);
+    int l = _input_snapshot_key(keys, P_KEY_L);
+    int r = _input_snapshot_key(keys, P_KEY_R);
+    int st = _input_snapshot_key(keys, P_KEY_START);
+    int se = _input_snapshot_key(keys, P_KEY_SELECT);
+    int dr = _input_snapshot_key(keys, P_KEY_RIGHT);
+    int dl = _input_snapshot_key(keys, P_KEY_LEFT);
+    int du = _input_snapshot_key(keys, P_KEY_UP);
+    int dd = _input_snapshot_key(keys, P_KEY_DOWN);
 
     GBA_HandleInput(a, b, l, r, st, se, dr, dl, du, dd);
 }
 
+int Input_SnapshotSpeedup(void)
+{
+    return SDL_AtomicGet(&input_snapshot_speedup);
+}
+
+void Input_Update_GB(void)
+{
+    Input_Snapshot();
+    Input_ApplySnapshot_GB();
+}
+
+void Input_Update_GBA(void)
+{
+    Input_Snapshot();
+    Input_ApplySnapshot_GBA();
+}
+
 int Input_Speedup_Enabled(void)
 {
     const Uint8 *state = SDL_GetKeyboardState(NULL);
@@ -446,6 +521,17 @@ void Input_RumbleEnable(void)
         SDL_HapticRumblePlay(Joystick[controller].haptic, 1.0, 16);
 }
 
+void Input_RumbleRequest(void)
+{
+    SDL_AtomicSet(&input_rumble_requested, 1);
+}
+
+void Input_RumbleHandleRequest(void)
+{
+    if (SDL_AtomicSet(&input_rumble_requested, 0))
+        Input_RumbleEnable();
+}
+
 int Input_JoystickHasRumble(int index)
 {
     return Joystick[index].haptic != NULL;
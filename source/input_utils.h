@@ -48,9 +48,25 @@ int Input_PlayerGetEnabled(int player);
 
 //------------------------------------------------------------------------------
 
+// Read the controls and pass them to the emulated system
 void Input_Update_GB(void);
 void Input_Update_GBA(void);
 
+// Same as above, split for the emulation thread. The main thread reads the
+// controls with Input_Snapshot() and the emulation thread passes the last state
+// read to the emulated system with Input_ApplySnapshot_*().
+void Input_Snapshot(void);
+void Input_ApplySnapshot_GB(void);
+void Input_ApplySnapshot_GBA(void);
+int Input_SnapshotSpeedup(void);
+
+// Keys of a player in the last snapshot. Bit N is set if the key with index N
+// in _key_config_enum_ is pressed.
+int Input_SnapshotGetKeys(int player);
+// Pass keys in the same format to the emulated system
+void Input_ApplyKeys_GB(int player, int keys);
+void Input_ApplyKeys_GBA(int keys);
+
 int Input_Speedup_Enabled(void);
 
 //-----------------------------------------------------------------------------
@@ -73,6 +89,10 @@ int Input_GetJoystickFromName(char *name);
 void Input_InitSystem(void);
 
 void Input_RumbleEnable(void);
+// The emulation thread can't use the haptic device, it asks the main thread to
+// enable the rumble with Input_RumbleRequest().
+void Input_RumbleRequest(void);
+void Input_RumbleHandleRequest(void);
 // Returns -1 if error opening haptic, 0 if there isn't haptic, if not, correct.
 int Input_JoystickHasRumble(int index);
 
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <SDL2/SDL.h>
+
+#include "debug_utils.h"
+#include "link_cable.h"
+#include "net_utils.h"
+
+// Time to wait for the other side to answer before giving up
+#define LINK_CABLE_TIMEOUT_MS 500
+
+// Messages are a type byte followed by a 32 bit value in little endian
+#define LINK_MSG_DATA   'D' // Sent by the master
+#define LINK_MSG_REPLY  'R' // Answer of the slave
+#define LINK_MSG_SIZE   5
+
+static SDL_Thread *link_thread = NULL;
+static SDL_mutex *link_mutex = NULL;
+static SDL_mutex *link_send_mutex = NULL;
+static SDL_cond *link_cond = NULL;
+
+static SDL_atomic_t link_quit;
+static SDL_atomic_t link_connected;
+static SDL_atomic_t link_is_host;
+
+static net_socket link_socket = NET_INVALID_SOCKET;
+
+// Protected by link_mutex
+static int link_reply_pending = 0;
+static uint32_t link_reply_value;
+static int link_slave_ready = 0;
+static uint32_t link_slave_value;
+static uint32_t link_slave_received;
+
+// Set by the thread when the slave receives data, checked by the emulator
+static SDL_atomic_t link_slave_has_received;
+
+// Only used from the emulation thread
+static uint32_t link_stats_transfers;
+static uint64_t link_stats_wait_us;
+
+static int link_send(uint8_t type, uint32_t value)
+{
+    uint8_t msg[LINK_MSG_SIZE] = {
+        type, value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF,
+        (value >> 24) & 0xFF
+    };
+
+    SDL_LockMutex(link_send_mutex);
+    int ret = 0;
+    if (link_socket != NET_INVALID_SOCKET)
+        ret = Net_SendAll(link_socket, msg, sizeof(msg));
+    SDL_UnlockMutex(link_send_mutex);
+
+    return ret;
+}
+
+static void link_disconnect(void)
+{
+    SDL_LockMutex(link_send_mutex);
+    Net_Close(link_socket);
+    link_socket = NET_INVALID_SOCKET;
+    SDL_UnlockMutex(link_send_mutex);
+
+    SDL_AtomicSet(&link_connected, 0);
+
+    // Wake up the master if it's waiting for an answer
+    SDL_LockMutex(link_mutex);
+    SDL_CondBroadcast(link_cond);
+    SDL_UnlockMutex(link_mutex);
+}
+
+static void link_handle_message(const uint8_t *msg)
+{
+    uint32_t value = msg[1] | (msg[2] << 8) | (msg[3] << 16)
+                     | ((uint32_t)msg[4] << 24);
+
+    if (msg[0] == LINK_MSG_DATA)
+    {
+        uint32_t reply = LINK_CABLE_NO_DATA;
+
+        SDL_LockMutex(link_mutex);
+        if (link_slave_ready)
+        {
+            reply = link_slave_value;
+            link_slave_ready = 0;
+            link_slave_received = value;
+            SDL_AtomicSet(&link_slave_has_received, 1);
+        }
+        SDL_UnlockMutex(link_mutex);
+
+        link_send(LINK_MSG_REPLY, reply);
+    }
+    else if (msg[0] == LINK_MSG_REPLY)
+    {
+        SDL_LockMutex(link_mutex);
+        link_reply_value = value;
+        link_reply_pending = 0;
+        SDL_CondBroadcast(link_cond);
+        SDL_UnlockMutex(link_mutex);
+    }
+}
+
+static int _link_thread_func(void *data)
+{
+    (void)data;
+
+    net_socket listener = NET_INVALID_SOCKET;
+
+    while (!SDL_AtomicGet(&link_quit))
+    {
+        if (!SDL_AtomicGet(&link_connected))
+        {
+            net_socket s = NET_INVALID_SOCKET;
+
+            // If this instance is already waiting for a connection, don't try
+            // to connect to itself.
+            if (listener == NET_INVALID_SOCKET)
+            {
+                s = Net_TCPConnect("127.0.0.1", LINK_CABLE_PORT);
+                if (s == NET_INVALID_SOCKET)
+                    listener = Net_TCPListen(LINK_CABLE_PORT);
+            }
+
+            int is_host = 0;
+
+            if ((s == NET_INVALID_SOCKET) && (listener != NET_INVALID_SOCKET))
+            {
+                s = Net_TCPAccept(listener, 200);
+                is_host = 1;
+            }
+
+            if (s == NET_INVALID_SOCKET)
+            {
+                if (listener == NET_INVALID_SOCKET)
+                    SDL_Delay(200);
+                continue;
+            }
+
+            Net_Close(listener);
+            listener = NET_INVALID_SOCKET;
+
+            SDL_LockMutex(link_send_mutex);
+            link_socket = s;
+            SDL_UnlockMutex(link_send_mutex);
+
+            SDL_AtomicSet(&link_is_host, is_host);
+            SDL_AtomicSet(&link_connected, 1);
+            Debug_LogMsgArg("Link cable: Connected");
+            continue;
+        }
+
+        int ret = Net_WaitReadable(link_socket, 100);
+        if (ret == 0)
+            continue;
+
+        uint8_t msg[LINK_MSG_SIZE];
+        if ((ret < 0) || !Net_RecvAll(link_socket, msg, sizeof(msg)))
+        {
+            Debug_LogMsgArg("Link cable: Disconnected");
+            link_disconnect();
+            continue;
+        }
+
+        link_handle_message(msg);
+    }
+
+    Net_Close(listener);
+
+    return 0;
+}
+
+int LinkCable_Start(void)
+{
+    if (link_thread != NULL)
+        return 1;
+
+    if (!Net_Init())
+        return 0;
+
+    link_mutex = SDL_CreateMutex();
+    link_send_mutex = SDL_CreateMutex();
+    link_cond = SDL_CreateCond();
+    if ((link_mutex == NULL) || (link_send_mutex == NULL)
+        || (link_cond == NULL))
+    {
+        Debug_ErrorMsgArg("Link cable: Failed to create mutex: %s",
+                          SDL_GetError());
+        return 0;
+    }
+
+    SDL_AtomicSet(&link_quit, 0);
+    SDL_AtomicSet(&link_connected, 0);
+    SDL_AtomicSet(&link_is_host, 0);
+    SDL_AtomicSet(&link_slave_has_received, 0);
+    link_reply_pending = 0;
+    link_slave_ready = 0;
+
+    link_stats_transfers = 0;
+    link_stats_wait_us = 0;
+
+    link_thread = SDL_CreateThread(_link_thread_func, "Link cable", NULL);
+    if (link_thread == NULL)
+    {
+        Debug_ErrorMsgArg("Link cable: Failed to create thread: %s",
+                          SDL_GetError());
+        return 0;
+    }
+
+    return 1;
+}
+
+void LinkCable_Stop(void)
+{
+    if (link_thread == NULL)
+        return;
+
+    SDL_AtomicSet(&link_quit, 1);
+    SDL_WaitThread(link_thread, NULL);
+    link_thread = NULL;
+
+    link_disconnect();
+
+    if (link_stats_transfers > 0)
+    {
+        Debug_LogMsgArg("Link cable: %u transfers, %u us average wait",
+                        link_stats_transfers,
+                        (uint32_t)(link_stats_wait_us / link_stats_transfers));
+    }
+
+    SDL_DestroyCond(link_cond);
+    SDL_DestroyMutex(link_send_mutex);
+    SDL_DestroyMutex(link_mutex);
+    link_cond = NULL;
+    link_send_mutex = NULL;
+    link_mutex = NULL;
+}
+
+int LinkCable_IsConnected(void)
+{
+    if (link_thread == NULL)
+        return 0;
+
+    return SDL_AtomicGet(&link_connected);
+}
+
+int LinkCable_IsHost(void)
+{
+    if (link_thread == NULL)
+        return 0;
+
+    return SDL_AtomicGet(&link_is_host);
+}
+
+uint32_t LinkCable_MasterExchange(uint32_t value)
+{
+    if (!LinkCable_IsConnected())
+        return LINK_CABLE_NO_DATA;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    SDL_LockMutex(link_mutex);
+
+    link_reply_pending = 1;
+    link_reply_value = LINK_CABLE_NO_DATA;
+
+    SDL_UnlockMutex(link_mutex);
+
+    if (!link_send(LINK_MSG_DATA, value))
+        return LINK_CABLE_NO_DATA;
+
+    SDL_LockMutex(link_mutex);
+
+    while (link_reply_pending && SDL_AtomicGet(&link_connected))
+    {
+        if (SDL_CondWaitTimeout(link_cond, link_mutex, LINK_CABLE_TIMEOUT_MS)
+            == SDL_MUTEX_TIMEDOUT)
+        {
+            break;
+        }
+    }
+
+    uint32_t reply = link_reply_pending ? LINK_CABLE_NO_DATA
+                                        : link_reply_value;
+    link_reply_pending = 0;
+
+    SDL_UnlockMutex(link_mutex);
+
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    link_stats_wait_us += elapsed * 1000000 / SDL_GetPerformanceFrequency();
+    link_stats_transfers++;
+
+    return reply;
+}
+
+void LinkCable_SlaveSetReady(int ready, uint32_t value)
+{
+    if (link_thread == NULL)
+        return;
+
+    SDL_LockMutex(link_mutex);
+    link_slave_ready = ready;
+    link_slave_value = value;
+    if (ready)
+        SDL_AtomicSet(&link_slave_has_received, 0);
+    SDL_UnlockMutex(link_mutex);
+}
+
+int LinkCable_SlaveGetReceived(uint32_t *value)
+{
+    if (link_thread == NULL)
+        return 0;
+
+    // Fast check without locking the mutex, this is called very often
+    if (!SDL_AtomicGet(&link_slave_has_received))
+        return 0;
+
+    SDL_LockMutex(link_mutex);
+    *value = link_slave_received;
+    SDL_AtomicSet(&link_slave_has_received, 0);
+    SDL_UnlockMutex(link_mutex);
+
+    return 1;
+}
+
+void LinkCable_GetStats(uint32_t *transfers, uint64_t *wait_us)
+{
+    *transfers = link_stats_transfers;
+    *wait_us = link_stats_wait_us;
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef LINK_CABLE__
+#define LINK_CABLE__
+
+#include <stdint.h>
+
+// Link cable between two instances of the emulator running in the same host.
+// The first instance that starts the link waits for a connection, the second
+// one connects to it. Both instances only synchronize when a transfer ends.
+
+#define LINK_CABLE_PORT 5738
+
+// Value returned by the master when the other side isn't ready
+#define LINK_CABLE_NO_DATA 0xFFFFFFFF
+
+// The connection is done in the background, they don't block.
+int LinkCable_Start(void);
+void LinkCable_Stop(void);
+
+int LinkCable_IsConnected(void);
+// Returns 1 if this instance waited for the connection of the other one
+int LinkCable_IsHost(void);
+
+// The side that drives the clock sends its value and gets the value of the
+// other side. It blocks until the answer arrives.
+uint32_t LinkCable_MasterExchange(uint32_t value);
+
+// The side that uses the external clock sets the value that it's going to send
+// when the other side starts a transfer.
+void LinkCable_SlaveSetReady(int ready, uint32_t value);
+// Returns 1 if a transfer has finished, and the value received from the other
+// side. The slave stops being ready when this happens.
+int LinkCable_SlaveGetReceived(uint32_t *value);
+
+// Number of transfers done as master and total time spent waiting for the
+// other side to answer.
+void LinkCable_GetStats(uint32_t *transfers, uint64_t *wait_us);
+
+#endif // LINK_CABLE__
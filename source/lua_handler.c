@@ -12,24 +12,211 @@
 # include <lauxlib.h>
 #endif
 
+#include "gb_core/debug.h"
+#include "gb_core/gameboy.h"
+#include "gb_core/gb_main.h"
+#include "gb_core/memory.h"
+#include "gb_core/video.h"
+
+#include "gba_core/disassembler.h"
 #include "gba_core/gba.h"
+#include "gba_core/memory.h"
 #include "gba_core/sound.h"
 
 #include "gui/win_main.h"
 
 #include "debug_utils.h"
 #include "general_utils.h"
+#include "lua_handler.h"
 #include "sound_utils.h"
 #include "wav_utils.h"
 #include "window_handler.h"
 
 #ifdef ENABLE_LUA
-static char *script_path = NULL;
-static SDL_Thread *script_thread;
-static int script_running = 0;
+
+extern _GB_CONTEXT_ GameBoy;
+
+// Scripts run in the emulation thread. The body of the script runs in a Lua
+// coroutine that is resumed between frames, and run_frames_and_pause() yields
+// it until the requested number of frames has been emulated. Scripts can also
+// register callbacks that are called at the start of each frame, at VBlank or
+// when the CPU executes some address. They run inline, in the middle of the
+// emulation, so they see the exact state of the emulated machine.
+
+static lua_State *script_state = NULL;
+static lua_State *script_coroutine = NULL;
+static int script_coroutine_ref = LUA_NOREF;
+
+static int script_running = 0; // The body of the script hasn't finished yet
+static int script_in_coroutine = 0; // Set while the body of the script runs
+static int script_wait_frames = 0;
+static int script_controls_input = 0;
 
 static uint16_t lua_keyinput = 0;
 
+#define SCRIPT_MAX_HOOKS    16
+#define SCRIPT_MAX_PC_HOOKS 64
+
+// References to Lua functions in the registry
+static int script_frame_hooks[SCRIPT_MAX_HOOKS];
+static int script_frame_hooks_num = 0;
+static int script_vblank_hooks[SCRIPT_MAX_HOOKS];
+static int script_vblank_hooks_num = 0;
+
+typedef struct
+{
+    u32 address;
+    int ref;
+} script_pc_hook_t;
+
+static script_pc_hook_t script_pc_hooks[SCRIPT_MAX_PC_HOOKS];
+static int script_pc_hooks_num = 0;
+
+// ----------------------------------------------------------------------------
+
+static void script_call_ref(int ref, int has_arg, lua_Integer arg)
+{
+    lua_State *L = script_state;
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+    if (has_arg)
+        lua_pushinteger(L, arg);
+
+    if (lua_pcall(L, has_arg ? 1 : 0, 0, 0))
+    {
+        Debug_LogMsgArg("Script callback error: %s", lua_tostring(L, -1));
+        lua_pop(L, 1);
+    }
+}
+
+static void script_pc_hook(u32 address)
+{
+    for (int i = 0; i < script_pc_hooks_num; i++)
+    {
+        if (script_pc_hooks[i].address == address)
+            script_call_ref(script_pc_hooks[i].ref, 1, address);
+    }
+}
+
+static void script_vblank_hook(void)
+{
+    for (int i = 0; i < script_vblank_hooks_num; i++)
+        script_call_ref(script_vblank_hooks[i], 0, 0);
+}
+
+static void script_apply_keys(void)
+{
+    script_controls_input = 1;
+
+    if (Win_MainRunningGBA())
+    {
+        GBA_HandleInputFlags(lua_keyinput);
+    }
+    else if (Win_MainRunningGB())
+    {
+        GB_InputSet(0, lua_keyinput & BIT(0), lua_keyinput & BIT(1),
+                    lua_keyinput & BIT(3), lua_keyinput & BIT(2),
+                    lua_keyinput & BIT(4), lua_keyinput & BIT(5),
+                    lua_keyinput & BIT(6), lua_keyinput & BIT(7));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+// Copy size bytes from the memory map of the running system. Regions that can
+// be accessed directly are copied in one go, the rest are read byte by byte.
+static void script_memory_read(u32 address, u8 *dst, size_t size)
+{
+    while (size > 0)
+    {
+        size_t copy = 0;
+        const u8 *src = NULL;
+
+        if (Win_MainRunningGBA())
+        {
+            u32 available;
+            src = GBA_MemoryGetReadPointer(address, &available);
+            if (src != NULL)
+                copy = available;
+        }
+        else
+        {
+            address &= 0xFFFF;
+            src = GameBoy.Memory.ReadPage[address >> 8];
+            if (src != NULL)
+            {
+                src += address & 0xFF;
+                copy = 0x100 - (address & 0xFF);
+            }
+        }
+
+        if (src != NULL)
+        {
+            if (copy > size)
+                copy = size;
+            memcpy(dst, src, copy);
+        }
+        else
+        {
+            copy = 1;
+            if (Win_MainRunningGBA())
+                *dst = GBA_MemoryRead8(address);
+            else
+                *dst = GB_MemRead8(address);
+        }
+
+        address += copy;
+        dst += copy;
+        size -= copy;
+    }
+}
+
+static void script_memory_write(u32 address, const u8 *src, size_t size)
+{
+    while (size > 0)
+    {
+        size_t copy = 0;
+        u8 *dst = NULL;
+
+        if (Win_MainRunningGBA())
+        {
+            u32 available;
+            dst = GBA_MemoryGetWritePointer(address, &available, 0);
+            if (dst != NULL)
+                copy = available;
+        }
+        else
+        {
+            address &= 0xFFFF;
+            dst = GameBoy.Memory.WritePage[address >> 8];
+            if (dst != NULL)
+            {
+                dst += address & 0xFF;
+                copy = 0x100 - (address & 0xFF);
+            }
+        }
+
+        if (dst != NULL)
+        {
+            if (copy > size)
+                copy = size;
+            memcpy(dst, src, copy);
+        }
+        else
+        {
+            copy = 1;
+            if (Win_MainRunningGBA())
+                GBA_MemoryWrite8(address, *src);
+            else
+                GB_MemWrite8(address, *src);
+        }
+
+        address += copy;
+        src += copy;
+        size -= copy;
+    }
+}
+
 // ----------------------------------------------------------------------------
 
 static int lua_run_frames_and_pause(lua_State *L)
@@ -42,50 +229,58 @@ static int lua_run_frames_and_pause(lua_State *L)
         return 0;
     }
 
+    if (!script_in_coroutine)
+    {
+        Debug_LogMsgArg("%s(): Can't be used from callbacks", __func__);
+        return 0;
+    }
+
     // Get argument of the function and remove it from the stack
     lua_Integer frames = lua_tointeger(L, -1);
     lua_pop(L, 1);
 
-    Debug_LogMsgArg("%s(%lld)", __func__, frames);
+    Debug_LogMsgArg("%s(%lld)", __func__, (long long)frames);
 
-    for (int i = 0; i < frames; i++)
-    {
-        if (Win_MainRunningGBA())
-        {
-            GBA_SoundResetBufferPointers();
-            GBA_RunForOneFrame();
-            GBA_SoundSaveToWAV();
-        }
-    }
+    if (frames <= 0)
+        return 0;
 
-    // Number of results
-    return 0;
+    // The frame that is emulated right after yielding counts as one
+    script_wait_frames = frames - 1;
+
+    return lua_yield(L, 0);
 }
 
 static int lua_screenshot(lua_State *L)
 {
     // Number of arguments
     int narg = lua_gettop(L);
-    if (narg == 0)
+    if (narg > 1)
+    {
+        Debug_LogMsgArg("%s(): Invalid number of arguments: %d", __func__, narg);
+        return 0;
+    }
+
+    if (Win_MainRunningGB())
+    {
+        // The GB core always saves screenshots to the screenshots folder
+        Debug_LogMsgArg("%s()", __func__);
+        GB_Screenshot();
+    }
+    else if (narg == 0)
     {
         Debug_LogMsgArg("%s()", __func__);
         GBA_Screenshot("screenshot.png");
     }
-    else if (narg == 1)
+    else
     {
         const char *name = lua_tostring(L, -1);
 
         Debug_LogMsgArg("%s(%s)", __func__, name);
         GBA_Screenshot(name);
-
-        lua_pop(L, 1);
-    }
-    else
-    {
-        Debug_LogMsgArg("%s(): Invalid number of arguments: %d", __func__, narg);
-        return 0;
     }
 
+    lua_settop(L, 0);
+
     // Number of results
     return 0;
 }
@@ -140,7 +335,7 @@ static int lua_keys_hold(lua_State *L)
 
     lua_keyinput |= keys;
 
-    GBA_HandleInputFlags(lua_keyinput);
+    script_apply_keys();
 
     // Number of results
     return 0;
@@ -168,7 +363,7 @@ static int lua_keys_release(lua_State *L)
 
     lua_keyinput &= ~keys;
 
-    GBA_HandleInputFlags(lua_keyinput);
+    script_apply_keys();
 
     // Number of results
     return 0;
@@ -240,63 +435,253 @@ static int lua_exit(lua_State *L)
     return 0;
 }
 
-// ----------------------------------------------------------------------------
+// on_frame(function): Called at the start of every frame
+static int lua_on_frame(lua_State *L)
+{
+    int narg = lua_gettop(L);
+    if ((narg != 1) || !lua_isfunction(L, -1))
+    {
+        Debug_LogMsgArg("%s(): Expected one function", __func__);
+        lua_settop(L, 0);
+        return 0;
+    }
+
+    if (script_frame_hooks_num == SCRIPT_MAX_HOOKS)
+    {
+        Debug_LogMsgArg("%s(): Too many callbacks", __func__);
+        lua_settop(L, 0);
+        return 0;
+    }
 
-static int Script_Runner(unused__ void *ptr)
+    script_frame_hooks[script_frame_hooks_num++] =
+            luaL_ref(L, LUA_REGISTRYINDEX);
+
+    // Number of results
+    return 0;
+}
+
+// on_vblank(function): Called when the emulated PPU enters VBlank
+static int lua_on_vblank(lua_State *L)
 {
-    int ret = 1;
+    int narg = lua_gettop(L);
+    if ((narg != 1) || !lua_isfunction(L, -1))
+    {
+        Debug_LogMsgArg("%s(): Expected one function", __func__);
+        lua_settop(L, 0);
+        return 0;
+    }
 
-    // Create Lua state
-    lua_State *L = luaL_newstate();
+    if (script_vblank_hooks_num == SCRIPT_MAX_HOOKS)
+    {
+        Debug_LogMsgArg("%s(): Too many callbacks", __func__);
+        lua_settop(L, 0);
+        return 0;
+    }
 
-    // Load Lua libraries
-    luaL_openlibs(L);
+    script_vblank_hooks[script_vblank_hooks_num++] =
+            luaL_ref(L, LUA_REGISTRYINDEX);
 
-    // Load script from file
-    int status = luaL_loadfile(L, script_path);
-    if (status) {
-        // On error, the error message is at the top of the stack
-        fprintf(stderr, "Couldn't load file: %s", lua_tostring(L, -1));
-        goto exit;
+    GBA_DebugSetVBlankHookCallback(script_vblank_hook);
+    GB_DebugSetVBlankHookCallback(script_vblank_hook);
+
+    // Number of results
+    return 0;
+}
+
+// on_pc(address, function): Called before executing the instruction at the
+// specified address. The function receives the address as argument.
+static int lua_on_pc(lua_State *L)
+{
+    int narg = lua_gettop(L);
+    if ((narg != 2) || !lua_isfunction(L, -1))
+    {
+        Debug_LogMsgArg("%s(): Expected an address and a function",
+                        __func__);
+        lua_settop(L, 0);
+        return 0;
     }
 
-    // Register C functions
-    lua_register(L, "run_frames_and_pause", lua_run_frames_and_pause);
-    lua_register(L, "screenshot", lua_screenshot);
-    lua_register(L, "keys_hold", lua_keys_hold);
-    lua_register(L, "keys_release", lua_keys_release);
-    lua_register(L, "wav_record_start", lua_wav_record_start);
-    lua_register(L, "wav_record_end", lua_wav_record_end);
-    lua_register(L, "exit", lua_exit);
+    if (script_pc_hooks_num == SCRIPT_MAX_PC_HOOKS)
+    {
+        Debug_LogMsgArg("%s(): Too many callbacks", __func__);
+        lua_settop(L, 0);
+        return 0;
+    }
 
-    while (!Win_MainRunningGBA() && !Win_MainRunningGB())
-        SDL_Delay(0);
+    u32 address = lua_tointeger(L, 1);
+    if (Win_MainRunningGBA())
+        address &= ~1; // The CPU loop checks halfword-aligned addresses
 
-    // GB not supported for now
-    if (Win_MainRunningGB())
+    Debug_LogMsgArg("%s(0x%08X)", __func__, address);
+
+    script_pc_hook_t *hook = &script_pc_hooks[script_pc_hooks_num++];
+    hook->address = address;
+    hook->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_settop(L, 0);
+
+    if (Win_MainRunningGBA())
+        GBA_DebugAddPCHook(address);
+    else
+        GB_DebugAddPCHook(address);
+
+    // Number of results
+    return 0;
+}
+
+// Maximum size of a memory_read() or memory_write() call
+#define SCRIPT_MEMORY_MAX_SIZE  (32 * 1024 * 1024)
+
+// memory_read(address, size): Returns a string with the contents of the memory
+static int lua_memory_read(lua_State *L)
+{
+    int narg = lua_gettop(L);
+    if (narg != 2)
+    {
+        Debug_LogMsgArg("%s(): Invalid number of arguments: %d", __func__, narg);
+        lua_settop(L, 0);
         return 0;
+    }
+
+    u32 address = lua_tointeger(L, 1);
+    lua_Integer size = lua_tointeger(L, 2);
+    lua_settop(L, 0);
 
-    // Run script with 0 arguments and expect one return value
-    int result = lua_pcall(L, 0, 1, 0);
-    if (result) {
-        fprintf(stderr, "Failed to run script: %s", lua_tostring(L, -1));
-        goto exit;
+    if ((size < 0) || (size > SCRIPT_MEMORY_MAX_SIZE))
+    {
+        Debug_LogMsgArg("%s(): Invalid size: %lld", __func__, (long long)size);
+        return 0;
+    }
+
+    // luaL_Buffer isn't used because it can use a lot of stack
+    u8 *buffer = malloc(size > 0 ? size : 1);
+    if (buffer == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    script_memory_read(address, buffer, size);
+    lua_pushlstring(L, (const char *)buffer, size);
+
+    free(buffer);
+
+    // Number of results
+    return 1;
+}
+
+// memory_write(address, data): Writes the contents of a string to memory
+static int lua_memory_write(lua_State *L)
+{
+    int narg = lua_gettop(L);
+    if ((narg != 2) || !lua_isstring(L, 2))
+    {
+        Debug_LogMsgArg("%s(): Expected an address and a string", __func__);
+        lua_settop(L, 0);
+        return 0;
+    }
+
+    u32 address = lua_tointeger(L, 1);
+    size_t size;
+    const char *src = lua_tolstring(L, 2, &size);
+
+    if (size > SCRIPT_MEMORY_MAX_SIZE)
+    {
+        Debug_LogMsgArg("%s(): Invalid size: %zu", __func__, size);
+        lua_settop(L, 0);
+        return 0;
+    }
+
+    script_memory_write(address, (const u8 *)src, size);
+    lua_settop(L, 0);
+
+    // Number of results
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static void script_close(void)
+{
+    GBA_DebugSetPCHookCallback(NULL);
+    GBA_DebugClearPCHookAll();
+    GBA_DebugSetVBlankHookCallback(NULL);
+    GB_DebugSetPCHookCallback(NULL);
+    GB_DebugClearPCHookAll();
+    GB_DebugSetVBlankHookCallback(NULL);
+
+    script_frame_hooks_num = 0;
+    script_vblank_hooks_num = 0;
+    script_pc_hooks_num = 0;
+
+    // This also frees the coroutine
+    lua_close(script_state);
+    script_state = NULL;
+    script_coroutine = NULL;
+    script_coroutine_ref = LUA_NOREF;
+
+    script_running = 0;
+    script_controls_input = 0;
+}
+
+// Resume the body of the script until it yields or ends
+static void script_resume(void)
+{
+    script_in_coroutine = 1;
+#if LUA_VERSION_NUM >= 504
+    int nres;
+    int status = lua_resume(script_coroutine, NULL, 0, &nres);
+#else
+    int status = lua_resume(script_coroutine, NULL, 0);
+#endif
+    script_in_coroutine = 0;
+
+    if (status == LUA_YIELD)
+        return;
+
+    script_running = 0;
+
+    if (status != LUA_OK)
+    {
+        Debug_LogMsgArg("Failed to run script: %s",
+                        lua_tostring(script_coroutine, -1));
+        script_close();
+        return;
     }
 
     // Get returned value and remove it from the stack (it's at the top)
-    int retval  = lua_tointeger(L, -1);
-    lua_pop(L, 1);
+    int retval = 0;
+    if (lua_gettop(script_coroutine) > 0)
+        retval = lua_tointeger(script_coroutine, -1);
+    lua_settop(script_coroutine, 0);
 
     Debug_LogMsgArg("Script returned: %d", retval);
 
-    // Close Lua
-    lua_close(L);
+    // Keep the script loaded while its callbacks may be called
+    if ((script_frame_hooks_num == 0) && (script_vblank_hooks_num == 0)
+        && (script_pc_hooks_num == 0))
+    {
+        script_close();
+    }
+}
 
-    script_running = 0;
+void Script_HookFrame(void)
+{
+    if (script_state == NULL)
+        return;
+
+    for (int i = 0; i < script_frame_hooks_num; i++)
+        script_call_ref(script_frame_hooks[i], 0, 0);
+
+    if (!script_running)
+        return;
+
+    if (script_wait_frames > 0)
+    {
+        script_wait_frames--;
+        return;
+    }
 
-    ret = 0;
-exit:
-    return ret;
+    script_resume();
 }
 
 int Script_IsRunning(void)
@@ -304,50 +689,101 @@ int Script_IsRunning(void)
     return script_running;
 }
 
+int Script_IsLoaded(void)
+{
+    return script_state != NULL;
+}
+
+int Script_ControlsInput(void)
+{
+    return script_controls_input;
+}
+
 int Script_RunLua(const char *path)
 {
     if (path == NULL)
         return 1;
 
-    size_t len = strlen(path);
+    if (script_state != NULL)
+        script_close();
 
-    script_path = malloc(len + 1);
-    if (script_path == NULL)
+    // Create Lua state
+    lua_State *L = luaL_newstate();
+    if (L == NULL)
+    {
+        Debug_LogMsgArg("Couldn't create Lua state");
         return 1;
+    }
 
-    snprintf(script_path, len + 1, "%s", path);
-
-    //is_waiting = 1;
+    // Load Lua libraries
+    luaL_openlibs(L);
 
-    script_thread = SDL_CreateThread(Script_Runner, "Script Runner", NULL);
-    if (script_thread == NULL)
+    // Load script from file
+    int status = luaL_loadfile(L, path);
+    if (status)
     {
-        Debug_LogMsgArg("SDL_CreateThread failed: %s", SDL_GetError());
+        // On error, the error message is at the top of the stack
+        Debug_LogMsgArg("Couldn't load file: %s", lua_tostring(L, -1));
+        lua_close(L);
         return 1;
     }
 
+    // Register C functions
+    lua_register(L, "run_frames_and_pause", lua_run_frames_and_pause);
+    lua_register(L, "screenshot", lua_screenshot);
+    lua_register(L, "keys_hold", lua_keys_hold);
+    lua_register(L, "keys_release", lua_keys_release);
+    lua_register(L, "wav_record_start", lua_wav_record_start);
+    lua_register(L, "wav_record_end", lua_wav_record_end);
+    lua_register(L, "exit", lua_exit);
+    lua_register(L, "on_frame", lua_on_frame);
+    lua_register(L, "on_vblank", lua_on_vblank);
+    lua_register(L, "on_pc", lua_on_pc);
+    lua_register(L, "memory_read", lua_memory_read);
+    lua_register(L, "memory_write", lua_memory_write);
+
+    // Move the loaded script to a coroutine. The reference in the registry
+    // prevents the coroutine from being collected.
+    script_coroutine = lua_newthread(L);
+    script_coroutine_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_xmove(L, script_coroutine, 1);
+
+    script_state = L;
     script_running = 1;
+    script_wait_frames = 0;
+    lua_keyinput = 0;
 
+    GBA_DebugSetPCHookCallback(script_pc_hook);
+    GB_DebugSetPCHookCallback(script_pc_hook);
+
+    // The script starts at the first frame of the game
     return 0;
 }
 
-void Script_WaitEnd(void)
+void Script_End(void)
 {
-    int return_status;
-
-    SDL_WaitThread(script_thread, &return_status);
+    if (script_state != NULL)
+        script_close();
+}
 
-    if (return_status != 0)
-        Debug_LogMsgArg("%s: Thread returned with: %d", __func__, return_status);
+#else // ENABLE_LUA
 
-    free(script_path);
+void Script_HookFrame(void)
+{
+    return;
+}
 
-    script_running = 0;
+int Script_IsRunning(void)
+{
+    return 0;
 }
 
-#else // ENABLE_LUA
+int Script_IsLoaded(void)
+{
+    return 0;
+}
 
-int Script_IsRunning(void)
+int Script_ControlsInput(void)
 {
     return 0;
 }
@@ -359,7 +795,7 @@ int Script_RunLua(unused__ const char *path)
     return 0;
 }
 
-void Script_WaitEnd(void)
+void Script_End(void)
 {
     return;
 }
@@ -7,12 +7,24 @@
 #ifndef LUA_HANDLER__
 #define LUA_HANDLER__
 
+// Returns 1 while the body of the script hasn't finished
 int Script_IsRunning(void);
 
-// Run the script in the file pointed by path
+// Returns 1 while a script is loaded. Its hooks may still be called after the
+// body of the script has finished.
+int Script_IsLoaded(void);
+
+// Returns 1 if the script has taken control of the keys of the emulated system
+int Script_ControlsInput(void);
+
+// Load the script in the file pointed by path. It starts running when the next
+// frame of a game is emulated.
 int Script_RunLua(const char *path);
 
-// Wait until the script is finished
-void Script_WaitEnd(void);
+// Call it at the start of every emulated frame
+void Script_HookFrame(void);
+
+// Unload the script
+void Script_End(void);
 
 #endif // LUA_HANDLER__
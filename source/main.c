@@ -8,13 +8,20 @@
 
 #include <SDL2/SDL.h>
 
+#include "autosave.h"
+#include "capture.h"
 #include "config.h"
 #include "debug_utils.h"
+#include "emu_thread.h"
 #include "file_utils.h"
 #include "font_utils.h"
 #include "input_utils.h"
 #include "lua_handler.h"
+#include "movie.h"
+#include "netplay.h"
+#include "rom_library.h"
 #include "sound_utils.h"
+#include "timing_utils.h"
 #include "window_handler.h"
 
 #include "gui/win_main.h"
@@ -65,6 +72,15 @@ static int Init(void)
 
     Sound_Init();
 
+    if (Autosave_Init())
+        atexit(Autosave_End);
+
+    if (RomLibrary_Init())
+        atexit(RomLibrary_End);
+
+    if (Capture_Init())
+        atexit(Capture_End);
+
     if (DirCheckExistence(DirGetScreenshotFolderPath()) == 0)
         DirCreate(DirGetScreenshotFolderPath());
 
@@ -102,21 +118,62 @@ int main(int argc, char *argv[])
     if (Init() != 0)
         return 1;
 
-    // Check if the user provided a script
+    // Check if the user provided a script, a movie or other options
 
-    if (argc > 2)
+    while ((argc > 2) && (strncmp(argv[1], "--", 2) == 0))
     {
         if (strcmp(argv[1], "--lua") == 0)
         {
-            Script_RunLua(argv[2]);
+            if (Script_RunLua(argv[2]) == 0)
+                atexit(Script_End);
+        }
+        else if (strcmp(argv[1], "--movie-record") == 0)
+        {
+            if (Movie_RecordStart(argv[2]))
+                atexit(Movie_End);
+        }
+        else if (strcmp(argv[1], "--movie-play") == 0)
+        {
+            if (Movie_PlayStart(argv[2]))
+                atexit(Movie_End);
+        }
+        else if (strcmp(argv[1], "--netplay-host") == 0)
+        {
+            if (Netplay_Host((uint16_t)atoi(argv[2])))
+                atexit(Netplay_End);
+        }
+        else if (strcmp(argv[1], "--netplay-connect") == 0)
+        {
+            if (Netplay_Connect(argv[2]))
+                atexit(Netplay_End);
+        }
+        else if (strcmp(argv[1], "--netplay-loopback") == 0)
+        {
+            if (Netplay_Loopback(atoi(argv[2])))
+                atexit(Netplay_End);
+        }
+        else if (strcmp(argv[1], "--timing-log") == 0)
+        {
+            if (Timing_LogStart(argv[2]))
+                atexit(Timing_LogEnd);
+        }
+        else if ((strcmp(argv[1], "--movie-benchmark") == 0) && (argc > 3))
+        {
+            // Run the movie without creating any window
+            return Movie_Benchmark(argv[2], argv[3]);
+        }
+        else
+        {
+            Debug_LogMsgArg("Unknown option: %s", argv[1]);
+            break;
+        }
 
-            // Remove argv[1] and argv[2]
+        // Remove argv[1] and argv[2]
 
-            for (int i = 1; i < argc - 2; i++)
-                argv[i] = argv[i + 2];
+        for (int i = 1; i < argc - 2; i++)
+            argv[i] = argv[i + 2];
 
-            argc = argc - 2;
-        }
+        argc = argc - 2;
     }
 
     // Load main window with the ROM provided as argument
@@ -136,7 +193,14 @@ int main(int argc, char *argv[])
         Win_MainRender();
 
         // Synchronise video
-        if (Input_Speedup_Enabled())
+        if (EmuThread_IsRunning())
+        {
+            // The emulation thread keeps the speed, wait for its next frame
+            EmuThread_WaitFrame((unsigned int)FLOAT_MS_PER_FRAME + 1);
+
+            waitforticks = SDL_GetTicks();
+        }
+        else if (Input_Speedup_Enabled())
         {
             SDL_Delay(0);
         }
@@ -0,0 +1,616 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "build_options.h"
+#include "debug_utils.h"
+#include "file_utils.h"
+#include "general_utils.h"
+#include "movie.h"
+#include "rom_archive.h"
+#include "timing_utils.h"
+
+#include "gb_core/gameboy.h"
+#include "gb_core/gb_main.h"
+#include "gb_core/sound.h"
+#include "gb_core/video.h"
+
+#include "gba_core/bios.h"
+#include "gba_core/cpu.h"
+#include "gba_core/gba.h"
+#include "gba_core/memory.h"
+#include "gba_core/save.h"
+#include "gba_core/sound.h"
+#include "gba_core/video.h"
+
+extern _GB_CONTEXT_ GameBoy;
+
+// File format (all values are 32-bit little endian):
+//
+//   "GBMV", version, system, ROM hash, number of frames, final state hash
+//   Input of each frame
+//
+// The input of GBA frames is the active-high value of KEYINPUT. The input of GB
+// frames has the keys of player N in bits 8 * N to 8 * N + 7.
+
+#define MOVIE_MAGIC         "GBMV"
+#define MOVIE_VERSION       1
+#define MOVIE_HEADER_SIZE   24
+
+#define MOVIE_NONE              0
+#define MOVIE_RECORD_PENDING    1 // Waiting for a ROM to be loaded
+#define MOVIE_RECORDING         2
+#define MOVIE_PLAY_PENDING      3
+#define MOVIE_PLAYING           4
+
+static int movie_mode = MOVIE_NONE;
+static int movie_system;
+
+static char movie_path[MAX_PATHLEN];
+
+// Used while recording
+static FILE *movie_file = NULL;
+
+// Used while playing
+static u8 *movie_data = NULL;
+
+// Used for both
+static u32 movie_frames;
+static u32 movie_frame_index;
+
+//------------------------------------------------------------------------------
+
+// 32-bit FNV-1a
+#define MOVIE_HASH_INIT 2166136261U
+
+static u32 movie_hash(u32 hash, const void *data, size_t size)
+{
+    const u8 *p = data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static u32 movie_hash_u32(u32 hash, u32 value)
+{
+    u8 bytes[4] = {
+        value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24
+    };
+
+    return movie_hash(hash, bytes, sizeof(bytes));
+}
+
+// Hash of the memory and CPU registers of the emulated machine
+static u32 movie_state_hash(int system)
+{
+    u32 hash = MOVIE_HASH_INIT;
+
+    if (system == MOVIE_SYSTEM_GBA)
+    {
+        hash = movie_hash(hash, Mem.ewram, sizeof(Mem.ewram));
+        hash = movie_hash(hash, Mem.iwram, sizeof(Mem.iwram));
+        hash = movie_hash(hash, Mem.io_regs, sizeof(Mem.io_regs));
+        hash = movie_hash(hash, Mem.pal_ram, sizeof(Mem.pal_ram));
+        hash = movie_hash(hash, Mem.vram, sizeof(Mem.vram));
+        hash = movie_hash(hash, Mem.oam, sizeof(Mem.oam));
+
+        for (int i = 0; i < 16; i++)
+            hash = movie_hash_u32(hash, CPU.R[i]);
+        hash = movie_hash_u32(hash, CPU.CPSR);
+    }
+    else
+    {
+        _GB_MEMORY_ *mem = &GameBoy.Memory;
+
+        hash = movie_hash(hash, mem->VideoRAM, sizeof(mem->VideoRAM));
+        hash = movie_hash(hash, mem->ExternRAM, sizeof(mem->ExternRAM));
+        hash = movie_hash(hash, mem->WorkRAM, sizeof(mem->WorkRAM));
+        hash = movie_hash(hash, mem->WorkRAM_Switch,
+                          sizeof(mem->WorkRAM_Switch));
+        hash = movie_hash(hash, mem->ObjAttrMem, sizeof(mem->ObjAttrMem));
+        hash = movie_hash(hash, mem->IO_Ports, sizeof(mem->IO_Ports));
+        hash = movie_hash(hash, mem->HighRAM, sizeof(mem->HighRAM));
+
+        _GB_CPU_ *cpu = &GameBoy.CPU;
+
+        hash = movie_hash_u32(hash, cpu->R16.AF & 0xFFFF);
+        hash = movie_hash_u32(hash, cpu->R16.BC & 0xFFFF);
+        hash = movie_hash_u32(hash, cpu->R16.DE & 0xFFFF);
+        hash = movie_hash_u32(hash, cpu->R16.HL & 0xFFFF);
+        hash = movie_hash_u32(hash, cpu->R16.SP & 0xFFFF);
+        hash = movie_hash_u32(hash, cpu->R16.PC & 0xFFFF);
+    }
+
+    return hash;
+}
+
+// Returns 0 if the ROM can't be loaded
+static int movie_rom_hash_get(const char *rom_path, u32 *hash)
+{
+    void *buffer;
+    size_t size;
+
+    FileLoad(rom_path, &buffer, &size);
+    if (buffer == NULL)
+        return 0;
+
+    *hash = movie_hash(MOVIE_HASH_INIT, buffer, size);
+
+    free(buffer);
+
+    return 1;
+}
+
+static u32 movie_read_u32(const u8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static int movie_write_u32(FILE *f, u32 value)
+{
+    u8 bytes[4] = {
+        value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24
+    };
+
+    return fwrite(bytes, sizeof(bytes), 1, f) == 1;
+}
+
+//------------------------------------------------------------------------------
+
+static u32 movie_input_get(int system)
+{
+    if (system == MOVIE_SYSTEM_GBA)
+        return ~REG_KEYINPUT & 0x3FF;
+
+    u32 input = 0;
+    for (int i = 0; i < 4; i++)
+        input |= (GB_Input_Get(i) & 0xFF) << (8 * i);
+
+    return input;
+}
+
+static void movie_input_set(int system, u32 input)
+{
+    if (system == MOVIE_SYSTEM_GBA)
+    {
+        GBA_HandleInputFlags(input & 0x3FF);
+        return;
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        u32 keys = (input >> (8 * i)) & 0xFF;
+
+        GB_InputSet(i, keys & KEY_A, keys & KEY_B, keys & KEY_START,
+                    keys & KEY_SELECT, keys & KEY_RIGHT, keys & KEY_LEFT,
+                    keys & KEY_UP, keys & KEY_DOWN);
+    }
+}
+
+// Only the keys are saved in movies. The accelerometer of MBC7 cartridges and
+// the image of the GB Camera aren't, so movies of games that use them would
+// desync. Returns 1 if the loaded cartridge can be used with movies.
+static int movie_cartridge_supported(int system)
+{
+    if (system != MOVIE_SYSTEM_GB)
+        return 1;
+
+    int mapper = GameBoy.Emulator.MemoryController;
+    if ((mapper == MEM_MBC7) || (mapper == MEM_CAMERA))
+    {
+        Debug_ErrorMsgArg("Movies can't be used with cartridges that have an "
+                          "accelerometer or a camera.");
+        return 0;
+    }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
+// Load a movie file into movie_data and check the header. Returns 1 on success.
+static int movie_load(const char *path)
+{
+    void *buffer;
+    size_t size;
+
+    FileLoad(path, &buffer, &size);
+    if (buffer == NULL)
+        return 0;
+
+    const u8 *header = buffer;
+
+    if ((size < MOVIE_HEADER_SIZE) || (memcmp(header, MOVIE_MAGIC, 4) != 0)
+        || (movie_read_u32(&header[4]) != MOVIE_VERSION))
+    {
+        Debug_ErrorMsgArg("%s isn't a valid movie file", path);
+        free(buffer);
+        return 0;
+    }
+
+    u32 frames = movie_read_u32(&header[16]);
+    if (((size - MOVIE_HEADER_SIZE) / 4) < frames)
+    {
+        Debug_ErrorMsgArg("Movie %s is truncated", path);
+        free(buffer);
+        return 0;
+    }
+
+    free(movie_data);
+    movie_data = buffer;
+    movie_frames = frames;
+    movie_frame_index = 0;
+
+    return 1;
+}
+
+static u32 movie_header_get(int offset)
+{
+    return movie_read_u32(&movie_data[offset]);
+}
+
+static u32 movie_frame_input_get(u32 frame)
+{
+    return movie_read_u32(&movie_data[MOVIE_HEADER_SIZE + frame * 4]);
+}
+
+// Check that the ROM matches the one used to record the movie
+static void movie_check_rom(u32 rom_hash)
+{
+    if (movie_header_get(12) != rom_hash)
+    {
+        Debug_ErrorMsgArg("The movie was recorded with a different ROM.\n"
+                          "It will probably desync.");
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int Movie_RecordStart(const char *path)
+{
+    Movie_End();
+
+    s_strncpy(movie_path, path, sizeof(movie_path));
+    movie_mode = MOVIE_RECORD_PENDING;
+
+    return 1;
+}
+
+int Movie_PlayStart(const char *path)
+{
+    Movie_End();
+
+    if (!movie_load(path))
+        return 0;
+
+    s_strncpy(movie_path, path, sizeof(movie_path));
+    movie_mode = MOVIE_PLAY_PENDING;
+
+    return 1;
+}
+
+static void movie_record_end(void)
+{
+    u32 state_hash = movie_state_hash(movie_system);
+
+    // Fill the fields of the header that weren't known at the start
+    if ((fseek(movie_file, 16, SEEK_SET) != 0)
+        || !movie_write_u32(movie_file, movie_frames)
+        || !movie_write_u32(movie_file, state_hash))
+    {
+        Debug_ErrorMsgArg("Failed to write movie: %s", movie_path);
+    }
+
+    fclose(movie_file);
+    movie_file = NULL;
+
+    Debug_LogMsgArg("Movie recorded: %s (%u frames, state hash %08X)",
+                    movie_path, movie_frames, state_hash);
+}
+
+void Movie_End(void)
+{
+    if (movie_mode == MOVIE_RECORDING)
+        movie_record_end();
+
+    free(movie_data);
+    movie_data = NULL;
+
+    movie_mode = MOVIE_NONE;
+}
+
+int Movie_IsPlaying(void)
+{
+    return movie_mode == MOVIE_PLAYING;
+}
+
+void Movie_ROMLoaded(const char *rom_path, int system)
+{
+    u32 rom_hash;
+
+    if ((movie_mode == MOVIE_RECORD_PENDING)
+        || (movie_mode == MOVIE_PLAY_PENDING))
+    {
+        if (!movie_cartridge_supported(system))
+        {
+            Movie_End();
+            return;
+        }
+    }
+
+    if (movie_mode == MOVIE_RECORD_PENDING)
+    {
+        if (!movie_rom_hash_get(rom_path, &rom_hash))
+        {
+            movie_mode = MOVIE_NONE;
+            return;
+        }
+
+        movie_file = fopen(movie_path, "wb");
+        if (movie_file == NULL)
+        {
+            Debug_ErrorMsgArg("Couldn't create movie: %s", movie_path);
+            movie_mode = MOVIE_NONE;
+            return;
+        }
+
+        fwrite(MOVIE_MAGIC, 4, 1, movie_file);
+        movie_write_u32(movie_file, MOVIE_VERSION);
+        movie_write_u32(movie_file, system);
+        movie_write_u32(movie_file, rom_hash);
+        movie_write_u32(movie_file, 0); // Number of frames
+        movie_write_u32(movie_file, 0); // Final state hash
+
+        movie_system = system;
+        movie_frames = 0;
+        movie_mode = MOVIE_RECORDING;
+    }
+    else if (movie_mode == MOVIE_PLAY_PENDING)
+    {
+        if ((u32)system != movie_header_get(8))
+        {
+            Debug_ErrorMsgArg("The movie was recorded with another system");
+            Movie_End();
+            return;
+        }
+
+        if (movie_rom_hash_get(rom_path, &rom_hash))
+            movie_check_rom(rom_hash);
+
+        movie_system = system;
+        movie_frame_index = 0;
+        movie_mode = MOVIE_PLAYING;
+    }
+}
+
+void Movie_ROMUnloaded(void)
+{
+    // The movie can't continue after the ROM is unloaded
+    if ((movie_mode == MOVIE_RECORDING) || (movie_mode == MOVIE_PLAYING))
+        Movie_End();
+}
+
+static void movie_handle_frame(int system)
+{
+    if (movie_mode == MOVIE_RECORDING)
+    {
+        if (!movie_write_u32(movie_file, movie_input_get(system)))
+        {
+            Debug_ErrorMsgArg("Failed to write movie: %s", movie_path);
+            Movie_End();
+            return;
+        }
+
+        movie_frames++;
+    }
+    else if (movie_mode == MOVIE_PLAYING)
+    {
+        if (movie_frame_index == movie_frames)
+        {
+            u32 state_hash = movie_state_hash(system);
+
+            if (state_hash == movie_header_get(20))
+            {
+                Debug_LogMsgArg("Movie finished: %s", movie_path);
+            }
+            else
+            {
+                Debug_ErrorMsgArg("Movie finished with a different state.\n"
+                                  "State hash: %08X (expected %08X)",
+                                  state_hash, movie_header_get(20));
+            }
+
+            Movie_End();
+            return;
+        }
+
+        movie_input_set(system, movie_frame_input_get(movie_frame_index));
+        movie_frame_index++;
+    }
+}
+
+void Movie_HandleFrameGBA(void)
+{
+    movie_handle_frame(MOVIE_SYSTEM_GBA);
+}
+
+void Movie_HandleFrameGB(void)
+{
+    movie_handle_frame(MOVIE_SYSTEM_GB);
+}
+
+//------------------------------------------------------------------------------
+
+static int movie_compare_u64(const void *a, const void *b)
+{
+    Uint64 va = *(const Uint64 *)a;
+    Uint64 vb = *(const Uint64 *)b;
+
+    return (va > vb) - (va < vb);
+}
+
+int Movie_Benchmark(const char *movie_file_path, const char *rom_path)
+{
+    Movie_End();
+
+    if (!movie_load(movie_file_path))
+        return 1;
+
+    int system = movie_header_get(8);
+    u32 expected_hash = movie_header_get(20);
+
+    u32 rom_hash;
+    if (!movie_rom_hash_get(rom_path, &rom_hash))
+    {
+        Movie_End();
+        return 1;
+    }
+    movie_check_rom(rom_hash);
+
+    Uint64 *frame_ticks = malloc((movie_frames + 1) * sizeof(Uint64));
+    if (frame_ticks == NULL)
+    {
+        Debug_ErrorMsgArg("%s(): Not enough memory", __func__);
+        Movie_End();
+        return 1;
+    }
+
+    void *bios_buffer = NULL;
+
+    if (system == MOVIE_SYSTEM_GBA)
+    {
+        static char bios_path[MAX_PATHLEN];
+        size_t bios_size;
+        snprintf(bios_path, sizeof(bios_path), "%s" GBA_BIOS_FILENAME,
+                 DirGetBiosFolderPath());
+
+        FileLoad_NoError(bios_path, &bios_buffer, &bios_size);
+        GBA_BiosLoaded(bios_size != 0);
+
+        size_t rom_size;
+        void *rom_buffer = calloc(1, GBA_ROM_BUFFER_SIZE);
+        if ((rom_buffer == NULL) ||
+            (RomArchive_Read(rom_path, rom_buffer, GBA_ROM_BUFFER_SIZE,
+                             &rom_size) == 0))
+        {
+            Debug_ErrorMsgArg("Couldn't load data from %s.", rom_path);
+            free(rom_buffer);
+            free(bios_buffer);
+            free(frame_ticks);
+            Movie_End();
+            return 1;
+        }
+
+        char save_path[MAX_PATHLEN];
+        RomArchive_GetBasePath(rom_path, save_path, sizeof(save_path));
+        GBA_SaveSetFilename(save_path);
+        GBA_InitRomBuffer(bios_buffer, rom_buffer, rom_size);
+        GBA_SkipFrame(0);
+    }
+    else if (system == MOVIE_SYSTEM_GB)
+    {
+        if (!GB_ROMLoad(rom_path))
+        {
+            free(frame_ticks);
+            Movie_End();
+            return 1;
+        }
+        if (!movie_cartridge_supported(system))
+        {
+            GB_End(0);
+            free(frame_ticks);
+            Movie_End();
+            return 1;
+        }
+        GB_SkipFrame(0);
+    }
+    else
+    {
+        Debug_ErrorMsgArg("Unknown system in movie: %d", system);
+        free(frame_ticks);
+        Movie_End();
+        return 1;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    for (u32 i = 0; i < movie_frames; i++)
+    {
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+
+        movie_input_set(system, movie_frame_input_get(i));
+
+        if (system == MOVIE_SYSTEM_GBA)
+        {
+            GBA_SoundResetBufferPointers();
+            GBA_RunForOneFrame();
+        }
+        else
+        {
+            GB_SoundResetBufferPointers();
+            GB_RunForOneFrame();
+        }
+
+        frame_ticks[i] = SDL_GetPerformanceCounter() - frame_start;
+
+        Timing_FrameEnd();
+    }
+
+    Uint64 total_ticks = SDL_GetPerformanceCounter() - start;
+
+    u32 state_hash = movie_state_hash(system);
+
+    if (system == MOVIE_SYSTEM_GBA)
+        GBA_EndRom(0);
+    else
+        GB_End(0);
+
+    free(bios_buffer);
+
+    double freq = SDL_GetPerformanceFrequency();
+    double total_s = total_ticks / freq;
+
+    printf("Movie: %s\n", movie_file_path);
+    printf("Frames: %u\n", movie_frames);
+    printf("Time: %.3f s\n", total_s);
+    if ((movie_frames > 0) && (total_s > 0))
+    {
+        printf("Speed: %.1f FPS\n", movie_frames / total_s);
+
+        qsort(frame_ticks, movie_frames, sizeof(Uint64), movie_compare_u64);
+
+        const int percentiles[] = { 50, 90, 99, 100 };
+        for (size_t i = 0; i < ARRAY_NUM_ELEMENTS(percentiles); i++)
+        {
+            u32 index = ((movie_frames - 1) * percentiles[i]) / 100;
+            printf("Frame time p%d: %.1f us\n", percentiles[i],
+                   frame_ticks[index] * 1000000.0 / freq);
+        }
+    }
+    printf("State hash: %08X (expected %08X)\n", state_hash, expected_hash);
+
+    free(frame_ticks);
+    Movie_End();
+
+    if (state_hash != expected_hash)
+    {
+        printf("Desync detected!\n");
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef MOVIE__
+#define MOVIE__
+
+// Movies store the input of every frame since the ROM is loaded, so that they
+// can be played back to get exactly the same result. The header has a hash of
+// the ROM and a hash of the state of the emulated machine after the last frame
+// so that desyncs can be detected. Only the keys are stored, so GB cartridges
+// with an accelerometer (MBC7) or a camera can't be used with movies.
+
+#define MOVIE_SYSTEM_GB     1
+#define MOVIE_SYSTEM_GBA    2
+
+// Record or play a movie starting from the next ROM that is loaded. They return
+// 1 on success.
+int Movie_RecordStart(const char *path);
+int Movie_PlayStart(const char *path);
+
+// Stop recording or playing
+void Movie_End(void);
+
+// Returns 1 while playing a movie
+int Movie_IsPlaying(void);
+
+// Called by the main window
+void Movie_ROMLoaded(const char *rom_path, int system);
+void Movie_ROMUnloaded(void);
+// Called after updating the input and before emulating the frame
+void Movie_HandleFrameGBA(void);
+void Movie_HandleFrameGB(void);
+
+// Play a movie as fast as possible without creating any window and print
+// performance statistics and the final state hash. Returns 0 on success, 1 on
+// error and 2 if the final state doesn't match the recorded one.
+int Movie_Benchmark(const char *movie_path, const char *rom_path);
+
+#endif // MOVIE__
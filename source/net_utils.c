@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+// Needed for getaddrinfo()
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+# include <winsock2.h>
+# include <ws2tcpip.h>
+#else
+# include <netdb.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <sys/select.h>
+# include <sys/socket.h>
+# include <sys/types.h>
+# include <unistd.h>
+#endif
+
+#include "debug_utils.h"
+#include "net_utils.h"
+
+#if defined(_WIN32)
+typedef int net_len;
+# define net_close_socket closesocket
+#else
+typedef size_t net_len;
+# define net_close_socket close
+#endif
+
+static int net_initialized = 0;
+
+int Net_Init(void)
+{
+    if (net_initialized)
+        return 1;
+
+#if defined(_WIN32)
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+    {
+        Debug_ErrorMsgArg("WSAStartup() failed");
+        return 0;
+    }
+#endif
+
+    net_initialized = 1;
+    return 1;
+}
+
+void Net_End(void)
+{
+    if (!net_initialized)
+        return;
+
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+
+    net_initialized = 0;
+}
+
+static void net_set_nodelay(net_socket s)
+{
+    int flag = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&flag, sizeof(flag));
+}
+
+net_socket Net_TCPConnect(const char *host, uint16_t port)
+{
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", (unsigned int)port);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *result;
+    if (getaddrinfo(host, port_str, &hints, &result) != 0)
+        return NET_INVALID_SOCKET;
+
+    net_socket s = NET_INVALID_SOCKET;
+
+    for (struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next)
+    {
+        s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s == NET_INVALID_SOCKET)
+            continue;
+
+        if (connect(s, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+
+        net_close_socket(s);
+        s = NET_INVALID_SOCKET;
+    }
+
+    freeaddrinfo(result);
+
+    if (s != NET_INVALID_SOCKET)
+        net_set_nodelay(s);
+
+    return s;
+}
+
+net_socket Net_TCPListen(uint16_t port)
+{
+    net_socket s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NET_INVALID_SOCKET)
+        return NET_INVALID_SOCKET;
+
+    int flag = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&flag, sizeof(flag));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        || (listen(s, 1) != 0))
+    {
+        net_close_socket(s);
+        return NET_INVALID_SOCKET;
+    }
+
+    return s;
+}
+
+net_socket Net_TCPAccept(net_socket listener, int timeout_ms)
+{
+    if (Net_WaitReadable(listener, timeout_ms) != 1)
+        return NET_INVALID_SOCKET;
+
+    net_socket s = accept(listener, NULL, NULL);
+    if (s != NET_INVALID_SOCKET)
+        net_set_nodelay(s);
+
+    return s;
+}
+
+net_socket Net_UDPOpen(uint16_t port, int loopback)
+{
+    net_socket s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s == NET_INVALID_SOCKET)
+        return NET_INVALID_SOCKET;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(loopback ? INADDR_LOOPBACK : INADDR_ANY);
+
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        net_close_socket(s);
+        return NET_INVALID_SOCKET;
+    }
+
+    return s;
+}
+
+int Net_UDPGetAddress(net_socket s, net_address *addr)
+{
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+
+    if (getsockname(s, (struct sockaddr *)&sin, &len) != 0)
+        return 0;
+
+    addr->ip = sin.sin_addr.s_addr;
+    addr->port = sin.sin_port;
+
+    return 1;
+}
+
+int Net_UDPResolve(const char *host, uint16_t port, net_address *addr)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    struct addrinfo *result;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0)
+        return 0;
+
+    struct sockaddr_in *sin = (struct sockaddr_in *)result->ai_addr;
+    addr->ip = sin->sin_addr.s_addr;
+    addr->port = htons(port);
+
+    freeaddrinfo(result);
+
+    return 1;
+}
+
+int Net_UDPAddressEqual(const net_address *a, const net_address *b)
+{
+    return (a->ip == b->ip) && (a->port == b->port);
+}
+
+int Net_UDPSendTo(net_socket s, const void *data, size_t size,
+                  const net_address *addr)
+{
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = addr->port;
+    sin.sin_addr.s_addr = addr->ip;
+
+    int ret = sendto(s, data, (net_len)size, 0, (struct sockaddr *)&sin,
+                     sizeof(sin));
+
+    return ret == (int)size;
+}
+
+int Net_UDPRecvFrom(net_socket s, void *data, size_t size, net_address *addr)
+{
+    int ret = Net_WaitReadable(s, 0);
+    if (ret <= 0)
+        return ret;
+
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+
+    ret = recvfrom(s, data, (net_len)size, 0, (struct sockaddr *)&sin, &len);
+    if (ret < 0)
+        return -1;
+
+    addr->ip = sin.sin_addr.s_addr;
+    addr->port = sin.sin_port;
+
+    return ret;
+}
+
+void Net_Close(net_socket s)
+{
+    if (s != NET_INVALID_SOCKET)
+        net_close_socket(s);
+}
+
+int Net_WaitReadable(net_socket s, int timeout_ms)
+{
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(s, &set);
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    int ret = select((int)s + 1, &set, NULL, NULL, &tv);
+    if (ret < 0)
+        return -1;
+
+    return (ret > 0) ? 1 : 0;
+}
+
+int Net_SendAll(net_socket s, const void *data, size_t size)
+{
+    const char *ptr = data;
+
+    while (size > 0)
+    {
+        int ret = send(s, ptr, (net_len)size, 0);
+        if (ret <= 0)
+            return 0;
+
+        ptr += ret;
+        size -= ret;
+    }
+
+    return 1;
+}
+
+int Net_RecvAll(net_socket s, void *data, size_t size)
+{
+    char *ptr = data;
+
+    while (size > 0)
+    {
+        int ret = recv(s, ptr, (net_len)size, 0);
+        if (ret <= 0)
+            return 0;
+
+        ptr += ret;
+        size -= ret;
+    }
+
+    return 1;
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef NET_UTILS__
+#define NET_UTILS__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+typedef uintptr_t net_socket;
+#else
+typedef int net_socket;
+#endif
+
+#define NET_INVALID_SOCKET ((net_socket)-1)
+
+// IPv4 address and port used by UDP sockets
+typedef struct
+{
+    uint32_t ip; // Network byte order
+    uint16_t port; // Network byte order
+} net_address;
+
+// Must be called before using any other function. Returns 1 on success.
+int Net_Init(void);
+void Net_End(void);
+
+// Returns NET_INVALID_SOCKET on error. Connected sockets have Nagle's algorithm
+// disabled, as all the users of this code send small messages.
+net_socket Net_TCPConnect(const char *host, uint16_t port);
+net_socket Net_TCPListen(uint16_t port);
+// Waits up to timeout_ms for a connection. Returns NET_INVALID_SOCKET if there
+// are no connections.
+net_socket Net_TCPAccept(net_socket listener, int timeout_ms);
+
+// Opens a UDP socket bound to the port. If loopback is 1 it only receives
+// packets from the same host. If port is 0, any free port is used. Returns
+// NET_INVALID_SOCKET on error.
+net_socket Net_UDPOpen(uint16_t port, int loopback);
+// Returns the address the socket is bound to. Returns 1 on success.
+int Net_UDPGetAddress(net_socket s, net_address *addr);
+// Returns 1 on success
+int Net_UDPResolve(const char *host, uint16_t port, net_address *addr);
+int Net_UDPAddressEqual(const net_address *a, const net_address *b);
+// They don't block. Net_UDPSendTo() returns 1 on success. Net_UDPRecvFrom()
+// returns the size of the packet received, 0 if there are no packets and -1 on
+// error. Packets bigger than the buffer are truncated.
+int Net_UDPSendTo(net_socket s, const void *data, size_t size,
+                  const net_address *addr);
+int Net_UDPRecvFrom(net_socket s, void *data, size_t size, net_address *addr);
+
+void Net_Close(net_socket s);
+
+// Returns 1 if there is data to read, 0 on timeout and -1 on error
+int Net_WaitReadable(net_socket s, int timeout_ms);
+
+// They don't return until all the data has been transferred. They return 1 on
+// success and 0 if there has been an error or the connection has been closed.
+int Net_SendAll(net_socket s, const void *data, size_t size);
+int Net_RecvAll(net_socket s, void *data, size_t size);
+
+#endif // NET_UTILS__
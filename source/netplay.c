@@ -0,0 +1,708 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "debug_utils.h"
+#include "general_utils.h"
+#include "input_utils.h"
+#include "net_utils.h"
+#include "netplay.h"
+
+#include "gb_core/gb_main.h"
+#include "gb_core/sgb.h"
+#include "gb_core/sound.h"
+#include "gb_core/state.h"
+#include "gb_core/video.h"
+
+#include "gba_core/gba.h"
+#include "gba_core/sound.h"
+#include "gba_core/state.h"
+#include "gba_core/video.h"
+
+// Frames between reading the local input and using it. It gives the input time
+// to reach the other side, so that there are less rollbacks.
+#define NETPLAY_INPUT_DELAY     2
+
+// Time without packets from the other side before warning the user
+#define NETPLAY_TIMEOUT_MS      5000
+
+// Size of the buffers of inputs. It must be a power of 2 and much bigger than
+// NETPLAY_MAX_ROLLBACK + NETPLAY_INPUT_DELAY.
+#define NETPLAY_INPUT_RING      64
+#define NETPLAY_INPUT_MASK      (NETPLAY_INPUT_RING - 1)
+
+// States saved at the start of the frames that may be emulated again
+#define NETPLAY_NUM_STATES      (NETPLAY_MAX_ROLLBACK + 1)
+
+// Packets start with "GN", the type and the player that sends them.
+//
+// Hello: System of the ROM (1 byte).
+//
+// Input: Number of inputs of the other side received (4 bytes), first frame of
+// the inputs (4 bytes), number of inputs (1 byte), inputs (2 bytes each). All
+// values are little endian. The inputs that the other side hasn't received yet
+// are sent in every packet, so lost packets don't need to be sent again.
+#define NETPLAY_MSG_HELLO       'H'
+#define NETPLAY_MSG_INPUT       'I'
+#define NETPLAY_MSG_HEADER_SIZE 4
+#define NETPLAY_MSG_MAX_INPUTS  32
+#define NETPLAY_MSG_MAX_SIZE \
+    (NETPLAY_MSG_HEADER_SIZE + 9 + (NETPLAY_MSG_MAX_INPUTS * 2))
+
+#define NETPLAY_NONE            0
+#define NETPLAY_HOST            1
+#define NETPLAY_CLIENT          2
+#define NETPLAY_LOOPBACK        3
+
+#define NETPLAY_STATE_IDLE      0 // No ROM loaded
+#define NETPLAY_STATE_WAITING   1 // Waiting for the other side
+#define NETPLAY_STATE_RUNNING   2
+#define NETPLAY_STATE_ENDED     3 // Error, emulate without netplay
+
+static int netplay_mode = NETPLAY_NONE;
+static int netplay_state = NETPLAY_STATE_IDLE;
+static int netplay_player; // 0 for the host, 1 for the client
+static int netplay_system;
+
+static net_socket netplay_socket = NET_INVALID_SOCKET;
+static net_address netplay_peer;
+static int netplay_has_peer;
+static Uint32 netplay_last_packet_ticks;
+static int netplay_timeout_logged;
+
+// Frames are counted from the moment the ROM is loaded
+static u32 netplay_frame; // Next frame to be emulated
+static u32 netplay_local_count; // Number of local inputs read
+static u32 netplay_local_acked; // Number of local inputs received by the peer
+static u32 netplay_remote_count; // Number of remote inputs received
+
+static u16 netplay_local_input[NETPLAY_INPUT_RING];
+static u16 netplay_remote_input[NETPLAY_INPUT_RING];
+// Remote input used to emulate each frame, it may be a prediction
+static u16 netplay_remote_used[NETPLAY_INPUT_RING];
+
+static int netplay_rollback_pending;
+static u32 netplay_rollback_frame; // First frame with a wrong prediction
+
+static u8 *netplay_states = NULL;
+static size_t netplay_state_size;
+
+// Simulated peer of the loopback mode
+static int netplay_loop_latency;
+static u32 netplay_loop_ticks; // Number of calls to the frame function
+static u32 netplay_loop_count; // Number of inputs read for the peer
+static u16 netplay_loop_input[NETPLAY_INPUT_RING];
+static u32 netplay_loop_input_ticks[NETPLAY_INPUT_RING];
+
+static netplay_stats_t netplay_stats;
+
+//------------------------------------------------------------------------------
+
+static double netplay_get_ms(void)
+{
+    return (double)SDL_GetPerformanceCounter() * 1000.0
+           / (double)SDL_GetPerformanceFrequency();
+}
+
+static void netplay_write_u32(u8 *p, u32 value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+static u32 netplay_read_u32(const u8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static void netplay_header(u8 *msg, u8 type, int player)
+{
+    msg[0] = 'G';
+    msg[1] = 'N';
+    msg[2] = type;
+    msg[3] = (u8)player;
+}
+
+//------------------------------------------------------------------------------
+
+static void netplay_send_hello(void)
+{
+    if (!netplay_has_peer)
+        return;
+
+    u8 msg[NETPLAY_MSG_HEADER_SIZE + 1];
+    netplay_header(msg, NETPLAY_MSG_HELLO, netplay_player);
+    msg[4] = (u8)netplay_system;
+
+    Net_UDPSendTo(netplay_socket, msg, sizeof(msg), &netplay_peer);
+}
+
+static void netplay_send_inputs(int player, const u16 *ring, u32 first,
+                                u32 count, u32 acked)
+{
+    if (count > NETPLAY_MSG_MAX_INPUTS)
+        count = NETPLAY_MSG_MAX_INPUTS;
+
+    u8 msg[NETPLAY_MSG_MAX_SIZE];
+    netplay_header(msg, NETPLAY_MSG_INPUT, player);
+    netplay_write_u32(&msg[4], acked);
+    netplay_write_u32(&msg[8], first);
+    msg[12] = (u8)count;
+
+    u8 *p = &msg[13];
+    for (u32 i = 0; i < count; i++)
+    {
+        u16 input = ring[(first + i) & NETPLAY_INPUT_MASK];
+        *p++ = input & 0xFF;
+        *p++ = input >> 8;
+    }
+
+    Net_UDPSendTo(netplay_socket, msg, (size_t)(p - msg), &netplay_peer);
+}
+
+static void netplay_receive_inputs(const u8 *msg, int size)
+{
+    if (size < 13)
+        return;
+
+    u32 acked = netplay_read_u32(&msg[4]);
+    u32 first = netplay_read_u32(&msg[8]);
+    u32 count = msg[12];
+
+    if ((count > NETPLAY_MSG_MAX_INPUTS) || (size < (int)(13 + count * 2)))
+        return;
+
+    if ((acked > netplay_local_acked) && (acked <= netplay_local_count))
+        netplay_local_acked = acked;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 frame = first + i;
+
+        // Only accept the inputs in order. They are sent again until they are
+        // received, so nothing is lost.
+        if (frame != netplay_remote_count)
+            continue;
+
+        // The other side can't be that far ahead
+        if (frame >= netplay_frame + NETPLAY_INPUT_RING - NETPLAY_NUM_STATES)
+            break;
+
+        u16 input = msg[13 + i * 2] | (msg[14 + i * 2] << 8);
+        u32 index = frame & NETPLAY_INPUT_MASK;
+
+        netplay_remote_input[index] = input;
+        netplay_remote_count++;
+
+        if ((frame < netplay_frame) && (netplay_remote_used[index] != input))
+        {
+            if (!netplay_rollback_pending || (frame < netplay_rollback_frame))
+                netplay_rollback_frame = frame;
+            netplay_rollback_pending = 1;
+        }
+    }
+}
+
+static void netplay_receive(void)
+{
+    while (1)
+    {
+        u8 msg[NETPLAY_MSG_MAX_SIZE];
+        net_address from;
+
+        int size = Net_UDPRecvFrom(netplay_socket, msg, sizeof(msg), &from);
+        if (size <= 0)
+            break;
+
+        if ((size < NETPLAY_MSG_HEADER_SIZE) || (msg[0] != 'G')
+            || (msg[1] != 'N') || (msg[3] == netplay_player))
+        {
+            continue;
+        }
+
+        if (netplay_has_peer && !Net_UDPAddressEqual(&from, &netplay_peer))
+            continue;
+
+        if (msg[2] == NETPLAY_MSG_HELLO)
+        {
+            if ((size < NETPLAY_MSG_HEADER_SIZE + 1)
+                || (netplay_state == NETPLAY_STATE_IDLE))
+            {
+                continue;
+            }
+
+            if (msg[4] != netplay_system)
+            {
+                Debug_ErrorMsgArg("Netplay: The other side has loaded a ROM "
+                                  "of a different system");
+                continue;
+            }
+
+            if (!netplay_has_peer)
+            {
+                netplay_peer = from;
+                netplay_has_peer = 1;
+            }
+
+            // The host answers every time in case the answer is lost
+            if (netplay_mode == NETPLAY_HOST)
+                netplay_send_hello();
+
+            if (netplay_state == NETPLAY_STATE_WAITING)
+            {
+                Debug_LogMsgArg("Netplay: Connected");
+                netplay_state = NETPLAY_STATE_RUNNING;
+            }
+        }
+        else if (msg[2] == NETPLAY_MSG_INPUT)
+        {
+            if (!netplay_has_peer)
+                continue;
+
+            if (netplay_state == NETPLAY_STATE_WAITING)
+            {
+                Debug_LogMsgArg("Netplay: Connected");
+                netplay_state = NETPLAY_STATE_RUNNING;
+            }
+
+            if (netplay_state == NETPLAY_STATE_RUNNING)
+                netplay_receive_inputs(msg, size);
+        }
+        else
+        {
+            continue;
+        }
+
+        netplay_last_packet_ticks = SDL_GetTicks();
+        netplay_timeout_logged = 0;
+    }
+}
+
+// The simulated peer reads the input of player 2 as if it was emulating the
+// same frames, and its packets arrive after the configured latency.
+static void netplay_loopback_update(void)
+{
+    netplay_loop_ticks++;
+
+    // A real peer would have to wait for the local inputs as well
+    if (netplay_loop_count < netplay_local_count + NETPLAY_MAX_ROLLBACK - 1)
+    {
+        u32 index = netplay_loop_count & NETPLAY_INPUT_MASK;
+        netplay_loop_input[index] = Input_SnapshotGetKeys(1);
+        netplay_loop_input_ticks[index] = netplay_loop_ticks;
+        netplay_loop_count++;
+    }
+
+    u32 count = 0;
+    while (netplay_remote_count + count < netplay_loop_count)
+    {
+        u32 index = (netplay_remote_count + count) & NETPLAY_INPUT_MASK;
+        if (netplay_loop_input_ticks[index] + netplay_loop_latency
+            > netplay_loop_ticks)
+        {
+            break;
+        }
+        count++;
+    }
+
+    // The peer receives the local inputs right away
+    netplay_local_acked = netplay_local_count;
+
+    if (count > 0)
+    {
+        netplay_send_inputs(1, netplay_loop_input, netplay_remote_count,
+                            count, netplay_local_count);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static int netplay_open(int mode, uint16_t port, int loopback)
+{
+    if (netplay_mode != NETPLAY_NONE)
+    {
+        Debug_ErrorMsgArg("Netplay: Already started");
+        return 0;
+    }
+
+    if (!Net_Init())
+        return 0;
+
+    netplay_socket = Net_UDPOpen(port, loopback);
+    if (netplay_socket == NET_INVALID_SOCKET)
+    {
+        Debug_ErrorMsgArg("Netplay: Can't open port %u", (unsigned int)port);
+        return 0;
+    }
+
+    netplay_mode = mode;
+    netplay_player = (mode == NETPLAY_CLIENT) ? 1 : 0;
+    netplay_state = NETPLAY_STATE_IDLE;
+    netplay_has_peer = 0;
+
+    return 1;
+}
+
+int Netplay_Host(uint16_t port)
+{
+    if (!netplay_open(NETPLAY_HOST, port, 0))
+        return 0;
+
+    Debug_LogMsgArg("Netplay: Waiting for connections in port %u",
+                    (unsigned int)port);
+
+    return 1;
+}
+
+int Netplay_Connect(const char *address)
+{
+    char host[256];
+    s_strncpy(host, address, sizeof(host));
+
+    uint16_t port = NETPLAY_DEFAULT_PORT;
+
+    char *colon = strrchr(host, ':');
+    if (colon != NULL)
+    {
+        *colon = '\0';
+        port = (uint16_t)atoi(colon + 1);
+    }
+
+    if (!netplay_open(NETPLAY_CLIENT, 0, 0))
+        return 0;
+
+    if (!Net_UDPResolve(host, port, &netplay_peer))
+    {
+        Debug_ErrorMsgArg("Netplay: Can't resolve %s", host);
+        Netplay_End();
+        return 0;
+    }
+
+    netplay_has_peer = 1;
+
+    return 1;
+}
+
+int Netplay_Loopback(int latency)
+{
+    if (!netplay_open(NETPLAY_LOOPBACK, 0, 1))
+        return 0;
+
+    // Packets are sent to the same socket. It's bound to the loopback
+    // interface, so this is 127.0.0.1.
+    if (!Net_UDPGetAddress(netplay_socket, &netplay_peer))
+    {
+        Netplay_End();
+        return 0;
+    }
+
+    netplay_has_peer = 1;
+
+    if (latency < 0)
+        latency = 0;
+    netplay_loop_latency = latency;
+
+    return 1;
+}
+
+void Netplay_End(void)
+{
+    if (netplay_mode == NETPLAY_NONE)
+        return;
+
+    Netplay_ROMUnloaded();
+
+    Net_Close(netplay_socket);
+    netplay_socket = NET_INVALID_SOCKET;
+
+    netplay_mode = NETPLAY_NONE;
+}
+
+int Netplay_IsEnabled(void)
+{
+    if (netplay_mode == NETPLAY_NONE)
+        return 0;
+
+    return (netplay_state == NETPLAY_STATE_WAITING)
+           || (netplay_state == NETPLAY_STATE_RUNNING);
+}
+
+void Netplay_ROMLoaded(int system)
+{
+    if (netplay_mode == NETPLAY_NONE)
+        return;
+
+    netplay_system = system;
+
+    if (system == NETPLAY_SYSTEM_GBA)
+        netplay_state_size = GBA_StateSize();
+    else
+        netplay_state_size = GB_StateSize();
+
+    free(netplay_states);
+    netplay_states = malloc(netplay_state_size * NETPLAY_NUM_STATES);
+    if (netplay_states == NULL)
+    {
+        Debug_ErrorMsgArg("Netplay: Not enough memory");
+        netplay_state = NETPLAY_STATE_ENDED;
+        return;
+    }
+
+    netplay_frame = 0;
+    netplay_local_acked = 0;
+    netplay_remote_count = 0;
+    netplay_rollback_pending = 0;
+
+    // The first frames are emulated before any input is read
+    netplay_local_count = NETPLAY_INPUT_DELAY;
+    memset(netplay_local_input, 0, sizeof(netplay_local_input));
+
+    netplay_loop_ticks = 0;
+    netplay_loop_count = 0;
+
+    memset(&netplay_stats, 0, sizeof(netplay_stats));
+
+    netplay_last_packet_ticks = SDL_GetTicks();
+    netplay_timeout_logged = 0;
+
+    if (netplay_mode == NETPLAY_LOOPBACK)
+        netplay_state = NETPLAY_STATE_RUNNING;
+    else
+        netplay_state = NETPLAY_STATE_WAITING;
+}
+
+void Netplay_ROMUnloaded(void)
+{
+    if (netplay_state == NETPLAY_STATE_IDLE)
+        return;
+
+    if (netplay_stats.rollbacks > 0)
+    {
+        Debug_LogMsgArg("Netplay: %u frames, %u rollbacks, %u frames emulated "
+                        "again (%u max), %.3f ms per rollback (%.3f max)",
+                        netplay_stats.frames, netplay_stats.rollbacks,
+                        netplay_stats.resim_frames,
+                        netplay_stats.resim_frames_max,
+                        netplay_stats.resim_ms / netplay_stats.rollbacks,
+                        netplay_stats.resim_ms_max);
+    }
+
+    free(netplay_states);
+    netplay_states = NULL;
+
+    netplay_state = NETPLAY_STATE_IDLE;
+
+    // The host waits for a new connection with the next ROM
+    if (netplay_mode == NETPLAY_HOST)
+        netplay_has_peer = 0;
+}
+
+//------------------------------------------------------------------------------
+
+static u8 *netplay_state_get(u32 frame)
+{
+    return netplay_states + (frame % NETPLAY_NUM_STATES) * netplay_state_size;
+}
+
+static void netplay_state_save(u32 frame)
+{
+    if (netplay_system == NETPLAY_SYSTEM_GBA)
+        GBA_StateSave(netplay_state_get(frame));
+    else
+        GB_StateSave(netplay_state_get(frame));
+}
+
+static void netplay_state_load(u32 frame)
+{
+    if (netplay_system == NETPLAY_SYSTEM_GBA)
+        GBA_StateLoad(netplay_state_get(frame));
+    else
+        GB_StateLoad(netplay_state_get(frame));
+}
+
+static void netplay_sound_reset(void)
+{
+    if (netplay_system == NETPLAY_SYSTEM_GBA)
+        GBA_SoundResetBufferPointers();
+    else
+        GB_SoundResetBufferPointers();
+}
+
+static void netplay_run_frame(u32 frame, int skip)
+{
+    u32 index = frame & NETPLAY_INPUT_MASK;
+
+    // Predict that the remote input hasn't changed since the last one received
+    u16 remote = 0;
+    if (frame < netplay_remote_count)
+        remote = netplay_remote_input[index];
+    else if (netplay_remote_count > 0)
+        remote = netplay_remote_input[(netplay_remote_count - 1)
+                                      & NETPLAY_INPUT_MASK];
+
+    netplay_remote_used[index] = remote;
+
+    int local = netplay_local_input[index];
+    int host = (netplay_player == 0) ? local : remote;
+    int client = (netplay_player == 0) ? remote : local;
+
+    if (netplay_system == NETPLAY_SYSTEM_GBA)
+    {
+        Input_ApplyKeys_GBA(host | client);
+
+        GBA_SkipFrame(skip);
+        GBA_RunForOneFrame();
+    }
+    else
+    {
+        if (SGB_MultiplayerIsEnabled())
+        {
+            Input_ApplyKeys_GB(0, host);
+            Input_ApplyKeys_GB(1, client);
+        }
+        else
+        {
+            Input_ApplyKeys_GB(0, host | client);
+        }
+
+        GB_SkipFrame(skip);
+        GB_RunForOneFrame();
+    }
+}
+
+// Load the state of the first frame with a wrong prediction and emulate the
+// frames until the current one again with the right input.
+static void netplay_rollback(int skip)
+{
+    double start = netplay_get_ms();
+
+    u32 first = netplay_rollback_frame;
+
+    netplay_state_load(first);
+
+    // The sound of these frames has already been played
+    netplay_sound_reset();
+
+    for (u32 frame = first; frame < netplay_frame; frame++)
+    {
+        if (frame != first)
+            netplay_state_save(frame);
+
+        // The GBA displays the screen drawn in the previous frame, so the last
+        // one needs to be drawn. Nothing else needs to be drawn.
+        int draw = (netplay_system == NETPLAY_SYSTEM_GBA)
+                   && (frame == netplay_frame - 1) && !skip;
+
+        netplay_run_frame(frame, !draw);
+    }
+
+    netplay_sound_reset();
+
+    netplay_rollback_pending = 0;
+
+    u32 frames = netplay_frame - first;
+    double ms = netplay_get_ms() - start;
+
+    netplay_stats.rollbacks++;
+    netplay_stats.resim_frames += frames;
+    if (frames > netplay_stats.resim_frames_max)
+        netplay_stats.resim_frames_max = frames;
+    netplay_stats.resim_ms += ms;
+    if (ms > netplay_stats.resim_ms_max)
+        netplay_stats.resim_ms_max = ms;
+}
+
+int Netplay_FrameReady(void)
+{
+    if (netplay_mode == NETPLAY_CLIENT)
+    {
+        if (netplay_state == NETPLAY_STATE_WAITING)
+            netplay_send_hello();
+    }
+
+    if (netplay_mode == NETPLAY_LOOPBACK)
+        netplay_loopback_update();
+
+    netplay_receive();
+
+    if (netplay_state == NETPLAY_STATE_WAITING)
+        return 0;
+
+    // The other side may be paused, so keep waiting for it
+    if (!netplay_timeout_logged
+        && (SDL_GetTicks() - netplay_last_packet_ticks > NETPLAY_TIMEOUT_MS))
+    {
+        Debug_LogMsgArg("Netplay: No answer from the other side");
+        netplay_timeout_logged = 1;
+    }
+
+    // Read the local input of a future frame
+    if (netplay_local_count <= netplay_frame + NETPLAY_INPUT_DELAY)
+    {
+        int keys = Input_SnapshotGetKeys(0) & ((1 << P_NUM_KEYS) - 1);
+        netplay_local_input[netplay_local_count & NETPLAY_INPUT_MASK] = keys;
+        netplay_local_count++;
+    }
+
+    if (netplay_mode != NETPLAY_LOOPBACK)
+    {
+        netplay_send_inputs(netplay_player, netplay_local_input,
+                            netplay_local_acked,
+                            netplay_local_count - netplay_local_acked,
+                            netplay_remote_count);
+    }
+
+    // Wait if there wouldn't be a state to go back to if the prediction fails
+    // The remote input can be ahead of the local one.
+    if (netplay_frame >= netplay_remote_count + NETPLAY_MAX_ROLLBACK)
+    {
+        netplay_stats.stalls++;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int netplay_frame_handle(int skip)
+{
+    if (netplay_state != NETPLAY_STATE_RUNNING)
+        return 0;
+
+    if (netplay_frame >= netplay_remote_count + NETPLAY_MAX_ROLLBACK)
+        return 0;
+
+    if (netplay_rollback_pending)
+        netplay_rollback(skip);
+
+    netplay_state_save(netplay_frame);
+    netplay_run_frame(netplay_frame, skip);
+    netplay_frame++;
+
+    netplay_stats.frames++;
+
+    return 1;
+}
+
+int Netplay_FrameGBA(int skip)
+{
+    return netplay_frame_handle(skip);
+}
+
+int Netplay_FrameGB(int skip)
+{
+    return netplay_frame_handle(skip);
+}
+
+void Netplay_GetStats(netplay_stats_t *stats)
+{
+    *stats = netplay_stats;
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef NETPLAY__
+#define NETPLAY__
+
+#include <stdint.h>
+
+// Rollback netplay over UDP. Both instances of the emulator load the same ROM
+// and emulate the same machine starting from the first frame. Each instance
+// only sends the keys of its first player. The input of the other side is
+// predicted to be the last one received. When it arrives and it is different,
+// the state of the frame is loaded and the frames since then are emulated
+// again. Both players control the same joypad, except in SGB games with
+// multiplayer enabled, where the host is player 1 and the client is player 2.
+
+#define NETPLAY_DEFAULT_PORT    5739
+
+// Maximum number of frames that can be emulated again after a misprediction.
+// The emulation stops if the input of the other side is older than this.
+#define NETPLAY_MAX_ROLLBACK    8
+
+#define NETPLAY_SYSTEM_GB       1
+#define NETPLAY_SYSTEM_GBA      2
+
+// They must be called before loading a ROM. They return 1 on success.
+// Waits for a connection in the specified port.
+int Netplay_Host(uint16_t port);
+// Connects to "host" or "host:port".
+int Netplay_Connect(const char *address);
+// Test mode without another instance. The second player is simulated with the
+// controls of player 2, and its input is sent through a UDP socket in the
+// loopback interface with the specified latency in frames.
+int Netplay_Loopback(int latency);
+
+void Netplay_End(void);
+
+// Returns 1 if the frames have to be emulated with Netplay_Frame*()
+int Netplay_IsEnabled(void);
+
+// Called by the main window
+void Netplay_ROMLoaded(int system);
+void Netplay_ROMUnloaded(void);
+
+// Exchanges input with the other side. It returns 0 if the next frame can't be
+// emulated yet because the emulator is waiting for the other side. It must be
+// called once before every call to Netplay_Frame*(), so that nothing else is
+// done for a frame that isn't going to be emulated.
+int Netplay_FrameReady(void);
+
+// Emulate one frame instead of GBA_RunForOneFrame() and GB_RunForOneFrame().
+// They return 0 if no frame has been emulated because the emulator is waiting
+// for the other side. If skip is 1 the frame isn't drawn.
+int Netplay_FrameGBA(int skip);
+int Netplay_FrameGB(int skip);
+
+typedef struct
+{
+    uint32_t frames; // Frames emulated, not counting the ones emulated again
+    uint32_t stalls; // Frames not emulated waiting for the other side
+    uint32_t rollbacks;
+    uint32_t resim_frames; // Total number of frames emulated again
+    uint32_t resim_frames_max; // Maximum in a single rollback
+    double resim_ms; // Total time spent in rollbacks
+    double resim_ms_max; // Maximum time of a single rollback
+} netplay_stats_t;
+
+void Netplay_GetStats(netplay_stats_t *stats);
+
+#endif // NETPLAY__
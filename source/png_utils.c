@@ -4,6 +4,7 @@
 //
 // GiiBiiAdvance - GBA/GB emulator
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -46,6 +47,71 @@ int Save_PNG(const char *filename, unsigned char *buffer,
     return 0;
 }
 
+// Save a RGBA buffer into a PNG file with a specific compression level. The
+// simplified API of libpng doesn't allow changing it.
+int Save_PNG_Level(const char *filename, unsigned char *buffer,
+                   int width, int height, int is_rgba, int level)
+{
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL)
+    {
+        Debug_LogMsgArg("%s(): Can't open %s", __func__, filename);
+        return 1;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                              NULL, NULL, NULL);
+    png_infop info = NULL;
+    if (png)
+        info = png_create_info_struct(png);
+
+    if (info == NULL)
+    {
+        png_destroy_write_struct(&png, NULL);
+        fclose(f);
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return 1;
+    }
+
+    if (setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_write_struct(&png, &info);
+        fclose(f);
+        Debug_LogMsgArg("%s(): Error while writing %s", __func__, filename);
+        return 1;
+    }
+
+    png_init_io(png, f);
+
+    png_set_compression_level(png, level);
+
+    // Filters don't help much when the data isn't compressed
+    if (level == 0)
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+
+    png_set_IHDR(png, info, width, height, 8,
+                 is_rgba ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    int row_stride = is_rgba ? (width * 4) : (width * 3);
+
+    for (int y = 0; y < height; y++)
+        png_write_row(png, &buffer[y * row_stride]);
+
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+
+    if (fclose(f) != 0)
+    {
+        Debug_LogMsgArg("%s(): Error while closing %s", __func__, filename);
+        return 1;
+    }
+
+    return 0;
+}
+
 // Load a PNG file into a RGBA buffer
 int Read_PNG(const char *filename, unsigned char **_buffer,
              int *_width, int *_height)
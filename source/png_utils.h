@@ -11,6 +11,11 @@
 int Save_PNG(const char *filename, unsigned char *buffer,
              int width, int height, int is_rgba);
 
+// Like Save_PNG(), but with the specified zlib compression level (0-9). Low
+// levels are faster to encode and create bigger files.
+int Save_PNG_Level(const char *filename, unsigned char *buffer,
+                   int width, int height, int is_rgba, int level);
+
 // Buffer is 32 bit (RGBA), returns 0 on success
 int Read_PNG(const char *filename, unsigned char **_buffer,
              int *_width, int *_height);
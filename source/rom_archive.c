@@ -0,0 +1,611 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+#include <zlib.h>
+
+#include "debug_utils.h"
+#include "file_utils.h"
+#include "general_utils.h"
+#include "rom_archive.h"
+
+// Size of the chunks of compressed data read from the file
+#define ROM_ARCHIVE_CHUNK_SIZE (64 * 1024)
+
+// No ROM is this big. It protects against corrupted archives that report huge
+// sizes when the buffer is allocated by RomArchive_Load().
+#define ROM_ARCHIVE_MAX_SIZE (64 * 1024 * 1024)
+
+// The end of central directory record is at the end of the file, followed by a
+// comment of up to 64 KB.
+#define ZIP_EOCD_SIZE           22
+#define ZIP_EOCD_SEARCH_SIZE    (ZIP_EOCD_SIZE + 0xFFFF)
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_LOCAL_HEADER_SIZE   30
+
+#define ZIP_METHOD_STORED   0
+#define ZIP_METHOD_DEFLATED 8
+
+#define GZIP_FLAG_FHCRC    (1 << 1)
+#define GZIP_FLAG_FEXTRA   (1 << 2)
+#define GZIP_FLAG_FNAME    (1 << 3)
+#define GZIP_FLAG_FCOMMENT (1 << 4)
+
+typedef struct
+{
+    FILE *f;
+    int type;
+    int deflated; // 0 if the data is stored without compression
+    long data_offset;
+    size_t data_size; // Size of the data in the file
+    size_t size; // Size of the uncompressed ROM
+    u32 crc;
+} rom_archive_entry;
+
+static u32 _rom_archive_read16(const u8 *ptr)
+{
+    return ptr[0] | (ptr[1] << 8);
+}
+
+static u32 _rom_archive_read32(const u8 *ptr)
+{
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+static int _rom_archive_extension_is(const char *path, const char *extension)
+{
+    size_t len = strlen(path);
+    size_t ext_len = strlen(extension);
+
+    if (len <= ext_len)
+        return 0;
+
+    const char *ext = &path[len - ext_len];
+
+    if (ext[-1] != '.')
+        return 0;
+
+    for (size_t i = 0; i < ext_len; i++)
+    {
+        if (toupper((unsigned char)ext[i]) != extension[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+int RomArchive_GetType(const char *path)
+{
+    if (_rom_archive_extension_is(path, "GZ"))
+        return ROM_ARCHIVE_GZIP;
+    if (_rom_archive_extension_is(path, "ZIP"))
+        return ROM_ARCHIVE_ZIP;
+
+    return ROM_ARCHIVE_NONE;
+}
+
+void RomArchive_GetBasePath(const char *path, char *dest, size_t dest_size)
+{
+    s_strncpy(dest, path, dest_size);
+
+    if (RomArchive_GetType(dest) == ROM_ARCHIVE_GZIP)
+        dest[strlen(dest) - 3] = '\0';
+}
+
+//------------------------------------------------------------------------------
+
+static int _rom_archive_file_size(FILE *f, size_t *size)
+{
+    if (fseek(f, 0, SEEK_END) != 0)
+        return 0;
+
+    long end = ftell(f);
+    if (end < 0)
+        return 0;
+
+    *size = end;
+    return 1;
+}
+
+static int _rom_archive_open_none(rom_archive_entry *e, char *name,
+                                  size_t name_size, const char *path)
+{
+    if (_rom_archive_file_size(e->f, &e->size) == 0)
+        return 0;
+
+    if (name)
+        s_strncpy(name, path, name_size);
+
+    e->deflated = 0;
+    e->data_offset = 0;
+    e->data_size = e->size;
+
+    return 1;
+}
+
+static int _rom_archive_open_gzip(rom_archive_entry *e, char *name,
+                                  size_t name_size, const char *path)
+{
+    u8 header[10];
+
+    if (fread(header, sizeof(header), 1, e->f) != 1)
+        return 0;
+
+    if ((header[0] != 0x1F) || (header[1] != 0x8B) || (header[2] != 8))
+    {
+        Debug_LogMsgArg("%s(): %s isn't a valid gzip file", __func__, path);
+        return 0;
+    }
+
+    int flags = header[3];
+
+    // If there is no name in the header, use the name of the archive without
+    // the ".gz" extension.
+    if (name)
+    {
+        s_strncpy(name, path, name_size);
+        size_t len = strlen(name);
+        if (len >= 3)
+            name[len - 3] = '\0';
+    }
+
+    if (flags & GZIP_FLAG_FEXTRA)
+    {
+        u8 len[2];
+        if (fread(len, sizeof(len), 1, e->f) != 1)
+            return 0;
+        if (fseek(e->f, _rom_archive_read16(len), SEEK_CUR) != 0)
+            return 0;
+    }
+
+    if (flags & GZIP_FLAG_FNAME)
+    {
+        size_t len = 0;
+        int c;
+
+        while ((c = fgetc(e->f)) > 0)
+        {
+            if (name && (len + 1 < name_size))
+            {
+                name[len++] = c;
+                name[len] = '\0';
+            }
+        }
+
+        if (c == EOF)
+            return 0;
+    }
+
+    if (flags & GZIP_FLAG_FCOMMENT)
+    {
+        int c;
+        while ((c = fgetc(e->f)) > 0)
+            ;
+        if (c == EOF)
+            return 0;
+    }
+
+    if (flags & GZIP_FLAG_FHCRC)
+    {
+        if (fseek(e->f, 2, SEEK_CUR) != 0)
+            return 0;
+    }
+
+    e->data_offset = ftell(e->f);
+
+    // The trailer has the CRC32 and the size of the uncompressed data
+
+    size_t file_size;
+    if (_rom_archive_file_size(e->f, &file_size) == 0)
+        return 0;
+
+    if (file_size < (size_t)e->data_offset + 8)
+        return 0;
+
+    u8 trailer[8];
+    if (fseek(e->f, file_size - 8, SEEK_SET) != 0)
+        return 0;
+    if (fread(trailer, sizeof(trailer), 1, e->f) != 1)
+        return 0;
+
+    e->deflated = 1;
+    e->data_size = file_size - 8 - e->data_offset;
+    e->crc = _rom_archive_read32(&trailer[0]);
+    e->size = _rom_archive_read32(&trailer[4]);
+
+    return 1;
+}
+
+static int _rom_archive_open_zip(rom_archive_entry *e, char *name,
+                                 size_t name_size, const char *path)
+{
+    size_t file_size;
+    if (_rom_archive_file_size(e->f, &file_size) == 0)
+        return 0;
+
+    if (file_size < ZIP_EOCD_SIZE)
+        return 0;
+
+    // Look for the end of central directory record
+
+    size_t search_size = (file_size < ZIP_EOCD_SEARCH_SIZE) ?
+                         file_size : ZIP_EOCD_SEARCH_SIZE;
+
+    u8 *buffer = malloc(search_size);
+    if (buffer == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    if ((fseek(e->f, file_size - search_size, SEEK_SET) != 0) ||
+        (fread(buffer, search_size, 1, e->f) != 1))
+    {
+        free(buffer);
+        return 0;
+    }
+
+    const u8 *eocd = NULL;
+    for (size_t i = search_size - ZIP_EOCD_SIZE + 1; i > 0; i--)
+    {
+        if (_rom_archive_read32(&buffer[i - 1]) == 0x06054B50)
+        {
+            eocd = &buffer[i - 1];
+            break;
+        }
+    }
+
+    if (eocd == NULL)
+    {
+        Debug_LogMsgArg("%s(): %s isn't a valid zip file", __func__, path);
+        free(buffer);
+        return 0;
+    }
+
+    u32 entries = _rom_archive_read16(&eocd[10]);
+    long central_offset = _rom_archive_read32(&eocd[16]);
+
+    free(buffer);
+
+    if (entries != 1)
+    {
+        Debug_LogMsgArg("%s(): %s has %u files, only one is supported",
+                        __func__, path, entries);
+        return 0;
+    }
+
+    // Sizes and CRC are read from the central directory because they aren't
+    // always present in the local header.
+
+    u8 header[ZIP_CENTRAL_HEADER_SIZE];
+
+    if ((fseek(e->f, central_offset, SEEK_SET) != 0) ||
+        (fread(header, ZIP_CENTRAL_HEADER_SIZE, 1, e->f) != 1))
+        return 0;
+
+    if (_rom_archive_read32(&header[0]) != 0x02014B50)
+        return 0;
+
+    u32 flags = _rom_archive_read16(&header[8]);
+    u32 method = _rom_archive_read16(&header[10]);
+    u32 name_len = _rom_archive_read16(&header[28]);
+    long local_offset = _rom_archive_read32(&header[42]);
+
+    e->crc = _rom_archive_read32(&header[16]);
+    e->data_size = _rom_archive_read32(&header[20]);
+    e->size = _rom_archive_read32(&header[24]);
+
+    if (flags & 1)
+    {
+        Debug_LogMsgArg("%s(): %s is encrypted", __func__, path);
+        return 0;
+    }
+
+    if ((e->data_size == 0xFFFFFFFF) || (e->size == 0xFFFFFFFF))
+    {
+        Debug_LogMsgArg("%s(): %s: Zip64 isn't supported", __func__, path);
+        return 0;
+    }
+
+    if (method == ZIP_METHOD_STORED)
+    {
+        e->deflated = 0;
+    }
+    else if (method == ZIP_METHOD_DEFLATED)
+    {
+        e->deflated = 1;
+    }
+    else
+    {
+        Debug_LogMsgArg("%s(): %s: Unsupported compression method %u",
+                        __func__, path, method);
+        return 0;
+    }
+
+    if (name)
+    {
+        size_t len = (name_len < name_size) ? name_len : (name_size - 1);
+        if (fread(name, 1, len, e->f) != len)
+            return 0;
+        name[len] = '\0';
+    }
+
+    // The data starts after the local header, which can have an extra field
+    // with a different size than the one in the central directory.
+
+    if ((fseek(e->f, local_offset, SEEK_SET) != 0) ||
+        (fread(header, ZIP_LOCAL_HEADER_SIZE, 1, e->f) != 1))
+        return 0;
+
+    if (_rom_archive_read32(&header[0]) != 0x04034B50)
+        return 0;
+
+    e->data_offset = local_offset + ZIP_LOCAL_HEADER_SIZE
+                   + _rom_archive_read16(&header[26])
+                   + _rom_archive_read16(&header[28]);
+
+    if ((size_t)e->data_offset + e->data_size > file_size)
+        return 0;
+
+    return 1;
+}
+
+// Returns 1 on success. The file of the entry must be closed by the caller.
+static int _rom_archive_open(rom_archive_entry *e, char *name,
+                             size_t name_size, const char *path)
+{
+    memset(e, 0, sizeof(rom_archive_entry));
+
+    e->f = fopen(path, "rb");
+    if (e->f == NULL)
+        return 0;
+
+    e->type = RomArchive_GetType(path);
+
+    int ret;
+
+    if (e->type == ROM_ARCHIVE_GZIP)
+        ret = _rom_archive_open_gzip(e, name, name_size, path);
+    else if (e->type == ROM_ARCHIVE_ZIP)
+        ret = _rom_archive_open_zip(e, name, name_size, path);
+    else
+        ret = _rom_archive_open_none(e, name, name_size, path);
+
+    if (ret == 0)
+    {
+        fclose(e->f);
+        e->f = NULL;
+    }
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+
+static int _rom_archive_read_stored(rom_archive_entry *e, u8 *buffer,
+                                    size_t max_size)
+{
+    size_t size = (e->size < max_size) ? e->size : max_size;
+
+    if (size == 0)
+        return 1;
+
+    if (fread(buffer, size, 1, e->f) != 1)
+        return 0;
+
+    // The CRC is only checked in archives, and only if the whole ROM is read
+    if ((e->type != ROM_ARCHIVE_NONE) && (size == e->size))
+    {
+        if (crc32(0, buffer, size) != e->crc)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int _rom_archive_read_deflated(rom_archive_entry *e, u8 *buffer,
+                                      size_t max_size)
+{
+    u8 *chunk = malloc(ROM_ARCHIVE_CHUNK_SIZE);
+    if (chunk == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return 0;
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    // Negative window bits: Raw deflate data, headers are handled by the caller
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    {
+        free(chunk);
+        return 0;
+    }
+
+    size_t out_size = (e->size < max_size) ? e->size : max_size;
+    size_t remaining = e->data_size;
+    u32 crc = crc32(0, NULL, 0);
+    int ok = 0;
+
+    stream.next_out = buffer;
+    stream.avail_out = out_size;
+
+    while (1)
+    {
+        if ((stream.avail_in == 0) && (remaining > 0))
+        {
+            size_t size = (remaining < ROM_ARCHIVE_CHUNK_SIZE) ?
+                          remaining : ROM_ARCHIVE_CHUNK_SIZE;
+            if (fread(chunk, size, 1, e->f) != 1)
+                break;
+
+            remaining -= size;
+            stream.next_in = chunk;
+            stream.avail_in = size;
+        }
+
+        u8 *start = stream.next_out;
+
+        int ret = inflate(&stream, Z_NO_FLUSH);
+
+        // Calculate the CRC while the data is still in the cache
+        crc = crc32(crc, start, stream.next_out - start);
+
+        if (ret == Z_STREAM_END)
+        {
+            ok = (stream.total_out == e->size) && (crc == e->crc);
+            break;
+        }
+
+        if ((ret != Z_OK) && (ret != Z_BUF_ERROR))
+            break;
+
+        // The buffer is full, the rest of the ROM is ignored
+        if (stream.avail_out == 0)
+        {
+            ok = 1;
+            break;
+        }
+
+        // Truncated file
+        if ((stream.avail_in == 0) && (remaining == 0))
+            break;
+    }
+
+    inflateEnd(&stream);
+    free(chunk);
+
+    return ok;
+}
+
+int RomArchive_GetInfo(const char *path, char *name, size_t name_size,
+                       size_t *size)
+{
+    rom_archive_entry e;
+
+    if (_rom_archive_open(&e, name, name_size, path) == 0)
+        return 0;
+
+    fclose(e.f);
+
+    *size = e.size;
+    return 1;
+}
+
+int RomArchive_GetCRC32(const char *path, uint32_t *crc)
+{
+    rom_archive_entry e;
+
+    if (RomArchive_GetType(path) == ROM_ARCHIVE_NONE)
+        return 0;
+
+    if (_rom_archive_open(&e, NULL, 0, path) == 0)
+        return 0;
+
+    fclose(e.f);
+
+    *crc = e.crc;
+    return 1;
+}
+
+int RomArchive_Read(const char *path, void *buffer, size_t max_size,
+                    size_t *size)
+{
+    rom_archive_entry e;
+
+    *size = 0;
+
+    if (_rom_archive_open(&e, NULL, 0, path) == 0)
+        return 0;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    int ret = 0;
+
+    if (fseek(e.f, e.data_offset, SEEK_SET) == 0)
+    {
+        if (e.deflated)
+            ret = _rom_archive_read_deflated(&e, buffer, max_size);
+        else
+            ret = _rom_archive_read_stored(&e, buffer, max_size);
+    }
+
+    Uint64 ticks = SDL_GetPerformanceCounter() - start;
+
+    fclose(e.f);
+
+    if (ret == 0)
+    {
+        Debug_LogMsgArg("%s(): Couldn't read %s", __func__, path);
+        return 0;
+    }
+
+    // Only report the speed of complete reads, not of headers
+    if ((e.type != ROM_ARCHIVE_NONE) && (e.size <= max_size) && (ticks > 0))
+    {
+        double seconds = (double)ticks / SDL_GetPerformanceFrequency();
+        Debug_LogMsgArg("%s: %zu bytes decompressed in %.1f ms (%.1f MB/s)",
+                        path, e.size, seconds * 1000.0,
+                        (e.size / (1024.0 * 1024.0)) / seconds);
+    }
+
+    *size = e.size;
+    return 1;
+}
+
+void RomArchive_Load(const char *path, void **buffer, size_t *size)
+{
+    *buffer = NULL;
+    *size = 0;
+
+    if (RomArchive_GetType(path) == ROM_ARCHIVE_NONE)
+    {
+        FileLoad(path, buffer, size);
+        return;
+    }
+
+    size_t rom_size;
+    if (RomArchive_GetInfo(path, NULL, 0, &rom_size) == 0)
+    {
+        Debug_ErrorMsgArg("%s isn't a valid archive!", path);
+        return;
+    }
+
+    if (rom_size == 0)
+    {
+        Debug_ErrorMsgArg("Size of %s is 0!", path);
+        return;
+    }
+
+    if (rom_size > ROM_ARCHIVE_MAX_SIZE)
+    {
+        Debug_ErrorMsgArg("Size of %s is too big!", path);
+        return;
+    }
+
+    void *rom = malloc(rom_size);
+    if (rom == NULL)
+    {
+        Debug_ErrorMsgArg("Not enought memory to load %s!", path);
+        return;
+    }
+
+    if (RomArchive_Read(path, rom, rom_size, size) == 0)
+    {
+        Debug_ErrorMsgArg("Error while decompressing: %s", path);
+        free(rom);
+        *size = 0;
+        return;
+    }
+
+    *buffer = rom;
+}
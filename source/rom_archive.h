@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef ROM_ARCHIVE__
+#define ROM_ARCHIVE__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Loading of ROMs that may be compressed as ".gz" files or as ".zip" files
+// with only one file inside. The data is decompressed in small chunks straight
+// into the destination buffer, the compressed file is never loaded as a whole.
+// Uncompressed files are read directly into the destination buffer as well.
+
+#define ROM_ARCHIVE_NONE 0 // Uncompressed file
+#define ROM_ARCHIVE_GZIP 1
+#define ROM_ARCHIVE_ZIP  2
+
+// Returns the ROM_ARCHIVE_* type of a file according to its extension
+int RomArchive_GetType(const char *path);
+
+// Copies the path to "dest" without the extension of gzip files, so that the
+// files derived from "game.gba.gz" (like saves) use the same name as the ones
+// of "game.gba". Other paths are copied unmodified.
+void RomArchive_GetBasePath(const char *path, char *dest, size_t dest_size);
+
+// Fills "name" with the name of the ROM inside of the archive (the path itself
+// for uncompressed files) and "size" with the size of the uncompressed ROM.
+// Returns 1 on success.
+int RomArchive_GetInfo(const char *path, char *name, size_t name_size,
+                       size_t *size);
+
+// Sets "crc" to the CRC32 of the uncompressed ROM stored in the archive, so the
+// ROM doesn't need to be decompressed to get it. Returns 1 on success, and 0 on
+// error or if the file isn't compressed.
+int RomArchive_GetCRC32(const char *path, uint32_t *crc);
+
+// Reads up to "max_size" bytes of the ROM into "buffer". "size" is set to the
+// full size of the uncompressed ROM, which may be bigger than "max_size". In
+// that case, the ROM is truncated. Returns 1 on success. Errors are only
+// written to the log, no message box is shown, so it can be used from any
+// thread.
+int RomArchive_Read(const char *path, void *buffer, size_t max_size,
+                    size_t *size);
+
+// Like FileLoad(), but the file may be compressed. The buffer has the size of
+// the uncompressed ROM, and it must be freed by the caller.
+void RomArchive_Load(const char *path, void **buffer, size_t *size);
+
+#endif // ROM_ARCHIVE__
@@ -0,0 +1,704 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+#include <zlib.h>
+
+#include "build_options.h"
+#include "debug_utils.h"
+#include "file_utils.h"
+#include "general_utils.h"
+#include "rom_archive.h"
+#include "rom_library.h"
+
+#define ROM_LIBRARY_FILE_HEADER "# GiiBiiAdvance ROM library 2\n"
+
+// Bytes read to get the information of the header. The GB header is the one
+// that ends later.
+#define ROM_LIBRARY_HEADER_SIZE 0x150
+
+#define ROM_LIBRARY_CRC_BUFFER_SIZE (64 * 1024)
+
+// The index is saved when the thread has nothing left to do, and also every
+// now and then while it is busy calculating CRC32s.
+#define ROM_LIBRARY_SAVE_INTERVAL_MS 10000
+
+typedef struct
+{
+    char *path;
+    u64 size;
+    s64 mtime;
+    int indexed; // Set when the header has been read
+    int crc_failed; // The file couldn't be read, don't try again
+    rom_library_info info;
+} rom_library_entry;
+
+static SDL_Thread *rom_library_thread = NULL;
+static SDL_mutex *rom_library_mutex = NULL;
+static SDL_cond *rom_library_cond = NULL;
+static SDL_atomic_t rom_library_quit;
+static SDL_atomic_t rom_library_generation;
+
+// All the variables below are protected by rom_library_mutex
+
+static rom_library_entry *rom_library_entries = NULL;
+static int rom_library_count, rom_library_max;
+
+// Open addressing hash table with indices to the entries, or -1 if empty
+static int *rom_library_hash = NULL;
+static int rom_library_hash_size; // Power of 2
+
+// Entries whose header has to be read
+static int *rom_library_queue = NULL;
+static int rom_library_queue_head, rom_library_queue_tail;
+static int rom_library_queue_max;
+
+// Entries before this one don't need their CRC32 to be calculated
+static int rom_library_crc_next;
+
+static int rom_library_dirty;
+static Uint32 rom_library_save_ticks;
+
+//------------------------------------------------------------------------------
+
+static u32 _rom_library_hash_path(const char *path)
+{
+    // 32-bit FNV-1a
+    u32 hash = 2166136261U;
+
+    while (*path)
+    {
+        hash ^= (u8)*path++;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static int _rom_library_hash_find(const char *path)
+{
+    if (rom_library_hash == NULL)
+        return -1;
+
+    u32 mask = rom_library_hash_size - 1;
+    u32 slot = _rom_library_hash_path(path) & mask;
+
+    while (rom_library_hash[slot] >= 0)
+    {
+        int index = rom_library_hash[slot];
+        if (strcmp(rom_library_entries[index].path, path) == 0)
+            return index;
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+static void _rom_library_hash_insert(int index)
+{
+    u32 mask = rom_library_hash_size - 1;
+    u32 slot = _rom_library_hash_path(rom_library_entries[index].path) & mask;
+
+    while (rom_library_hash[slot] >= 0)
+        slot = (slot + 1) & mask;
+
+    rom_library_hash[slot] = index;
+}
+
+// The table is kept at most half full
+static int _rom_library_hash_grow(void)
+{
+    if ((rom_library_count + 1) * 2 <= rom_library_hash_size)
+        return 1;
+
+    int size = (rom_library_hash_size == 0) ? 1024 : rom_library_hash_size * 2;
+
+    int *hash = malloc(size * sizeof(int));
+    if (hash == NULL)
+        return 0;
+
+    free(rom_library_hash);
+    rom_library_hash = hash;
+    rom_library_hash_size = size;
+
+    for (int i = 0; i < size; i++)
+        rom_library_hash[i] = -1;
+
+    for (int i = 0; i < rom_library_count; i++)
+        _rom_library_hash_insert(i);
+
+    return 1;
+}
+
+// Returns the index of the new entry, or -1 on error
+static int _rom_library_add(const char *path, u64 size, s64 mtime)
+{
+    if (_rom_library_hash_grow() == 0)
+        return -1;
+
+    if (rom_library_count == rom_library_max)
+    {
+        int max = (rom_library_max == 0) ? 256 : rom_library_max * 2;
+        rom_library_entry *entries =
+                realloc(rom_library_entries, max * sizeof(rom_library_entry));
+        if (entries == NULL)
+            return -1;
+
+        rom_library_entries = entries;
+        rom_library_max = max;
+    }
+
+    size_t len = strlen(path) + 1;
+    char *copy = malloc(len);
+    if (copy == NULL)
+        return -1;
+    memcpy(copy, path, len);
+
+    int index = rom_library_count++;
+    rom_library_entry *e = &rom_library_entries[index];
+
+    memset(e, 0, sizeof(rom_library_entry));
+    e->path = copy;
+    e->size = size;
+    e->mtime = mtime;
+
+    _rom_library_hash_insert(index);
+
+    return index;
+}
+
+static void _rom_library_queue(int index)
+{
+    if (rom_library_queue_tail == rom_library_queue_max)
+    {
+        // Move the pending entries to the start before growing the array
+        int pending = rom_library_queue_tail - rom_library_queue_head;
+        memmove(rom_library_queue, &rom_library_queue[rom_library_queue_head],
+                pending * sizeof(int));
+        rom_library_queue_head = 0;
+        rom_library_queue_tail = pending;
+
+        if (pending == rom_library_queue_max)
+        {
+            int max = (rom_library_queue_max == 0) ?
+                      256 : rom_library_queue_max * 2;
+            int *queue = realloc(rom_library_queue, max * sizeof(int));
+            if (queue == NULL)
+                return;
+
+            rom_library_queue = queue;
+            rom_library_queue_max = max;
+        }
+    }
+
+    rom_library_queue[rom_library_queue_tail++] = index;
+
+    SDL_CondBroadcast(rom_library_cond);
+}
+
+//------------------------------------------------------------------------------
+
+// Copies the printable characters of a header field and removes the spaces at
+// the end.
+static void _rom_library_copy_text(char *dest, const u8 *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (src[i] == 0)
+            break;
+
+        dest[i] = ((src[i] >= 0x20) && (src[i] < 0x7F)) ? src[i] : ' ';
+    }
+
+    while ((i > 0) && (dest[i - 1] == ' '))
+        i--;
+
+    dest[i] = '\0';
+}
+
+static void _rom_library_parse_header(const u8 *header, size_t size,
+                                      rom_library_info *info)
+{
+    static const u8 gb_logo_start[4] = { 0xCE, 0xED, 0x66, 0x66 };
+
+    memset(info, 0, sizeof(rom_library_info));
+    info->system = ROM_LIBRARY_SYSTEM_NONE;
+
+    if ((size >= 0xC0) && (header[0xB2] == 0x96)) // Fixed value in GBA ROMs
+    {
+        info->system = ROM_LIBRARY_SYSTEM_GBA;
+        _rom_library_copy_text(info->title, &header[0xA0], 12);
+        _rom_library_copy_text(info->code, &header[0xAC], 4);
+    }
+    else if ((size >= ROM_LIBRARY_HEADER_SIZE)
+             && (memcmp(&header[0x104], gb_logo_start, 4) == 0))
+    {
+        info->mapper = header[0x147];
+
+        if (header[0x143] & 0x80) // Game Boy Color game
+        {
+            if (header[0x143] == 0xC0)
+                info->system = ROM_LIBRARY_SYSTEM_GBC;
+            else
+                info->system = ROM_LIBRARY_SYSTEM_GB;
+
+            // The manufacturer code is only present in some of them
+            _rom_library_copy_text(info->title, &header[0x134], 11);
+            _rom_library_copy_text(info->code, &header[0x13F], 4);
+            if (strlen(info->code) != 4)
+                info->code[0] = '\0';
+        }
+        else
+        {
+            info->system = ROM_LIBRARY_SYSTEM_GB;
+            _rom_library_copy_text(info->title, &header[0x134], 16);
+        }
+    }
+}
+
+static void _rom_library_read_header(const char *path, rom_library_info *info)
+{
+    u8 header[ROM_LIBRARY_HEADER_SIZE];
+    size_t size;
+
+    // Compressed files are decompressed until the header has been read
+    if (RomArchive_Read(path, header, sizeof(header), &size) == 0)
+        size = 0;
+    else if (size > sizeof(header))
+        size = sizeof(header);
+
+    _rom_library_parse_header(header, size, info);
+}
+
+// Returns 1 on success. It stops if the emulator is closed. The CRC32 of the
+// ROM inside of an archive is stored in the archive.
+static int _rom_library_calculate_crc(const char *path, u8 *buffer, u32 *crc)
+{
+    if (RomArchive_GetType(path) != ROM_ARCHIVE_NONE)
+    {
+        uint32_t archive_crc;
+        if (RomArchive_GetCRC32(path, &archive_crc) == 0)
+            return 0;
+
+        *crc = archive_crc;
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return 0;
+
+    *crc = crc32(0, NULL, 0);
+
+    while (SDL_AtomicGet(&rom_library_quit) == 0)
+    {
+        size_t size = fread(buffer, 1, ROM_LIBRARY_CRC_BUFFER_SIZE, f);
+
+        *crc = crc32(*crc, buffer, size);
+
+        if (size < ROM_LIBRARY_CRC_BUFFER_SIZE)
+        {
+            int ok = !ferror(f);
+            fclose(f);
+            return ok;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void _rom_library_get_file_path(char *path, size_t size)
+{
+    if (DirGetRunningPath())
+        snprintf(path, size, "%sGiiBiiAdvance_library.txt",
+                 DirGetRunningPath());
+    else
+        s_strncpy(path, "GiiBiiAdvance_library.txt", size);
+}
+
+static void _rom_library_load(void)
+{
+    char path[MAX_PATHLEN];
+    _rom_library_get_file_path(path, sizeof(path));
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return;
+
+    size_t line_size = MAX_PATHLEN + 128;
+    char *line = malloc(line_size);
+    if (line == NULL)
+    {
+        fclose(f);
+        return;
+    }
+
+    if ((fgets(line, line_size, f) == NULL)
+        || (strcmp(line, ROM_LIBRARY_FILE_HEADER) != 0))
+    {
+        Debug_LogMsgArg("ROM library: Unknown format: %s", path);
+        free(line);
+        fclose(f);
+        return;
+    }
+
+    // size mtime system mapper has_crc32 crc32 code title path, separated by
+    // tabulators.
+    while (fgets(line, line_size, f) != NULL)
+    {
+        char *fields[9];
+        int count = 0;
+        char *p = line;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        while (count < 9)
+        {
+            fields[count++] = p;
+            p = strchr(p, '\t');
+            if (p == NULL)
+                break;
+            *p++ = '\0';
+        }
+
+        if ((count != 9) || (fields[8][0] == '\0'))
+            continue;
+
+        if (_rom_library_hash_find(fields[8]) >= 0)
+            continue;
+
+        int index = _rom_library_add(fields[8], strtoull(fields[0], NULL, 10),
+                                     strtoll(fields[1], NULL, 10));
+        if (index < 0)
+            break;
+
+        rom_library_entry *e = &rom_library_entries[index];
+
+        e->indexed = 1;
+        e->info.system = atoi(fields[2]);
+        e->info.mapper = atoi(fields[3]);
+        e->info.has_crc32 = atoi(fields[4]);
+        e->info.crc32 = strtoul(fields[5], NULL, 16);
+        s_strncpy(e->info.code, fields[6], sizeof(e->info.code));
+        s_strncpy(e->info.title, fields[7], sizeof(e->info.title));
+    }
+
+    free(line);
+    fclose(f);
+}
+
+// Returns a buffer with the contents of the index file. The mutex must be
+// locked.
+static char *_rom_library_serialize(size_t *size)
+{
+    size_t max = sizeof(ROM_LIBRARY_FILE_HEADER);
+    for (int i = 0; i < rom_library_count; i++)
+        max += strlen(rom_library_entries[i].path) + 128;
+
+    char *buffer = malloc(max);
+    if (buffer == NULL)
+        return NULL;
+
+    size_t len = snprintf(buffer, max, ROM_LIBRARY_FILE_HEADER);
+
+    for (int i = 0; i < rom_library_count; i++)
+    {
+        rom_library_entry *e = &rom_library_entries[i];
+
+        if (e->indexed == 0)
+            continue;
+
+        // Tabulators and new lines would break the format
+        if (strpbrk(e->path, "\t\r\n") != NULL)
+            continue;
+
+        len += snprintf(&buffer[len], max - len,
+                        "%" PRIu64 "\t%" PRId64 "\t%d\t%d\t%d\t%08" PRIX32
+                        "\t%s\t%s\t%s\n",
+                        e->size, e->mtime, e->info.system, e->info.mapper,
+                        e->info.has_crc32, e->info.crc32, e->info.code,
+                        e->info.title, e->path);
+    }
+
+    *size = len;
+    return buffer;
+}
+
+// The mutex must be locked. It is unlocked while the file is written.
+static void _rom_library_save(void)
+{
+    size_t size;
+    char *buffer = _rom_library_serialize(&size);
+    if (buffer == NULL)
+        return;
+
+    rom_library_dirty = 0;
+    rom_library_save_ticks = SDL_GetTicks();
+
+    SDL_UnlockMutex(rom_library_mutex);
+
+    char path[MAX_PATHLEN];
+    _rom_library_get_file_path(path, sizeof(path));
+    FileSaveAtomic(path, buffer, size);
+    free(buffer);
+
+    SDL_LockMutex(rom_library_mutex);
+}
+
+//------------------------------------------------------------------------------
+
+// Returns the index of an entry that needs its CRC32, or -1 if there are none
+static int _rom_library_next_crc(void)
+{
+    while (rom_library_crc_next < rom_library_count)
+    {
+        rom_library_entry *e = &rom_library_entries[rom_library_crc_next];
+
+        if (e->indexed && (e->info.system != ROM_LIBRARY_SYSTEM_NONE)
+            && (e->info.has_crc32 == 0) && (e->crc_failed == 0))
+        {
+            return rom_library_crc_next;
+        }
+
+        rom_library_crc_next++;
+    }
+
+    return -1;
+}
+
+static int _rom_library_thread_func(void *data)
+{
+    (void)data;
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    u8 *buffer = malloc(ROM_LIBRARY_CRC_BUFFER_SIZE);
+    char *path = malloc(MAX_PATHLEN);
+    if ((buffer == NULL) || (path == NULL))
+    {
+        free(buffer);
+        free(path);
+        return 0;
+    }
+
+    SDL_LockMutex(rom_library_mutex);
+
+    while (SDL_AtomicGet(&rom_library_quit) == 0)
+    {
+        int index;
+        int read_header = 0;
+
+        // The headers are read before calculating any CRC32 so that the file
+        // explorer gets the information as soon as possible.
+        if (rom_library_queue_head < rom_library_queue_tail)
+        {
+            index = rom_library_queue[rom_library_queue_head++];
+            read_header = 1;
+        }
+        else
+        {
+            rom_library_queue_head = 0;
+            rom_library_queue_tail = 0;
+
+            if (rom_library_dirty && ((SDL_GetTicks() - rom_library_save_ticks)
+                                      >= ROM_LIBRARY_SAVE_INTERVAL_MS))
+            {
+                _rom_library_save();
+                continue;
+            }
+
+            index = _rom_library_next_crc();
+        }
+
+        if (index < 0)
+        {
+            if (rom_library_dirty)
+                _rom_library_save();
+            else
+                SDL_CondWait(rom_library_cond, rom_library_mutex);
+            continue;
+        }
+
+        rom_library_entry *e = &rom_library_entries[index];
+        u64 size = e->size;
+        s64 mtime = e->mtime;
+        s_strncpy(path, e->path, MAX_PATHLEN);
+
+        SDL_UnlockMutex(rom_library_mutex);
+
+        rom_library_info info;
+        u32 crc = 0;
+        int ok = 1;
+
+        if (read_header)
+            _rom_library_read_header(path, &info);
+        else
+            ok = _rom_library_calculate_crc(path, buffer, &crc);
+
+        SDL_LockMutex(rom_library_mutex);
+
+        // The array may have been reallocated, and the file may have been
+        // modified while it was being read.
+        e = &rom_library_entries[index];
+        if ((e->size != size) || (e->mtime != mtime))
+            continue;
+
+        if (read_header)
+        {
+            e->info = info;
+            e->indexed = 1;
+            if (rom_library_crc_next > index)
+                rom_library_crc_next = index;
+        }
+        else if (ok)
+        {
+            e->info.crc32 = crc;
+            e->info.has_crc32 = 1;
+        }
+        else
+        {
+            // It isn't tried again until the file changes or the emulator is
+            // restarted.
+            e->crc_failed = 1;
+            continue;
+        }
+
+        rom_library_dirty = 1;
+        SDL_AtomicAdd(&rom_library_generation, 1);
+    }
+
+    SDL_UnlockMutex(rom_library_mutex);
+
+    free(buffer);
+    free(path);
+
+    return 0;
+}
+
+int RomLibrary_Init(void)
+{
+    rom_library_mutex = SDL_CreateMutex();
+    rom_library_cond = SDL_CreateCond();
+    if ((rom_library_mutex == NULL) || (rom_library_cond == NULL))
+    {
+        Debug_ErrorMsgArg("ROM library: Failed to create mutex: %s",
+                          SDL_GetError());
+        return 0;
+    }
+
+    _rom_library_load();
+
+    SDL_AtomicSet(&rom_library_quit, 0);
+    rom_library_thread = SDL_CreateThread(_rom_library_thread_func,
+                                          "ROM library", NULL);
+    if (rom_library_thread == NULL)
+    {
+        Debug_ErrorMsgArg("ROM library: Failed to create thread: %s",
+                          SDL_GetError());
+        return 0;
+    }
+
+    return 1;
+}
+
+void RomLibrary_End(void)
+{
+    if (rom_library_thread == NULL)
+        return;
+
+    SDL_LockMutex(rom_library_mutex);
+    SDL_AtomicSet(&rom_library_quit, 1);
+    SDL_CondBroadcast(rom_library_cond);
+    SDL_UnlockMutex(rom_library_mutex);
+
+    SDL_WaitThread(rom_library_thread, NULL);
+    rom_library_thread = NULL;
+
+    SDL_LockMutex(rom_library_mutex);
+    if (rom_library_dirty)
+        _rom_library_save();
+    SDL_UnlockMutex(rom_library_mutex);
+
+    for (int i = 0; i < rom_library_count; i++)
+        free(rom_library_entries[i].path);
+    free(rom_library_entries);
+    rom_library_entries = NULL;
+    rom_library_count = 0;
+    rom_library_max = 0;
+
+    free(rom_library_hash);
+    rom_library_hash = NULL;
+    rom_library_hash_size = 0;
+
+    free(rom_library_queue);
+    rom_library_queue = NULL;
+    rom_library_queue_head = 0;
+    rom_library_queue_tail = 0;
+    rom_library_queue_max = 0;
+
+    SDL_DestroyCond(rom_library_cond);
+    SDL_DestroyMutex(rom_library_mutex);
+    rom_library_cond = NULL;
+    rom_library_mutex = NULL;
+}
+
+int RomLibrary_Get(const char *path, uint64_t size, int64_t mtime,
+                   rom_library_info *info)
+{
+    if (rom_library_thread == NULL)
+        return 0;
+
+    int ret = 0;
+
+    SDL_LockMutex(rom_library_mutex);
+
+    int index = _rom_library_hash_find(path);
+    if (index < 0)
+    {
+        index = _rom_library_add(path, size, mtime);
+        if (index >= 0)
+            _rom_library_queue(index);
+    }
+    else
+    {
+        rom_library_entry *e = &rom_library_entries[index];
+
+        if ((e->size != size) || (e->mtime != mtime))
+        {
+            // The file has changed, read it again
+            e->size = size;
+            e->mtime = mtime;
+            e->indexed = 0;
+            e->crc_failed = 0;
+            e->info.has_crc32 = 0;
+            _rom_library_queue(index);
+        }
+        else if (e->indexed)
+        {
+            *info = e->info;
+            ret = 1;
+        }
+    }
+
+    SDL_UnlockMutex(rom_library_mutex);
+
+    return ret;
+}
+
+int RomLibrary_GetGeneration(void)
+{
+    return SDL_AtomicGet(&rom_library_generation);
+}
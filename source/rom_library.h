@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef ROM_LIBRARY__
+#define ROM_LIBRARY__
+
+#include <stdint.h>
+
+// Index of the ROMs seen in the file explorer. It is saved to disk, and it is
+// filled by a background thread that only reads the header of the files. Once
+// there are no headers left to read, the CRC32 of the files is calculated.
+// Files are identified by their path, size and modification time.
+
+#define ROM_LIBRARY_SYSTEM_NONE 0 // Not a valid ROM
+#define ROM_LIBRARY_SYSTEM_GB   1
+#define ROM_LIBRARY_SYSTEM_GBC  2 // Game Boy Color only
+#define ROM_LIBRARY_SYSTEM_GBA  3
+
+typedef struct
+{
+    int system;
+    char title[17];
+    char code[5]; // Game code of GBA games, manufacturer code of GB games
+    int mapper; // Cartridge type of GB games
+    int has_crc32; // Set when crc32 has been calculated
+    uint32_t crc32;
+} rom_library_info;
+
+// Loads the index and starts the thread
+int RomLibrary_Init(void);
+// Stops the thread and saves the index
+void RomLibrary_End(void);
+
+// Returns 1 and fills "info" if the file is in the index. If not, it is queued
+// to be read by the thread, and it returns 0.
+int RomLibrary_Get(const char *path, uint64_t size, int64_t mtime,
+                   rom_library_info *info);
+
+// This number changes every time the thread adds information to the index
+int RomLibrary_GetGeneration(void);
+
+#endif // ROM_LIBRARY__
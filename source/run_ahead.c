@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdlib.h>
+
+#include <SDL2/SDL.h>
+
+#include "config.h"
+#include "debug_utils.h"
+#include "general_utils.h"
+#include "input_utils.h"
+#include "lua_handler.h"
+#include "run_ahead.h"
+
+#include "gb_core/camera.h"
+#include "gb_core/debug.h"
+#include "gb_core/gameboy.h"
+#include "gb_core/gb_main.h"
+#include "gb_core/sound.h"
+#include "gb_core/state.h"
+#include "gb_core/video.h"
+
+#include "gba_core/disassembler.h"
+#include "gba_core/gba.h"
+#include "gba_core/profiler.h"
+#include "gba_core/sound.h"
+#include "gba_core/state.h"
+#include "gba_core/video.h"
+
+extern _GB_CONTEXT_ GameBoy;
+
+#define RUN_AHEAD_MS_PER_FRAME ((double)1000.0 / (double)60.0)
+
+// Weight of the last measurement in the averages of the times
+#define RUN_AHEAD_AVERAGE_WEIGHT (0.1)
+
+// Only used from the thread that emulates the frames
+static void *run_ahead_state = NULL;
+static size_t run_ahead_state_size = 0;
+
+static int run_ahead_last_frames = 0;
+static double run_ahead_frame_ms = 0.0; // Time taken by one emulated frame
+static double run_ahead_state_ms = 0.0; // Time taken to save and load a state
+
+static double _run_ahead_get_ms(void)
+{
+    return (double)SDL_GetPerformanceCounter() * 1000.0
+           / (double)SDL_GetPerformanceFrequency();
+}
+
+static void _run_ahead_average(double *average, double value)
+{
+    if (*average <= 0.0)
+        *average = value;
+    else
+        *average += (value - *average) * RUN_AHEAD_AVERAGE_WEIGHT;
+}
+
+// Returns a buffer big enough to hold a state of the given size
+static void *_run_ahead_get_buffer(size_t size)
+{
+    if (size <= run_ahead_state_size)
+        return run_ahead_state;
+
+    void *buffer = realloc(run_ahead_state, size);
+    if (buffer == NULL)
+    {
+        Debug_LogMsgArg("%s(): Not enough memory", __func__);
+        return NULL;
+    }
+
+    run_ahead_state = buffer;
+    run_ahead_state_size = size;
+
+    return run_ahead_state;
+}
+
+// Frames to run ahead of the input in this frame. Run-ahead is disabled when
+// the frames emulated ahead could have side effects outside of the emulated
+// machine, or when it would get in the way of the debugger and the scripts.
+static int _run_ahead_get_frames(void)
+{
+    if (Input_SnapshotSpeedup())
+        return 0;
+
+    if (Script_IsLoaded())
+        return 0;
+
+    return EmulatorConfig.run_ahead;
+}
+
+void RunAhead_FrameGBA(int skip)
+{
+    int frames = _run_ahead_get_frames();
+
+    if (GBA_DebugAnyBreakpoint() || GBA_DebugAnyWatchpoint()
+        || GBA_ProfilerIsEnabled() || EmulatorConfig.gba_link_cable)
+    {
+        frames = 0;
+    }
+
+    void *state = NULL;
+    if (frames > 0)
+    {
+        state = _run_ahead_get_buffer(GBA_StateSize());
+        if (state == NULL)
+            frames = 0;
+    }
+
+    run_ahead_last_frames = frames;
+
+    // The screen buffer is swapped at the start of each frame and the one that
+    // is displayed is the one drawn in the previous frame, so the last two
+    // frames need to be drawn.
+
+    double start = _run_ahead_get_ms();
+
+    GBA_SkipFrame(skip || (frames > 1));
+    GBA_RunForOneFrame();
+
+    double end = _run_ahead_get_ms();
+    _run_ahead_average(&run_ahead_frame_ms, end - start);
+
+    if (frames == 0)
+        return;
+
+    start = _run_ahead_get_ms();
+    GBA_StateSave(state);
+    double state_ms = _run_ahead_get_ms() - start;
+
+    // The sound output buffer isn't part of the state. The samples of the
+    // frames ahead are written after the ones of the real frame, and they are
+    // discarded after loading the state.
+    u32 sound_ptr = GBA_SoundGetBufferPointer();
+
+    for (int i = 0; i < frames; i++)
+    {
+        GBA_SkipFrame(skip || (i < (frames - 2)));
+        GBA_RunForOneFrame();
+    }
+
+    start = _run_ahead_get_ms();
+    GBA_StateLoad(state);
+    GBA_SoundSetBufferPointer(sound_ptr);
+    end = _run_ahead_get_ms();
+
+    _run_ahead_average(&run_ahead_state_ms, state_ms + end - start);
+}
+
+void RunAhead_FrameGB(int skip)
+{
+    int frames = _run_ahead_get_frames();
+
+    // The printer allocates memory when it receives data, and the state of the
+    // webcam and the other emulator connected by the link cable can't be saved.
+    if (GB_DebugAnyBreakpoint() || GB_MapperIsGBCamera()
+        || (GameBoy.Emulator.serial_device != SERIAL_NONE))
+    {
+        frames = 0;
+    }
+
+    void *state = NULL;
+    if (frames > 0)
+    {
+        state = _run_ahead_get_buffer(GB_StateSize());
+        if (state == NULL)
+            frames = 0;
+    }
+
+    run_ahead_last_frames = frames;
+
+    double start = _run_ahead_get_ms();
+
+    GB_SkipFrame(skip || (frames > 0));
+    GB_RunForOneFrame();
+
+    double end = _run_ahead_get_ms();
+    _run_ahead_average(&run_ahead_frame_ms, end - start);
+
+    if (frames == 0)
+        return;
+
+    start = _run_ahead_get_ms();
+    GB_StateSave(state);
+    double state_ms = _run_ahead_get_ms() - start;
+
+    u32 sound_ptr = GB_SoundGetBufferPointer();
+
+    for (int i = 0; i < frames; i++)
+    {
+        GB_SkipFrame(skip || (i < (frames - 1)));
+        GB_RunForOneFrame();
+    }
+
+    start = _run_ahead_get_ms();
+    GB_StateLoad(state);
+    GB_SoundSetBufferPointer(sound_ptr);
+    end = _run_ahead_get_ms();
+
+    _run_ahead_average(&run_ahead_state_ms, state_ms + end - start);
+}
+
+void RunAhead_End(void)
+{
+    free(run_ahead_state);
+    run_ahead_state = NULL;
+    run_ahead_state_size = 0;
+}
+
+void RunAhead_GetBudget(int *frames, int *max_frames)
+{
+    *frames = run_ahead_last_frames;
+
+    if (run_ahead_frame_ms <= 0.0)
+    {
+        *max_frames = 0;
+        return;
+    }
+
+    // One frame of the budget is used by the real frame
+    double left_ms = RUN_AHEAD_MS_PER_FRAME - run_ahead_state_ms;
+    int max = (int)(left_ms / run_ahead_frame_ms) - 1;
+
+    if (max < 0)
+        max = 0;
+    else if (max > RUN_AHEAD_MAX_FRAMES)
+        max = RUN_AHEAD_MAX_FRAMES;
+
+    *max_frames = max;
+}
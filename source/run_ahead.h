@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef RUN_AHEAD__
+#define RUN_AHEAD__
+
+// Maximum number of frames that can be emulated ahead of the input
+#define RUN_AHEAD_MAX_FRAMES    8
+
+// Emulate one frame instead of GBA_RunForOneFrame() and GB_RunForOneFrame().
+// If run-ahead is enabled, the state of the machine is saved after the frame,
+// the frames ahead are emulated with the same input, and the state is loaded
+// again. The screen buffer is left with the last frame emulated ahead, so the
+// effect of the input is seen that many frames earlier. The rest of the state
+// (sound buffer included) is the one of the real frame. If skip is 1 the frame
+// isn't drawn.
+void RunAhead_FrameGBA(int skip);
+void RunAhead_FrameGB(int skip);
+
+// Frees the buffer used to save the state
+void RunAhead_End(void);
+
+// Returns the number of frames that have been emulated ahead in the last frame
+// and an estimation of the maximum number of frames that could be emulated
+// ahead in the time of one frame, based on the time taken by the last frames.
+void RunAhead_GetBudget(int *frames, int *max_frames);
+
+#endif // RUN_AHEAD__
@@ -73,9 +73,14 @@ static void Sound_Callback(unused__ void *userdata, Uint8 *buffer, int len)
     }
 }
 
+// The stream is also used by the audio callback. Samples are sent from the
+// emulation thread, so the audio device has to be locked while doing it.
+
 void Sound_ClearBuffer(void)
 {
+    SDL_LockAudio();
     SDL_AudioStreamClear(stream);
+    SDL_UnlockAudio();
 }
 
 static void Sound_End(void)
@@ -140,7 +145,9 @@ int Sound_IsBufferTooBig(void)
 
 void Sound_SendSamples(int16_t *buffer, int len)
 {
+    SDL_LockAudio();
     int rc = SDL_AudioStreamPut(stream, buffer, len);
+    SDL_UnlockAudio();
     if (rc == -1)
         Debug_LogMsgArg("Failed to send samples to stream: %s", SDL_GetError());
 }
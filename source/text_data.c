@@ -84,6 +84,7 @@ const char *readme_text =
 "     F5: Show disassembler.\n"
 "     F6: Show memory viewer.\n"
 "     F7: Show I/O viewer.\n"
+"     F10: Start/stop recording video (see capture_* in the .ini file).\n"
 "     F12: Screenshot.\n"
 "\n"
 "\n"
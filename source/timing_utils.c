@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "build_options.h"
+#include "debug_utils.h"
+#include "font_utils.h"
+#include "general_utils.h"
+#include "timing_utils.h"
+
+#include "gb_core/timing.h"
+#include "gba_core/timing.h"
+
+#ifdef ENABLE_TIMING
+
+// The cores use their own IDs for the subsystems they measure
+#if (GB_TIMING_CPU != TIMING_CPU) || (GB_TIMING_VIDEO != TIMING_VIDEO) \
+    || (GB_TIMING_DMA != TIMING_DMA) || (GB_TIMING_TIMERS != TIMING_TIMERS) \
+    || (GB_TIMING_SOUND != TIMING_SOUND)
+# error "The GB core timing IDs don't match the frontend ones"
+#endif
+
+#if (GBA_TIMING_CPU != TIMING_CPU) || (GBA_TIMING_VIDEO != TIMING_VIDEO) \
+    || (GBA_TIMING_DMA != TIMING_DMA) || (GBA_TIMING_TIMERS != TIMING_TIMERS) \
+    || (GBA_TIMING_SOUND != TIMING_SOUND)
+# error "The GBA core timing IDs don't match the frontend ones"
+#endif
+
+// The last entry is the total time of the frame
+#define TIMING_FRAME (TIMING_NUM)
+
+static const char *timing_names[TIMING_NUM + 1] = {
+    "cpu", "video", "dma", "timers", "sound", "convert", "render", "frame"
+};
+
+int timing_enabled = 0;
+
+// Nested scopes
+#define TIMING_STACK_SIZE 8
+
+static int timing_stack[TIMING_STACK_SIZE];
+static int timing_depth = 0;
+static Uint64 timing_last; // Last time a scope was entered or exited
+
+// Time accumulated during the current frame
+static Uint64 timing_acc[TIMING_NUM];
+static Uint64 timing_frame_start = 0;
+
+void Timing_Begin(int id)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    if ((timing_depth > 0) && (timing_depth <= TIMING_STACK_SIZE))
+        timing_acc[timing_stack[timing_depth - 1]] += now - timing_last;
+
+    if (timing_depth < TIMING_STACK_SIZE)
+        timing_stack[timing_depth] = id;
+
+    timing_depth++;
+    timing_last = now;
+}
+
+void Timing_End(void)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    if (timing_depth == 0)
+        return;
+
+    timing_depth--;
+
+    if (timing_depth < TIMING_STACK_SIZE)
+        timing_acc[timing_stack[timing_depth]] += now - timing_last;
+
+    timing_last = now;
+}
+
+//------------------------------------------------------------------------------
+
+// Histograms have 8 buckets per power of two of microseconds
+#define TIMING_HIST_SIZE 192
+
+typedef struct {
+    u32 frames;
+    double total_us;
+    double max_us;
+    u32 hist[TIMING_HIST_SIZE];
+} _timing_stats_t;
+
+static _timing_stats_t timing_stats[TIMING_NUM + 1];
+
+static int timing_hist_bucket(double us)
+{
+    u32 v = (us > (double)0xFFFFFF) ? 0xFFFFFF : (u32)us;
+
+    if (v < 8)
+        return v;
+
+    int octave = 3;
+    while ((v >> (octave + 1)) != 0)
+        octave++;
+
+    int bucket = (octave - 2) * 8 + ((v >> (octave - 3)) & 7);
+
+    if (bucket >= TIMING_HIST_SIZE)
+        bucket = TIMING_HIST_SIZE - 1;
+
+    return bucket;
+}
+
+// Returns the lowest value of a bucket
+static double timing_hist_value(int bucket)
+{
+    if (bucket < 8)
+        return bucket;
+
+    int octave = bucket / 8 + 2;
+    u32 v = (1u << octave) | ((u32)(bucket & 7) << (octave - 3));
+
+    return v;
+}
+
+static double timing_stats_percentile(const _timing_stats_t *s, int percent)
+{
+    u64 target = ((u64)s->frames * percent + 99) / 100;
+    u64 count = 0;
+
+    for (int i = 0; i < TIMING_HIST_SIZE; i++)
+    {
+        count += s->hist[i];
+        if ((count >= target) && (count > 0))
+            return timing_hist_value(i);
+    }
+
+    return s->max_us;
+}
+
+static void timing_stats_add(int id, double us)
+{
+    _timing_stats_t *s = &timing_stats[id];
+
+    s->frames++;
+    s->total_us += us;
+    if (us > s->max_us)
+        s->max_us = us;
+
+    s->hist[timing_hist_bucket(us)]++;
+}
+
+static void timing_stats_reset(void)
+{
+    memset(timing_stats, 0, sizeof(timing_stats));
+}
+
+//------------------------------------------------------------------------------
+
+static int timing_overlay = 0;
+
+// Averages shown in the overlay. They are updated every few frames so that
+// they can be read.
+#define TIMING_OVERLAY_FRAMES 30
+
+static double timing_overlay_sum[TIMING_NUM + 1];
+static int timing_overlay_frames = 0;
+static double timing_overlay_avg[TIMING_NUM + 1];
+
+static FILE *timing_log_csv = NULL;
+static char timing_log_json_path[MAX_PATHLEN];
+static u32 timing_log_frame;
+
+static void timing_update_enabled(void)
+{
+    int enabled = timing_overlay || (timing_log_csv != NULL);
+
+    if (enabled && !timing_enabled)
+    {
+        memset(timing_acc, 0, sizeof(timing_acc));
+        timing_depth = 0;
+        timing_frame_start = 0;
+    }
+
+    timing_enabled = enabled;
+
+    // The cores only call the hooks while times are being measured
+    GB_TimingSetCallbacks(enabled ? Timing_Begin : NULL,
+                          enabled ? Timing_End : NULL);
+    GBA_TimingSetCallbacks(enabled ? Timing_Begin : NULL,
+                           enabled ? Timing_End : NULL);
+}
+
+void Timing_FrameEnd(void)
+{
+    if (!timing_enabled)
+        return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    double us_per_tick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+
+    // The first frame is incomplete
+    if (timing_frame_start == 0)
+    {
+        memset(timing_acc, 0, sizeof(timing_acc));
+        timing_frame_start = now;
+        return;
+    }
+
+    double us[TIMING_NUM + 1];
+
+    for (int i = 0; i < TIMING_NUM; i++)
+    {
+        us[i] = (double)timing_acc[i] * us_per_tick;
+        timing_acc[i] = 0;
+    }
+    us[TIMING_FRAME] = (double)(now - timing_frame_start) * us_per_tick;
+
+    timing_frame_start = now;
+    timing_depth = 0; // This is always called outside of all scopes
+
+    for (int i = 0; i < TIMING_NUM + 1; i++)
+    {
+        timing_stats_add(i, us[i]);
+        timing_overlay_sum[i] += us[i];
+    }
+
+    timing_overlay_frames++;
+    if (timing_overlay_frames == TIMING_OVERLAY_FRAMES)
+    {
+        for (int i = 0; i < TIMING_NUM + 1; i++)
+        {
+            timing_overlay_avg[i] = timing_overlay_sum[i]
+                                  / TIMING_OVERLAY_FRAMES;
+            timing_overlay_sum[i] = 0;
+        }
+        timing_overlay_frames = 0;
+    }
+
+    if (timing_log_csv)
+    {
+        fprintf(timing_log_csv, "%u", timing_log_frame++);
+        for (int i = 0; i < TIMING_NUM + 1; i++)
+            fprintf(timing_log_csv, ",%.1f", us[i]);
+        fprintf(timing_log_csv, "\n");
+    }
+}
+
+void Timing_OverlaySet(int enable)
+{
+    timing_overlay = enable;
+
+    timing_overlay_frames = 0;
+    memset(timing_overlay_sum, 0, sizeof(timing_overlay_sum));
+    memset(timing_overlay_avg, 0, sizeof(timing_overlay_avg));
+
+    timing_update_enabled();
+}
+
+int Timing_OverlayGet(void)
+{
+    return timing_overlay;
+}
+
+void Timing_OverlayDraw(unsigned char *buffer, int width, int height)
+{
+    if (!timing_overlay)
+        return;
+
+    for (int i = 0; i < TIMING_NUM + 1; i++)
+    {
+        FU_PrintColor(buffer, width, height, 0, i * FONT_HEIGHT, 0xFFFFFFFF,
+                      "%-7s%6.2f", timing_names[i],
+                      timing_overlay_avg[i] / 1000.0);
+    }
+}
+
+int Timing_LogStart(const char *basename)
+{
+    Timing_LogEnd();
+
+    char path[MAX_PATHLEN];
+    snprintf(path, sizeof(path), "%s.csv", basename);
+
+    timing_log_csv = fopen(path, "w");
+    if (timing_log_csv == NULL)
+    {
+        Debug_ErrorMsgArg("Couldn't open %s for writing.", path);
+        return 0;
+    }
+
+    fprintf(timing_log_csv, "frame");
+    for (int i = 0; i < TIMING_NUM + 1; i++)
+        fprintf(timing_log_csv, ",%s_us", timing_names[i]);
+    fprintf(timing_log_csv, "\n");
+
+    snprintf(timing_log_json_path, sizeof(timing_log_json_path), "%s.json",
+             basename);
+
+    timing_log_frame = 0;
+    timing_stats_reset();
+    timing_update_enabled();
+
+    return 1;
+}
+
+void Timing_LogEnd(void)
+{
+    if (timing_log_csv == NULL)
+        return;
+
+    fclose(timing_log_csv);
+    timing_log_csv = NULL;
+
+    timing_update_enabled();
+
+    FILE *f = fopen(timing_log_json_path, "w");
+    if (f == NULL)
+    {
+        Debug_ErrorMsgArg("Couldn't open %s for writing.",
+                          timing_log_json_path);
+        return;
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"frames\": %u,\n", timing_stats[TIMING_FRAME].frames);
+    fprintf(f, "  \"subsystems\": {\n");
+
+    for (int i = 0; i < TIMING_NUM + 1; i++)
+    {
+        const _timing_stats_t *s = &timing_stats[i];
+        double mean = s->frames ? s->total_us / s->frames : 0.0;
+
+        fprintf(f, "    \"%s\": { \"mean_us\": %.1f, \"p50_us\": %.0f, "
+                "\"p90_us\": %.0f, \"p99_us\": %.0f, \"max_us\": %.1f, "
+                "\"total_ms\": %.1f }%s\n", timing_names[i], mean,
+                timing_stats_percentile(s, 50), timing_stats_percentile(s, 90),
+                timing_stats_percentile(s, 99), s->max_us,
+                s->total_us / 1000.0, (i < TIMING_NUM) ? "," : "");
+    }
+
+    fprintf(f, "  }\n");
+    fprintf(f, "}\n");
+
+    fclose(f);
+}
+
+#else // ENABLE_TIMING
+
+void Timing_FrameEnd(void)
+{
+}
+
+void Timing_OverlaySet(unused__ int enable)
+{
+}
+
+int Timing_OverlayGet(void)
+{
+    return 0;
+}
+
+void Timing_OverlayDraw(unused__ unsigned char *buffer, unused__ int width,
+                        unused__ int height)
+{
+}
+
+int Timing_LogStart(unused__ const char *basename)
+{
+    Debug_ErrorMsgArg("Timing support hasn't been compiled in.");
+    return 0;
+}
+
+void Timing_LogEnd(void)
+{
+}
+
+#endif // ENABLE_TIMING
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+//
+// Copyright (c) 2011-2015, 2019-2020, Antonio Niño Díaz
+//
+// GiiBiiAdvance - GBA/GB emulator
+
+#ifndef TIMING_UTILS__
+#define TIMING_UTILS__
+
+// Host time spent in each subsystem of the emulator. The time of each
+// subsystem is accumulated during a frame and added to a histogram at the end
+// of the frame. Scopes can be nested, the time of the inner scope isn't
+// counted in the outer one.
+//
+// The cores don't include this file. They have their own scopes, which call
+// Timing_Begin() and Timing_End() through callbacks while timing is enabled.
+//
+// If ENABLE_TIMING isn't defined, the scopes are compiled out and the rest of
+// the functions do nothing.
+
+#define TIMING_CPU      0
+#define TIMING_VIDEO    1 // PPU and scanline rendering
+#define TIMING_DMA      2
+#define TIMING_TIMERS   3
+#define TIMING_SOUND    4
+#define TIMING_CONVERT  5 // Conversion of the framebuffer to RGB
+#define TIMING_RENDER   6 // Output to the window
+#define TIMING_NUM      7
+
+#ifdef ENABLE_TIMING
+
+extern int timing_enabled;
+
+void Timing_Begin(int id);
+void Timing_End(void);
+
+#define TIMING_BEGIN(id)            \
+    do {                            \
+        if (timing_enabled)         \
+            Timing_Begin(id);       \
+    } while (0)
+
+#define TIMING_END(id)              \
+    do {                            \
+        if (timing_enabled)         \
+            Timing_End();           \
+    } while (0)
+
+#else
+
+#define TIMING_BEGIN(id) do { } while (0)
+#define TIMING_END(id)   do { } while (0)
+
+#endif
+
+// Called by the main loop after each emulated frame
+void Timing_FrameEnd(void);
+
+// Show the average times of the last frames on top of the game screen
+void Timing_OverlaySet(int enable);
+int Timing_OverlayGet(void);
+void Timing_OverlayDraw(unsigned char *buffer, int width, int height);
+
+// Save the times of every frame to "<basename>.csv" and a summary of the
+// session to "<basename>.json" when Timing_LogEnd() is called. Returns 1 on
+// success.
+int Timing_LogStart(const char *basename);
+void Timing_LogEnd(void);
+
+#endif // TIMING_UTILS__
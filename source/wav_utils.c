@@ -7,6 +7,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
 
 #include "debug_utils.h"
 
@@ -53,20 +56,37 @@ static uint32_t wav_sample_rate;
 #define WAV_NUMBER_CHANNELS     (2)
 #define WAV_BITS_PER_SAMPLE     (16)
 
-void WAV_FileEnd(void)
-{
-    // Check if there is an open file
-    if (wav_file == NULL)
-        return;
+// The samples of each frame are copied to a ring buffer, and a writer thread
+// saves them to the file in big blocks. The header is updated after every
+// block, so the file is valid up to the last block written even if the
+// emulator doesn't exit cleanly.
 
-    // Now that the final size is known, write the header
+// About 30 seconds of audio at 32 KHz
+#define WAV_RING_SIZE           (4 * 1024 * 1024)
+// Amount of data that wakes up the writer thread
+#define WAV_WRITE_THRESHOLD     (256 * 1024)
+// The data is written at least this often even if the threshold isn't reached
+#define WAV_WRITE_TIMEOUT_MS    (1000)
 
-    fseek(wav_file, 0, SEEK_END);
-    long int size = ftell(wav_file);
+static uint8_t *wav_ring;
+static size_t wav_ring_start;   // Read position of the writer thread
+static size_t wav_ring_count;   // Bytes waiting to be written
+static int wav_quit;
+static int wav_write_error;
+
+static SDL_mutex *wav_mutex;
+static SDL_cond *wav_data_cond;
+static SDL_cond *wav_space_cond;
+static SDL_Thread *wav_thread;
+
+static uint32_t wav_data_size; // Only used by the thread that writes the file
 
+static void _wav_write_header(uint32_t data_size)
+{
     wav_header_t header = {
         .chunk_id = 0x46464952,
-        .chunk_size = size - sizeof(uint32_t) - sizeof(uint32_t),
+        .chunk_size = sizeof(wav_header_t) - sizeof(uint32_t)
+                      - sizeof(uint32_t) + data_size,
         .format = 0x45564157,
 
         .subchunk_1_id = 0x20746D66,
@@ -79,7 +99,7 @@ void WAV_FileEnd(void)
         .bits_per_sample = WAV_BITS_PER_SAMPLE,
 
         .subchunk_2_id = 0x61746164,
-        .subchunk_2_size = size - sizeof(wav_header_t),
+        .subchunk_2_size = data_size,
     };
 
     fseek(wav_file, 0, SEEK_SET);
@@ -87,15 +107,158 @@ void WAV_FileEnd(void)
     if (fwrite(&header, sizeof(header), 1, wav_file) != 1)
         Debug_LogMsgArg("%s(): Can't write header.", __func__);
 
+    fseek(wav_file, 0, SEEK_END);
+}
+
+// Appends data to the file and updates the header so that it is valid even if
+// nothing else is written.
+static int _wav_write_block(const void *data, size_t size)
+{
+    if (size == 0)
+        return 1;
+
+    if (fwrite(data, size, 1, wav_file) != 1)
+        return 0;
+
+    wav_data_size += size;
+    _wav_write_header(wav_data_size);
+
+    return fflush(wav_file) == 0;
+}
+
+static int _wav_thread_func(void *data)
+{
+    (void)data;
+
+    SDL_LockMutex(wav_mutex);
+
+    while (1)
+    {
+        if ((wav_ring_count < WAV_WRITE_THRESHOLD) && !wav_quit)
+        {
+            SDL_CondWaitTimeout(wav_data_cond, wav_mutex,
+                                WAV_WRITE_TIMEOUT_MS);
+        }
+
+        if (wav_ring_count == 0)
+        {
+            if (wav_quit)
+                break; // Quit, and there is nothing left to write
+            continue;
+        }
+
+        // Write everything up to the end of the ring. The rest will be written
+        // in the next iteration.
+        size_t start = wav_ring_start;
+        size_t size = wav_ring_count;
+        if (start + size > WAV_RING_SIZE)
+            size = WAV_RING_SIZE - start;
+
+        // The emulation thread only writes to the free part of the ring, so
+        // this block can be written without holding the lock.
+        SDL_UnlockMutex(wav_mutex);
+
+        int ok = _wav_write_block(wav_ring + start, size);
+
+        SDL_LockMutex(wav_mutex);
+
+        if (!ok)
+            wav_write_error = 1;
+
+        wav_ring_start = (start + size) % WAV_RING_SIZE;
+        wav_ring_count -= size;
+        SDL_CondSignal(wav_space_cond);
+    }
+
+    SDL_UnlockMutex(wav_mutex);
+
+    return 0;
+}
+
+static void _wav_thread_end(void)
+{
+    if (wav_thread != NULL)
+    {
+        SDL_LockMutex(wav_mutex);
+        wav_quit = 1;
+        SDL_CondSignal(wav_data_cond);
+        SDL_UnlockMutex(wav_mutex);
+
+        SDL_WaitThread(wav_thread, NULL);
+        wav_thread = NULL;
+    }
+
+    SDL_DestroyCond(wav_space_cond);
+    SDL_DestroyCond(wav_data_cond);
+    SDL_DestroyMutex(wav_mutex);
+    wav_space_cond = NULL;
+    wav_data_cond = NULL;
+    wav_mutex = NULL;
+
+    free(wav_ring);
+    wav_ring = NULL;
+}
+
+// If this fails the data is written from the emulation thread
+static int _wav_thread_start(void)
+{
+    wav_ring = malloc(WAV_RING_SIZE);
+    wav_mutex = SDL_CreateMutex();
+    wav_data_cond = SDL_CreateCond();
+    wav_space_cond = SDL_CreateCond();
+    if ((wav_ring == NULL) || (wav_mutex == NULL) || (wav_data_cond == NULL)
+        || (wav_space_cond == NULL))
+    {
+        Debug_LogMsgArg("%s(): Failed to create writer: %s", __func__,
+                        SDL_GetError());
+        _wav_thread_end();
+        return 0;
+    }
+
+    wav_ring_start = 0;
+    wav_ring_count = 0;
+    wav_quit = 0;
+
+    wav_thread = SDL_CreateThread(_wav_thread_func, "WAV", NULL);
+    if (wav_thread == NULL)
+    {
+        Debug_LogMsgArg("%s(): Failed to create thread: %s", __func__,
+                        SDL_GetError());
+        _wav_thread_end();
+        return 0;
+    }
+
+    return 1;
+}
+
+void WAV_FileEnd(void)
+{
+    // Check if there is an open file
+    if (wav_file == NULL)
+        return;
+
+    // Wait until all the data in the ring buffer has been written
+    _wav_thread_end();
+
+    if (wav_write_error)
+        Debug_LogMsgArg("%s(): Failed to write data.", __func__);
+
+    // The header is already up to date, but write it again in case the last
+    // block couldn't be written.
+    _wav_write_header(wav_data_size);
+
     fclose(wav_file);
 
-    Debug_LogMsgArg("%s: File saved. Size: %ld", __func__, size);
+    Debug_LogMsgArg("%s: File saved. Size: %lu", __func__,
+                    (unsigned long)(wav_data_size + sizeof(wav_header_t)));
 
     wav_file = NULL;
 }
 
 void WAV_FileStart(const char *path, uint32_t sample_rate)
 {
+    static int atexit_registered = 0;
+
     if (path == NULL)
         path = "audio.wav";
 
@@ -109,17 +272,21 @@ void WAV_FileStart(const char *path, uint32_t sample_rate)
         return;
     }
 
-    wav_header_t header =  { 0 };
-    if (fwrite(&header, sizeof(header), 1, wav_file) != 1)
-    {
-        Debug_LogMsgArg("%s(): Can't allocate space for header.", __func__);
-        return;
-    }
-
     wav_sample_rate = sample_rate;
+    wav_data_size = 0;
+    wav_write_error = 0;
+
+    // Write a valid header for an empty file, it is updated as data is written
+    _wav_write_header(0);
+
+    _wav_thread_start();
 
     // Close file when the program exits
-    atexit(WAV_FileEnd);
+    if (!atexit_registered)
+    {
+        atexit(WAV_FileEnd);
+        atexit_registered = 1;
+    }
 }
 
 int WAV_FileIsOpen(void)
@@ -135,6 +302,39 @@ void WAV_FileStream(int16_t *buffer, size_t size)
     if (wav_file == NULL)
         return;
 
-    if (fwrite(buffer, size, 1, wav_file) != 1)
-        Debug_LogMsgArg("%s(): Failed to write data.", __func__);
+    if (wav_thread == NULL)
+    {
+        if (!_wav_write_block(buffer, size))
+            Debug_LogMsgArg("%s(): Failed to write data.", __func__);
+        return;
+    }
+
+    const uint8_t *src = (const uint8_t *)buffer;
+
+    SDL_LockMutex(wav_mutex);
+
+    while (size > 0)
+    {
+        // The recording has to be lossless, so wait if the writer thread is
+        // too far behind. This should only happen if the disk is very slow.
+        while (wav_ring_count == WAV_RING_SIZE)
+            SDL_CondWait(wav_space_cond, wav_mutex);
+
+        size_t end = (wav_ring_start + wav_ring_count) % WAV_RING_SIZE;
+        size_t copy = WAV_RING_SIZE - wav_ring_count;
+        if (copy > WAV_RING_SIZE - end)
+            copy = WAV_RING_SIZE - end;
+        if (copy > size)
+            copy = size;
+
+        memcpy(wav_ring + end, src, copy);
+        wav_ring_count += copy;
+        src += copy;
+        size -= copy;
+    }
+
+    if (wav_ring_count >= WAV_WRITE_THRESHOLD)
+        SDL_CondSignal(wav_data_cond);
+
+    SDL_UnlockMutex(wav_mutex);
 }
@@ -10,6 +10,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// WAV recorder. The samples are buffered and written to the file by a
+// background thread, and the header is kept up to date as the file grows.
+
 void WAV_FileStart(const char *path, uint32_t sample_rate);
 void WAV_FileEnd(void);
 
@@ -6,7 +6,11 @@
 
 extern "C"
 {
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
 
 #include "config.h"
 #include "debug_utils.h"
@@ -15,106 +19,252 @@ extern "C"
 #include "gb_core/camera.h"
 }
 
-#ifdef NO_CAMERA_EMULATION
+#ifndef NO_CAMERA_EMULATION
+#include "opencv2/opencv.hpp"
+#endif
 
-extern "C" int Webcam_Init(void)
+// Frames are captured by a thread and converted to the size of the sensor.
+// There are 3 buffers: the thread writes to one, the emulator reads from
+// another one, and the third one holds the latest complete frame. Buffers are
+// exchanged atomically, so no locks are needed.
+
+typedef unsigned char webcam_frame[GBCAM_SENSOR_H][GBCAM_SENSOR_W];
+
+static webcam_frame webcam_frames[3];
+
+#define WEBCAM_FRAME_NEW 4 // Set in webcam_latest if it hasn't been read
+
+static SDL_atomic_t webcam_latest; // Index of the latest frame + flag
+static int webcam_back; // Only used by the thread
+static int webcam_front; // Only used by the emulator
+static int webcam_has_frame;
+
+static SDL_Thread *webcam_thread = NULL;
+static SDL_atomic_t webcam_quit;
+static SDL_atomic_t webcam_failed;
+
+// Returns 1 on success
+typedef int (*webcam_capture_fn)(unsigned char *dst);
+static webcam_capture_fn webcam_capture = NULL;
+
+// Time between frames of sources that don't block until a frame is ready
+static Uint32 webcam_frame_time_ms = 0;
+
+static void webcam_random_output(void)
 {
-    Debug_ErrorMsgArg("This version of GiiBiiAdvance was compiled without "
-                      "webcam support.");
-    return 0;
+    for (int j = 0; j < GBCAM_SENSOR_H; j++)
+    {
+        for (int i = 0; i < GBCAM_SENSOR_W; i++)
+            gb_camera_webcam_output[j][i] = rand() & 0xFF;
+    }
 }
 
-extern "C" int Webcam_GetFrame(void)
+//------------------------------------------------------------------------------
+
+// Raw files are a sequence of frames of the size of the sensor, with one byte
+// per pixel. They are played in a loop.
+
+static FILE *webcam_raw_file = NULL;
+
+static int webcam_raw_capture(unsigned char *dst)
 {
-    // Random output
+    size_t size = GBCAM_SENSOR_W * GBCAM_SENSOR_H;
 
-    for (int j = 0; j < GBCAM_SENSOR_H; j++)
+    if (fread(dst, 1, size, webcam_raw_file) == size)
+        return 1;
+
+    rewind(webcam_raw_file);
+
+    return fread(dst, 1, size, webcam_raw_file) == size;
+}
+
+static int webcam_raw_open(const char *path)
+{
+    webcam_raw_file = fopen(path, "rb");
+    if (webcam_raw_file == NULL)
     {
-        for (int i = 0; i < GBCAM_SENSOR_W; i++)
-            gb_camera_webcam_output[i][j] = rand() & 0xFF;
+        Debug_ErrorMsgArg("Couldn't open %s", path);
+        return 0;
     }
 
+    webcam_capture = webcam_raw_capture;
+    webcam_frame_time_ms = 1000 / 30;
+
+    return 1;
+}
+
+static void webcam_raw_close(void)
+{
+    if (webcam_raw_file == NULL)
+        return;
+
+    fclose(webcam_raw_file);
+    webcam_raw_file = NULL;
+}
+
+static int webcam_file_is_raw(const char *path)
+{
+    size_t len = strlen(path);
+    if (len < 4)
+        return 0;
+
+    const char *ext = &path[len - 4];
+    return (strcmp(ext, ".raw") == 0) || (strcmp(ext, ".RAW") == 0);
+}
+
+//------------------------------------------------------------------------------
+
+#ifdef NO_CAMERA_EMULATION
+
+static int webcam_cv_open(void)
+{
+    Debug_ErrorMsgArg("This version of GiiBiiAdvance was compiled without "
+                      "webcam support.");
     return 0;
 }
 
-extern "C" void Webcam_End(void)
+static void webcam_cv_close(void)
 {
     // Do nothing
 }
 
 #else
 
-#include "opencv2/opencv.hpp"
-
 static cv::VideoCapture cap;
 
 static int camera_enabled = 0;
 static int camera_zoomfactor = 1;
 
-// Returns 1 on success
-extern "C" int Webcam_Init(void)
+static int webcam_cv_capture(unsigned char *dst)
 {
-    if (camera_enabled)
-        return 1;
-
-    // Try to open the default camera
-    if (!cap.open(EmulatorConfig.webcam_select))
+    cv::Mat frame, convertedframe;
+    cap >> frame;
+    if (frame.empty())
     {
-        Debug_DebugMsgArg("OpenCV error:\n"
-                          "Couldn't open camera %d",
-                          EmulatorConfig.webcam_select);
-        return 0;
+        // Video files are played in a loop
+        if (EmulatorConfig.webcam_file[0] == '\0')
+            return 0;
+
+        cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+        cap >> frame;
+        if (frame.empty())
+            return 0;
     }
 
-    camera_enabled = 1;
+    frame.convertTo(convertedframe, CV_8U);
+    unsigned char *p = convertedframe.data;
 
-    // TODO : Select resolution from configuration file?
+    cv::Size size = convertedframe.size();
+    int w = size.width;
+    //int h = size.height;
 
-    // This is the minimum standard resolution that works with GB Camera
-    // (128 x (112 + 4))
-    int w = 160;
-    int h = 120;
+    if (convertedframe.channels() != 3)
+        return 0;
+
+    // How much to jump from one element of a row to the next one
+    size_t step = convertedframe.elemSize();
 
-    while (1) // Get the smallest valid resolution
+    for (int j = 0; j < GBCAM_SENSOR_H; j++)
     {
-        cap.set(cv::CAP_PROP_FRAME_WIDTH, w);
-        cap.set(cv::CAP_PROP_FRAME_HEIGHT, h);
+        for (int i = 0; i < GBCAM_SENSOR_W; i++)
+        {
+            size_t index = ((j * camera_zoomfactor) * w * step)
+                           + ((i * camera_zoomfactor) * 3);
+
+            int r = p[index + 0];
+            int g = p[index + 1];
+            int b = p[index + 2];
+
+            *dst++ = (2 * r + 5 * g + 1 * b) >> 3;
+        }
+    }
+
+    return 1;
+}
 
-        w = cap.get(cv::CAP_PROP_FRAME_WIDTH);
-        h = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+// Returns 1 on success
+static int webcam_cv_open(void)
+{
+    if (camera_enabled)
+        return 1;
 
-        if ((w >= GBCAM_SENSOR_W) && (h >= GBCAM_SENSOR_H))
+    if (EmulatorConfig.webcam_file[0] != '\0')
+    {
+        // Video file or image sequence, like "frame_%03d.png"
+        if (!cap.open(EmulatorConfig.webcam_file))
         {
-            break;
+            Debug_DebugMsgArg("OpenCV error:\n"
+                              "Couldn't open %s",
+                              EmulatorConfig.webcam_file);
+            return 0;
         }
-        else
+
+        webcam_frame_time_ms = 1000 / 30;
+    }
+    else
+    {
+        // Try to open the default camera
+        if (!cap.open(EmulatorConfig.webcam_select))
         {
-            w *= 2;
-            h *= 2;
+            Debug_DebugMsgArg("OpenCV error:\n"
+                              "Couldn't open camera %d",
+                              EmulatorConfig.webcam_select);
+            return 0;
         }
 
-        if (w >= 1024) // Too big, stop now.
-            break;
+        // Reading from a webcam blocks until there is a new frame
+        webcam_frame_time_ms = 0;
+
+        // TODO : Select resolution from configuration file?
+
+        // This is the minimum standard resolution that works with GB Camera
+        // (128 x (112 + 4))
+        int w = 160;
+        int h = 120;
+
+        while (1) // Get the smallest valid resolution
+        {
+            cap.set(cv::CAP_PROP_FRAME_WIDTH, w);
+            cap.set(cv::CAP_PROP_FRAME_HEIGHT, h);
+
+            w = cap.get(cv::CAP_PROP_FRAME_WIDTH);
+            h = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+
+            if ((w >= GBCAM_SENSOR_W) && (h >= GBCAM_SENSOR_H))
+            {
+                break;
+            }
+            else
+            {
+                w *= 2;
+                h *= 2;
+            }
+
+            if (w >= 1024) // Too big, stop now.
+                break;
+        }
     }
 
+    camera_enabled = 1;
+
     cv::Mat frame;
     cap >> frame;
     if (frame.empty())
     {
         Webcam_End();
         Debug_ErrorMsgArg("OpenCV error: Couldn't get frame");
-        return -1;
+        return 0;
     }
 
     cv::Size size = frame.size();
-    w = size.width;
-    h = size.height;
+    int w = size.width;
+    int h = size.height;
 
     Debug_LogMsgArg("Camera resolution is: %dx%d", w, h);
     if ((w < GBCAM_SENSOR_W) || (h < GBCAM_SENSOR_H))
     {
         Debug_ErrorMsgArg("Camera resolution is too small..");
-        GB_CameraEnd();
+        Webcam_End();
         return 0;
     }
 
@@ -123,65 +273,124 @@ extern "C" int Webcam_Init(void)
 
     camera_zoomfactor = (xfactor > yfactor) ? yfactor : xfactor; // Min
 
+    webcam_capture = webcam_cv_capture;
+
     return 1;
 }
 
-extern "C" int Webcam_GetFrame(void)
+static void webcam_cv_close(void)
 {
     if (camera_enabled == 0)
+        return;
+
+    cap.release();
+
+    camera_enabled = 0;
+}
+
+#endif // NO_CAMERA_EMULATION
+
+//------------------------------------------------------------------------------
+
+static int _webcam_thread_func(void *data)
+{
+    (void)data;
+
+    while (!SDL_AtomicGet(&webcam_quit))
     {
-        // Random output
-        for (int j = 0; j < GBCAM_SENSOR_H; j++)
+        Uint32 start = SDL_GetTicks();
+
+        if (!webcam_capture(&webcam_frames[webcam_back][0][0]))
         {
-            for (int i = 0; i < GBCAM_SENSOR_W; i++)
-                gb_camera_webcam_output[i][j] = rand() & 0xFF;
+            SDL_AtomicSet(&webcam_failed, 1);
+            break;
         }
+
+        // Publish the new frame and get the old one to write the next frame
+        int old = SDL_AtomicSet(&webcam_latest,
+                                webcam_back | WEBCAM_FRAME_NEW);
+        webcam_back = old & ~WEBCAM_FRAME_NEW;
+
+        Uint32 elapsed = SDL_GetTicks() - start;
+        if (elapsed < webcam_frame_time_ms)
+            SDL_Delay(webcam_frame_time_ms - elapsed);
+    }
+
+    return 0;
+}
+
+extern "C" int Webcam_Init(void)
+{
+    if (webcam_thread != NULL)
+        return 1;
+
+    int ok;
+    if ((EmulatorConfig.webcam_file[0] != '\0')
+        && webcam_file_is_raw(EmulatorConfig.webcam_file))
+    {
+        ok = webcam_raw_open(EmulatorConfig.webcam_file);
     }
     else
     {
-        // Get image
-        cv::Mat frame, convertedframe;
-        cap >> frame;
-        if (frame.empty())
-        {
-            Webcam_End();
-            Debug_ErrorMsgArg("OpenCV error: Couldn't get frame");
-            return -1;
-        }
+        ok = webcam_cv_open();
+    }
 
-        frame.convertTo(convertedframe, CV_8U);
-        unsigned char *p = convertedframe.data;
+    if (!ok)
+        return 0;
 
-        cv::Size size = convertedframe.size();
-        int w = size.width;
-        //int h = size.height;
+    webcam_back = 0;
+    webcam_front = 1;
+    SDL_AtomicSet(&webcam_latest, 2);
+    webcam_has_frame = 0;
 
-        int channels = convertedframe.channels();
-        if (channels != 3)
-        {
-            Debug_ErrorMsgArg("Invalid camera output.\n"
-                              "Channels = %d",
-                              channels);
-            return -1;
-        }
+    SDL_AtomicSet(&webcam_quit, 0);
+    SDL_AtomicSet(&webcam_failed, 0);
 
-        // How much to jump from one element of a row to the next one
-        size_t step = convertedframe.elemSize();
+    webcam_thread = SDL_CreateThread(_webcam_thread_func, "Webcam", NULL);
+    if (webcam_thread == NULL)
+    {
+        Debug_ErrorMsgArg("Webcam: Failed to create thread: %s",
+                          SDL_GetError());
+        Webcam_End();
+        return 0;
+    }
 
-        for (int j = 0; j < GBCAM_SENSOR_H; j++)
-        {
-            for (int i = 0; i < GBCAM_SENSOR_W; i++)
-            {
-                size_t index = ((j * camera_zoomfactor) * w * step)
-                               + ((i * camera_zoomfactor) * 3);
+    return 1;
+}
 
-                int r = p[index + 0];
-                int g = p[index + 1];
-                int b = p[index + 2];
+extern "C" int Webcam_GetFrame(void)
+{
+    if (webcam_thread == NULL)
+    {
+        webcam_random_output();
+        return 0;
+    }
 
-                gb_camera_webcam_output[i][j] = (2 * r + 5 * g + 1 * b) >> 3;
-            }
-        }
+    if (SDL_AtomicGet(&webcam_failed))
+    {
+        Webcam_End();
+        Debug_ErrorMsgArg("Webcam: Couldn't get frame");
+        return -1;
+    }
+
+    // Get the latest frame if there is a new one
+    if (SDL_AtomicGet(&webcam_latest) & WEBCAM_FRAME_NEW)
+    {
+        int old = SDL_AtomicSet(&webcam_latest, webcam_front);
+        webcam_front = old & ~WEBCAM_FRAME_NEW;
+        webcam_has_frame = 1;
+    }
+
+    if (!webcam_has_frame)
+    {
+        webcam_random_output();
+        return 0;
+    }
+
+    for (int j = 0; j < GBCAM_SENSOR_H; j++)
+    {
+        for (int i = 0; i < GBCAM_SENSOR_W; i++)
+            gb_camera_webcam_output[j][i] = webcam_frames[webcam_front][j][i];
     }
 
     return 0;
@@ -189,12 +398,15 @@ extern "C" int Webcam_GetFrame(void)
 
 extern "C" void Webcam_End(void)
 {
-    if (camera_enabled == 0)
-        return;
+    if (webcam_thread != NULL)
+    {
+        SDL_AtomicSet(&webcam_quit, 1);
+        SDL_WaitThread(webcam_thread, NULL);
+        webcam_thread = NULL;
+    }
 
-    cap.release();
+    webcam_raw_close();
+    webcam_cv_close();
 
-    camera_enabled = 0;
+    webcam_capture = NULL;
 }
-
-#endif // ENABLE_OPENCV
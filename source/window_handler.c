@@ -15,6 +15,7 @@
 #endif
 
 #include "debug_utils.h"
+#include "emu_thread.h"
 #include "window_handler.h"
 
 #define MAX_WINDOWS 20
@@ -419,6 +420,11 @@ void WH_HandleEvents(void)
 
     while (SDL_PollEvent(&e))
     {
+        // The callbacks can access the state of the emulated system. The lock
+        // isn't held while polling because that can block while a window is
+        // being dragged in some systems.
+        EmuThread_Lock();
+
         // Handle window events
         if (_wh_handle_event(&e) == 0)
         {
@@ -428,6 +434,8 @@ void WH_HandleEvents(void)
                     gMainWindow->mEventCallback(&e);
             }
         }
+
+        EmuThread_Unlock();
     }
 }
 